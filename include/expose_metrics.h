@@ -7,12 +7,15 @@
 // #include "read_cpu_usage.h"
 #include "globant.h"
 #include <errno.h>
+#include <limits.h>
 #include <prom.h>
 #include <promhttp.h>
 #include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h> // Para sleep
 
 /**
@@ -33,11 +36,15 @@ int update_memory_gauge(void);
 
 /**
  * @brief Actualiza las métricas de disco.
+ *
+ * Los tiempos acumulados sólo se anotan; se publican como contadores en publish_counter_rates.
  */
 void update_disk_gauge(void);
 
 /**
  * @brief Actualiza las métricas de red.
+ *
+ * Los contadores acumulados sólo se anotan; se publican en publish_counter_rates.
  */
 void update_network_gauge(void);
 
@@ -48,22 +55,52 @@ void update_proccess_gauge(void);
 
 /**
  * @brief Actualiza la métrica de cambios de contexto.
+ *
+ * El contador acumulado sólo se anota; se publica en publish_counter_rates.
  */
 void update_context_switches_gauge(void);
 
 /**
- * @brief Función del hilo para exponer las métricas vía HTTP en el puerto 8000.
- * @param arg Argumento no utilizado.
- * @return NULL
+ * @brief Publica los contadores acumulados anotados en el ciclo.
+ *
+ * Calcula en una sola pasada cuánto aumentó cada contador del kernel desde el ciclo anterior, teniendo en cuenta
+ * reinicios y desbordes, y lo suma a su counter. Si la configuración lo pide, también actualiza el gauge con la tasa
+ * por segundo de cada uno. Debe llamarse una vez por ciclo, después de las funciones update_*.
  */
-void* expose_metrics(void* arg);
+void publish_counter_rates(void);
 
 /**
- * @brief Inicializar mutex y métricas.
+ * @brief Guarda en el historial reciente los valores de todos los contadores y gauges del ciclo.
+ *
+ * Cada serie guarda sus muestras comprimidas como en Gorilla, con memoria acotada por serie; el uso de memoria del
+ * historial se publica en sus propios gauges. No hace nada si el historial no está habilitado en la configuración.
  */
-int init_metrics(Config);
+void record_history(void);
+
+/**
+ * @brief Registra la duración de un ciclo de recolección en el resumen de latencia del agente.
+ * @param seconds Segundos que tardó el ciclo.
+ */
+void observe_collection_duration(double seconds);
 
 /**
- * @brief Destructor de mutex
+ * @brief Función del hilo para exponer las métricas vía HTTP.
+ *
+ * Escucha en la dirección y el puerto TCP configurados y, si se indica, en un socket Unix para que un scraper
+ * local no atraviese la pila TCP.
+ * @param arg Puntero a la Config con las opciones del servidor HTTP.
+ * @return NULL
+ */
+void* expose_metrics(void* arg);
+
+/**
+ * @brief Inicializar métricas.
+ *
+ * Sólo se crean las métricas de los grupos listados en la configuración; las demás nunca se reservan. Las métricas
+ * relacionadas (memoria, disco y red) se publican como grupo: cada actualización las confirma juntas, y los scrapes y
+ * los exportadores las leen siempre del mismo ciclo. Los lectores se turnan con el lock del registro, pero nunca
+ * bloquean al hilo que actualiza el grupo. Los contadores acumulados del kernel se exponen como counters y,
+ * si rate_gauges está habilitado, con un gauge de su tasa por segundo. Si se configura el historial, también se crea
+ * y se sirve en /api/v1/query_range.
  */
-void destroy_mutex(void);
+int init_metrics(Config);
@@ -6,9 +6,23 @@
  */
 typedef struct
 {
-    int sampling_interval; // Intervalo de muestreo
-    char** metrics;        // Nombres de las métricas
-    int metrics_count;     // Cantidad de métricas
+    int sampling_interval;        // Intervalo de muestreo
+    char** metrics;               // Nombres de las métricas
+    int metrics_count;            // Cantidad de métricas
+    char* remote_write_url;       // URL del receptor remote_write (NULL si está deshabilitado)
+    char* remote_write_wal;       // Ruta del WAL para lotes no entregados (NULL si no se usa)
+    int remote_write_concurrency; // Cantidad de shards, cada uno con su hilo de envío (0 usa el valor por defecto)
+    char* udp_host;               // Host del receptor UDP (NULL si el exportador está deshabilitado)
+    int udp_port;                 // Puerto del receptor UDP (0 usa el del formato)
+    int udp_statsd;               // 1 para StatsD, 0 para InfluxDB line protocol
+    char* http_bind_address;      // Dirección del servidor HTTP (NULL escucha en todas las interfaces)
+    int http_port;                // Puerto del servidor HTTP (0 deshabilita TCP)
+    char* http_unix_socket;       // Socket Unix del servidor HTTP (NULL si no se usa)
+    char* shm_name;               // Segmento de memoria compartida (NULL si no se publica)
+    int shm_capacity;             // Cantidad máxima de series en el segmento
+    int rate_gauges;              // 1 para publicar la tasa por segundo de cada contador acumulado
+    int history_retention;        // Segundos de historial reciente en memoria (0 deshabilita el historial)
+    int history_series_bytes;     // Memoria máxima de cada serie del historial (0 usa el valor por defecto)
 } Config;
 
 /**
@@ -19,6 +33,21 @@ typedef struct
  */
 #define intervalo 10
 
+/**
+ * @brief Puerto HTTP por defecto del exportador
+ */
+#define HTTP_PORT 8000
+
+/**
+ * @brief Nombre por defecto del segmento de memoria compartida
+ */
+#define SHM_NAME "/sistema_monitoreo"
+
+/**
+ * @brief Cantidad por defecto de series del segmento de memoria compartida
+ */
+#define SHM_CAPACITY 1024
+
 /**
  * @brief Tamaño del buffer
  * Tamaño del buffer para leer archivos en el sistema de archivos.
@@ -0,0 +1,334 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/**
+ * @file prom_bench.c
+ * @brief Throughput of the hot paths of the library
+ *
+ * Each case runs for a fixed number of iterations and prints the operations per second. Build with BENCH=1 and run
+ * the prom_bench executable; pass a case name to run only that case. The contention case splits the same number of
+ * sets across a growing number of threads, so its aggregate rate only rises with the thread count on a machine with
+ * that many cores. The sharded case does the same for increments of one counter, first a regular one and then a
+ * sharded one.
+ *
+ * The history_record case records the registry into a prom_history_t every 100 ms of simulated time, with every series
+ * changing between records, and reports the samples appended per second and the bytes each sample takes.
+ *
+ * The large_registry case reports memory rather than throughput: the growth of the resident set, the calls into libc's
+ * allocator and the bytes libc holds, for a registry of PROM_BENCH_LARGE_METRICS metrics of PROM_BENCH_SERIES series
+ * each. Run it alone, in a build with and without PROM_SLAB, to compare the allocators.
+ */
+
+#include <malloc.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "prom.h"
+
+#define PROM_BENCH_SERIES 512
+#define PROM_BENCH_SETS 2000000
+#define PROM_BENCH_SCRAPES 2000
+#define PROM_BENCH_MAX_THREADS 64
+#define PROM_BENCH_LARGE_METRICS 128
+
+static prom_collector_registry_t *bench_registry;
+static prom_gauge_t *bench_gauge;
+static char bench_label_values[PROM_BENCH_SERIES][2][16];
+
+// Count the calls into libc's allocator by interposing it. free is left alone since it does not allocate.
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static _Atomic size_t prom_bench_libc_calls;
+
+void *malloc(size_t size) {
+  atomic_fetch_add_explicit(&prom_bench_libc_calls, 1, memory_order_relaxed);
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+  atomic_fetch_add_explicit(&prom_bench_libc_calls, 1, memory_order_relaxed);
+  return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+  atomic_fetch_add_explicit(&prom_bench_libc_calls, 1, memory_order_relaxed);
+  return __libc_realloc(ptr, size);
+}
+
+static double prom_bench_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void prom_bench_report(const char *name, size_t ops, double seconds) {
+  printf("%-24s %12zu ops %10.3f s %14.0f ops/s\n", name, ops, seconds, ops / seconds);
+}
+
+static void prom_bench_init(void) {
+  // A registry without the process collector so that procfs reads do not dominate the scrape
+  bench_registry = prom_collector_registry_new("bench");
+  const char *keys[] = {"device", "kind"};
+  bench_gauge = prom_gauge_new("bench_gauge", "gauge updated by the benchmark", 2, keys);
+  prom_collector_t *collector = prom_collector_new("bench");
+  prom_collector_add_metric(collector, bench_gauge);
+  prom_collector_registry_register_collector(bench_registry, collector);
+  for (int i = 0; i < PROM_BENCH_SERIES; i++) {
+    sprintf(bench_label_values[i][0], "dev%d", i / 4);
+    sprintf(bench_label_values[i][1], "kind%d", i % 4);
+    const char *values[] = {bench_label_values[i][0], bench_label_values[i][1]};
+    prom_gauge_set(bench_gauge, i, values);
+  }
+}
+
+// Sets a labeled gauge, cycling through every series
+static void prom_bench_set(void) {
+  double start = prom_bench_now();
+  for (size_t i = 0; i < PROM_BENCH_SETS; i++) {
+    size_t series = i % PROM_BENCH_SERIES;
+    const char *values[] = {bench_label_values[series][0], bench_label_values[series][1]};
+    prom_gauge_set(bench_gauge, (double)i, values);
+  }
+  prom_bench_report("gauge_set", PROM_BENCH_SETS, prom_bench_now() - start);
+}
+
+// Sets the same series through children resolved up front
+static void prom_bench_child_set(void) {
+  prom_metric_sample_t *children[PROM_BENCH_SERIES];
+  for (int i = 0; i < PROM_BENCH_SERIES; i++) {
+    const char *values[] = {bench_label_values[i][0], bench_label_values[i][1]};
+    children[i] = prom_gauge_child(bench_gauge, values);
+  }
+  double start = prom_bench_now();
+  for (size_t i = 0; i < PROM_BENCH_SETS; i++) prom_metric_sample_set(children[i % PROM_BENCH_SERIES], (double)i);
+  prom_bench_report("gauge_child_set", PROM_BENCH_SETS, prom_bench_now() - start);
+}
+
+// Observes an unlabeled histogram with values spread across all of its buckets
+static void prom_bench_histogram_observe(void) {
+  prom_histogram_t *histogram = prom_histogram_new("bench_histogram", "histogram observed by the benchmark",
+                                                   prom_histogram_buckets_exponential(1.0, 2.0, 16), 0, NULL);
+  double start = prom_bench_now();
+  for (size_t i = 0; i < PROM_BENCH_SETS; i++) prom_histogram_observe(histogram, (double)(i % 70000), NULL);
+  prom_bench_report("histogram_observe", PROM_BENCH_SETS, prom_bench_now() - start);
+  prom_histogram_destroy(histogram);
+}
+
+// Observes an unlabeled summary through its child with values spread over a wide range
+static void prom_bench_summary_observe(void) {
+  prom_summary_t *summary = prom_summary_new("bench_summary", "summary observed by the benchmark", 0, NULL, 0, 0, NULL);
+  prom_metric_sample_summary_t *child = prom_summary_child(summary, NULL);
+  double start = prom_bench_now();
+  for (size_t i = 0; i < PROM_BENCH_SETS; i++) prom_metric_sample_summary_observe(child, (double)(i % 70000));
+  prom_bench_report("summary_observe", PROM_BENCH_SETS, prom_bench_now() - start);
+  prom_summary_destroy(summary);
+}
+
+// Observes an unlabeled native histogram through its child with values spread over a wide range
+static void prom_bench_native_histogram_observe(void) {
+  prom_native_histogram_t *histogram =
+      prom_native_histogram_new("bench_native_histogram", "native histogram observed by the benchmark", 3, 0, 0, NULL);
+  prom_metric_sample_native_histogram_t *child = prom_native_histogram_child(histogram, NULL);
+  double start = prom_bench_now();
+  for (size_t i = 0; i < PROM_BENCH_SETS; i++) {
+    prom_metric_sample_native_histogram_observe(child, (double)(i % 70000) / 7.0);
+  }
+  prom_bench_report("native_histogram_observe", PROM_BENCH_SETS, prom_bench_now() - start);
+  prom_native_histogram_destroy(histogram);
+}
+
+static void *prom_bench_set_thread(void *arg) {
+  size_t thread = (size_t)arg;
+  size_t sets = (size_t)PROM_BENCH_SETS / PROM_BENCH_MAX_THREADS;
+  // Threads start at different series so that they do not all write the same sample at once
+  for (size_t i = 0; i < sets; i++) {
+    size_t series = (i + thread * 97) % PROM_BENCH_SERIES;
+    const char *values[] = {bench_label_values[series][0], bench_label_values[series][1]};
+    prom_gauge_set(bench_gauge, (double)i, values);
+  }
+  return NULL;
+}
+
+// Sets a labeled gauge from many threads at once
+static void prom_bench_contention(void) {
+  for (size_t threads = 1; threads <= PROM_BENCH_MAX_THREADS; threads *= 2) {
+    pthread_t tids[PROM_BENCH_MAX_THREADS];
+    size_t ops = threads * ((size_t)PROM_BENCH_SETS / PROM_BENCH_MAX_THREADS);
+    double start = prom_bench_now();
+    for (size_t t = 0; t < threads; t++) pthread_create(&tids[t], NULL, prom_bench_set_thread, (void *)t);
+    for (size_t t = 0; t < threads; t++) pthread_join(tids[t], NULL);
+    char name[32];
+    sprintf(name, "contention/%zu", threads);
+    prom_bench_report(name, ops, prom_bench_now() - start);
+  }
+}
+
+static void *prom_bench_inc_thread(void *arg) {
+  prom_metric_sample_t *child = (prom_metric_sample_t *)arg;
+  size_t incs = (size_t)PROM_BENCH_SETS / PROM_BENCH_MAX_THREADS;
+  for (size_t i = 0; i < incs; i++) prom_metric_sample_add(child, 1.0);
+  return NULL;
+}
+
+// Increments one counter from many threads at once, with and without sharding
+static void prom_bench_sharded(void) {
+  prom_counter_t *counters[] = {prom_counter_new("bench_counter", "counter incremented by the benchmark", 0, NULL),
+                                prom_counter_sharded_new("bench_counter", "counter incremented by the benchmark", 0,
+                                                         NULL)};
+  const char *names[] = {"counter", "sharded"};
+  for (size_t c = 0; c < 2; c++) {
+    prom_metric_sample_t *child = prom_counter_child(counters[c], NULL);
+    for (size_t threads = 1; threads <= PROM_BENCH_MAX_THREADS; threads *= 2) {
+      pthread_t tids[PROM_BENCH_MAX_THREADS];
+      size_t ops = threads * ((size_t)PROM_BENCH_SETS / PROM_BENCH_MAX_THREADS);
+      double start = prom_bench_now();
+      for (size_t t = 0; t < threads; t++) pthread_create(&tids[t], NULL, prom_bench_inc_thread, child);
+      for (size_t t = 0; t < threads; t++) pthread_join(tids[t], NULL);
+      char name[32];
+      sprintf(name, "%s/%zu", names[c], threads);
+      prom_bench_report(name, ops, prom_bench_now() - start);
+    }
+    prom_counter_destroy(counters[c]);
+  }
+}
+
+// Renders the registry in the text format
+static void prom_bench_scrape(void) {
+  size_t bytes = 0;
+  double start = prom_bench_now();
+  for (size_t i = 0; i < PROM_BENCH_SCRAPES; i++) {
+    const char *buf = prom_collector_registry_bridge(bench_registry);
+    bytes += strlen(buf);
+    free((void *)buf);
+  }
+  double seconds = prom_bench_now() - start;
+  prom_bench_report("scrape", PROM_BENCH_SCRAPES, seconds);
+  printf("%-24s %12zu bytes/scrape\n", "", bytes / PROM_BENCH_SCRAPES);
+}
+
+// Renders OpenMetrics, which escapes every label value, into a buffer kept across scrapes
+static void prom_bench_scrape_openmetrics(void) {
+  char *buf = NULL;
+  size_t cap = 0;
+  size_t bytes = 0;
+  double start = prom_bench_now();
+  for (size_t i = 0; i < PROM_BENCH_SCRAPES; i++) {
+    size_t len = 0;
+    prom_collector_registry_render(bench_registry, PROM_EXPOSITION_OPENMETRICS, &buf, &cap, &len);
+    bytes += len;
+  }
+  double seconds = prom_bench_now() - start;
+  prom_free(buf);
+  prom_bench_report("scrape_openmetrics", PROM_BENCH_SCRAPES, seconds);
+  printf("%-24s %12zu bytes/scrape\n", "", bytes / PROM_BENCH_SCRAPES);
+}
+
+// Records every series of the registry into a history, as an agent sampling every 100 ms would
+static void prom_bench_history_record(void) {
+  prom_metric_sample_t *children[PROM_BENCH_SERIES];
+  for (int i = 0; i < PROM_BENCH_SERIES; i++) {
+    const char *values[] = {bench_label_values[i][0], bench_label_values[i][1]};
+    children[i] = prom_gauge_child(bench_gauge, values);
+  }
+  prom_history_t *history = prom_history_new(NULL);
+  int64_t t = 1700000000000;
+  double seconds = 0.0;
+  for (size_t i = 0; i < PROM_BENCH_SCRAPES; i++, t += 100) {
+    for (int j = 0; j < PROM_BENCH_SERIES; j++) prom_metric_sample_set(children[j], (double)((i * 7 + j) % 1000));
+    double start = prom_bench_now();
+    prom_history_record(history, bench_registry, t);
+    seconds += prom_bench_now() - start;
+  }
+  prom_history_stats_t stats;
+  prom_history_stats(history, &stats);
+  prom_bench_report("history_record", (size_t)PROM_BENCH_SCRAPES * PROM_BENCH_SERIES, seconds);
+  printf("%-24s %12.2f bytes/sample, %zu KiB for %zu series\n", "", (double)stats.bytes / stats.samples,
+         stats.bytes / 1024, stats.series);
+  prom_history_destroy(history);
+}
+
+static size_t prom_bench_rss(void) {
+  size_t pages = 0;
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (f == NULL) return 0;
+  if (fscanf(f, "%*u %zu", &pages) != 1) pages = 0;
+  fclose(f);
+  return pages * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+// Builds a registry of many labeled gauges that share their label values, renders it once and reports the memory used
+static void prom_bench_large_registry(void) {
+  size_t rss = prom_bench_rss();
+  size_t calls = atomic_load(&prom_bench_libc_calls);
+  double start = prom_bench_now();
+
+  prom_collector_registry_t *registry = prom_collector_registry_new("large");
+  prom_collector_t *collector = prom_collector_new("large");
+  prom_collector_registry_register_collector(registry, collector);
+  const char *keys[] = {"device", "kind"};
+  char name[32];
+  for (int m = 0; m < PROM_BENCH_LARGE_METRICS; m++) {
+    snprintf(name, sizeof(name), "large_gauge_%d", m);
+    prom_gauge_t *gauge = prom_gauge_new(name, "gauge of the large registry benchmark", 2, keys);
+    prom_collector_add_metric(collector, gauge);
+    for (int i = 0; i < PROM_BENCH_SERIES; i++) {
+      const char *values[] = {bench_label_values[i][0], bench_label_values[i][1]};
+      prom_gauge_set(gauge, i, values);
+    }
+  }
+  const char *buf = prom_collector_registry_bridge(registry);
+  free((void *)buf);
+
+  size_t series = (size_t)PROM_BENCH_LARGE_METRICS * PROM_BENCH_SERIES;
+  prom_bench_report("large_registry", series, prom_bench_now() - start);
+  printf("%-24s %12zu KiB rss growth\n", "", (prom_bench_rss() - rss) / 1024);
+  printf("%-24s %12zu libc allocator calls\n", "", atomic_load(&prom_bench_libc_calls) - calls);
+  struct mallinfo2 info = mallinfo2();
+  printf("%-24s %12zu KiB in use, %zu KiB free in the libc heap\n", "", info.uordblks / 1024, info.fordblks / 1024);
+#ifdef PROM_SLAB
+  prom_slab_stats_t stats;
+  prom_slab_stats(&stats);
+  printf("%-24s %12zu KiB of slab pages, %.1f%% unused\n", "", stats.page_bytes / 1024,
+         stats.page_bytes ? 100.0 * (1.0 - (double)stats.used_bytes / stats.page_bytes) : 0.0);
+  printf("%-24s %12zu interned strings, %zu intern hits\n", "", stats.interned_strings, (size_t)stats.intern_hits);
+#endif
+  prom_collector_registry_destroy(registry);
+}
+
+int main(int argc, const char **argv) {
+  prom_bench_init();
+  const char *only = argc > 1 ? argv[1] : NULL;
+  if (only == NULL || strcmp(only, "gauge_set") == 0) prom_bench_set();
+  if (only == NULL || strcmp(only, "gauge_child_set") == 0) prom_bench_child_set();
+  if (only == NULL || strcmp(only, "histogram_observe") == 0) prom_bench_histogram_observe();
+  if (only == NULL || strcmp(only, "summary_observe") == 0) prom_bench_summary_observe();
+  if (only == NULL || strcmp(only, "native_histogram_observe") == 0) prom_bench_native_histogram_observe();
+  if (only == NULL || strcmp(only, "contention") == 0) prom_bench_contention();
+  if (only == NULL || strcmp(only, "sharded") == 0) prom_bench_sharded();
+  if (only == NULL || strcmp(only, "scrape") == 0) prom_bench_scrape();
+  if (only == NULL || strcmp(only, "scrape_openmetrics") == 0) prom_bench_scrape_openmetrics();
+  if (only == NULL || strcmp(only, "history_record") == 0) prom_bench_history_record();
+  if (only == NULL || strcmp(only, "large_registry") == 0) prom_bench_large_registry();
+  prom_collector_registry_destroy(bench_registry);
+  return 0;
+}
@@ -32,6 +32,8 @@ limitations under the License.
  * * [Counter](https://prometheus.io/docs/concepts/metric_types/#counter)
  * * [Gauge](https://prometheus.io/docs/concepts/metric_types/#gauge)
  * * [Histogram](https://prometheus.io/docs/concepts/metric_types/#histogram)
+ * * [Summary](https://prometheus.io/docs/concepts/metric_types/#summary)
+ * * [Native histogram](https://prometheus.io/docs/specs/native_histograms/), exposed over protobuf
  *
  * To get started using one of the metric types, declare the metric at file scope. For example:
  *
@@ -123,12 +125,23 @@ limitations under the License.
 #include "prom_collector_registry.h"
 #include "prom_counter.h"
 #include "prom_gauge.h"
+#include "prom_group.h"
 #include "prom_histogram.h"
 #include "prom_histogram_buckets.h"
+#include "prom_history.h"
 #include "prom_linked_list.h"
 #include "prom_map.h"
 #include "prom_metric.h"
 #include "prom_metric_sample.h"
 #include "prom_metric_sample_histogram.h"
+#include "prom_metric_sample_native_histogram.h"
+#include "prom_metric_sample_summary.h"
+#include "prom_native_histogram.h"
+#include "prom_rate.h"
+#include "prom_remote_write.h"
+#include "prom_shm.h"
+#include "prom_slab.h"
+#include "prom_summary.h"
+#include "prom_udp_exporter.h"
 
 #endif //  PROM_INCLUDED
\ No newline at end of file
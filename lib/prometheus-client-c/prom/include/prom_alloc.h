@@ -25,6 +25,20 @@ limitations under the License.
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef PROM_SLAB
+
+#include "prom_slab.h"
+
+#define prom_malloc prom_slab_malloc
+#define prom_realloc prom_slab_realloc
+#define prom_strdup prom_slab_strdup
+#define prom_strndup prom_slab_strndup
+#define prom_free prom_slab_free
+#define prom_intern prom_slab_intern
+#define prom_intern_release prom_slab_intern_release
+
+#else
+
 /**
  * @brief Redefine this macro if you wish to override it. The default value is malloc.
  */
@@ -40,9 +54,27 @@ limitations under the License.
  */
 #define prom_strdup strdup
 
+/**
+ * @brief Redefine this macro if you wish to override it. The default value is strndup.
+ */
+#define prom_strndup strndup
+
 /**
  * @brief Redefine this macro if you wish to override it. The default value is free.
  */
 #define prom_free free
 
+/**
+ * @brief Returns an immutable copy of a string that is shared with equal strings where the allocator supports it.
+ *        Release it with prom_intern_release. The default value is prom_strdup.
+ */
+#define prom_intern prom_strdup
+
+/**
+ * @brief Releases a string returned by prom_intern. The default value frees the copy.
+ */
+#define prom_intern_release(str) prom_free((void *)(str))
+
+#endif  // PROM_SLAB
+
 #endif  // PROM_ALLOC_H
@@ -20,6 +20,11 @@ limitations under the License.
 #include "prom_map.h"
 #include "prom_metric.h"
 
+/**
+ * @brief The number of seconds a process collector reuses the limits it read from /proc/[pid]/limits
+ */
+#define PROM_COLLECTOR_PROCESS_LIMITS_INTERVAL 300
+
 /**
  * @file prom_collector.h
  * @brief A Prometheus collector returns a collection of metrics
@@ -59,6 +64,15 @@ prom_collector_t *prom_collector_new(const char *name);
  */
 prom_collector_t *prom_collector_process_new(const char *limits_path, const char *stat_path);
 
+/**
+ * @brief Makes every process collector read the limits file again on its next collection.
+ *
+ * Limits rarely change, so process collectors parse the limits file at most once every
+ * PROM_COLLECTOR_PROCESS_LIMITS_INTERVAL seconds. Call this after changing the limits of the process, e.g. with
+ * setrlimit(2), for process_max_fds and process_virtual_memory_max_bytes to reflect the change on the next scrape.
+ */
+void prom_collector_process_refresh_limits(void);
+
 /**
  * @brief Destroy a collector. You MUST set self to NULL after destruction.
  * @param self The target prom_collector_t*
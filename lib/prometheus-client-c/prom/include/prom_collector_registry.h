@@ -25,6 +25,19 @@ limitations under the License.
 #include "prom_collector.h"
 #include "prom_metric.h"
 
+/**
+ * @brief The exposition formats a prom_collector_registry_t can render.
+ *
+ * References
+ * * See https://prometheus.io/docs/instrumenting/exposition_formats/
+ * * See https://github.com/OpenObservability/OpenMetrics/blob/main/specification/OpenMetrics.md
+ */
+typedef enum prom_exposition_format {
+  PROM_EXPOSITION_TEXT,        /**< The text based format, version 0.0.4 */
+  PROM_EXPOSITION_OPENMETRICS, /**< OpenMetrics text, version 1.0.0. Includes _created samples and exemplars. */
+  PROM_EXPOSITION_PROTOBUF     /**< Length-delimited io.prometheus.client.MetricFamily messages */
+} prom_exposition_format_t;
+
 /**
  * @brief A prom_registry_t is responsible for registering metrics and briding them to the string exposition format
  */
@@ -106,12 +119,95 @@ int prom_collector_registry_register_collector(prom_collector_registry_t *self,
  */
 const char *prom_collector_registry_bridge(prom_collector_registry_t *self);
 
+/**
+ * @brief Renders the registry in the given exposition format. The returned buffer MUST be freed with free(), whatever
+ *        the prom_alloc.h hooks are.
+ *
+ * The protobuf format is binary and may contain NUL bytes, so the length of the output is returned through len.
+ *
+ * When a generation has been set via prom_collector_registry_advance_generation, the rendered output is cached per
+ * format and reused until the next generation. Otherwise every call renders the current values.
+ *
+ * @param self The target prom_collector_registry_t*
+ * @param format The exposition format
+ * @param len Set to the number of bytes in the returned buffer, excluding the terminating NUL. May be NULL.
+ * @return The rendered metrics or NULL upon failure
+ */
+const char *prom_collector_registry_bridge_format(prom_collector_registry_t *self, prom_exposition_format_t format,
+                                                  size_t *len);
+
+/**
+ * @brief Renders the registry in the given exposition format into a buffer owned by the caller.
+ *
+ * Unlike prom_collector_registry_bridge_format, the buffer is reused across calls: it is grown with prom_realloc when
+ * the output does not fit and is otherwise left alone, so a caller that keeps its buffer between scrapes stops
+ * allocating once the buffer has grown to fit the output. Release it with prom_free when no longer needed. Output is
+ * cached per generation as in prom_collector_registry_bridge_format.
+ *
+ * @param self The target prom_collector_registry_t*
+ * @param format The exposition format
+ * @param buf The buffer to render into. *buf may be NULL, in which case *cap must be 0.
+ * @param cap The number of bytes allocated to *buf. Updated when the buffer grows.
+ * @param len Set to the number of bytes rendered, excluding the terminating NUL. May be NULL.
+ * @return A non-zero integer value upon failure
+ *
+ *     char *buf = NULL;
+ *     size_t cap = 0, len = 0;
+ *     prom_collector_registry_render(PROM_COLLECTOR_REGISTRY_DEFAULT, PROM_EXPOSITION_TEXT, &buf, &cap, &len);
+ */
+int prom_collector_registry_render(prom_collector_registry_t *self, prom_exposition_format_t format, char **buf,
+                                   size_t *cap, size_t *len);
+
+/**
+ * @brief Marks the current metric values as a new generation.
+ *
+ * Programs that update their metrics in cycles can call this after each cycle so that scrapes within the same cycle
+ * share a single rendering per format instead of walking every collector on each request.
+ *
+ * @param self The target prom_collector_registry_t*
+ * @return A non-zero integer value upon failure
+ */
+int prom_collector_registry_advance_generation(prom_collector_registry_t *self);
+
+/**
+ * @brief Starts a new sweep interval on every metric of the registry and evicts the series that have gone unused for
+ * longer than their metric's series TTL.
+ *
+ * Programs that update their metrics in cycles can call this once per cycle, so that a TTL set with
+ * prom_metric_set_series_ttl counts cycles. Once a metric has a series limit or TTL, the registry also exposes
+ * prom_series_dropped_total and prom_series_evicted_total with a metric label, updated on every sweep.
+ *
+ * @param self The target prom_collector_registry_t*
+ * @return A non-zero integer value upon failure
+ */
+int prom_collector_registry_sweep(prom_collector_registry_t *self);
+
+/**
+ * @brief Selects the exposition format for the value of an HTTP Accept header.
+ *
+ * Media ranges are ranked by their q parameter. The text format is returned when accept is NULL or when no supported
+ * media range is acceptable. Protobuf is only selected when the proto=io.prometheus.client.MetricFamily and
+ * encoding=delimited parameters are present.
+ *
+ * @param accept The value of the Accept header. May be NULL.
+ * @return The selected prom_exposition_format_t
+ */
+prom_exposition_format_t prom_collector_registry_negotiate_format(const char *accept);
+
+/**
+ * @brief Returns the value for the Content-Type header of a response in the given exposition format
+ * @param format The exposition format
+ * @return A static string
+ */
+const char *prom_collector_registry_content_type(prom_exposition_format_t format);
+
 /**
  *@brief Validates that the given metric name complies with the specification:
  *
  * Reference: https://prometheus.io/docs/concepts/data_model/#metric-names-and-labels
  *
- * Returns a non-zero integer value on failure.
+ * Returns a non-zero integer value on failure. The name must match [a-zA-Z_:][a-zA-Z0-9_:]*. The check does not
+ * allocate.
  *
  * @param self The target prom_collector_registry_t*
  * @param metric_name The metric name to validate
@@ -119,4 +215,18 @@ const char *prom_collector_registry_bridge(prom_collector_registry_t *self);
  */
 int prom_collector_registry_validate_metric_name(prom_collector_registry_t *self, const char *metric_name);
 
+/**
+ *@brief Validates that the given label name complies with the specification:
+ *
+ * Reference: https://prometheus.io/docs/concepts/data_model/#metric-names-and-labels
+ *
+ * Returns a non-zero integer value on failure. The name must match [a-zA-Z_][a-zA-Z0-9_]* and must not start with
+ * "__", which is reserved for internal use. The check does not allocate.
+ *
+ * @param self The target prom_collector_registry_t*
+ * @param label_name The label name to validate
+ * @return A non-zero integer value upon failure
+ */
+int prom_collector_registry_validate_label_name(prom_collector_registry_t *self, const char *label_name);
+
 #endif  // PROM_H
@@ -17,6 +17,7 @@ limitations under the License.
 #ifndef PROM_COUNTER_H
 #define PROM_COUNTER_H
 
+#include <stdint.h>
 #include <stdlib.h>
 
 #include "prom_metric.h"
@@ -43,7 +44,7 @@ typedef prom_metric_t prom_counter_t;
  * @param label_keys A collection of label keys. The number of keys MUST match the value passed as label_key_count. If
  *                   no labels are required, pass NULL. Otherwise, it may be convenient to pass this value as a
  *                   literal.
- * @return The constructed prom_counter_t*
+ * @return The constructed prom_counter_t*, or NULL if the name or a label key is invalid
  *
  * *Example*
  *
@@ -55,6 +56,44 @@ typedef prom_metric_t prom_counter_t;
  */
 prom_counter_t *prom_counter_new(const char *name, const char *help, size_t label_key_count, const char **label_keys);
 
+/**
+ * @brief Construct a prom_counter_t* whose samples spread increments over per-thread cells.
+ *
+ * A regular counter sample is a single value that every thread updates with compare and swap, so a counter that many
+ * threads increment at once spends its time moving one cache line between cores. Each sample of a sharded counter
+ * instead holds 16 cache-line-sized cells and a thread only adds to its own; the cells are summed when the counter is
+ * collected. That costs about 1 KiB per sample, so reserve it for hot counters with few label sets.
+ *
+ * The parameters are the same as those of prom_counter_new.
+ * @return The constructed prom_counter_t*, or NULL if the name or a label key is invalid
+ *
+ * *Example*
+ *
+ *     prom_counter_sharded_new("requests_total", "requests served by any worker thread", 0, NULL);
+ */
+prom_counter_t *prom_counter_sharded_new(const char *name, const char *help, size_t label_key_count,
+                                         const char **label_keys);
+
+/**
+ * @brief Construct a prom_counter_t* whose samples hold a 64-bit unsigned integer instead of a double.
+ *
+ * A double only represents integers exactly up to 2^53, so byte counters and the like silently lose precision past
+ * that point. Integer counters add with a single atomic instruction instead of a compare and swap loop and are
+ * rendered with an integer printer. Use prom_counter_add_u64 or prom_metric_sample_add_u64 to update them; values
+ * passed to prom_counter_add are truncated toward zero. prom_counter_add fails and leaves the counter unchanged for
+ * NaN, infinities and values of 2^64 or more, which have no integer to truncate to. Exposition formats that only carry
+ * doubles, such as protobuf and remote write, convert the value on the way out.
+ *
+ * The parameters are the same as those of prom_counter_new.
+ * @return The constructed prom_counter_t*, or NULL if the name or a label key is invalid
+ *
+ * *Example*
+ *
+ *     prom_counter_u64_new("received_bytes_total", "bytes received on every interface", 0, NULL);
+ */
+prom_counter_t *prom_counter_u64_new(const char *name, const char *help, size_t label_key_count,
+                                     const char **label_keys);
+
 /**
  * @brief Destroys a prom_counter_t*. You must set self to NULL after destruction. A non-zero integer value will be
  *        returned on failure.
@@ -100,4 +139,60 @@ int prom_counter_inc(prom_counter_t *self, const char **label_values);
  */
 int prom_counter_add(prom_counter_t *self, double r_value, const char **label_values);
 
+/**
+ * @brief Add the integer value to the prom_counter_t*. A non-zero integer value will be returned on failure.
+ *
+ * The value is added exactly to counters built with prom_counter_u64_new and converted to a double for others.
+ * @param self The target  prom_counter_t*
+ * @param value The value to add to the prom_counter_t passed as self.
+ * @param label_values The label values associated with the metric sample being updated.
+ * @return A non-zero integer value upon failure.
+ *
+ * *Example*
+ *
+ *     prom_counter_add_u64(received_bytes, delta, NULL);
+ */
+int prom_counter_add_u64(prom_counter_t *self, uint64_t value, const char **label_values);
+
+/**
+ * @brief Add the value to the prom_counter_t* and record it as the exemplar of the sample. A non-zero integer value
+ *        will be returned on failure.
+ *
+ * Exemplars are exposed by the OpenMetrics and protobuf exposition formats. Only the most recent exemplar of each
+ * sample is kept.
+ * @param self The target  prom_counter_t*
+ * @param r_value The double to add to the prom_counter_t passed as self. The value MUST be greater than or equal to 0.
+ * @param label_values The label values associated with the metric sample being updated.
+ * @param exemplar_label_count The number of exemplar labels, at most 128
+ * @param exemplar_label_keys The exemplar label names. Combined with their values they MUST NOT exceed 128 characters,
+ *                            less 2 for each label beyond 64.
+ * @param exemplar_label_values The exemplar label values
+ * @return A non-zero integer value upon failure.
+ *
+ * *Example*
+ *
+ *     prom_counter_add_with_exemplar(foo_counter, 1, NULL, 1, (const char**) { "trace_id" }, (const char**) { id });
+ */
+int prom_counter_add_with_exemplar(prom_counter_t *self, double r_value, const char **label_values,
+                                   size_t exemplar_label_count, const char **exemplar_label_keys,
+                                   const char **exemplar_label_values);
+
+/**
+ * @brief Returns the sample of the prom_counter_t* for the given label values, creating it if it does not exist yet.
+ *
+ * The child is valid until the counter is destroyed. Updating it with prom_metric_sample_add skips formatting and
+ * looking up the label values, so series that are updated on every interval should be resolved once and updated
+ * through their child.
+ * @param self The target prom_counter_t*
+ * @param label_values The label values of the sample. The number of labels must match the value passed to
+ *                     label_key_count in the counter's constructor. If no label values are necessary, pass NULL.
+ * @return The prom_metric_sample_t* of the given label values, or NULL upon failure.
+ *
+ * *Example*
+ *
+ *     prom_metric_sample_t *cpu0_user = prom_counter_child(foo_counter, (const char *[]){"0", "user"});
+ *     prom_metric_sample_add(cpu0_user, 3);
+ */
+prom_metric_sample_t *prom_counter_child(prom_counter_t *self, const char **label_values);
+
 #endif  // PROM_COUNTER_H
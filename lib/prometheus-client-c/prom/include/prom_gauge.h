@@ -22,6 +22,7 @@ limitations under the License.
 #ifndef PROM_GAUGE_H
 #define PROM_GAUGE_H
 
+#include <stdint.h>
 #include <stdlib.h>
 
 #include "prom_metric.h"
@@ -43,7 +44,7 @@ typedef prom_metric_t prom_gauge_t;
  * @param label_keys A collection of label keys. The number of keys MUST match the value passed as label_key_count. If
  *                   no labels are required, pass NULL. Otherwise, it may be convenient to pass this value as a
  *                   literal.
- * @return The constructed prom_guage_t*
+ * @return The constructed prom_guage_t*, or NULL if the name or a label key is invalid
  *
  *     // An example with labels
  *     prom_gauge_new("foo", "foo is a gauge with labels", 2, (const char**) { "one", "two" });
@@ -53,6 +54,23 @@ typedef prom_metric_t prom_gauge_t;
  */
 prom_gauge_t *prom_gauge_new(const char *name, const char *help, size_t label_key_count, const char **label_keys);
 
+/**
+ * @brief Constructs a prom_gauge_t* whose samples hold a 64-bit signed integer instead of a double.
+ *
+ * Intended for naturally integral values such as byte totals and process counts, which a double only represents
+ * exactly up to 2^53. Updates are single atomic instructions and the value is rendered with an integer printer. Use
+ * prom_gauge_set_i64 and prom_gauge_add_i64 to update them; doubles passed to the other gauge functions are truncated
+ * toward zero. Those functions fail and leave the gauge unchanged for NaN, infinities and values outside
+ * [-2^63, 2^63), which have no integer to truncate to.
+ *
+ * The parameters are the same as those of prom_gauge_new.
+ * @return The constructed prom_gauge_t*, or NULL if the name or a label key is invalid
+ *
+ *     prom_gauge_i64_new("running_processes", "processes in the running state", 0, NULL);
+ */
+prom_gauge_t *prom_gauge_i64_new(const char *name, const char *help, size_t label_key_count,
+                                 const char **label_keys);
+
 /**
  * @brief Destroys a prom_gauge_t*. You must set self to NULL after destruction. A non-zero integer value will be
  *        returned on failure.
@@ -152,4 +170,48 @@ int prom_gauge_sub(prom_gauge_t *self, double r_value, const char **label_values
  */
 int prom_gauge_set(prom_gauge_t *self, double r_value, const char **label_values);
 
+/**
+ * @brief Add the signed integer value to the prom_gauge_t*. The value may be negative.
+ *
+ * The value is added exactly to gauges built with prom_gauge_i64_new and converted to a double for others.
+ * @param self The target prom_gauge_t*
+ * @param value The value to add to the prom_gauge_t* passed as self
+ * @param label_values The label values associated with the metric sample being updated.
+ * @return A non-zero integer value upon failure.
+ */
+int prom_gauge_add_i64(prom_gauge_t *self, int64_t value, const char **label_values);
+
+/**
+ * @brief Set the prom_gauge_t* to the signed integer value.
+ *
+ * The value is stored exactly by gauges built with prom_gauge_i64_new and converted to a double for others.
+ * @param self The target prom_gauge_t*
+ * @param value The value to which the prom_gauge_t* passed as self will be set
+ * @param label_values The label values associated with the metric sample being updated.
+ * @return A non-zero integer value upon failure.
+ *
+ * *Example*
+ *
+ *     prom_gauge_set_i64(running_processes, 42, NULL);
+ */
+int prom_gauge_set_i64(prom_gauge_t *self, int64_t value, const char **label_values);
+
+/**
+ * @brief Returns the sample of the prom_gauge_t* for the given label values, creating it if it does not exist yet.
+ *
+ * The child is valid until the gauge is destroyed. Updating it with prom_metric_sample_set, prom_metric_sample_add or
+ * prom_metric_sample_sub skips formatting and looking up the label values, so series that are updated on every
+ * interval should be resolved once and updated through their child.
+ * @param self The target prom_gauge_t*
+ * @param label_values The label values of the sample. The number of labels must match the value passed to
+ *                     label_key_count in the gauge's constructor. If no label values are necessary, pass NULL.
+ * @return The prom_metric_sample_t* of the given label values, or NULL upon failure.
+ *
+ * *Example*
+ *
+ *     prom_metric_sample_t *eth0_rx = prom_gauge_child(foo_gauge, (const char *[]){"eth0", "rx"});
+ *     prom_metric_sample_set(eth0_rx, 22);
+ */
+prom_metric_sample_t *prom_gauge_child(prom_gauge_t *self, const char **label_values);
+
 #endif  // PROM_GAUGE_H
@@ -0,0 +1,85 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/**
+ * @file prom_group.h
+ * @brief Publish the values of related metrics together
+ */
+
+#ifndef PROM_GROUP_H
+#define PROM_GROUP_H
+
+#include "prom_metric.h"
+
+/**
+ * @brief A set of counters and gauges whose values are published as a unit.
+ *
+ * A collector stages new values by updating the metrics of the group between prom_group_begin and prom_group_commit.
+ * Readers take a snapshot of every sample of the group within one pass of a sequence lock, so they see the values of a
+ * single commit and never a mix of two. The readers are scrapes and the prom_shm.h, prom_udp_exporter.h,
+ * prom_remote_write.h and prom_history.h exporters. They serialize with each other on the registry lock, but they
+ * never block the writer: a snapshot that overlaps a commit retries, and one that keeps overlapping falls back to the
+ * values read last time.
+ *
+ * A group has a single writer, its metrics are scraped through a single registry and it must outlive its metrics.
+ */
+typedef struct prom_group prom_group_t;
+
+/**
+ * @brief Constructs an empty prom_group_t*
+ * @return The constructed prom_group_t* or NULL upon failure
+ */
+prom_group_t *prom_group_new(void);
+
+/**
+ * @brief Destroys a prom_group_t*. You must set self to NULL after destruction. A non-zero integer value will be
+ *        returned on failure.
+ * @param self The target prom_group_t*
+ * @return A non-zero integer value upon failure
+ */
+int prom_group_destroy(prom_group_t *self);
+
+/**
+ * @brief Adds a counter or gauge to the group. Metrics must be added before they are registered, and a metric belongs
+ *        to at most one group.
+ * @param self The target prom_group_t*
+ * @param metric The counter or gauge to add
+ * @return A non-zero integer value upon failure
+ */
+int prom_group_add(prom_group_t *self, prom_metric_t *metric);
+
+/**
+ * @brief Starts staging values. Scrapes and exporters keep reading the values of the previous commit until
+ *        prom_group_commit.
+ * @param self The target prom_group_t*
+ * @return A non-zero integer value upon failure, including when the group is already staging
+ */
+int prom_group_begin(prom_group_t *self);
+
+/**
+ * @brief Publishes the values staged since prom_group_begin
+ * @param self The target prom_group_t*
+ * @return A non-zero integer value upon failure, including when the group is not staging
+ *
+ *     prom_group_begin(memory);
+ *     prom_gauge_set(total_bytes, total, NULL);
+ *     prom_gauge_set(used_bytes, used, NULL);
+ *     prom_group_commit(memory);
+ */
+int prom_group_commit(prom_group_t *self);
+
+#endif  // PROM_GROUP_H
@@ -45,7 +45,7 @@ typedef prom_metric_t prom_histogram_t;
  * @param label_keys A collection of label keys. The number of keys MUST match the value passed as label_key_count. If
  *                   no labels are required, pass NULL. Otherwise, it may be convenient to pass this value as a
  *                   literal.
- * @return The constructed prom_histogram_t*
+ * @return The constructed prom_histogram_t*, or NULL if the name, a label key or the buckets are invalid
  *
  * *Example*
  *
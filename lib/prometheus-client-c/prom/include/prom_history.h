@@ -0,0 +1,152 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+/**
+ * @file prom_history.h
+ * @brief Keep the recent history of every counter and gauge in memory, compressed as in Gorilla
+ *
+ * References:
+ *   * Pelkonen et al., "Gorilla: A Fast, Scalable, In-Memory Time Series Database", VLDB 2015
+ *   * https://prometheus.io/docs/prometheus/latest/querying/api/#range-queries
+ */
+
+#ifndef PROM_HISTORY_H
+#define PROM_HISTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "prom_collector_registry.h"
+
+/**
+ * @brief The retention used when the configured one is 0, in seconds
+ */
+#define PROM_HISTORY_DEFAULT_RETENTION 3600
+
+/**
+ * @brief The memory a series may use when the configured limit is 0, in bytes
+ */
+#define PROM_HISTORY_DEFAULT_SERIES_BYTES 65536
+
+/**
+ * @brief The most points a series may have in the answer to a range query with a step
+ */
+#define PROM_HISTORY_MAX_POINTS 11000
+
+/**
+ * @brief The largest distance from the unix epoch of the start and end of a range query, in milliseconds. 2^53 ms is
+ * more than 285,000 years either way and keeps the arithmetic on the range from overflowing.
+ */
+#define PROM_HISTORY_MAX_TIMESTAMP_MS 9007199254740992LL
+
+/**
+ * @brief How far back from each step of a range query the latest sample is looked for, in milliseconds
+ */
+#define PROM_HISTORY_LOOKBACK_MS 300000
+
+/**
+ * @brief An in-memory history of the counters and gauges of a registry.
+ *
+ * Each record appends the value of every counter and gauge sample to the ring of its series. Timestamps are stored as
+ * delta-of-deltas and values as the XOR with the previous value, so a sample taken at a regular interval whose value
+ * did not change takes two bits. Rings are made of fixed-size chunks: once a series has used its memory limit, or its
+ * oldest chunk has aged past the retention, that chunk is recycled. Series that have not been recorded for the whole
+ * retention are dropped.
+ *
+ * Recording and querying may run concurrently from different threads.
+ */
+typedef struct prom_history prom_history_t;
+
+/**
+ * @brief Options for prom_history_new. Zero valued members select the documented default.
+ */
+typedef struct prom_history_config {
+  int64_t retention;   /**< How long samples are kept, in seconds. Default PROM_HISTORY_DEFAULT_RETENTION. */
+  size_t series_bytes; /**< The most memory the chunks of a series use. Default PROM_HISTORY_DEFAULT_SERIES_BYTES. */
+} prom_history_config_t;
+
+/**
+ * @brief Memory usage of a prom_history_t
+ */
+typedef struct prom_history_stats {
+  size_t series;               /**< The number of series held */
+  uint64_t samples;            /**< The number of samples held */
+  size_t bytes;                /**< The memory used by every series together */
+  size_t largest_series_bytes; /**< The memory used by the largest series */
+  size_t series_bytes_limit;   /**< The most memory the chunks of a series use */
+} prom_history_stats_t;
+
+/**
+ * @brief Constructs a prom_history_t*
+ * @param config The history options, or NULL for the defaults
+ * @return The constructed prom_history_t* or NULL upon failure
+ */
+prom_history_t *prom_history_new(const prom_history_config_t *config);
+
+/**
+ * @brief Destroys a prom_history_t*. You MUST set self to NULL after destruction.
+ * @param self The target prom_history_t*
+ * @return A non-zero integer value upon failure
+ */
+int prom_history_destroy(prom_history_t *self);
+
+/**
+ * @brief Appends the value of every counter and gauge sample of the registry to its series. Histograms and summaries
+ *        are skipped.
+ * @param self The target prom_history_t*
+ * @param registry The registry to record
+ * @param timestamp_ms The unix time of the samples in milliseconds, or 0 for the current time. Samples that are not
+ *                     later than the last one of their series are skipped.
+ * @return A non-zero integer value upon failure
+ */
+int prom_history_record(prom_history_t *self, prom_collector_registry_t *registry, int64_t timestamp_ms);
+
+/**
+ * @brief Renders the history of a metric as the JSON response of the Prometheus range query API.
+ *
+ * With a step, each series has a point at start, start + step, ... up to end, holding its latest sample within
+ * PROM_HISTORY_LOOKBACK_MS, as Prometheus evaluates range queries. Without one, every sample between start and end is
+ * returned as it was recorded.
+ *
+ * The buffer is grown with prom_realloc when the response does not fit, as in prom_collector_registry_render. Release
+ * it with prom_free when no longer needed.
+ *
+ * @param self The target prom_history_t*
+ * @param name The name of the metric. Every series of the metric is returned.
+ * @param start_ms The start of the range, as unix time in milliseconds
+ * @param end_ms The end of the range, as unix time in milliseconds
+ * @param step_ms The distance between points in milliseconds, or 0 for the recorded samples
+ * @param buf The buffer to render into; *buf may be NULL
+ * @param cap The allocated size of *buf
+ * @param len Set to the length of the response, excluding the terminating NUL
+ * @return A non-zero integer value upon failure, including when the range is invalid, has more than
+ *         PROM_HISTORY_MAX_POINTS steps or ends further than PROM_HISTORY_MAX_TIMESTAMP_MS from the epoch. The buffer
+ *         then holds the JSON error response.
+ */
+int prom_history_query_range(prom_history_t *self, const char *name, int64_t start_ms, int64_t end_ms,
+                             int64_t step_ms, char **buf, size_t *cap, size_t *len);
+
+/**
+ * @brief Copies the memory usage of self into stats
+ * @param self The target prom_history_t*
+ * @param stats The destination
+ * @return A non-zero integer value upon failure
+ */
+int prom_history_stats(prom_history_t *self, prom_history_stats_t *stats);
+
+#endif  // PROM_HISTORY_H
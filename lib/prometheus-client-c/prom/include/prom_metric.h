@@ -22,8 +22,13 @@ limitations under the License.
 #ifndef PROM_METRIC_H
 #define PROM_METRIC_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include "prom_metric_sample.h"
 #include "prom_metric_sample_histogram.h"
+#include "prom_metric_sample_native_histogram.h"
+#include "prom_metric_sample_summary.h"
 
 struct prom_metric;
 /**
@@ -40,11 +45,13 @@ typedef struct prom_metric prom_metric_t;
  * with O(1) lookups in average case; nonethless, caching metric samples and updating them directly might be
  * preferrable in performance-sensitive situations.
  *
+ * The sample is pinned: series TTL eviction never removes it, so it stays valid until the metric is destroyed.
+ *
  * @param self The target prom_metric_t*
  * @param label_values The label values associated with the metric sample being updated. The number of labels must
  *                     match the value passed to label_key_count in the counter's constructor. If no label values are
  *                     necessary, pass NULL. Otherwise, It may be convenient to pass this value as a literal.
- * @return A prom_metric_sample_t*
+ * @return A prom_metric_sample_t*, or NULL if the sample does not exist and the metric is at its series limit
  */
 prom_metric_sample_t *prom_metric_sample_from_labels(prom_metric_t *self, const char **label_values);
 
@@ -55,6 +62,8 @@ prom_metric_sample_t *prom_metric_sample_from_labels(prom_metric_t *self, const
  * with O(1) lookups in average case; nonethless, caching metric samples and updating them directly might be
  * preferrable in performance-sensitive situations.
  *
+ * The sample is pinned: series TTL eviction never removes it, so it stays valid until the metric is destroyed.
+ *
  * @param self The target prom_histogram_metric_t*
  * @param label_values The label values associated with the metric sample being updated. The number of labels must
  *                     match the value passed to label_key_count in the counter's constructor. If no label values are
@@ -64,4 +73,73 @@ prom_metric_sample_t *prom_metric_sample_from_labels(prom_metric_t *self, const
 prom_metric_sample_histogram_t *prom_metric_sample_histogram_from_labels(prom_metric_t *self,
                                                                          const char **label_values);
 
+/**
+ * @brief Returns a prom_metric_sample_summary_t*. The order of label_values is significant.
+ *
+ * The sample is pinned: series TTL eviction never removes it, so it stays valid until the metric is destroyed.
+ *
+ * @param self The target prom_summary_t*
+ * @param label_values The label values associated with the metric sample being updated. The number of labels must
+ *                     match the value passed to label_key_count in the summary's constructor. If no label values are
+ *                     necessary, pass NULL.
+ * @return prom_metric_sample_summary_t*
+ */
+prom_metric_sample_summary_t *prom_metric_sample_summary_from_labels(prom_metric_t *self, const char **label_values);
+
+/**
+ * @brief Returns a prom_metric_sample_native_histogram_t*. The order of label_values is significant.
+ *
+ * The sample is pinned: series TTL eviction never removes it, so it stays valid until the metric is destroyed.
+ *
+ * @param self The target prom_native_histogram_t*
+ * @param label_values The label values associated with the metric sample being updated. The number of labels must
+ *                     match the value passed to label_key_count in the histogram's constructor. If no label values
+ *                     are necessary, pass NULL.
+ * @return prom_metric_sample_native_histogram_t*
+ */
+prom_metric_sample_native_histogram_t *prom_metric_sample_native_histogram_from_labels(prom_metric_t *self,
+                                                                                       const char **label_values);
+
+/**
+ * @brief Limits the number of series, that is samples with distinct label values, the metric may hold.
+ *
+ * Once the metric holds max_series samples, updates that would create another one fail and are counted by
+ * prom_metric_dropped_series. Existing series keep working. Set the limit before the metric is updated from several
+ * threads.
+ *
+ * @param self The target prom_metric_t*
+ * @param max_series The most series the metric may hold. Pass 0, the default, for no limit.
+ * @return A non-zero integer value upon failure
+ */
+int prom_metric_set_max_series(prom_metric_t *self, size_t max_series);
+
+/**
+ * @brief Evicts series that go unused for the given number of sweeps.
+ *
+ * prom_collector_registry_sweep starts a new sweep interval on every metric of a registry. Each update stamps its
+ * series with the current interval, and a series that has not been updated for ttl intervals is removed and its memory
+ * freed.
+ * Evictions are counted by prom_metric_evicted_series. Series obtained through the prom_*_child and
+ * prom_metric_sample_*_from_labels functions are pinned and never evicted.
+ *
+ * @param self The target prom_metric_t*
+ * @param ttl The number of sweeps a series may go without updates. Pass 0, the default, to keep every series.
+ * @return A non-zero integer value upon failure
+ */
+int prom_metric_set_series_ttl(prom_metric_t *self, uint64_t ttl);
+
+/**
+ * @brief Returns the number of updates that were refused because the metric was at its series limit
+ * @param self The target prom_metric_t*
+ * @return The number of refused updates
+ */
+uint64_t prom_metric_dropped_series(prom_metric_t *self);
+
+/**
+ * @brief Returns the number of series that were evicted for going unused longer than the series TTL
+ * @param self The target prom_metric_t*
+ * @return The number of evicted series
+ */
+uint64_t prom_metric_evicted_series(prom_metric_t *self);
+
 #endif  // PROM_METRIC_H
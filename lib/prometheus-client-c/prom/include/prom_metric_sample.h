@@ -22,6 +22,9 @@ limitations under the License.
 #ifndef PROM_METRIC_SAMPLE_H
 #define PROM_METRIC_SAMPLE_H
 
+#include <stdint.h>
+#include <stdlib.h>
+
 struct prom_metric_sample;
 /**
  * @brief Contains the specific metric and value given the name and label set
@@ -37,6 +40,22 @@ typedef struct prom_metric_sample prom_metric_sample_t;
  */
 int prom_metric_sample_add(prom_metric_sample_t *self, double r_value);
 
+/**
+ * @brief Add the r_value to the sample and record it as the sample's exemplar.
+ *
+ * This operation MUST be called on a sample derived from a counter metric. Exemplars are only rendered by the
+ * OpenMetrics and protobuf exposition formats. The combined length of the exemplar label names and values must not
+ * exceed 128 characters.
+ * @param self The target prom_metric_sample_t*
+ * @param r_value The double to add to prom_metric_sample_t* provided by self
+ * @param label_count The number of exemplar labels
+ * @param label_keys The exemplar label names, e.g. trace_id
+ * @param label_values The exemplar label values
+ * @return Non-zero integer value upon failure
+ */
+int prom_metric_sample_add_with_exemplar(prom_metric_sample_t *self, double r_value, size_t label_count,
+                                         const char **label_keys, const char **label_values);
+
 /**
  * @brief Subtract the r_value from the sample.
  *
@@ -57,4 +76,35 @@ int prom_metric_sample_sub(prom_metric_sample_t *self, double r_value);
  */
 int prom_metric_sample_set(prom_metric_sample_t *self, double r_value);
 
+/**
+ * @brief Add the integer value to the sample.
+ *
+ * Samples of integer metrics (see prom_counter_u64_new and prom_gauge_i64_new) take the value with a single atomic
+ * add and stay exact over the full 64-bit range. Other samples add the value converted to a double.
+ * @param self The target prom_metric_sample_t*
+ * @param value The value to add to prom_metric_sample_t* provided by self
+ * @return Non-zero integer value upon failure
+ */
+int prom_metric_sample_add_u64(prom_metric_sample_t *self, uint64_t value);
+
+/**
+ * @brief Add the signed integer value to the sample. The value may be negative.
+ *
+ * This operation MUST be called on a sample derived from a gauge metric.
+ * @param self The target prom_metric_sample_t*
+ * @param value The value to add to prom_metric_sample_t* provided by self
+ * @return Non-zero integer value upon failure
+ */
+int prom_metric_sample_add_i64(prom_metric_sample_t *self, int64_t value);
+
+/**
+ * @brief Set the sample to the signed integer value.
+ *
+ * This operation MUST be called on a sample derived from a gauge metric.
+ * @param self The target prom_metric_sample_t*
+ * @param value The value which will be set to the prom_metric_sample_t* provided by self
+ * @return Non-zero integer value upon failure
+ */
+int prom_metric_sample_set_i64(prom_metric_sample_t *self, int64_t value);
+
 #endif  // PROM_METRIC_SAMPLE_H
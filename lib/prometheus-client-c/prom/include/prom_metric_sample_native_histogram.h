@@ -0,0 +1,42 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/**
+ * @file prom_metric_sample_native_histogram.h
+ * @brief Functions for interacting with the samples of a native histogram directly
+ */
+
+#ifndef PROM_METRIC_SAMPLE_NATIVE_HISTOGRAM_H
+#define PROM_METRIC_SAMPLE_NATIVE_HISTOGRAM_H
+
+struct prom_metric_sample_native_histogram;
+/**
+ * @brief Contains the sparse exponential buckets, count and sum of one labeled native histogram series
+ */
+typedef struct prom_metric_sample_native_histogram prom_metric_sample_native_histogram_t;
+
+/**
+ * @brief Record the value in the prom_metric_sample_native_histogram_t*. The insert does not allocate.
+ *
+ * NaN is counted and added to the sum but falls in no bucket.
+ * @param self The target prom_metric_sample_native_histogram_t*
+ * @param value The observed value
+ * @return A non-zero integer value upon failure
+ */
+int prom_metric_sample_native_histogram_observe(prom_metric_sample_native_histogram_t *self, double value);
+
+#endif  // PROM_METRIC_SAMPLE_NATIVE_HISTOGRAM_H
@@ -0,0 +1,119 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/**
+ * @file prom_native_histogram.h
+ * @brief https://prometheus.io/docs/specs/native_histograms/
+ */
+
+#ifndef PROM_NATIVE_HISTOGRAM_H
+#define PROM_NATIVE_HISTOGRAM_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "prom_metric.h"
+#include "prom_metric_sample_native_histogram.h"
+
+/**
+ * @brief The lowest schema. Each bucket spans 2^16 times the range of the previous one.
+ */
+#define PROM_NATIVE_HISTOGRAM_MIN_SCHEMA (-4)
+
+/**
+ * @brief The highest schema. Each bucket spans 2^(1/256) times the range of the previous one.
+ */
+#define PROM_NATIVE_HISTOGRAM_MAX_SCHEMA 8
+
+/**
+ * @brief The number of buckets a series may hold when 0 is passed to prom_native_histogram_new
+ */
+#define PROM_NATIVE_HISTOGRAM_DEFAULT_MAX_BUCKETS 160
+
+/**
+ * @brief Observations whose absolute value is at most this go to the zero bucket
+ */
+#define PROM_NATIVE_HISTOGRAM_ZERO_THRESHOLD 2.938735877055719e-39
+
+/**
+ * @brief A prometheus native histogram.
+ *
+ * Buckets are exponential and sparse: at schema s, bucket i holds the observations whose absolute value is in
+ * (2^((i - 1) * 2^-s), 2^(i * 2^-s)], and only buckets that received observations are stored. When a series would
+ * hold more than max_buckets buckets, its schema is lowered, which merges neighbouring buckets pairwise, so the
+ * resolution adapts to the spread of the observed values. Storage is allocated with the series and observing does not
+ * allocate.
+ *
+ * The buckets are only exposed in the protobuf format. The text formats carry the +Inf bucket, _count and _sum.
+ *
+ * References
+ * * See https://prometheus.io/docs/specs/native_histograms/
+ */
+typedef prom_metric_t prom_native_histogram_t;
+
+/**
+ * @brief Constructs a prom_native_histogram_t*
+ * @param name The name of the metric
+ * @param help The metric description
+ * @param schema The resolution each series starts at, between PROM_NATIVE_HISTOGRAM_MIN_SCHEMA and
+ *               PROM_NATIVE_HISTOGRAM_MAX_SCHEMA. 3 gives buckets about 9% wide.
+ * @param max_buckets The most buckets a series may hold. Pass 0 for PROM_NATIVE_HISTOGRAM_DEFAULT_MAX_BUCKETS.
+ * @param label_key_count The number of labels associated with the given metric. Pass 0 if the metric does not
+ *                        require labels.
+ * @param label_keys A collection of label keys. The number of keys MUST match the value passed as label_key_count. If
+ *                   no labels are required, pass NULL.
+ * @return The constructed prom_native_histogram_t*, or NULL if the schema is out of range
+ *
+ *     prom_native_histogram_new("request_seconds", "request latency", 3, 0, 0, NULL);
+ */
+prom_native_histogram_t *prom_native_histogram_new(const char *name, const char *help, int32_t schema,
+                                                   size_t max_buckets, size_t label_key_count,
+                                                   const char **label_keys);
+
+/**
+ * @brief Destroys a prom_native_histogram_t*. You must set self to NULL after destruction. A non-zero integer value
+ *        will be returned on failure.
+ * @param self The target prom_native_histogram_t*
+ * @return A non-zero integer value upon failure
+ */
+int prom_native_histogram_destroy(prom_native_histogram_t *self);
+
+/**
+ * @brief Record the value in the prom_native_histogram_t*.
+ * @param self The target prom_native_histogram_t*
+ * @param value The observed value
+ * @param label_values The label values associated with the metric sample being updated. The number of labels must
+ *                     match the value passed to label_key_count in the histogram's constructor. If no label values are
+ *                     necessary, pass NULL.
+ * @return A non-zero integer value upon failure
+ */
+int prom_native_histogram_observe(prom_native_histogram_t *self, double value, const char **label_values);
+
+/**
+ * @brief Returns the sample of the prom_native_histogram_t* for the given label values, creating it if it does not
+ *        exist yet.
+ *
+ * The child is valid until the histogram is destroyed. Observing through prom_metric_sample_native_histogram_observe
+ * skips formatting and looking up the label values.
+ * @param self The target prom_native_histogram_t*
+ * @param label_values The label values of the sample, or NULL if the histogram has no labels.
+ * @return The prom_metric_sample_native_histogram_t* of the given label values, or NULL upon failure.
+ */
+prom_metric_sample_native_histogram_t *prom_native_histogram_child(prom_native_histogram_t *self,
+                                                                   const char **label_values);
+
+#endif  // PROM_NATIVE_HISTOGRAM_H
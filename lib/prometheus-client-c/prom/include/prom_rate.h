@@ -0,0 +1,97 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+/**
+ * @file prom_rate.h
+ * @brief Publish cumulative counters read from outside the process, such as the kernel's, with their rates
+ */
+
+#ifndef PROM_RATE_H
+#define PROM_RATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "prom_metric_sample.h"
+
+/**
+ * @brief Tracks raw cumulative counters and publishes their increases and per-second rates.
+ *
+ * Each series binds a raw counter to a counter sample, which receives the increase of the raw value on every update,
+ * and optionally to a gauge sample, which is set to its per-second rate. The first observation of a series adds the
+ * raw value itself, so the counter starts out equal to it.
+ *
+ * A raw value lower than the previous one means the counter either wrapped around or was reset. A counter narrower
+ * than 64 bits that decreases from the top quarter of its range is taken to have wrapped, and the increase is counted
+ * across the wrap. Any other decrease is a reset and the increase is the new raw value.
+ *
+ * The state of every series is kept in parallel arrays and updated in a single pass, so collectors should add all of
+ * their series to one prom_rate_t*. A prom_rate_t* has a single writer.
+ */
+typedef struct prom_rate prom_rate_t;
+
+/**
+ * @brief Constructs an empty prom_rate_t*
+ * @return The constructed prom_rate_t* or NULL upon failure
+ */
+prom_rate_t *prom_rate_new(void);
+
+/**
+ * @brief Destroys a prom_rate_t*. The bound samples are not touched. You must set self to NULL after destruction. A
+ *        non-zero integer value will be returned on failure.
+ * @param self The target prom_rate_t*
+ * @return A non-zero integer value upon failure
+ */
+int prom_rate_destroy(prom_rate_t *self);
+
+/**
+ * @brief Adds a series to the prom_rate_t*
+ * @param self The target prom_rate_t*
+ * @param counter The counter sample that receives the increases, see prom_counter_child
+ * @param rate The gauge sample that is set to the per-second rate, see prom_gauge_child. Pass NULL to only publish the
+ *             counter.
+ * @param bits The width of the raw counter in bits, between 1 and 64
+ * @param index Set to the index of the new series, which is passed to prom_rate_observe
+ * @return A non-zero integer value upon failure
+ */
+int prom_rate_add(prom_rate_t *self, prom_metric_sample_t *counter, prom_metric_sample_t *rate, unsigned int bits,
+                  size_t *index);
+
+/**
+ * @brief Stages a raw value of a series for the next prom_rate_update. Series that are not observed between two
+ *        updates keep their counter and rate.
+ * @param self The target prom_rate_t*
+ * @param index The index of the series returned by prom_rate_add
+ * @param value The raw value of the counter
+ * @return A non-zero integer value upon failure
+ */
+int prom_rate_observe(prom_rate_t *self, size_t index, uint64_t value);
+
+/**
+ * @brief Computes the increase and rate of every series observed since the last update and publishes them
+ * @param self The target prom_rate_t*
+ * @param now The time of the observations in seconds, from a monotonic clock
+ * @return A non-zero integer value upon failure
+ *
+ *     prom_rate_observe(rates, ctxt, stat.ctxt);
+ *     prom_rate_observe(rates, rx_bytes, dev.rx_bytes);
+ *     prom_rate_update(rates, now);
+ */
+int prom_rate_update(prom_rate_t *self, double now);
+
+#endif  // PROM_RATE_H
@@ -0,0 +1,107 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/**
+ * @file prom_remote_write.h
+ * @brief Push metrics to a Prometheus remote write endpoint
+ *
+ * Reference: https://prometheus.io/docs/concepts/remote_write_spec/
+ */
+
+#ifndef PROM_REMOTE_WRITE_H
+#define PROM_REMOTE_WRITE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "prom_collector_registry.h"
+
+/**
+ * @brief A remote write client. Each push snapshots a registry into snappy compressed WriteRequests, one per shard,
+ * which are sent by one background sender per shard. Series are assigned to shards by hash and each sender delivers
+ * its requests one at a time, oldest first, so the receiver sees the samples of every series in order.
+ */
+typedef struct prom_remote_write prom_remote_write_t;
+
+/**
+ * @brief Options for prom_remote_write_new. Zero valued members select the documented default.
+ */
+typedef struct prom_remote_write_config {
+  const char *url;               /**< The endpoint, e.g. http://127.0.0.1:9090/api/v1/write. Only http is supported. */
+  const char *wal_path;          /**< Undelivered requests are appended here, or to wal_path.N for shard N > 0. NULL
+                                      disables the WAL. */
+  size_t wal_max_bytes;          /**< The size limit of the WALs, split evenly among the shards. Default 64 MiB. */
+  unsigned int concurrency;      /**< The number of shards, each with one request in flight. Default 1. */
+  unsigned int queue_capacity;   /**< The number of requests buffered in memory per shard. When full, the oldest
+                                      moves to the WAL. Default 16. */
+  unsigned int max_retries;      /**< Retries of a failed request before it is written to the WAL. Default 3. */
+  unsigned int retry_backoff_ms; /**< The first retry delay. It doubles on each retry. Default 100. */
+  unsigned int timeout_ms;       /**< The connect, send and receive timeout. Default 5000. */
+} prom_remote_write_config_t;
+
+/**
+ * @brief Delivery statistics of a prom_remote_write_t
+ */
+typedef struct prom_remote_write_stats {
+  uint64_t requests_sent;     /**< Requests accepted by the receiver */
+  uint64_t requests_failed;   /**< Send attempts that failed, including retries */
+  uint64_t requests_dropped;  /**< Requests that were rejected by the receiver or did not fit in the queue or WAL */
+  uint64_t wal_pending_bytes; /**< Bytes waiting in the WAL for replay */
+} prom_remote_write_stats_t;
+
+/**
+ * @brief Constructs a prom_remote_write_t* and starts its senders. Records left in the WAL by a previous process are
+ * replayed.
+ * @param config The client options. The strings are copied.
+ * @return The constructed prom_remote_write_t* or NULL upon failure
+ */
+prom_remote_write_t *prom_remote_write_new(const prom_remote_write_config_t *config);
+
+/**
+ * @brief Stops the senders and destroys self. Requests still queued in memory are moved to the WAL when it is enabled.
+ * You MUST set self to NULL after destruction.
+ * @param self The target prom_remote_write_t*
+ * @return A non-zero integer value upon failure
+ */
+int prom_remote_write_destroy(prom_remote_write_t *self);
+
+/**
+ * @brief Encodes every sample of the registry into one request and queues it. This does not wait for the request to
+ * be sent.
+ * @param self The target prom_remote_write_t*
+ * @param registry The registry to snapshot
+ * @return A non-zero integer value upon failure
+ */
+int prom_remote_write_push(prom_remote_write_t *self, prom_collector_registry_t *registry);
+
+/**
+ * @brief Waits until the queues are empty, no request is in flight and the WALs have been replayed.
+ * @param self The target prom_remote_write_t*
+ * @param timeout_ms The maximum time to wait
+ * @return A non-zero integer value if the timeout expired first
+ */
+int prom_remote_write_flush(prom_remote_write_t *self, unsigned int timeout_ms);
+
+/**
+ * @brief Copies the delivery statistics of self into stats
+ * @param self The target prom_remote_write_t*
+ * @param stats The destination
+ * @return A non-zero integer value upon failure
+ */
+int prom_remote_write_stats(prom_remote_write_t *self, prom_remote_write_stats_t *stats);
+
+#endif  // PROM_REMOTE_WRITE_H
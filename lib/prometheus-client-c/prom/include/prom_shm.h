@@ -0,0 +1,166 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/**
+ * @file prom_shm.h
+ * @brief Publish the latest sample values into a POSIX shared memory segment
+ *
+ * The segment has a fixed binary layout so that local consumers can map it and read consistent snapshots without
+ * system calls:
+ *
+ *     prom_shm_header_t                 at offset 0
+ *     prom_shm_descriptor_t[capacity]   at header.descriptors_offset
+ *     double[capacity]                  at header.values_offset
+ *
+ * A series keeps its slot for the lifetime of the segment. Descriptors are written before the slot is published by
+ * raising header.count and never change afterwards, so readers may reference them in place. The values and count
+ * are guarded by the sequence number header.seq, which is odd while the publisher is writing.
+ */
+
+#ifndef PROM_SHM_H
+#define PROM_SHM_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "prom_collector_registry.h"
+
+/**
+ * @brief The value of prom_shm_header_t.magic: "PSHM" in little endian
+ */
+#define PROM_SHM_MAGIC 0x4d485350
+
+/**
+ * @brief The layout version described by this header
+ */
+#define PROM_SHM_VERSION 1
+
+/**
+ * @brief The size of prom_shm_descriptor_t.name including the terminating NUL
+ */
+#define PROM_SHM_NAME_MAX 248
+
+/**
+ * @brief The header at the start of the segment
+ */
+typedef struct prom_shm_header {
+  uint32_t magic;              /**< PROM_SHM_MAGIC */
+  uint32_t version;            /**< PROM_SHM_VERSION */
+  uint32_t capacity;           /**< The number of descriptor and value slots */
+  uint32_t descriptor_size;    /**< sizeof(prom_shm_descriptor_t) */
+  uint64_t descriptors_offset; /**< The offset of the descriptor table from the start of the segment */
+  uint64_t values_offset;      /**< The offset of the values array from the start of the segment */
+  _Atomic uint64_t seq;        /**< Odd while the publisher writes count, timestamp_ms and the values */
+  uint64_t count;              /**< The number of published series */
+  uint64_t timestamp_ms;       /**< The unix time of the last publication in milliseconds */
+  uint64_t dropped;            /**< The number of series that did not fit in capacity */
+  uint8_t reserved[64];        /**< Pads the header to 128 bytes */
+} prom_shm_header_t;
+
+/**
+ * @brief The type of a published series
+ */
+typedef enum prom_shm_type { PROM_SHM_COUNTER = 0, PROM_SHM_GAUGE = 1 } prom_shm_type_t;
+
+/**
+ * @brief One entry of the descriptor table
+ */
+typedef struct prom_shm_descriptor {
+  uint32_t type;                 /**< A prom_shm_type_t */
+  uint32_t name_len;             /**< The length of name without the terminating NUL */
+  char name[PROM_SHM_NAME_MAX];  /**< The series in exposition format, e.g. cpu_usage{core="0"} */
+} prom_shm_descriptor_t;
+
+/**
+ * @brief Publishes the counters and gauges of a registry into a shared memory segment
+ */
+typedef struct prom_shm_publisher prom_shm_publisher_t;
+
+/**
+ * @brief Maps a segment created by a prom_shm_publisher_t
+ */
+typedef struct prom_shm_reader prom_shm_reader_t;
+
+/**
+ * @brief Creates the segment, replacing a segment of the same name left by a previous process
+ * @param name The shared memory object name, e.g. "/prom_metrics". See shm_open(3).
+ * @param capacity The maximum number of series
+ * @return The constructed prom_shm_publisher_t* or NULL upon failure
+ */
+prom_shm_publisher_t *prom_shm_publisher_new(const char *name, size_t capacity);
+
+/**
+ * @brief Unmaps and removes the segment, then destroys self. You MUST set self to NULL after destruction.
+ * @param self The target prom_shm_publisher_t*
+ * @return A non-zero integer value upon failure
+ */
+int prom_shm_publisher_destroy(prom_shm_publisher_t *self);
+
+/**
+ * @brief Writes the current value of every counter and gauge sample of the registry. Series that were published
+ * before but are missing from the registry read as NaN. Histograms and summaries are skipped.
+ * @param self The target prom_shm_publisher_t*
+ * @param registry The registry to snapshot
+ * @return A non-zero integer value upon failure
+ */
+int prom_shm_publisher_publish(prom_shm_publisher_t *self, prom_collector_registry_t *registry);
+
+/**
+ * @brief Maps an existing segment read only
+ * @param name The shared memory object name given to prom_shm_publisher_new
+ * @return The constructed prom_shm_reader_t* or NULL if the segment does not exist or has an unknown layout
+ */
+prom_shm_reader_t *prom_shm_reader_open(const char *name);
+
+/**
+ * @brief Unmaps the segment and destroys self. You MUST set self to NULL after destruction.
+ * @param self The target prom_shm_reader_t*
+ * @return A non-zero integer value upon failure
+ */
+int prom_shm_reader_close(prom_shm_reader_t *self);
+
+/**
+ * @brief Returns the number of slots in the segment, which bounds the count returned by prom_shm_reader_snapshot
+ * @param self The target prom_shm_reader_t*
+ * @return The capacity of the segment
+ */
+size_t prom_shm_reader_capacity(prom_shm_reader_t *self);
+
+/**
+ * @brief Returns the descriptor of slot i. The descriptor points into the segment and is valid for every i below a
+ * count returned by prom_shm_reader_snapshot.
+ * @param self The target prom_shm_reader_t*
+ * @param i The slot
+ * @return The descriptor or NULL if i is out of range
+ */
+const prom_shm_descriptor_t *prom_shm_reader_descriptor(prom_shm_reader_t *self, size_t i);
+
+/**
+ * @brief Copies a consistent snapshot of the values into values. This spins while the publisher is writing and never
+ * enters the kernel.
+ *
+ * @param self The target prom_shm_reader_t*
+ * @param values The destination. It must hold prom_shm_reader_capacity(self) values.
+ * @param count Set to the number of published series
+ * @param timestamp_ms Set to the time of the publication. May be NULL.
+ * @return A non-zero integer value if no consistent snapshot could be taken, e.g. because the publisher died while
+ * writing
+ */
+int prom_shm_reader_snapshot(prom_shm_reader_t *self, double *values, size_t *count, uint64_t *timestamp_ms);
+
+#endif  // PROM_SHM_H
@@ -0,0 +1,116 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/**
+ * @file prom_slab.h
+ * @brief A slab allocator and string interning arena for libprom
+ *
+ * libprom makes a great many small allocations: map nodes, samples, label value copies and l_values. The slab
+ * allocator serves them from fixed size classes carved out of 64KiB pages of a single reserved arena, so they pack
+ * densely and are found again without going through libc. Empty pages are handed back to the kernel. Requests larger
+ * than the biggest size class, and every request once the arena is exhausted, fall through to libc.
+ *
+ * Building libprom with PROM_SLAB set in the environment routes the prom_alloc.h hooks to this allocator. The functions
+ * are always available so that they can be measured and tested in either build.
+ */
+
+#ifndef PROM_SLAB_H
+#define PROM_SLAB_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * @brief The largest request the slab allocator serves itself. Larger requests go to libc.
+ */
+#define PROM_SLAB_MAX_SIZE 1024
+
+/**
+ * @brief Allocation counters of the slab allocator.
+ *
+ * Fragmentation of the arena is 1 - used_bytes / page_bytes: the share of the pages held from the kernel that no live
+ * block occupies.
+ */
+typedef struct prom_slab_stats {
+  size_t arena_bytes;        /**< bytes of address space reserved for the arena */
+  size_t page_bytes;         /**< bytes of the pages currently carved from the arena */
+  size_t used_bytes;         /**< bytes of the live blocks, counted at their size class */
+  size_t interned_strings;   /**< distinct strings currently interned */
+  uint64_t allocs;           /**< blocks handed out by the slab allocator */
+  uint64_t frees;            /**< blocks returned to the slab allocator */
+  uint64_t libc_allocs;      /**< requests that fell through to libc */
+  uint64_t intern_hits;      /**< prom_slab_intern calls that found the string already interned */
+} prom_slab_stats_t;
+
+/**
+ * @brief Allocates size bytes, aligned like malloc.
+ * @param size The number of bytes
+ * @return The allocation, or NULL if the memory is exhausted
+ */
+void *prom_slab_malloc(size_t size);
+
+/**
+ * @brief Resizes an allocation made by prom_slab_malloc or libc. Blocks that already have room for size bytes are
+ *        returned as they are.
+ * @param ptr The allocation to resize, or NULL
+ * @param size The new number of bytes
+ * @return The resized allocation, or NULL if the memory is exhausted
+ */
+void *prom_slab_realloc(void *ptr, size_t size);
+
+/**
+ * @brief Copies str into a block of the slab allocator.
+ * @param str The string to copy
+ * @return The copy
+ */
+char *prom_slab_strdup(const char *str);
+
+/**
+ * @brief Copies at most len characters of str into a block of the slab allocator.
+ * @param str The string to copy
+ * @param len The most characters to copy
+ * @return The copy, always NUL terminated
+ */
+char *prom_slab_strndup(const char *str, size_t len);
+
+/**
+ * @brief Frees an allocation made by prom_slab_malloc or libc.
+ * @param ptr The allocation, or NULL
+ */
+void prom_slab_free(void *ptr);
+
+/**
+ * @brief Returns a shared, immutable copy of str. Every call returns the same copy for equal strings until each of
+ *        them has been released with prom_slab_intern_release.
+ * @param str The string to intern
+ * @return The interned copy
+ */
+const char *prom_slab_intern(const char *str);
+
+/**
+ * @brief Releases a string returned by prom_slab_intern. The copy is freed after its last release.
+ * @param str The interned string, or NULL
+ */
+void prom_slab_intern_release(const char *str);
+
+/**
+ * @brief Reads the counters of the slab allocator.
+ * @param stats Receives the counters
+ */
+void prom_slab_stats(prom_slab_stats_t *stats);
+
+#endif  // PROM_SLAB_H
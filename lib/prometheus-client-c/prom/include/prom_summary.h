@@ -0,0 +1,102 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/**
+ * @file prom_summary.h
+ * @brief https://prometheus.io/docs/concepts/metric_types/#summary
+ */
+
+#ifndef PROM_SUMMARY_H
+#define PROM_SUMMARY_H
+
+#include <stdlib.h>
+
+#include "prom_metric.h"
+#include "prom_metric_sample_summary.h"
+
+/**
+ * @brief The most quantiles a prom_summary_t* may report
+ */
+#define PROM_SUMMARY_MAX_QUANTILES 16
+
+/**
+ * @brief A prometheus summary.
+ *
+ * Each series keeps a t-digest per fifth of a sliding time window, so its memory is fixed no matter how many values
+ * are observed, and observing a value does not allocate. The reported quantiles cover the last max_age seconds while
+ * the _count and _sum series cover every observation.
+ *
+ * References
+ * * See https://prometheus.io/docs/concepts/metric_types/#summary
+ */
+typedef prom_metric_t prom_summary_t;
+
+/**
+ * @brief Constructs a prom_summary_t*
+ * @param name The name of the metric
+ * @param help The metric description
+ * @param quantile_count The number of quantiles in quantiles, at most PROM_SUMMARY_MAX_QUANTILES. Pass 0 to report
+ *                       the 0.5, 0.9 and 0.99 quantiles.
+ * @param quantiles The quantiles to report, increasing and within [0, 1]. They are copied.
+ * @param max_age The number of seconds of observations the quantiles are computed over. Pass 0 for 600 seconds.
+ * @param label_key_count The number of labels associated with the given metric. Pass 0 if the metric does not
+ *                        require labels.
+ * @param label_keys A collection of label keys. The number of keys MUST match the value passed as label_key_count. If
+ *                   no labels are required, pass NULL. "quantile" is reserved.
+ * @return The constructed prom_summary_t*, or NULL if the name, a label key or the quantiles are invalid
+ *
+ *     // The median and 99th percentile of the last minute
+ *     prom_summary_new("scrape_seconds", "time spent rendering scrapes", 2, (const double[]){0.5, 0.99}, 60, 0, NULL);
+ */
+prom_summary_t *prom_summary_new(const char *name, const char *help, size_t quantile_count, const double *quantiles,
+                                 double max_age, size_t label_key_count, const char **label_keys);
+
+/**
+ * @brief Destroys a prom_summary_t*. You must set self to NULL after destruction. A non-zero integer value will be
+ *        returned on failure.
+ * @param self The target prom_summary_t*
+ * @return A non-zero integer value upon failure
+ */
+int prom_summary_destroy(prom_summary_t *self);
+
+/**
+ * @brief Record the value in the prom_summary_t*.
+ * @param self The target prom_summary_t*
+ * @param value The observed value. NaN is rejected.
+ * @param label_values The label values associated with the metric sample being updated. The number of labels must
+ *                     match the value passed to label_key_count in the summary's constructor. If no label values are
+ *                     necessary, pass NULL.
+ * @return A non-zero integer value upon failure
+ *
+ * *Example*
+ *
+ *     prom_summary_observe(scrape_seconds, 0.0042, NULL);
+ */
+int prom_summary_observe(prom_summary_t *self, double value, const char **label_values);
+
+/**
+ * @brief Returns the sample of the prom_summary_t* for the given label values, creating it if it does not exist yet.
+ *
+ * The child is valid until the summary is destroyed. Observing through prom_metric_sample_summary_observe skips
+ * formatting and looking up the label values.
+ * @param self The target prom_summary_t*
+ * @param label_values The label values of the sample, or NULL if the summary has no labels.
+ * @return The prom_metric_sample_summary_t* of the given label values, or NULL upon failure.
+ */
+prom_metric_sample_summary_t *prom_summary_child(prom_summary_t *self, const char **label_values);
+
+#endif  // PROM_SUMMARY_H
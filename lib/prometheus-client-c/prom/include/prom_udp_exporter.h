@@ -0,0 +1,100 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/**
+ * @file prom_udp_exporter.h
+ * @brief Send metrics over UDP as InfluxDB line protocol or StatsD
+ *
+ * References:
+ *   * https://docs.influxdata.com/influxdb/v1/write_protocols/line_protocol_reference/
+ *   * https://github.com/statsd/statsd/blob/master/docs/metric_types.md
+ */
+
+#ifndef PROM_UDP_EXPORTER_H
+#define PROM_UDP_EXPORTER_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "prom_collector_registry.h"
+
+/**
+ * @brief A UDP exporter. Each send serializes the counters and gauges of a registry into lines, packs the lines into
+ * datagrams no larger than the configured MTU and writes every datagram with a single sendmmsg call.
+ */
+typedef struct prom_udp_exporter prom_udp_exporter_t;
+
+/**
+ * @brief The wire format of a prom_udp_exporter_t
+ */
+typedef enum prom_udp_exporter_format {
+  PROM_UDP_EXPORTER_INFLUX, /**< name,label=value value=1.5 1577836800000000000 */
+  PROM_UDP_EXPORTER_STATSD  /**< name:1.5|g|#label:value (labels are sent as DogStatsD tags) */
+} prom_udp_exporter_format_t;
+
+/**
+ * @brief Options for prom_udp_exporter_new. Zero valued members select the documented default.
+ */
+typedef struct prom_udp_exporter_config {
+  const char *host;                  /**< The receiver host. Default 127.0.0.1. */
+  unsigned short port;               /**< The receiver port. Default 8089 for InfluxDB and 8125 for StatsD. */
+  prom_udp_exporter_format_t format; /**< The wire format. Default PROM_UDP_EXPORTER_INFLUX. */
+  size_t mtu;                        /**< The largest datagram payload. Default 1432. */
+} prom_udp_exporter_config_t;
+
+/**
+ * @brief Delivery statistics of a prom_udp_exporter_t
+ */
+typedef struct prom_udp_exporter_stats {
+  uint64_t datagrams_sent;    /**< Datagrams handed to the kernel */
+  uint64_t datagrams_dropped; /**< Datagrams the kernel refused, e.g. because the socket buffer was full */
+  uint64_t bytes_sent;        /**< Payload bytes of the datagrams that were sent */
+} prom_udp_exporter_stats_t;
+
+/**
+ * @brief Constructs a prom_udp_exporter_t* and connects its socket
+ * @param config The exporter options. The strings are not retained.
+ * @return The constructed prom_udp_exporter_t* or NULL upon failure
+ */
+prom_udp_exporter_t *prom_udp_exporter_new(const prom_udp_exporter_config_t *config);
+
+/**
+ * @brief Closes the socket and destroys self. You MUST set self to NULL after destruction.
+ * @param self The target prom_udp_exporter_t*
+ * @return A non-zero integer value upon failure
+ */
+int prom_udp_exporter_destroy(prom_udp_exporter_t *self);
+
+/**
+ * @brief Sends every counter and gauge sample of the registry. Histograms and summaries are skipped, as are samples
+ * whose value is not finite. The buffers are reused across calls so that a steady set of samples does not allocate.
+ * Delivery is best effort: the call never blocks on a full socket buffer.
+ * @param self The target prom_udp_exporter_t*
+ * @param registry The registry to snapshot
+ * @return A non-zero integer value upon failure
+ */
+int prom_udp_exporter_send(prom_udp_exporter_t *self, prom_collector_registry_t *registry);
+
+/**
+ * @brief Copies the delivery statistics of self into stats
+ * @param self The target prom_udp_exporter_t*
+ * @param stats The destination
+ * @return A non-zero integer value upon failure
+ */
+int prom_udp_exporter_stats(prom_udp_exporter_t *self, prom_udp_exporter_stats_t *stats);
+
+#endif  // PROM_UDP_EXPORTER_H
@@ -14,7 +14,11 @@
  * limitations under the License.
  */
 
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 // Public
@@ -34,6 +38,7 @@
 #include "prom_process_limits_t.h"
 #include "prom_process_stat_i.h"
 #include "prom_process_stat_t.h"
+#include "prom_procfs_i.h"
 #include "prom_string_builder_i.h"
 
 prom_map_t *prom_collector_default_collect(prom_collector_t *self) { return self->metrics; }
@@ -60,6 +65,11 @@ prom_collector_t *prom_collector_new(const char *name) {
   }
   self->proc_limits_file_path = NULL;
   self->proc_stat_file_path = NULL;
+  self->proc_limits_file = NULL;
+  self->proc_stat_file = NULL;
+  self->proc_limits_read_at = 0.0;
+  self->proc_limits_generation = 0;
+  memset(&self->proc_stat, 0, sizeof(self->proc_stat));
   return self;
 }
 
@@ -78,6 +88,17 @@ int prom_collector_destroy(prom_collector_t *self) {
   if (r) ret = r;
   self->string_builder = NULL;
 
+  if (self->proc_limits_file != NULL) {
+    r = prom_process_limits_file_destroy(self->proc_limits_file);
+    if (r) ret = r;
+    self->proc_limits_file = NULL;
+  }
+  if (self->proc_stat_file != NULL) {
+    r = prom_process_stat_file_destroy(self->proc_stat_file);
+    if (r) ret = r;
+    self->proc_stat_file = NULL;
+  }
+
   prom_free((char *)self->name);
   self->name = NULL;
   prom_free(self);
@@ -165,113 +186,93 @@ prom_collector_t *prom_collector_process_new(const char *limits_path, const char
   return self;
 }
 
-prom_map_t *prom_collector_process_collect(prom_collector_t *self) {
-  PROM_ASSERT(self != NULL);
-  if (self == NULL) return NULL;
+// Bumped by prom_collector_process_refresh_limits. It starts at 1 so that collectors, which start at 0, read the limits
+// on their first collection.
+static _Atomic uint64_t prom_collector_process_limits_generation = 1;
 
-  int r = 0;
+void prom_collector_process_refresh_limits(void) {
+  atomic_fetch_add_explicit(&prom_collector_process_limits_generation, 1, memory_order_relaxed);
+}
 
-  // Allocate and create a *prom_process_limits_file_t
-  prom_process_limits_file_t *limits_f = prom_process_limits_file_new(self->proc_limits_file_path);
-  if (limits_f == NULL) {
-    prom_process_limits_file_destroy(limits_f);
-    return NULL;
-  }
+static double prom_collector_process_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
 
-  // Allocate and create a *prom_map_t from prom_process_limits_file_t. This is the main storage container for the
-  // limits metric data
-  prom_map_t *limits_map = prom_process_limits(limits_f);
-  if (limits_map == NULL) {
-    prom_process_limits_file_destroy(limits_f);
-    prom_map_destroy(limits_map);
-    return NULL;
-  }
+// Reads the limits file and sets process_max_fds and process_virtual_memory_max_bytes
+static int prom_collector_process_collect_limits(prom_collector_t *self) {
+  int r = 0;
 
-  // Retrieve the *prom_process_limits_row_t for Max open files
-  prom_process_limits_row_t *max_fds = (prom_process_limits_row_t *)prom_map_get(limits_map, "Max open files");
-  if (max_fds == NULL) {
-    prom_process_limits_file_destroy(limits_f);
-    prom_map_destroy(limits_map);
-    return NULL;
+  // The limits file is opened on the first read and read again into the same buffer on later ones
+  if (self->proc_limits_file == NULL) {
+    self->proc_limits_file = prom_process_limits_file_new(self->proc_limits_file_path);
+    if (self->proc_limits_file == NULL) return 1;
+  } else {
+    r = prom_procfs_buf_read(self->proc_limits_file);
+    if (r) return r;
   }
 
-  // Retrieve the *prom_process_limits_row_t for Max address space
-  prom_process_limits_row_t *virtual_memory_max_bytes =
-      (prom_process_limits_row_t *)prom_map_get(limits_map, "Max address space");
-  if (virtual_memory_max_bytes == NULL) {
-    prom_process_limits_file_destroy(limits_f);
-    prom_map_destroy(limits_map);
-    return NULL;
-  }
+  // Only two limits are exported, so they are read straight from the buffer
+  double max_fds = 0.0;
+  double virtual_memory_max_bytes = 0.0;
+  r = prom_process_limits_soft(self->proc_limits_file, "Max open files", &max_fds);
+  if (r) return r;
+  r = prom_process_limits_soft(self->proc_limits_file, "Max address space", &virtual_memory_max_bytes);
+  if (r) return r;
 
   // Set the metric values for max_fds and virtual_memory_max_bytes
-  r = prom_gauge_set(prom_process_max_fds, max_fds->soft, NULL);
-  if (r) return NULL;
-  r = prom_gauge_set(prom_process_virtual_memory_max_bytes, virtual_memory_max_bytes->soft, NULL);
-  if (r) return NULL;
+  r = prom_gauge_set(prom_process_max_fds, max_fds, NULL);
+  if (r) return r;
+  return prom_gauge_set(prom_process_virtual_memory_max_bytes, virtual_memory_max_bytes, NULL);
+}
+
+// Reads the procfs files into the process metrics
+static int prom_collector_process_update(prom_collector_t *self) {
+  int r = 0;
+
+  // Limits rarely change, so the gauges keep the values last read until they are refreshed or grow old
+  uint64_t generation = atomic_load_explicit(&prom_collector_process_limits_generation, memory_order_relaxed);
+  double now = prom_collector_process_now();
+  if (self->proc_limits_generation != generation ||
+      now - self->proc_limits_read_at >= PROM_COLLECTOR_PROCESS_LIMITS_INTERVAL) {
+    r = prom_collector_process_collect_limits(self);
+    if (r) return r;
+    self->proc_limits_generation = generation;
+    self->proc_limits_read_at = now;
+  }
 
-  // Aloocate and create a *prom_process_stat_file_t
-  prom_process_stat_file_t *stat_f = prom_process_stat_file_new(self->proc_stat_file_path);
-  if (stat_f == NULL) {
-    prom_process_limits_file_destroy(limits_f);
-    prom_map_destroy(limits_map);
-    return self->metrics;
+  // The stat file is opened on the first scrape and read again into the same buffer on later ones
+  if (self->proc_stat_file == NULL) {
+    self->proc_stat_file = prom_process_stat_file_new(self->proc_stat_file_path);
+    if (self->proc_stat_file == NULL) return 0;
+  } else {
+    r = prom_procfs_buf_read(self->proc_stat_file);
+    if (r) return 0;
   }
 
-  // Allocate and create a *prom_process_stat_t from *prom_process_stat_file_t
-  prom_process_stat_t *stat = prom_process_stat_new(stat_f);
+  // The stat fields are parsed into the collector, so a collection allocates nothing once the files are open
+  prom_process_stat_t *stat = &self->proc_stat;
+  r = prom_process_stat_parse(stat, self->proc_stat_file);
+  if (r) return r;
 
   // Set the metrics related to the stat file
   r = prom_gauge_set(prom_process_cpu_seconds_total, ((stat->utime + stat->stime) / sysconf(_SC_CLK_TCK)), NULL);
-  if (r) {
-    prom_process_limits_file_destroy(limits_f);
-    prom_map_destroy(limits_map);
-    prom_process_stat_file_destroy(stat_f);
-    prom_process_stat_destroy(stat);
-    return NULL;
-  }
+  if (r) return r;
   r = prom_gauge_set(prom_process_virtual_memory_bytes, stat->vsize, NULL);
-  if (r) {
-    prom_process_limits_file_destroy(limits_f);
-    prom_map_destroy(limits_map);
-    prom_process_stat_file_destroy(stat_f);
-    prom_process_stat_destroy(stat);
-    return NULL;
-  }
+  if (r) return r;
   r = prom_gauge_set(prom_process_resident_memory_bytes, stat->rss*sysconf(_SC_PAGE_SIZE), NULL);
-  if (r) {
-    prom_process_limits_file_destroy(limits_f);
-    prom_map_destroy(limits_map);
-    prom_process_stat_file_destroy(stat_f);
-    prom_process_stat_destroy(stat);
-    return NULL;
-  }
+  if (r) return r;
   r = prom_gauge_set(prom_process_start_time_seconds, stat->starttime, NULL);
-  if (r) {
-    prom_process_limits_file_destroy(limits_f);
-    prom_map_destroy(limits_map);
-    prom_process_stat_file_destroy(stat_f);
-    prom_process_stat_destroy(stat);
-    return NULL;
-  }
-  r = prom_gauge_set(prom_process_open_fds, prom_process_fds_count(NULL), NULL);
-  if (r) {
-    prom_process_limits_file_destroy(limits_f);
-    prom_map_destroy(limits_map);
-    prom_process_stat_file_destroy(stat_f);
-    prom_process_stat_destroy(stat);
-    return NULL;
-  }
+  if (r) return r;
+  return prom_gauge_set(prom_process_open_fds, prom_process_fds_count(NULL), NULL);
+}
 
-  // If there is any issue deallocating the following structures, return NULL to indicate failure
-  r = prom_process_limits_file_destroy(limits_f);
-  if (r) return NULL;
-  r = prom_map_destroy(limits_map);
-  if (r) return NULL;
-  r = prom_process_stat_file_destroy(stat_f);
-  if (r) return NULL;
-  r = prom_process_stat_destroy(stat);
-  if (r) return NULL;
+prom_map_t *prom_collector_process_collect(prom_collector_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return NULL;
 
-  return self->metrics;
+  // Scrapes and exporters call collect_fn under the registry write lock, so collections never read into the procfs
+  // buffers at the same time
+  return prom_collector_process_update(self) ? NULL : self->metrics;
 }
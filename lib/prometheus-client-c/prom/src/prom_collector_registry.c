@@ -15,23 +15,30 @@
  */
 
 #include <pthread.h>
-#include <regex.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
+#include <strings.h>
 
 // Public
 #include "prom_alloc.h"
 #include "prom_collector.h"
 #include "prom_collector_registry.h"
+#include "prom_counter.h"
 
 // Private
 #include "prom_assert.h"
 #include "prom_collector_registry_t.h"
 #include "prom_collector_t.h"
+#include "prom_epoch_i.h"
 #include "prom_errors.h"
+#include "prom_group_i.h"
 #include "prom_log.h"
 #include "prom_map_i.h"
 #include "prom_metric_formatter_i.h"
 #include "prom_metric_i.h"
+#include "prom_metric_sample_t.h"
 #include "prom_metric_t.h"
 #include "prom_process_limits_i.h"
 #include "prom_string_builder_i.h"
@@ -52,6 +59,15 @@ prom_collector_registry_t *prom_collector_registry_new(const char *name) {
 
   self->metric_formatter = prom_metric_formatter_new();
   self->string_builder = prom_string_builder_new();
+  self->generation = 0;
+  for (int i = 0; i < PROM_EXPOSITION_FORMAT_COUNT; i++) {
+    self->renderings[i].data = NULL;
+    self->renderings[i].len = 0;
+    self->renderings[i].cap = 0;
+    self->renderings[i].generation = 0;
+  }
+  self->series_dropped = NULL;
+  self->series_evicted = NULL;
   self->lock = (pthread_rwlock_t *)prom_malloc(sizeof(pthread_rwlock_t));
   r = pthread_rwlock_init(self->lock, NULL);
   if (r) {
@@ -116,6 +132,11 @@ int prom_collector_registry_destroy(prom_collector_registry_t *self) {
   self->string_builder = NULL;
   if (r) ret = r;
 
+  for (int i = 0; i < PROM_EXPOSITION_FORMAT_COUNT; i++) {
+    prom_free(self->renderings[i].data);
+    self->renderings[i].data = NULL;
+  }
+
   r = pthread_rwlock_destroy(self->lock);
   prom_free(self->lock);
   self->lock = NULL;
@@ -190,28 +211,380 @@ int prom_collector_registry_register_collector(prom_collector_registry_t *self,
   return 0;
 }
 
+// Returns true if name matches [a-zA-Z_:][a-zA-Z0-9_:]*, or [a-zA-Z_][a-zA-Z0-9_]* when colons are not allowed. This
+// runs for every name at registration, so it is a single pass over the characters instead of a regular expression.
+static bool prom_collector_registry_name_valid(const char *name, bool colon) {
+  if (name == NULL || *name == '\0') return false;
+  for (const char *c = name; *c != '\0'; c++) {
+    if ((*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || *c == '_' || (colon && *c == ':')) continue;
+    if (*c >= '0' && *c <= '9' && c != name) continue;
+    return false;
+  }
+  return true;
+}
+
 int prom_collector_registry_validate_metric_name(prom_collector_registry_t *self, const char *metric_name) {
-  regex_t r;
-  int ret = 0;
-  ret = regcomp(&r, "^[a-zA-Z_:][a-zA-Z0-9_:]*$", REG_EXTENDED);
-  if (ret) {
-    PROM_LOG(PROM_REGEX_REGCOMP_ERROR);
-    regfree(&r);
-    return ret;
+  if (!prom_collector_registry_name_valid(metric_name, true)) {
+    PROM_LOG(PROM_METRIC_INVALID_NAME);
+    return 1;
   }
+  return 0;
+}
 
-  ret = regexec(&r, metric_name, 0, NULL, 0);
-  if (ret) {
-    PROM_LOG(PROM_REGEX_REGEXEC_ERROR);
-    regfree(&r);
-    return ret;
+int prom_collector_registry_validate_label_name(prom_collector_registry_t *self, const char *label_name) {
+  if (!prom_collector_registry_name_valid(label_name, false) || strncmp(label_name, "__", 2) == 0) {
+    PROM_LOG(PROM_METRIC_INVALID_LABEL_NAME);
+    return 1;
   }
-  regfree(&r);
   return 0;
 }
 
 const char *prom_collector_registry_bridge(prom_collector_registry_t *self) {
+  return prom_collector_registry_bridge_format(self, PROM_EXPOSITION_TEXT, NULL);
+}
+
+// Grows *buf to at least size bytes. The capacity at least doubles so that output which grows a little with every
+// render does not reallocate every time.
+static int prom_collector_registry_reserve(char **buf, size_t *cap, size_t size) {
+  if (*cap >= size) return 0;
+  size_t new_cap = *cap * 2;
+  if (new_cap < size) new_cap = size;
+  char *data = (char *)prom_realloc(*buf, new_cap);
+  if (data == NULL) return 1;
+  *buf = data;
+  *cap = new_cap;
+  return 0;
+}
+
+/**
+ * @brief API PRIVATE Brings the rendering of the given format up to date and returns it, or NULL upon failure. The
+ * caller holds the write lock.
+ *
+ * Neither the formatter nor the rendering release their buffers between scrapes, so once they have grown to fit the
+ * output, rendering does not allocate.
+ */
+static prom_collector_registry_rendering_t *prom_collector_registry_render_locked(prom_collector_registry_t *self,
+                                                                                  prom_exposition_format_t format) {
+  int r = 0;
+  prom_collector_registry_rendering_t *rendering = &self->renderings[format];
+  if (self->generation != 0 && rendering->data != NULL && rendering->generation == self->generation) return rendering;
+
+  rendering->generation = 0;
   prom_metric_formatter_clear(self->metric_formatter);
-  prom_metric_formatter_load_metrics(self->metric_formatter, self->collectors);
-  return (const char *)prom_metric_formatter_dump(self->metric_formatter);
+  prom_metric_formatter_set_format(self->metric_formatter, format);
+  r = prom_metric_formatter_load_metrics(self->metric_formatter, self->collectors);
+  if (r) return NULL;
+
+  size_t len = prom_metric_formatter_len(self->metric_formatter);
+  r = prom_collector_registry_reserve(&rendering->data, &rendering->cap, len + 1);
+  if (r) return NULL;
+  memcpy(rendering->data, prom_metric_formatter_str(self->metric_formatter), len + 1);
+  rendering->len = len;
+  rendering->generation = self->generation;
+  return rendering;
+}
+
+const char *prom_collector_registry_bridge_format(prom_collector_registry_t *self, prom_exposition_format_t format,
+                                                  size_t *len) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return NULL;
+  if (format < 0 || format >= PROM_EXPOSITION_FORMAT_COUNT) return NULL;
+
+  int r = 0;
+
+  // The formatter and the renderings are shared between scrapes, so rendering is exclusive
+  r = pthread_rwlock_wrlock(self->lock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return NULL;
+  }
+
+  char *out = NULL;
+  prom_collector_registry_rendering_t *rendering = prom_collector_registry_render_locked(self, format);
+  if (rendering != NULL) {
+    // Callers own the returned buffer and release it with free(), so it comes from libc whatever the prom_alloc.h
+    // hooks are. The rendering stays with the registry.
+    out = (char *)malloc(rendering->len + 1);
+    memcpy(out, rendering->data, rendering->len + 1);
+    if (len != NULL) *len = rendering->len;
+  }
+
+  r = pthread_rwlock_unlock(self->lock);
+  if (r) PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);
+  return out;
+}
+
+int prom_collector_registry_render(prom_collector_registry_t *self, prom_exposition_format_t format, char **buf,
+                                   size_t *cap, size_t *len) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL || buf == NULL || cap == NULL) return 1;
+  if (format < 0 || format >= PROM_EXPOSITION_FORMAT_COUNT) return 1;
+
+  int r = 0;
+  r = pthread_rwlock_wrlock(self->lock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return r;
+  }
+
+  prom_collector_registry_rendering_t *rendering = prom_collector_registry_render_locked(self, format);
+  if (rendering == NULL) {
+    r = 1;
+  } else {
+    r = prom_collector_registry_reserve(buf, cap, rendering->len + 1);
+    if (!r) {
+      memcpy(*buf, rendering->data, rendering->len + 1);
+      if (len != NULL) *len = rendering->len;
+    }
+  }
+
+  int unlock_r = pthread_rwlock_unlock(self->lock);
+  if (unlock_r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);
+    return unlock_r;
+  }
+  return r;
+}
+
+int prom_collector_registry_advance_generation(prom_collector_registry_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+
+  int r = 0;
+  r = pthread_rwlock_wrlock(self->lock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return r;
+  }
+  self->generation++;
+  r = pthread_rwlock_unlock(self->lock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);
+    return r;
+  }
+  return 0;
+}
+
+// Raises the sample of the given metric name in counter to total. The totals only grow, so the difference is added.
+int prom_collector_registry_foreach_sample(prom_collector_registry_t *self, prom_collector_registry_sample_fn fn,
+                                           void *data) {
+  PROM_ASSERT(self != NULL);
+  PROM_ASSERT(fn != NULL);
+  if (self == NULL || fn == NULL) return 1;
+
+  // Taking a group's snapshot updates the group, so the walk is exclusive like a scrape
+  int r = pthread_rwlock_wrlock(self->lock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return r;
+  }
+
+  prom_epoch_enter();
+  uint64_t scrape = prom_group_next_scrape();
+  size_t collector_count = 0;
+  prom_map_entry_t *collector_entries = prom_map_entries(self->collectors, &collector_count);
+  for (size_t i = 0; i < collector_count && r == 0; i++) {
+    prom_collector_t *collector = (prom_collector_t *)collector_entries[i].value;
+    prom_map_t *metrics = collector->collect_fn(collector);
+    if (metrics == NULL) {
+      r = 1;
+      break;
+    }
+    size_t metric_count = 0;
+    prom_map_entry_t *metric_entries = prom_map_entries(metrics, &metric_count);
+    for (size_t j = 0; j < metric_count && r == 0; j++) {
+      prom_metric_t *metric = (prom_metric_t *)metric_entries[j].value;
+      // The first metric of a group to be read takes the group's snapshot, so its metrics show the same commit
+      if (metric->group != NULL) prom_group_snapshot(metric->group, scrape);
+      size_t sample_count = 0;
+      prom_map_entry_t *samples = prom_map_entries(metric->samples, &sample_count);
+      for (size_t k = 0; k < sample_count && r == 0; k++) r = fn(metric, samples[k].value, data);
+    }
+  }
+  prom_epoch_exit();
+
+  int rr = pthread_rwlock_unlock(self->lock);
+  if (rr) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);
+    return rr;
+  }
+  return r;
+}
+
+static int prom_collector_registry_report_series(prom_metric_t *counter, const char *name, uint64_t total) {
+  prom_metric_sample_t *sample = prom_metric_sample_from_labels(counter, (const char *[]){name});
+  if (sample == NULL) return 1;
+  uint64_t reported = atomic_load_explicit(&sample->i_value, memory_order_relaxed);
+  if (total <= reported) return 0;
+  return prom_metric_sample_add_u64(sample, total - reported);
+}
+
+// Creates a counter of series with a metric label and registers it with the given collector
+static prom_metric_t *prom_collector_registry_series_counter(prom_collector_t *collector, const char *name,
+                                                             const char *help) {
+  const char *label_keys[] = {"metric"};
+  prom_metric_t *counter = prom_counter_u64_new(name, help, 1, label_keys);
+  if (counter == NULL) return NULL;
+  if (prom_collector_add_metric(collector, counter)) {
+    prom_counter_destroy(counter);
+    return NULL;
+  }
+  return counter;
+}
+
+// Creates the counters that report dropped and evicted series in the default collector, unless they exist
+static int prom_collector_registry_series_counters_init(prom_collector_registry_t *self) {
+  if (self->series_dropped != NULL && self->series_evicted != NULL) return 0;
+  prom_collector_t *collector = (prom_collector_t *)prom_map_get(self->collectors, "default");
+  if (collector == NULL) return 1;
+
+  if (self->series_dropped == NULL) {
+    self->series_dropped = prom_collector_registry_series_counter(
+        collector, "prom_series_dropped_total", "Updates refused because the metric held its maximum number of series");
+  }
+  if (self->series_evicted == NULL) {
+    self->series_evicted = prom_collector_registry_series_counter(
+        collector, "prom_series_evicted_total", "Series removed after going unused for longer than the series TTL");
+  }
+  return self->series_dropped == NULL || self->series_evicted == NULL;
+}
+
+int prom_collector_registry_sweep(prom_collector_registry_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+
+  int r = 0;
+  int ret = 0;
+  r = pthread_rwlock_wrlock(self->lock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return r;
+  }
+
+  prom_epoch_enter();
+  size_t collector_count = 0;
+  prom_map_entry_t *collector_entries = prom_map_entries(self->collectors, &collector_count);
+  for (size_t i = 0; i < collector_count; i++) {
+    prom_collector_t *collector = (prom_collector_t *)collector_entries[i].value;
+    size_t metric_count = 0;
+    prom_map_entry_t *metric_entries = prom_map_entries(collector->metrics, &metric_count);
+    for (size_t j = 0; j < metric_count; j++) {
+      prom_metric_t *metric = (prom_metric_t *)metric_entries[j].value;
+      prom_metric_sweep(metric);
+
+      // Only metrics with a limit are reported, so registries that use none expose nothing new
+      if (metric->max_series == 0 && metric->series_ttl == 0) continue;
+      r = prom_collector_registry_series_counters_init(self);
+      if (r == 0) r = prom_collector_registry_report_series(self->series_dropped, metric->name,
+                                                            prom_metric_dropped_series(metric));
+      if (r == 0) r = prom_collector_registry_report_series(self->series_evicted, metric->name,
+                                                            prom_metric_evicted_series(metric));
+      if (r) ret = r;
+    }
+  }
+  prom_epoch_exit();
+
+  // Evicted samples wait for readers to move on; give them a chance to be freed every sweep
+  prom_epoch_reclaim();
+
+  r = pthread_rwlock_unlock(self->lock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);
+    return r;
+  }
+  return ret;
+}
+
+// Returns true if the len bytes at str equal the given lowercase token, ignoring case
+static bool prom_collector_registry_token_eq(const char *str, size_t len, const char *token) {
+  return strlen(token) == len && strncasecmp(str, token, len) == 0;
+}
+
+// Trims leading and trailing whitespace from the len bytes at *str
+static void prom_collector_registry_trim(const char **str, size_t *len) {
+  while (*len > 0 && (**str == ' ' || **str == '\t')) {
+    (*str)++;
+    (*len)--;
+  }
+  while (*len > 0 && ((*str)[*len - 1] == ' ' || (*str)[*len - 1] == '\t')) (*len)--;
+}
+
+prom_exposition_format_t prom_collector_registry_negotiate_format(const char *accept) {
+  prom_exposition_format_t best = PROM_EXPOSITION_TEXT;
+  double best_q = 0.0;
+  if (accept == NULL) return best;
+
+  // Walk each comma separated media range: type/subtype *( ";" param "=" value )
+  const char *range = accept;
+  while (*range != '\0') {
+    const char *range_end = strchr(range, ',');
+    if (range_end == NULL) range_end = range + strlen(range);
+
+    const char *media = range;
+    const char *media_end = memchr(range, ';', range_end - range);
+    if (media_end == NULL) media_end = range_end;
+    size_t media_len = media_end - media;
+    prom_collector_registry_trim(&media, &media_len);
+
+    double q = 1.0;
+    bool proto = false;
+    bool delimited = false;
+    const char *param = media_end;
+    while (param < range_end) {
+      param++;  // skip ';'
+      const char *param_end = memchr(param, ';', range_end - param);
+      if (param_end == NULL) param_end = range_end;
+      const char *eq = memchr(param, '=', param_end - param);
+      if (eq != NULL) {
+        const char *key = param;
+        size_t key_len = eq - param;
+        const char *value = eq + 1;
+        size_t value_len = param_end - value;
+        prom_collector_registry_trim(&key, &key_len);
+        prom_collector_registry_trim(&value, &value_len);
+        if (prom_collector_registry_token_eq(key, key_len, "q")) {
+          q = strtod(value, NULL);
+        } else if (prom_collector_registry_token_eq(key, key_len, "proto")) {
+          proto = value_len == strlen("io.prometheus.client.MetricFamily") &&
+                  strncmp(value, "io.prometheus.client.MetricFamily", value_len) == 0;
+        } else if (prom_collector_registry_token_eq(key, key_len, "encoding")) {
+          delimited = prom_collector_registry_token_eq(value, value_len, "delimited");
+        }
+      }
+      param = param_end;
+    }
+
+    bool supported = true;
+    prom_exposition_format_t format = PROM_EXPOSITION_TEXT;
+    if (prom_collector_registry_token_eq(media, media_len, "application/vnd.google.protobuf")) {
+      format = PROM_EXPOSITION_PROTOBUF;
+      supported = proto && delimited;
+    } else if (prom_collector_registry_token_eq(media, media_len, "application/openmetrics-text")) {
+      format = PROM_EXPOSITION_OPENMETRICS;
+    } else if (!prom_collector_registry_token_eq(media, media_len, "text/plain") &&
+               !prom_collector_registry_token_eq(media, media_len, "text/*") &&
+               !prom_collector_registry_token_eq(media, media_len, "*/*")) {
+      supported = false;
+    }
+
+    // Strictly greater so that the earliest of equally weighted ranges wins
+    if (supported && q > best_q) {
+      best = format;
+      best_q = q;
+    }
+
+    range = *range_end == ',' ? range_end + 1 : range_end;
+  }
+  return best;
+}
+
+const char *prom_collector_registry_content_type(prom_exposition_format_t format) {
+  switch (format) {
+    case PROM_EXPOSITION_OPENMETRICS:
+      return "application/openmetrics-text; version=1.0.0; charset=utf-8";
+    case PROM_EXPOSITION_PROTOBUF:
+      return "application/vnd.google.protobuf; proto=io.prometheus.client.MetricFamily; encoding=delimited";
+    default:
+      return "text/plain; version=0.0.4; charset=utf-8";
+  }
 }
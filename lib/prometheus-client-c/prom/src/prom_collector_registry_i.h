@@ -23,4 +23,15 @@ int prom_collector_registry_enable_custom_process_metrics(prom_collector_registr
                                                           const char *process_limits_path,
                                                           const char *process_stats_path);
 
+/**
+ * @brief API PRIVATE Calls fn with every sample of every metric the registry's collectors return, passing data along.
+ *
+ * The walk holds the registry write lock, so it is serialized with scrapes and with the other exporters. Metrics that
+ * belong to a prom_group are read from the group's snapshot, taken once per walk, so fn sees every metric of a group
+ * at the same commit when it reads them with prom_metric_sample_scrape_value. Returns non-zero if a collector fails
+ * or fn returns non-zero.
+ */
+int prom_collector_registry_foreach_sample(prom_collector_registry_t *self, prom_collector_registry_sample_fn fn,
+                                           void *data);
+
 #endif  // PROM_COLLECTOR_REGISTRY_I_INCLUDED
@@ -19,15 +19,38 @@
 
 #include <pthread.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 // Public
 #include "prom_collector_registry.h"
+#include "prom_metric.h"
 
 // Private
 #include "prom_map_t.h"
 #include "prom_metric_formatter_t.h"
 #include "prom_string_builder_t.h"
 
+/**
+ * @brief API PRIVATE The number of members in prom_exposition_format_t
+ */
+#define PROM_EXPOSITION_FORMAT_COUNT 3
+
+/**
+ * @brief API PRIVATE A cached rendering of the registry in one exposition format
+ */
+typedef struct prom_collector_registry_rendering {
+  char *data;          /**< data is the rendered output or NULL */
+  size_t len;          /**< len is the number of bytes in data excluding the terminating NUL */
+  size_t cap;          /**< cap is the number of bytes allocated to data. It is kept between renders */
+  uint64_t generation; /**< generation is the registry generation data was rendered at. 0 if data is stale */
+} prom_collector_registry_rendering_t;
+
+/**
+ * @brief API PRIVATE Called by prom_collector_registry_foreach_sample with one sample of metric. The sample is the
+ * prom_metric_sample_*_t that matches the metric's type. A non-zero return stops the walk and is returned by it.
+ */
+typedef int (*prom_collector_registry_sample_fn)(prom_metric_t *metric, void *sample, void *data);
+
 struct prom_collector_registry {
   const char *name;
   bool disable_process_metrics;              /**< Disables the collection of process metrics */
@@ -35,6 +58,10 @@ struct prom_collector_registry {
   prom_string_builder_t *string_builder;     /**< Enables string building */
   prom_metric_formatter_t *metric_formatter; /**< metric formatter for metric exposition on bridge call */
   pthread_rwlock_t *lock;                    /**< mutex for safety against concurrent registration */
+  uint64_t generation;                       /**< generation of the metric values. 0 disables rendering caches */
+  prom_collector_registry_rendering_t renderings[PROM_EXPOSITION_FORMAT_COUNT]; /**< cached output per format */
+  prom_metric_t *series_dropped; /**< series_dropped reports prom_metric_dropped_series. NULL until a sweep needs it */
+  prom_metric_t *series_evicted; /**< series_evicted reports prom_metric_evicted_series. NULL until a sweep needs it */
 };
 
 #endif  // PROM_REGISTRY_T_H
@@ -17,8 +17,12 @@
 #ifndef PROM_COLLECTOR_T_H
 #define PROM_COLLECTOR_T_H
 
+#include <stdint.h>
+
 #include "prom_collector.h"
 #include "prom_map_t.h"
+#include "prom_process_stat_t.h"
+#include "prom_procfs_t.h"
 #include "prom_string_builder_t.h"
 
 struct prom_collector {
@@ -28,6 +32,11 @@ struct prom_collector {
   prom_string_builder_t *string_builder;
   const char *proc_limits_file_path;
   const char *proc_stat_file_path;
+  prom_procfs_buf_t *proc_limits_file; /**< proc_limits_file stays open between scrapes. NULL until the first one */
+  prom_procfs_buf_t *proc_stat_file;   /**< proc_stat_file stays open between scrapes. NULL until the first one */
+  prom_process_stat_t proc_stat;       /**< proc_stat is parsed from proc_stat_file in place on each collection */
+  double proc_limits_read_at;          /**< proc_limits_read_at is the monotonic time the limits were last read at */
+  uint64_t proc_limits_generation;     /**< proc_limits_generation is the refresh generation the limits were read at */
 };
 
 #endif  // PROM_COLLECTOR_T_H
@@ -21,6 +21,7 @@
 
 // Private
 #include "prom_assert.h"
+#include "prom_epoch_i.h"
 #include "prom_errors.h"
 #include "prom_log.h"
 #include "prom_metric_i.h"
@@ -32,6 +33,22 @@ prom_counter_t *prom_counter_new(const char *name, const char *help, size_t labe
   return (prom_counter_t *)prom_metric_new(PROM_COUNTER, name, help, label_key_count, label_keys);
 }
 
+prom_counter_t *prom_counter_sharded_new(const char *name, const char *help, size_t label_key_count,
+                                         const char **label_keys) {
+  prom_counter_t *self = prom_counter_new(name, help, label_key_count, label_keys);
+  if (self == NULL) return NULL;
+  self->sharded = true;
+  return self;
+}
+
+prom_counter_t *prom_counter_u64_new(const char *name, const char *help, size_t label_key_count,
+                                     const char **label_keys) {
+  prom_counter_t *self = prom_counter_new(name, help, label_key_count, label_keys);
+  if (self == NULL) return NULL;
+  self->integer = true;
+  return self;
+}
+
 int prom_counter_destroy(prom_counter_t *self) {
   PROM_ASSERT(self != NULL);
   if (self == NULL) return 0;
@@ -48,9 +65,11 @@ int prom_counter_inc(prom_counter_t *self, const char **label_values) {
     PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
     return 1;
   }
-  prom_metric_sample_t *sample = prom_metric_sample_from_labels(self, label_values);
-  if (sample == NULL) return 1;
-  return prom_metric_sample_add(sample, 1.0);
+  prom_epoch_enter();
+  prom_metric_sample_t *sample = prom_metric_sample_for_update(self, label_values);
+  int r = sample == NULL ? 1 : prom_metric_sample_add(sample, 1.0);
+  prom_epoch_exit();
+  return r;
 }
 
 int prom_counter_add(prom_counter_t *self, double r_value, const char **label_values) {
@@ -60,7 +79,51 @@ int prom_counter_add(prom_counter_t *self, double r_value, const char **label_va
     PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
     return 1;
   }
-  prom_metric_sample_t *sample = prom_metric_sample_from_labels(self, label_values);
-  if (sample == NULL) return 1;
-  return prom_metric_sample_add(sample, r_value);
+  prom_epoch_enter();
+  prom_metric_sample_t *sample = prom_metric_sample_for_update(self, label_values);
+  int r = sample == NULL ? 1 : prom_metric_sample_add(sample, r_value);
+  prom_epoch_exit();
+  return r;
+}
+
+int prom_counter_add_u64(prom_counter_t *self, uint64_t value, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (self->type != PROM_COUNTER) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  prom_epoch_enter();
+  prom_metric_sample_t *sample = prom_metric_sample_for_update(self, label_values);
+  int r = sample == NULL ? 1 : prom_metric_sample_add_u64(sample, value);
+  prom_epoch_exit();
+  return r;
+}
+
+int prom_counter_add_with_exemplar(prom_counter_t *self, double r_value, const char **label_values,
+                                   size_t exemplar_label_count, const char **exemplar_label_keys,
+                                   const char **exemplar_label_values) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (self->type != PROM_COUNTER) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  prom_epoch_enter();
+  prom_metric_sample_t *sample = prom_metric_sample_for_update(self, label_values);
+  int r = sample == NULL ? 1
+                         : prom_metric_sample_add_with_exemplar(sample, r_value, exemplar_label_count,
+                                                                exemplar_label_keys, exemplar_label_values);
+  prom_epoch_exit();
+  return r;
+}
+
+prom_metric_sample_t *prom_counter_child(prom_counter_t *self, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return NULL;
+  if (self->type != PROM_COUNTER) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return NULL;
+  }
+  return prom_metric_sample_from_labels(self, label_values);
 }
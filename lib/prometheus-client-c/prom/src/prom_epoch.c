@@ -0,0 +1,176 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Public
+#include "prom_alloc.h"
+
+// Private
+#include "prom_epoch_i.h"
+#include "prom_epoch_t.h"
+#include "prom_log.h"
+
+// Epoch based reclamation. A reader announces the global epoch in its record on entry and clears it on exit. Retired
+// memory is stamped with the global epoch, and the epoch only advances once every announcing reader has observed it.
+// A reader can therefore lag the global epoch by at most one, so memory retired in epoch e is unreachable to all readers
+// once the global epoch reaches e + 2.
+//
+// Readers never take a lock or write shared memory other than their own record. Retiring and reclaiming are serialized
+// by prom_epoch_lock and happen on the comparatively rare write paths.
+//
+// Reference:
+//   * https://www.cl.cam.ac.uk/techreports/UCAM-CL-TR-579.pdf
+
+static _Atomic uint64_t prom_epoch_global = 1;
+static _Atomic(prom_epoch_record_t *) prom_epoch_records = NULL;
+static pthread_mutex_t prom_epoch_lock = PTHREAD_MUTEX_INITIALIZER;
+static prom_epoch_retired_t *prom_epoch_retired_head = NULL;
+static size_t prom_epoch_retired_count = 0;
+
+static pthread_once_t prom_epoch_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t prom_epoch_key;
+static _Thread_local prom_epoch_record_t *prom_epoch_local = NULL;
+
+// Releases the record of an exiting thread so that another thread may claim it
+static void prom_epoch_record_release(void *item) {
+  prom_epoch_record_t *record = (prom_epoch_record_t *)item;
+  record->nesting = 0;
+  atomic_store_explicit(&record->epoch, 0, memory_order_release);
+  atomic_store_explicit(&record->in_use, false, memory_order_release);
+}
+
+static void prom_epoch_key_init(void) {
+  if (pthread_key_create(&prom_epoch_key, prom_epoch_record_release)) PROM_LOG("failed to create epoch key");
+}
+
+static prom_epoch_record_t *prom_epoch_record_acquire(void) {
+  pthread_once(&prom_epoch_key_once, prom_epoch_key_init);
+
+  // Prefer a record left behind by a thread that exited
+  prom_epoch_record_t *record = atomic_load_explicit(&prom_epoch_records, memory_order_acquire);
+  for (; record != NULL; record = record->next) {
+    bool expected = false;
+    if (!atomic_load_explicit(&record->in_use, memory_order_relaxed) &&
+        atomic_compare_exchange_strong(&record->in_use, &expected, true))
+      break;
+  }
+
+  if (record == NULL) {
+    record = (prom_epoch_record_t *)prom_malloc(sizeof(prom_epoch_record_t));
+    atomic_init(&record->epoch, 0);
+    atomic_init(&record->in_use, true);
+    record->nesting = 0;
+    record->next = atomic_load_explicit(&prom_epoch_records, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&prom_epoch_records, &record->next, record, memory_order_release,
+                                                  memory_order_relaxed)) {
+    }
+  }
+
+  pthread_setspecific(prom_epoch_key, record);
+  prom_epoch_local = record;
+  return record;
+}
+
+void prom_epoch_enter(void) {
+  prom_epoch_record_t *record = prom_epoch_local;
+  if (record == NULL) record = prom_epoch_record_acquire();
+  if (record->nesting++ > 0) return;
+  atomic_store_explicit(&record->epoch, atomic_load_explicit(&prom_epoch_global, memory_order_relaxed),
+                        memory_order_relaxed);
+  // The announcement must be visible before any shared pointer is loaded. This pairs with the fence in
+  // prom_epoch_reclaim_locked.
+  atomic_thread_fence(memory_order_seq_cst);
+}
+
+void prom_epoch_exit(void) {
+  prom_epoch_record_t *record = prom_epoch_local;
+  if (record == NULL || record->nesting == 0) return;
+  if (--record->nesting == 0) atomic_store_explicit(&record->epoch, 0, memory_order_release);
+}
+
+// Returns the list of retired items that may be freed. The caller frees them after releasing prom_epoch_lock so that
+// free functions may themselves retire memory.
+static prom_epoch_retired_t *prom_epoch_reclaim_locked(void) {
+  atomic_thread_fence(memory_order_seq_cst);
+  uint64_t epoch = atomic_load_explicit(&prom_epoch_global, memory_order_relaxed);
+
+  bool advance = true;
+  prom_epoch_record_t *record = atomic_load_explicit(&prom_epoch_records, memory_order_acquire);
+  for (; record != NULL; record = record->next) {
+    uint64_t seen = atomic_load_explicit(&record->epoch, memory_order_acquire);
+    if (seen != 0 && seen != epoch) {
+      advance = false;
+      break;
+    }
+  }
+  if (advance) atomic_store_explicit(&prom_epoch_global, ++epoch, memory_order_release);
+
+  prom_epoch_retired_t *ready = NULL;
+  prom_epoch_retired_t **link = &prom_epoch_retired_head;
+  while (*link != NULL) {
+    prom_epoch_retired_t *item = *link;
+    if (item->epoch + 2 <= epoch) {
+      *link = item->next;
+      item->next = ready;
+      ready = item;
+      prom_epoch_retired_count--;
+    } else {
+      link = &item->next;
+    }
+  }
+  return ready;
+}
+
+static void prom_epoch_free_list(prom_epoch_retired_t *item) {
+  while (item != NULL) {
+    prom_epoch_retired_t *next = item->next;
+    (*item->free_fn)(item->ptr);
+    prom_free(item);
+    item = next;
+  }
+}
+
+void prom_epoch_retire(void *ptr, prom_epoch_free_fn free_fn) {
+  if (ptr == NULL) return;
+  prom_epoch_retired_t *item = (prom_epoch_retired_t *)prom_malloc(sizeof(prom_epoch_retired_t));
+  item->ptr = ptr;
+  item->free_fn = free_fn;
+
+  pthread_mutex_lock(&prom_epoch_lock);
+  item->epoch = atomic_load_explicit(&prom_epoch_global, memory_order_relaxed);
+  item->next = prom_epoch_retired_head;
+  prom_epoch_retired_head = item;
+  prom_epoch_retired_count++;
+  prom_epoch_retired_t *ready = prom_epoch_reclaim_locked();
+  pthread_mutex_unlock(&prom_epoch_lock);
+
+  prom_epoch_free_list(ready);
+}
+
+size_t prom_epoch_reclaim(void) {
+  pthread_mutex_lock(&prom_epoch_lock);
+  prom_epoch_retired_t *ready = prom_epoch_reclaim_locked();
+  size_t pending = prom_epoch_retired_count;
+  pthread_mutex_unlock(&prom_epoch_lock);
+
+  prom_epoch_free_list(ready);
+  return pending;
+}
@@ -0,0 +1,51 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PROM_EPOCH_I_H
+#define PROM_EPOCH_I_H
+
+#include <stddef.h>
+
+#include "prom_epoch_t.h"
+
+/**
+ * @brief API PRIVATE Enters a read-side critical section on the calling thread.
+ *
+ * Memory passed to prom_epoch_retire is not freed while any thread that could have observed it remains inside its
+ * critical section. Critical sections may nest and must not block.
+ */
+void prom_epoch_enter(void);
+
+/**
+ * @brief API PRIVATE Leaves the read-side critical section entered by the matching prom_epoch_enter.
+ */
+void prom_epoch_exit(void);
+
+/**
+ * @brief API PRIVATE Frees ptr with free_fn once no reader can still hold a reference to it.
+ *
+ * ptr must already be unreachable from the shared structure it was removed from.
+ */
+void prom_epoch_retire(void *ptr, prom_epoch_free_fn free_fn);
+
+/**
+ * @brief API PRIVATE Advances the global epoch if every reader has caught up, then frees what can be freed. Returns the
+ * number of retired items that are still pending.
+ */
+size_t prom_epoch_reclaim(void);
+
+#endif  // PROM_EPOCH_I_H
@@ -0,0 +1,50 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PROM_EPOCH_T_H
+#define PROM_EPOCH_T_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef void (*prom_epoch_free_fn)(void *);
+
+/**
+ * @brief API PRIVATE A thread's announcement of the epoch it is reading in.
+ *
+ * Records are never freed. A record is claimed by a thread on its first critical section and released when that thread
+ * exits, after which another thread may claim it.
+ */
+typedef struct prom_epoch_record {
+  _Atomic uint64_t epoch;         /**< 0 outside of a critical section, else the global epoch observed on entry */
+  _Atomic bool in_use;            /**< in_use is true while a live thread owns the record */
+  unsigned int nesting;           /**< nesting counts the critical sections the owning thread has entered */
+  struct prom_epoch_record *next; /**< next record. The list only grows */
+} prom_epoch_record_t;
+
+/**
+ * @brief API PRIVATE Memory that was unlinked from a shared structure and is waiting for readers to move on.
+ */
+typedef struct prom_epoch_retired {
+  void *ptr;
+  prom_epoch_free_fn free_fn;
+  uint64_t epoch; /**< the global epoch when ptr was retired */
+  struct prom_epoch_retired *next;
+} prom_epoch_retired_t;
+
+#endif  // PROM_EPOCH_T_H
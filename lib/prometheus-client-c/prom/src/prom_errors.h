@@ -16,11 +16,21 @@
 
 #define PROM_STDIO_CLOSE_DIR_ERROR "failed to close dir"
 #define PROM_STDIO_OPEN_DIR_ERROR "failed to open dir"
+#define PROM_STDIO_READ_DIR_ERROR "failed to read dir"
 #define PROM_METRIC_INCORRECT_TYPE "incorrect metric type"
 #define PROM_METRIC_INVALID_LABEL_NAME "invalid label name"
+#define PROM_METRIC_INVALID_NAME "invalid metric name"
+#define PROM_METRIC_INTEGER_RANGE_ERROR "value is not finite or out of the range of an integer sample"
+#define PROM_NATIVE_HISTOGRAM_INVALID_SCHEMA "native histogram schema out of range"
+#define PROM_SUMMARY_INVALID_QUANTILES "invalid summary quantiles"
+#define PROM_GROUP_MEMBER_ERROR "metric already belongs to a group"
+#define PROM_GROUP_NOT_STAGING_ERROR "group commit without begin"
+#define PROM_GROUP_STAGING_ERROR "group begin while staging"
+#define PROM_RATE_BITS_ERROR "rate counter width must be between 1 and 64 bits"
+#define PROM_RATE_INDEX_ERROR "rate series index out of range"
+#define PROM_HISTORY_SERIES_ERROR "failed to allocate the history of a series"
+#define PROM_METRIC_EXEMPLAR_TOO_LONG "exemplar labels exceed 128 characters"
 #define PROM_PTHREAD_RWLOCK_DESTROY_ERROR "failed to destroy the pthread_rwlock_t*"
 #define PROM_PTHREAD_RWLOCK_INIT_ERROR "failed to initialize the pthread_rwlock_t*"
 #define PROM_PTHREAD_RWLOCK_LOCK_ERROR "failed to lock the pthread_rwlock_t*"
 #define PROM_PTHREAD_RWLOCK_UNLOCK_ERROR "failed to unlock the pthread_rwlock_t*"
-#define PROM_REGEX_REGCOMP_ERROR "failed to compile the regular expression"
-#define PROM_REGEX_REGEXEC_ERROR "failed to execute the regular expression"
@@ -21,6 +21,7 @@
 
 // Private
 #include "prom_assert.h"
+#include "prom_epoch_i.h"
 #include "prom_errors.h"
 #include "prom_log.h"
 #include "prom_metric_i.h"
@@ -32,6 +33,14 @@ prom_gauge_t *prom_gauge_new(const char *name, const char *help, size_t label_ke
   return (prom_gauge_t *)prom_metric_new(PROM_GAUGE, name, help, label_key_count, label_keys);
 }
 
+prom_gauge_t *prom_gauge_i64_new(const char *name, const char *help, size_t label_key_count,
+                                 const char **label_keys) {
+  prom_gauge_t *self = prom_gauge_new(name, help, label_key_count, label_keys);
+  if (self == NULL) return NULL;
+  self->integer = true;
+  return self;
+}
+
 int prom_gauge_destroy(prom_gauge_t *self) {
   PROM_ASSERT(self != NULL);
   int r = 0;
@@ -47,9 +56,11 @@ int prom_gauge_inc(prom_gauge_t *self, const char **label_values) {
     PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
     return 1;
   }
-  prom_metric_sample_t *sample = prom_metric_sample_from_labels(self, label_values);
-  if (sample == NULL) return 1;
-  return prom_metric_sample_add(sample, 1.0);
+  prom_epoch_enter();
+  prom_metric_sample_t *sample = prom_metric_sample_for_update(self, label_values);
+  int r = sample == NULL ? 1 : prom_metric_sample_add(sample, 1.0);
+  prom_epoch_exit();
+  return r;
 }
 
 int prom_gauge_dec(prom_gauge_t *self, const char **label_values) {
@@ -59,9 +70,11 @@ int prom_gauge_dec(prom_gauge_t *self, const char **label_values) {
     PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
     return 1;
   }
-  prom_metric_sample_t *sample = prom_metric_sample_from_labels(self, label_values);
-  if (sample == NULL) return 1;
-  return prom_metric_sample_sub(sample, 1.0);
+  prom_epoch_enter();
+  prom_metric_sample_t *sample = prom_metric_sample_for_update(self, label_values);
+  int r = sample == NULL ? 1 : prom_metric_sample_sub(sample, 1.0);
+  prom_epoch_exit();
+  return r;
 }
 
 int prom_gauge_add(prom_gauge_t *self, double r_value, const char **label_values) {
@@ -71,9 +84,11 @@ int prom_gauge_add(prom_gauge_t *self, double r_value, const char **label_values
     PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
     return 1;
   }
-  prom_metric_sample_t *sample = prom_metric_sample_from_labels(self, label_values);
-  if (sample == NULL) return 1;
-  return prom_metric_sample_add(sample, r_value);
+  prom_epoch_enter();
+  prom_metric_sample_t *sample = prom_metric_sample_for_update(self, label_values);
+  int r = sample == NULL ? 1 : prom_metric_sample_add(sample, r_value);
+  prom_epoch_exit();
+  return r;
 }
 
 int prom_gauge_sub(prom_gauge_t *self, double r_value, const char **label_values) {
@@ -83,9 +98,11 @@ int prom_gauge_sub(prom_gauge_t *self, double r_value, const char **label_values
     PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
     return 1;
   }
-  prom_metric_sample_t *sample = prom_metric_sample_from_labels(self, label_values);
-  if (sample == NULL) return 1;
-  return prom_metric_sample_sub(sample, r_value);
+  prom_epoch_enter();
+  prom_metric_sample_t *sample = prom_metric_sample_for_update(self, label_values);
+  int r = sample == NULL ? 1 : prom_metric_sample_sub(sample, r_value);
+  prom_epoch_exit();
+  return r;
 }
 
 int prom_gauge_set(prom_gauge_t *self, double r_value, const char **label_values) {
@@ -95,7 +112,47 @@ int prom_gauge_set(prom_gauge_t *self, double r_value, const char **label_values
     PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
     return 1;
   }
-  prom_metric_sample_t *sample = prom_metric_sample_from_labels(self, label_values);
-  if (sample == NULL) return 1;
-  return prom_metric_sample_set(sample, r_value);
+  prom_epoch_enter();
+  prom_metric_sample_t *sample = prom_metric_sample_for_update(self, label_values);
+  int r = sample == NULL ? 1 : prom_metric_sample_set(sample, r_value);
+  prom_epoch_exit();
+  return r;
+}
+
+int prom_gauge_add_i64(prom_gauge_t *self, int64_t value, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (self->type != PROM_GAUGE) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  prom_epoch_enter();
+  prom_metric_sample_t *sample = prom_metric_sample_for_update(self, label_values);
+  int r = sample == NULL ? 1 : prom_metric_sample_add_i64(sample, value);
+  prom_epoch_exit();
+  return r;
+}
+
+int prom_gauge_set_i64(prom_gauge_t *self, int64_t value, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (self->type != PROM_GAUGE) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  prom_epoch_enter();
+  prom_metric_sample_t *sample = prom_metric_sample_for_update(self, label_values);
+  int r = sample == NULL ? 1 : prom_metric_sample_set_i64(sample, value);
+  prom_epoch_exit();
+  return r;
+}
+
+prom_metric_sample_t *prom_gauge_child(prom_gauge_t *self, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return NULL;
+  if (self->type != PROM_GAUGE) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return NULL;
+  }
+  return prom_metric_sample_from_labels(self, label_values);
 }
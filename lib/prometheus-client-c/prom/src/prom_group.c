@@ -0,0 +1,156 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Public
+#include "prom_alloc.h"
+#include "prom_group.h"
+
+// Private
+#include "prom_assert.h"
+#include "prom_errors.h"
+#include "prom_group_i.h"
+#include "prom_group_t.h"
+#include "prom_log.h"
+#include "prom_map_i.h"
+#include "prom_metric_sample_i.h"
+#include "prom_metric_sample_t.h"
+#include "prom_metric_t.h"
+
+static _Atomic uint64_t prom_group_scrapes = 0;
+
+prom_group_t *prom_group_new(void) {
+  prom_group_t *self = (prom_group_t *)prom_malloc(sizeof(prom_group_t));
+  if (self == NULL) return NULL;
+  atomic_init(&self->seq, 0);
+  self->metrics = NULL;
+  self->metric_count = 0;
+  self->metric_cap = 0;
+  self->slot = 0;
+  self->scrape = 0;
+  return self;
+}
+
+int prom_group_destroy(prom_group_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 0;
+  prom_free(self->metrics);
+  self->metrics = NULL;
+  prom_free(self);
+  self = NULL;
+  return 0;
+}
+
+int prom_group_add(prom_group_t *self, prom_metric_t *metric) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL || metric == NULL) return 1;
+  if (metric->type != PROM_COUNTER && metric->type != PROM_GAUGE) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  if (metric->group != NULL) {
+    PROM_LOG(PROM_GROUP_MEMBER_ERROR);
+    return 1;
+  }
+
+  if (self->metric_count == self->metric_cap) {
+    size_t cap = self->metric_cap == 0 ? 4 : self->metric_cap * 2;
+    prom_metric_t **metrics = (prom_metric_t **)prom_realloc(self->metrics, cap * sizeof(prom_metric_t *));
+    if (metrics == NULL) return 1;
+    self->metrics = metrics;
+    self->metric_cap = cap;
+  }
+
+  int r = pthread_rwlock_wrlock(metric->rwlock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return r;
+  }
+  // Samples created from now on take the group from the metric
+  metric->group = self;
+  size_t sample_count = 0;
+  prom_map_entry_t *samples = prom_map_entries(metric->samples, &sample_count);
+  for (size_t i = 0; i < sample_count; i++) ((prom_metric_sample_t *)samples[i].value)->group = self;
+  r = pthread_rwlock_unlock(metric->rwlock);
+  if (r) PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);
+
+  self->metrics[self->metric_count++] = metric;
+  return r;
+}
+
+// Writer side of the seqlock: odd, release fence, values, even with release
+int prom_group_begin(prom_group_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  uint64_t seq = atomic_load_explicit(&self->seq, memory_order_relaxed);
+  if (seq & 1) {
+    PROM_LOG(PROM_GROUP_STAGING_ERROR);
+    return 1;
+  }
+  atomic_store_explicit(&self->seq, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  return 0;
+}
+
+int prom_group_commit(prom_group_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  uint64_t seq = atomic_load_explicit(&self->seq, memory_order_relaxed);
+  if (!(seq & 1)) {
+    PROM_LOG(PROM_GROUP_NOT_STAGING_ERROR);
+    return 1;
+  }
+  atomic_store_explicit(&self->seq, seq + 1, memory_order_release);
+  return 0;
+}
+
+uint64_t prom_group_next_scrape(void) {
+  return atomic_fetch_add_explicit(&prom_group_scrapes, 1, memory_order_relaxed) + 1;
+}
+
+// Copies every sample of the group into the given snapshot slot
+static void prom_group_read(prom_group_t *self, size_t slot) {
+  for (size_t i = 0; i < self->metric_count; i++) {
+    size_t sample_count = 0;
+    prom_map_entry_t *samples = prom_map_entries(self->metrics[i]->samples, &sample_count);
+    for (size_t j = 0; j < sample_count; j++) {
+      prom_metric_sample_snapshot((prom_metric_sample_t *)samples[j].value, slot);
+    }
+  }
+}
+
+size_t prom_group_snapshot(prom_group_t *self, uint64_t scrape) {
+  PROM_ASSERT(self != NULL);
+  if (self->scrape == scrape) return self->slot;
+  self->scrape = scrape;
+
+  // Reader side of the seqlock. The values are read into the slot that is not current, so a read that fails leaves
+  // the previous snapshot intact.
+  size_t slot = (self->slot + 1) % PROM_GROUP_SLOTS;
+  for (unsigned int attempt = 0; attempt < PROM_GROUP_READ_ATTEMPTS; attempt++) {
+    uint64_t seq = atomic_load_explicit(&self->seq, memory_order_acquire);
+    if (seq & 1) continue;
+    prom_group_read(self, slot);
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&self->seq, memory_order_relaxed) != seq) continue;
+    self->slot = slot;
+    return slot;
+  }
+  return self->slot;
+}
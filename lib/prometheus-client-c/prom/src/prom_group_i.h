@@ -0,0 +1,43 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_GROUP_I_H
+#define PROM_GROUP_I_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Private
+#include "prom_group_t.h"
+
+/**
+ * @brief API PRIVATE The number of times a scrape reads a group before it gives up on a writer that keeps committing
+ * and reuses the previous snapshot
+ */
+#define PROM_GROUP_READ_ATTEMPTS 1024
+
+/**
+ * @brief API PRIVATE Returns a new scrape identifier. Identifiers are unique across registries and never 0.
+ */
+uint64_t prom_group_next_scrape(void);
+
+/**
+ * @brief API PRIVATE Reads every sample of the group into a snapshot slot, once per scrape, and returns the slot that
+ * holds the latest consistent values. The caller is inside an epoch critical section.
+ */
+size_t prom_group_snapshot(prom_group_t *self, uint64_t scrape);
+
+#endif  // PROM_GROUP_I_H
@@ -0,0 +1,42 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_GROUP_T_H
+#define PROM_GROUP_T_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Public
+#include "prom_group.h"
+#include "prom_metric.h"
+
+/**
+ * @brief API PRIVATE The number of snapshots a sample keeps: the latest consistent one and the one being read
+ */
+#define PROM_GROUP_SLOTS 2
+
+struct prom_group {
+  _Atomic uint64_t seq;    /**< seq is odd while the writer stages values */
+  prom_metric_t **metrics; /**< metrics are the members of the group */
+  size_t metric_count;     /**< metric_count is the number of entries in metrics */
+  size_t metric_cap;       /**< metric_cap is the number of entries allocated to metrics */
+  size_t slot;             /**< slot is the snapshot of the samples that holds the latest consistent read */
+  uint64_t scrape;         /**< scrape identifies the scrape that last read the group. 0 before the first one */
+};
+
+#endif  // PROM_GROUP_T_H
@@ -22,6 +22,7 @@
 
 // Private
 #include "prom_assert.h"
+#include "prom_epoch_i.h"
 #include "prom_errors.h"
 #include "prom_log.h"
 #include "prom_map_i.h"
@@ -33,6 +34,7 @@
 prom_histogram_t *prom_histogram_new(const char *name, const char *help, prom_histogram_buckets_t *buckets,
                                      size_t label_key_count, const char **label_keys) {
   prom_histogram_t *self = (prom_histogram_t *)prom_metric_new(PROM_HISTOGRAM, name, help, label_key_count, label_keys);
+  if (self == NULL) return NULL;
   if (buckets == NULL) {
     if (!prom_histogram_default_buckets) {
       prom_histogram_default_buckets = prom_histogram_buckets_new(11,
@@ -73,7 +75,9 @@ int prom_histogram_observe(prom_histogram_t *self, double value, const char **la
     PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
     return 1;
   }
-  prom_metric_sample_histogram_t *h_sample = prom_metric_sample_histogram_from_labels(self, label_values);
-  if (h_sample == NULL) return 1;
-  return prom_metric_sample_histogram_observe(h_sample, value);
+  prom_epoch_enter();
+  prom_metric_sample_histogram_t *h_sample = prom_metric_sample_histogram_for_update(self, label_values);
+  int r = h_sample == NULL ? 1 : prom_metric_sample_histogram_observe(h_sample, value);
+  prom_epoch_exit();
+  return r;
 }
@@ -0,0 +1,678 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Public
+#include "prom_alloc.h"
+#include "prom_history.h"
+
+// Private
+#include "prom_assert.h"
+#include "prom_collector_registry_i.h"
+#include "prom_collector_registry_t.h"
+#include "prom_epoch_i.h"
+#include "prom_errors.h"
+#include "prom_history_i.h"
+#include "prom_history_t.h"
+#include "prom_log.h"
+#include "prom_map_i.h"
+#include "prom_metric_sample_i.h"
+#include "prom_metric_sample_t.h"
+#include "prom_metric_t.h"
+#include "prom_string_builder_i.h"
+
+#define PROM_HISTORY_INITIAL_BUF_CAP 4096
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Chunks
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Writes the low bits of value, most significant first. The bytes past the end of the stream are always zero.
+static inline void prom_history_put(prom_history_chunk_t *self, uint64_t value, unsigned int bits) {
+  while (bits > 0) {
+    unsigned int space = 8 - (unsigned int)(self->bits & 7);
+    unsigned int n = bits < space ? bits : space;
+    uint8_t part = (uint8_t)((value >> (bits - n)) & ((1u << n) - 1));
+    self->data[self->bits >> 3] |= (uint8_t)(part << (space - n));
+    self->bits += n;
+    bits -= n;
+  }
+}
+
+static inline uint64_t prom_history_get(const prom_history_chunk_t *chunk, size_t *pos, unsigned int bits) {
+  uint64_t value = 0;
+  while (bits > 0) {
+    unsigned int avail = 8 - (unsigned int)(*pos & 7);
+    unsigned int n = bits < avail ? bits : avail;
+    uint8_t byte = chunk->data[*pos >> 3];
+    value = (value << n) | ((uint64_t)(byte >> (avail - n)) & ((1u << n) - 1));
+    *pos += n;
+    bits -= n;
+  }
+  return value;
+}
+
+static inline uint64_t prom_history_bits(double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+static inline double prom_history_value(uint64_t bits) {
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// Delta-of-deltas take a prefix of up to four bits followed by a field sized for the millisecond timestamps of samples
+// taken seconds to minutes apart, the same ranges Prometheus uses. A regular interval encodes as a single 0 bit.
+static void prom_history_put_dod(prom_history_chunk_t *self, int64_t dod) {
+  if (dod == 0) {
+    prom_history_put(self, 0x0, 1);
+  } else if (dod >= -8191 && dod <= 8192) {
+    prom_history_put(self, 0x2, 2);
+    prom_history_put(self, (uint64_t)dod, 14);
+  } else if (dod >= -65535 && dod <= 65536) {
+    prom_history_put(self, 0x6, 3);
+    prom_history_put(self, (uint64_t)dod, 17);
+  } else if (dod >= -524287 && dod <= 524288) {
+    prom_history_put(self, 0xe, 4);
+    prom_history_put(self, (uint64_t)dod, 20);
+  } else {
+    prom_history_put(self, 0xf, 4);
+    prom_history_put(self, (uint64_t)dod, 64);
+  }
+}
+
+static int64_t prom_history_get_dod(const prom_history_chunk_t *chunk, size_t *pos) {
+  unsigned int ones = 0;
+  while (ones < 4 && prom_history_get(chunk, pos, 1)) ones++;
+  static const unsigned int widths[] = {0, 14, 17, 20, 64};
+  unsigned int bits = widths[ones];
+  if (bits == 0) return 0;
+  uint64_t value = prom_history_get(chunk, pos, bits);
+  if (bits == 64) return (int64_t)value;
+  // Fields are sign extended, except for the largest positive value which takes the pattern of the smallest negative
+  if (value > (UINT64_C(1) << (bits - 1))) return (int64_t)value - (int64_t)(UINT64_C(1) << bits);
+  return (int64_t)value;
+}
+
+// An unchanged value encodes as a single 0 bit. Otherwise the meaningful bits of the XOR with the previous value are
+// written, within the previous window of leading and trailing zeros when they fit in it.
+static void prom_history_put_value(prom_history_chunk_t *self, uint64_t bits) {
+  uint64_t x = bits ^ self->last_value;
+  if (x == 0) {
+    prom_history_put(self, 0x0, 1);
+    return;
+  }
+  prom_history_put(self, 0x1, 1);
+  unsigned int leading = (unsigned int)__builtin_clzll(x);
+  unsigned int trailing = (unsigned int)__builtin_ctzll(x);
+  // The leading count has a 5 bit field
+  if (leading > 31) leading = 31;
+  if (self->leading != PROM_HISTORY_NO_WINDOW && leading >= self->leading && trailing >= self->trailing) {
+    prom_history_put(self, 0x0, 1);
+    prom_history_put(self, x >> self->trailing, 64 - self->leading - self->trailing);
+    return;
+  }
+  self->leading = (uint8_t)leading;
+  self->trailing = (uint8_t)trailing;
+  unsigned int significant = 64 - leading - trailing;
+  prom_history_put(self, 0x1, 1);
+  prom_history_put(self, leading, 5);
+  // 64 significant bits do not fit in the 6 bit field and are written as 0, which never occurs otherwise
+  prom_history_put(self, significant & 0x3f, 6);
+  prom_history_put(self, x >> trailing, significant);
+}
+
+void prom_history_chunk_reset(prom_history_chunk_t *self) {
+  PROM_ASSERT(self != NULL);
+  memset(self->data, 0, (self->bits + 7) / 8);
+  self->first_t = 0;
+  self->last_t = 0;
+  self->last_delta = 0;
+  self->last_value = 0;
+  self->count = 0;
+  self->bits = 0;
+  self->leading = PROM_HISTORY_NO_WINDOW;
+  self->trailing = 0;
+}
+
+int prom_history_chunk_append(prom_history_chunk_t *self, int64_t t, double value) {
+  PROM_ASSERT(self != NULL);
+  uint64_t bits = prom_history_bits(value);
+  if (self->count == 0) {
+    prom_history_put(self, (uint64_t)t, 64);
+    prom_history_put(self, bits, 64);
+    self->first_t = t;
+  } else {
+    if (self->bits + PROM_HISTORY_SAMPLE_MAX_BITS > PROM_HISTORY_CHUNK_BYTES * 8) return 1;
+    int64_t delta = t - self->last_t;
+    prom_history_put_dod(self, delta - self->last_delta);
+    prom_history_put_value(self, bits);
+    self->last_delta = delta;
+  }
+  self->last_t = t;
+  self->last_value = bits;
+  self->count++;
+  return 0;
+}
+
+void prom_history_iter_init(prom_history_iter_t *self, const prom_history_chunk_t *chunk) {
+  PROM_ASSERT(self != NULL);
+  self->chunk = chunk;
+  self->pos = 0;
+  self->index = 0;
+  self->t = 0;
+  self->delta = 0;
+  self->value = 0;
+  self->leading = 0;
+  self->trailing = 0;
+}
+
+bool prom_history_iter_next(prom_history_iter_t *self, int64_t *t, double *value) {
+  PROM_ASSERT(self != NULL);
+  const prom_history_chunk_t *chunk = self->chunk;
+  if (self->index >= chunk->count) return false;
+
+  if (self->index == 0) {
+    self->t = (int64_t)prom_history_get(chunk, &self->pos, 64);
+    self->value = prom_history_get(chunk, &self->pos, 64);
+  } else {
+    self->delta += prom_history_get_dod(chunk, &self->pos);
+    self->t += self->delta;
+    if (prom_history_get(chunk, &self->pos, 1)) {
+      if (prom_history_get(chunk, &self->pos, 1)) {
+        unsigned int leading = (unsigned int)prom_history_get(chunk, &self->pos, 5);
+        unsigned int significant = (unsigned int)prom_history_get(chunk, &self->pos, 6);
+        if (significant == 0) significant = 64;
+        self->leading = (uint8_t)leading;
+        self->trailing = (uint8_t)(64 - leading - significant);
+      }
+      unsigned int significant = 64 - self->leading - self->trailing;
+      self->value ^= prom_history_get(chunk, &self->pos, significant) << self->trailing;
+    }
+  }
+  self->index++;
+  *t = self->t;
+  *value = prom_history_value(self->value);
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Output
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// A buffer owned by the caller that responses are written into. Once growing it fails, further writes are dropped.
+typedef struct prom_history_out {
+  char **buf;
+  size_t *cap;
+  size_t len;
+  bool failed;
+} prom_history_out_t;
+
+static bool prom_history_out_reserve(prom_history_out_t *out, size_t len) {
+  if (out->failed) return false;
+  // One more byte for the terminating NUL
+  if (*out->buf != NULL && out->len + len + 1 <= *out->cap) return true;
+  size_t cap = *out->buf != NULL && *out->cap > 0 ? *out->cap : PROM_HISTORY_INITIAL_BUF_CAP;
+  while (out->len + len + 1 > cap) cap *= 2;
+  char *buf = (char *)prom_realloc(*out->buf, cap);
+  if (buf == NULL) {
+    out->failed = true;
+    return false;
+  }
+  *out->buf = buf;
+  *out->cap = cap;
+  return true;
+}
+
+static void prom_history_out_put(prom_history_out_t *out, const char *str, size_t len) {
+  if (!prom_history_out_reserve(out, len)) return;
+  memcpy(*out->buf + out->len, str, len);
+  out->len += len;
+}
+
+static void prom_history_out_str(prom_history_out_t *out, const char *str) {
+  prom_history_out_put(out, str, strlen(str));
+}
+
+static void prom_history_out_json_string(prom_history_out_t *out, const char *str) {
+  // Every byte takes at most the six of a \u escape
+  if (!prom_history_out_reserve(out, 6 * strlen(str) + 2)) return;
+  char *p = *out->buf + out->len;
+  *p++ = '"';
+  for (const char *c = str; *c != '\0'; c++) {
+    if (*c == '"' || *c == '\\') {
+      *p++ = '\\';
+      *p++ = *c;
+    } else if ((unsigned char)*c < 0x20) {
+      p += sprintf(p, "\\u%04x", (unsigned int)(unsigned char)*c);
+    } else {
+      *p++ = *c;
+    }
+  }
+  *p++ = '"';
+  out->len = (size_t)(p - *out->buf);
+}
+
+// Writes [<seconds>,"<value>"] as the Prometheus API does: the timestamp in seconds with up to millisecond precision
+// and the value as a string.
+static void prom_history_out_point(prom_history_out_t *out, int64_t t, double value) {
+  if (!prom_history_out_reserve(out, 2 * PROM_STRING_BUILDER_DOUBLE_SIZE + 8)) return;
+  char *p = *out->buf + out->len;
+  *p++ = '[';
+  lldiv_t seconds = lldiv((long long)t, 1000);
+  if (seconds.rem < 0) {
+    seconds.quot--;
+    seconds.rem += 1000;
+  }
+  p += sprintf(p, "%lld", seconds.quot);
+  if (seconds.rem != 0) {
+    int digits = seconds.rem % 100 == 0 ? 1 : seconds.rem % 10 == 0 ? 2 : 3;
+    long long fraction = digits == 1 ? seconds.rem / 100 : digits == 2 ? seconds.rem / 10 : seconds.rem;
+    p += sprintf(p, ".%0*lld", digits, fraction);
+  }
+  *p++ = ',';
+  *p++ = '"';
+  if (isnan(value)) {
+    memcpy(p, "NaN", 3);
+    p += 3;
+  } else if (isinf(value)) {
+    memcpy(p, value > 0 ? "+Inf" : "-Inf", 4);
+    p += 4;
+  } else {
+    p += prom_string_builder_format_double(p, value);
+  }
+  *p++ = '"';
+  *p++ = ']';
+  out->len = (size_t)(p - *out->buf);
+}
+
+static int prom_history_out_finish(prom_history_out_t *out, size_t *len) {
+  if (!prom_history_out_reserve(out, 0)) return 1;
+  (*out->buf)[out->len] = '\0';
+  if (len != NULL) *len = out->len;
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Series
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void prom_history_series_free(void *gen) {
+  prom_history_series_t *self = (prom_history_series_t *)gen;
+  if (self == NULL) return;
+  prom_free(self->name);
+  prom_free(self->metric);
+  // Chunks that aged out are freed as they go, so any slot may be empty
+  for (size_t i = 0; self->chunks != NULL && i < self->capacity; i++) prom_free(self->chunks[i]);
+  prom_free(self->chunks);
+  prom_free(self);
+}
+
+static prom_history_series_t *prom_history_series_new(prom_history_t *history, prom_metric_t *metric,
+                                                      prom_metric_sample_t *sample) {
+  prom_history_series_t *self = (prom_history_series_t *)prom_malloc(sizeof(prom_history_series_t));
+  if (self == NULL) return NULL;
+  memset(self, 0, sizeof(prom_history_series_t));
+  self->name = prom_strdup(metric->name);
+  self->chunks = (prom_history_chunk_t **)prom_malloc(history->max_chunks * sizeof(prom_history_chunk_t *));
+  if (self->chunks != NULL) memset(self->chunks, 0, history->max_chunks * sizeof(prom_history_chunk_t *));
+  self->capacity = history->max_chunks;
+
+  // The name and labels are rendered once, as the "metric" object of the query responses
+  size_t cap = 0;
+  prom_history_out_t out = {&self->metric, &cap, 0, false};
+  prom_history_out_str(&out, "{\"__name__\":");
+  prom_history_out_json_string(&out, metric->name);
+  for (size_t i = 0; i < sample->label_count; i++) {
+    prom_history_out_str(&out, ",");
+    prom_history_out_json_string(&out, metric->label_keys[i]);
+    prom_history_out_str(&out, ":");
+    prom_history_out_json_string(&out, sample->label_values[i]);
+  }
+  prom_history_out_str(&out, "}");
+
+  if (self->name == NULL || self->chunks == NULL || prom_history_out_finish(&out, &self->metric_len)) {
+    prom_history_series_free(self);
+    return NULL;
+  }
+  return self;
+}
+
+// Appends a sample to the newest chunk of the series, starting a new chunk when it is full. Chunks whose samples are
+// all older than the retention are freed first; once the ring is full, the oldest chunk is reused.
+static int prom_history_series_append(prom_history_t *history, prom_history_series_t *self, int64_t t, double value) {
+  int64_t cutoff = t - history->config.retention * 1000;
+  while (self->used > 0 && self->chunks[self->head]->last_t < cutoff) {
+    prom_free(self->chunks[self->head]);
+    self->chunks[self->head] = NULL;
+    self->head = (self->head + 1) % self->capacity;
+    self->used--;
+  }
+
+  if (self->used > 0) {
+    prom_history_chunk_t *chunk = self->chunks[(self->head + self->used - 1) % self->capacity];
+    // Out of order samples cannot be encoded, and a repeated timestamp carries nothing new
+    if (t <= chunk->last_t) return 0;
+    if (prom_history_chunk_append(chunk, t, value) == 0) return 0;
+  }
+
+  size_t slot = (self->head + self->used) % self->capacity;
+  if (self->chunks[slot] == NULL) {
+    prom_history_chunk_t *chunk = (prom_history_chunk_t *)prom_malloc(sizeof(prom_history_chunk_t));
+    if (chunk == NULL) {
+      PROM_LOG(PROM_HISTORY_SERIES_ERROR);
+      return 1;
+    }
+    // Writing into the stream ORs bits into zeroed bytes; reset only clears the bytes that were written
+    memset(chunk, 0, sizeof(prom_history_chunk_t));
+    self->chunks[slot] = chunk;
+  }
+  prom_history_chunk_reset(self->chunks[slot]);
+  if (self->used == self->capacity) {
+    self->head = (self->head + 1) % self->capacity;
+  } else {
+    self->used++;
+  }
+  return prom_history_chunk_append(self->chunks[slot], t, value);
+}
+
+static size_t prom_history_series_bytes(const prom_history_series_t *self) {
+  size_t bytes = sizeof(prom_history_series_t) + strlen(self->name) + 1 + self->metric_len + 1;
+  bytes += self->capacity * sizeof(prom_history_chunk_t *);
+  for (size_t i = 0; i < self->capacity; i++) {
+    if (self->chunks[i] != NULL) bytes += sizeof(prom_history_chunk_t);
+  }
+  return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// History
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+prom_history_t *prom_history_new(const prom_history_config_t *config) {
+  prom_history_t *self = (prom_history_t *)prom_malloc(sizeof(prom_history_t));
+  if (self == NULL) return NULL;
+  memset(self, 0, sizeof(prom_history_t));
+
+  if (config != NULL) self->config = *config;
+  if (self->config.retention <= 0) self->config.retention = PROM_HISTORY_DEFAULT_RETENTION;
+  if (self->config.series_bytes == 0) self->config.series_bytes = PROM_HISTORY_DEFAULT_SERIES_BYTES;
+  // A ring of one chunk would lose every sample each time the chunk is reused
+  self->max_chunks = self->config.series_bytes / (sizeof(prom_history_chunk_t) + sizeof(prom_history_chunk_t *));
+  if (self->max_chunks < 2) self->max_chunks = 2;
+
+  self->series = prom_map_new();
+  if (self->series == NULL || prom_map_set_free_value_fn(self->series, prom_history_series_free)) {
+    if (self->series != NULL) prom_map_destroy(self->series);
+    prom_free(self);
+    return NULL;
+  }
+  int r = pthread_rwlock_init(&self->lock, NULL);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_INIT_ERROR);
+    prom_map_destroy(self->series);
+    prom_free(self);
+    return NULL;
+  }
+  return self;
+}
+
+int prom_history_destroy(prom_history_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 0;
+
+  int r = prom_map_destroy(self->series);
+  int rr = pthread_rwlock_destroy(&self->lock);
+  if (rr) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_DESTROY_ERROR);
+    r = rr;
+  }
+  prom_free(self);
+  self = NULL;
+  return r;
+}
+
+static int prom_history_record_sample(prom_history_t *self, prom_metric_t *metric, prom_metric_sample_t *sample,
+                                      int64_t timestamp_ms) {
+  prom_history_series_t *series =
+      (prom_history_series_t *)prom_map_touch(self->series, sample->l_value, (uint64_t)timestamp_ms);
+  if (series == NULL) {
+    series = prom_history_series_new(self, metric, sample);
+    if (series == NULL) {
+      PROM_LOG(PROM_HISTORY_SERIES_ERROR);
+      return 1;
+    }
+    if (prom_map_set(self->series, sample->l_value, series)) {
+      prom_history_series_free(series);
+      return 1;
+    }
+    prom_map_touch(self->series, sample->l_value, (uint64_t)timestamp_ms);
+  }
+  return prom_history_series_append(self, series, timestamp_ms, prom_metric_sample_scrape_value(sample));
+}
+
+// The state of one recording that prom_history_visit_sample is handed with each sample
+typedef struct prom_history_pass {
+  prom_history_t *history;
+  int64_t timestamp_ms;
+  bool failed; /**< failed is set once a sample could not be recorded. The other samples are still recorded */
+} prom_history_pass_t;
+
+static int prom_history_visit_sample(prom_metric_t *metric, void *sample, void *data) {
+  prom_history_pass_t *pass = (prom_history_pass_t *)data;
+  if (metric->type != PROM_COUNTER && metric->type != PROM_GAUGE) return 0;
+  if (prom_history_record_sample(pass->history, metric, (prom_metric_sample_t *)sample, pass->timestamp_ms)) {
+    pass->failed = true;
+  }
+  return 0;
+}
+
+int prom_history_record(prom_history_t *self, prom_collector_registry_t *registry, int64_t timestamp_ms) {
+  PROM_ASSERT(self != NULL);
+  PROM_ASSERT(registry != NULL);
+  if (self == NULL || registry == NULL) return 1;
+
+  if (timestamp_ms == 0) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    timestamp_ms = (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+  }
+
+  int r = pthread_rwlock_wrlock(&self->lock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return r;
+  }
+  prom_history_pass_t pass = {.history = self, .timestamp_ms = timestamp_ms, .failed = false};
+  r = prom_collector_registry_foreach_sample(registry, &prom_history_visit_sample, &pass);
+  if (r == 0 && pass.failed) r = 1;
+
+  // Series that were not recorded for the whole retention hold no samples worth keeping
+  int64_t cutoff = timestamp_ms - self->config.retention * 1000;
+  if (cutoff > 0) prom_map_sweep(self->series, (uint64_t)cutoff);
+
+  int rr = pthread_rwlock_unlock(&self->lock);
+  if (rr) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);
+    r = rr;
+  }
+  return r;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Queries
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int prom_history_query_error(prom_history_out_t *out, const char *error, size_t *len) {
+  out->len = 0;
+  prom_history_out_str(out, "{\"status\":\"error\",\"errorType\":\"bad_data\",\"error\":");
+  prom_history_out_json_string(out, error);
+  prom_history_out_str(out, "}");
+  prom_history_out_finish(out, len);
+  return 1;
+}
+
+// Writes the points of one series and returns how many there were. With a step, each point takes the latest sample
+// at most PROM_HISTORY_LOOKBACK_MS before it.
+static size_t prom_history_query_series(prom_history_out_t *out, const prom_history_series_t *series, int64_t start,
+                                        int64_t end, int64_t step) {
+  size_t points = 0;
+  int64_t from = step > 0 ? start - PROM_HISTORY_LOOKBACK_MS : start;
+  int64_t point = start;
+  bool have = false;
+  int64_t pt = 0;
+  double pv = 0.0;
+
+  for (size_t c = 0; c < series->used; c++) {
+    const prom_history_chunk_t *chunk = series->chunks[(series->head + c) % series->capacity];
+    if (chunk->last_t < from) continue;
+    if (chunk->first_t > end) break;
+
+    prom_history_iter_t iter;
+    prom_history_iter_init(&iter, chunk);
+    int64_t t;
+    double value;
+    while (prom_history_iter_next(&iter, &t, &value)) {
+      if (t < from) continue;
+      if (t > end) break;
+      if (step == 0) {
+        if (points++ > 0) prom_history_out_str(out, ",");
+        prom_history_out_point(out, t, value);
+        continue;
+      }
+      // Every point before this sample takes the previous one
+      while (point <= end && t > point) {
+        if (have && pt > point - PROM_HISTORY_LOOKBACK_MS) {
+          if (points++ > 0) prom_history_out_str(out, ",");
+          prom_history_out_point(out, point, pv);
+        }
+        point += step;
+      }
+      have = true;
+      pt = t;
+      pv = value;
+    }
+  }
+
+  for (; step > 0 && point <= end; point += step) {
+    if (have && pt > point - PROM_HISTORY_LOOKBACK_MS) {
+      if (points++ > 0) prom_history_out_str(out, ",");
+      prom_history_out_point(out, point, pv);
+    }
+  }
+  return points;
+}
+
+int prom_history_query_range(prom_history_t *self, const char *name, int64_t start_ms, int64_t end_ms,
+                             int64_t step_ms, char **buf, size_t *cap, size_t *len) {
+  PROM_ASSERT(self != NULL);
+  PROM_ASSERT(buf != NULL);
+  PROM_ASSERT(cap != NULL);
+  if (self == NULL || buf == NULL || cap == NULL) return 1;
+
+  prom_history_out_t out = {buf, cap, 0, false};
+  if (name == NULL || name[0] == '\0') return prom_history_query_error(&out, "missing metric name", len);
+  if (start_ms < -PROM_HISTORY_MAX_TIMESTAMP_MS || start_ms > PROM_HISTORY_MAX_TIMESTAMP_MS ||
+      end_ms < -PROM_HISTORY_MAX_TIMESTAMP_MS || end_ms > PROM_HISTORY_MAX_TIMESTAMP_MS) {
+    return prom_history_query_error(&out, "start or end timestamp out of range", len);
+  }
+  if (end_ms < start_ms) return prom_history_query_error(&out, "end timestamp must not be before start time", len);
+  if (step_ms < 0) return prom_history_query_error(&out, "zero or positive query resolution step required", len);
+  // A step past end leaves only the point at start, and shortening it keeps start + step from overflowing
+  if (step_ms > end_ms - start_ms) step_ms = end_ms - start_ms + 1;
+  if (step_ms > 0 && (end_ms - start_ms) / step_ms > PROM_HISTORY_MAX_POINTS) {
+    return prom_history_query_error(&out, "exceeded maximum resolution of 11,000 points per timeseries", len);
+  }
+
+  int r = pthread_rwlock_rdlock(&self->lock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return r;
+  }
+
+  prom_history_out_str(&out, "{\"status\":\"success\",\"data\":{\"resultType\":\"matrix\",\"result\":[");
+  bool first = true;
+  prom_epoch_enter();
+  size_t series_count = 0;
+  prom_map_entry_t *entries = prom_map_entries(self->series, &series_count);
+  for (size_t i = 0; i < series_count; i++) {
+    const prom_history_series_t *series = (const prom_history_series_t *)entries[i].value;
+    if (strcmp(series->name, name) != 0) continue;
+    size_t mark = out.len;
+    if (!first) prom_history_out_str(&out, ",");
+    prom_history_out_str(&out, "{\"metric\":");
+    prom_history_out_put(&out, series->metric, series->metric_len);
+    prom_history_out_str(&out, ",\"values\":[");
+    if (prom_history_query_series(&out, series, start_ms, end_ms, step_ms) == 0) {
+      // Series without points in the range are left out, as Prometheus does
+      out.len = mark;
+      continue;
+    }
+    prom_history_out_str(&out, "]}");
+    first = false;
+  }
+  prom_epoch_exit();
+  prom_history_out_str(&out, "]}}");
+
+  r = pthread_rwlock_unlock(&self->lock);
+  if (r) PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);
+  if (prom_history_out_finish(&out, len)) return 1;
+  return r;
+}
+
+int prom_history_stats(prom_history_t *self, prom_history_stats_t *stats) {
+  PROM_ASSERT(self != NULL);
+  PROM_ASSERT(stats != NULL);
+  if (self == NULL || stats == NULL) return 1;
+
+  int r = pthread_rwlock_rdlock(&self->lock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return r;
+  }
+
+  memset(stats, 0, sizeof(prom_history_stats_t));
+  stats->series_bytes_limit = self->config.series_bytes;
+  prom_epoch_enter();
+  size_t series_count = 0;
+  prom_map_entry_t *entries = prom_map_entries(self->series, &series_count);
+  for (size_t i = 0; i < series_count; i++) {
+    const prom_history_series_t *series = (const prom_history_series_t *)entries[i].value;
+    size_t bytes = prom_history_series_bytes(series);
+    stats->series++;
+    stats->bytes += bytes;
+    if (bytes > stats->largest_series_bytes) stats->largest_series_bytes = bytes;
+    for (size_t c = 0; c < series->used; c++) {
+      stats->samples += series->chunks[(series->head + c) % series->capacity]->count;
+    }
+  }
+  prom_epoch_exit();
+
+  r = pthread_rwlock_unlock(&self->lock);
+  if (r) PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);
+  return r;
+}
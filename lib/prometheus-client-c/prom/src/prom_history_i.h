@@ -0,0 +1,49 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#ifndef PROM_HISTORY_I_H
+#define PROM_HISTORY_I_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Private
+#include "prom_history_t.h"
+
+/**
+ * @brief API PRIVATE Empties the chunk so that its next sample is stored in full
+ */
+void prom_history_chunk_reset(prom_history_chunk_t *self);
+
+/**
+ * @brief API PRIVATE Appends a sample to the chunk. Returns non-zero, leaving the chunk as it was, when the chunk may
+ * not have room for it.
+ */
+int prom_history_chunk_append(prom_history_chunk_t *self, int64_t t, double value);
+
+/**
+ * @brief API PRIVATE Starts reading the samples of chunk
+ */
+void prom_history_iter_init(prom_history_iter_t *self, const prom_history_chunk_t *chunk);
+
+/**
+ * @brief API PRIVATE Reads the next sample of the chunk into t and value. Returns false once every sample was read.
+ */
+bool prom_history_iter_next(prom_history_iter_t *self, int64_t *t, double *value);
+
+#endif  // PROM_HISTORY_I_H
@@ -0,0 +1,97 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#ifndef PROM_HISTORY_T_H
+#define PROM_HISTORY_T_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Public
+#include "prom_history.h"
+
+// Private
+#include "prom_map_t.h"
+
+/**
+ * @brief API PRIVATE The number of bytes of encoded samples a chunk holds
+ */
+#define PROM_HISTORY_CHUNK_BYTES 1024
+
+/**
+ * @brief API PRIVATE The most bits a sample takes: a 64-bit delta-of-delta and a value with a new XOR window
+ */
+#define PROM_HISTORY_SAMPLE_MAX_BITS (4 + 64 + 2 + 5 + 6 + 64)
+
+/**
+ * @brief API PRIVATE The leading field of a chunk before its first XOR window is set
+ */
+#define PROM_HISTORY_NO_WINDOW 0xff
+
+/**
+ * @brief API PRIVATE A run of samples encoded as a bit stream. The first sample is stored in full, every later one as
+ * the delta-of-delta of its timestamp and the XOR of its value with the previous value.
+ */
+typedef struct prom_history_chunk {
+  int64_t first_t;                      /**< first_t is the timestamp of the first sample */
+  int64_t last_t;                       /**< last_t is the timestamp of the last sample */
+  int64_t last_delta;                   /**< last_delta is the distance between the last two timestamps */
+  uint64_t last_value;                  /**< last_value holds the bits of the last value */
+  size_t count;                         /**< count is the number of samples */
+  size_t bits;                          /**< bits is the number of bits written to data */
+  uint8_t leading;                      /**< leading is the count of leading zeros of the current XOR window */
+  uint8_t trailing;                     /**< trailing is the count of trailing zeros of the current XOR window */
+  uint8_t data[PROM_HISTORY_CHUNK_BYTES]; /**< data is the bit stream, most significant bit first */
+} prom_history_chunk_t;
+
+/**
+ * @brief API PRIVATE Reads the samples of a chunk in order
+ */
+typedef struct prom_history_iter {
+  const prom_history_chunk_t *chunk; /**< chunk is the chunk being read */
+  size_t pos;                        /**< pos is the bit position of the next sample */
+  size_t index;                      /**< index is the number of samples read */
+  int64_t t;                         /**< t is the timestamp of the last sample read */
+  int64_t delta;                     /**< delta is the distance between the last two timestamps read */
+  uint64_t value;                    /**< value holds the bits of the last value read */
+  uint8_t leading;                   /**< leading is the count of leading zeros of the current XOR window */
+  uint8_t trailing;                  /**< trailing is the count of trailing zeros of the current XOR window */
+} prom_history_iter_t;
+
+/**
+ * @brief API PRIVATE The history of one series: a ring of chunks, oldest first from head
+ */
+typedef struct prom_history_series {
+  char *name;                     /**< name is the name of the metric */
+  char *metric;                   /**< metric is the JSON object of the name and labels of the series */
+  size_t metric_len;              /**< metric_len is the length of metric */
+  prom_history_chunk_t **chunks;  /**< chunks has capacity slots, holding chunks allocated as they are first needed */
+  size_t capacity;                /**< capacity is the number of slots in chunks */
+  size_t head;                    /**< head is the index in chunks of the oldest chunk */
+  size_t used;                    /**< used is the number of chunks holding samples */
+} prom_history_series_t;
+
+struct prom_history {
+  prom_history_config_t config; /**< config holds the options with defaults applied */
+  size_t max_chunks;            /**< max_chunks is the number of chunks that fit in config.series_bytes */
+  prom_map_t *series;           /**< series maps the name and labels of each series to its prom_history_series_t */
+  pthread_rwlock_t lock;        /**< lock is held for writing while recording and for reading while querying */
+};
+
+#endif  // PROM_HISTORY_T_H
@@ -15,32 +15,109 @@
  */
 
 #include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 
 // Public
 #include "prom_alloc.h"
 
 // Private
 #include "prom_assert.h"
+#include "prom_epoch_i.h"
 #include "prom_errors.h"
-#include "prom_linked_list_i.h"
-#include "prom_linked_list_t.h"
 #include "prom_log.h"
 #include "prom_map_i.h"
 #include "prom_map_t.h"
 
-#define PROM_MAP_INITIAL_SIZE 32
+// The table is allocated on the first set. max_size is always a power of two so that a slot index is the low bits of
+// the hash, and the table doubles once it is half full.
+#define PROM_MAP_INITIAL_SIZE 8
+
+// A lookup that keeps finding a writer inside the table yields after this many attempts
+#define PROM_MAP_READ_SPINS 64
 
 static void destroy_map_node_value_no_op(void *value) {}
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// hash
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline uint64_t prom_map_mix(uint64_t a, uint64_t b) {
+#ifdef __SIZEOF_INT128__
+  __uint128_t r = (__uint128_t)a * b;
+  return (uint64_t)r ^ (uint64_t)(r >> 64);
+#else
+  uint64_t ha = a >> 32, la = (uint32_t)a, hb = b >> 32, lb = (uint32_t)b;
+  uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  uint64_t t = rl + (rm0 << 32), c = t < rl;
+  uint64_t lo = t + (rm1 << 32);
+  c += lo < t;
+  uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+  return lo ^ hi;
+#endif
+}
+
+static inline uint64_t prom_map_read64(const char *p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint64_t prom_map_read32(const char *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+/**
+ * @brief API PRIVATE hash function that returns a 64-bit hash of a key of the given length.
+ *
+ * This follows wyhash: the key is consumed 16 bytes at a time, each pair of 64-bit words is folded into the state with
+ * a 128-bit multiply, and short tails are read with overlapping loads instead of a loop per character.
+ *
+ * Reference:
+ *   * https://github.com/wangyi-fudan/wyhash
+ */
+static size_t prom_map_hash(const char *key, size_t len) {
+  const uint64_t s0 = 0xa0761d6478bd642full, s1 = 0xe7037ed1a0b428dbull, s2 = 0x8ebc6af09c88c6e3ull;
+  uint64_t seed = s0;
+  uint64_t a = 0, b = 0;
+  if (len <= 16) {
+    if (len >= 4) {
+      a = (prom_map_read32(key) << 32) | prom_map_read32(key + ((len >> 3) << 2));
+      b = (prom_map_read32(key + len - 4) << 32) | prom_map_read32(key + len - 4 - ((len >> 3) << 2));
+    } else if (len > 0) {
+      a = ((uint64_t)(unsigned char)key[0] << 16) | ((uint64_t)(unsigned char)key[len >> 1] << 8) |
+          (unsigned char)key[len - 1];
+    }
+  } else {
+    const char *p = key;
+    size_t n = len;
+    for (; n > 16; p += 16, n -= 16) seed = prom_map_mix(prom_map_read64(p) ^ s1, prom_map_read64(p + 8) ^ seed);
+    a = prom_map_read64(key + len - 16);
+    b = prom_map_read64(key + len - 8);
+  }
+  return (size_t)prom_map_mix(s2 ^ len, prom_map_mix(a ^ s1, b ^ seed));
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // prom_map_node
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 prom_map_node_t *prom_map_node_new(const char *key, void *value, prom_map_node_free_value_fn free_value_fn) {
-  prom_map_node_t *self = prom_malloc(sizeof(prom_map_node_t));
-  self->key = prom_strdup(key);
-  self->value = value;
+  // The key is copied into the same allocation as the node
+  size_t len = strlen(key);
+  prom_map_node_t *self = prom_malloc(sizeof(prom_map_node_t) + len + 1);
+  char *key_copy = (char *)(self + 1);
+  memcpy(key_copy, key, len + 1);
+  self->key = key_copy;
+  self->hash = prom_map_hash(key, len);
+  atomic_init(&self->value, value);
+  self->index = 0;
+  atomic_init(&self->stamp, 0);
   self->free_value_fn = free_value_fn;
   return self;
 }
@@ -48,25 +125,41 @@ prom_map_node_t *prom_map_node_new(const char *key, void *value, prom_map_node_f
 int prom_map_node_destroy(prom_map_node_t *self) {
   PROM_ASSERT(self != NULL);
   if (self == NULL) return 0;
-  prom_free((void *)self->key);
   self->key = NULL;
-  if (self->value != NULL) (*self->free_value_fn)(self->value);
-  self->value = NULL;
+  void *value = atomic_load_explicit(&self->value, memory_order_relaxed);
+  if (value != NULL) (*self->free_value_fn)(value);
+  atomic_store_explicit(&self->value, NULL, memory_order_relaxed);
   prom_free(self);
   self = NULL;
   return 0;
 }
 
-void prom_map_node_free(void *item) {
-  prom_map_node_t *map_node = (prom_map_node_t *)item;
-  prom_map_node_destroy(map_node);
-}
+static void prom_map_free_retired(void *item) { prom_free(item); }
 
-prom_linked_list_compare_t prom_map_node_compare(void *item_a, void *item_b) {
-  prom_map_node_t *map_node_a = (prom_map_node_t *)item_a;
-  prom_map_node_t *map_node_b = (prom_map_node_t *)item_b;
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// prom_map_entries
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-  return strcmp(map_node_a->key, map_node_b->key);
+static prom_map_entries_t *prom_map_entries_new(size_t capacity) {
+  prom_map_entries_t *self =
+      (prom_map_entries_t *)prom_malloc(sizeof(prom_map_entries_t) + sizeof(prom_map_entry_t) * capacity);
+  if (self == NULL) return NULL;
+  self->capacity = capacity;
+  atomic_init(&self->size, 0);
+  return self;
+}
+
+// Copies the entries of from into to, skipping the entry at skip. Pass a skip of at least the size to copy them all.
+static void prom_map_entries_copy(prom_map_entries_t *to, prom_map_entries_t *from, size_t skip) {
+  size_t size = atomic_load_explicit(&from->size, memory_order_relaxed);
+  size_t j = 0;
+  for (size_t i = 0; i < size; i++) {
+    if (i == skip) continue;
+    to->items[j].key = from->items[i].key;
+    atomic_init(&to->items[j].value, atomic_load_explicit(&from->items[i].value, memory_order_relaxed));
+    j++;
+  }
+  atomic_init(&to->size, j);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -78,36 +171,12 @@ prom_map_t *prom_map_new() {
 
   prom_map_t *self = (prom_map_t *)prom_malloc(sizeof(prom_map_t));
   self->size = 0;
-  self->max_size = PROM_MAP_INITIAL_SIZE;
-
-  self->keys = prom_linked_list_new();
-  if (self->keys == NULL) return NULL;
-
-  // These each key will be allocated once by prom_map_node_new and used here as well to save memory. With that said
-  // we will only have to deallocate each key once. That will happen on prom_map_node_destroy.
-  r = prom_linked_list_set_free_fn(self->keys, prom_linked_list_no_op_free);
-  if (r) {
-    prom_map_destroy(self);
-    return NULL;
-  }
-
-  self->addrs = prom_malloc(sizeof(prom_linked_list_t) * self->max_size);
+  self->max_size = 0;
+  atomic_init(&self->entries, NULL);
+  atomic_init(&self->table, NULL);
+  atomic_init(&self->version, 0);
   self->free_value_fn = destroy_map_node_value_no_op;
 
-  for (int i = 0; i < self->max_size; i++) {
-    self->addrs[i] = prom_linked_list_new();
-    r = prom_linked_list_set_free_fn(self->addrs[i], prom_map_node_free);
-    if (r) {
-      prom_map_destroy(self);
-      return NULL;
-    }
-    r = prom_linked_list_set_compare_fn(self->addrs[i], prom_map_node_compare);
-    if (r) {
-      prom_map_destroy(self);
-      return NULL;
-    }
-  }
-
   self->rwlock = (pthread_rwlock_t *)prom_malloc(sizeof(pthread_rwlock_t));
   r = pthread_rwlock_init(self->rwlock, NULL);
   if (r) {
@@ -124,17 +193,21 @@ int prom_map_destroy(prom_map_t *self) {
   int r = 0;
   int ret = 0;
 
-  r = prom_linked_list_destroy(self->keys);
-  if (r) ret = r;
-  self->keys = NULL;
+  // The map must no longer be shared, so the table, the entries and the nodes are freed immediately. The entries
+  // borrow their keys from the nodes.
+  prom_free(atomic_load_explicit(&self->entries, memory_order_relaxed));
+  atomic_store_explicit(&self->entries, NULL, memory_order_relaxed);
 
+  prom_map_table_t *table = atomic_load_explicit(&self->table, memory_order_relaxed);
   for (size_t i = 0; i < self->max_size; i++) {
-    r = prom_linked_list_destroy(self->addrs[i]);
-    if (r) ret = r;
-    self->addrs[i] = NULL;
+    prom_map_node_t *node = atomic_load_explicit(&table->slots[i].node, memory_order_relaxed);
+    if (node != NULL) {
+      r = prom_map_node_destroy(node);
+      if (r) ret = r;
+    }
   }
-  prom_free(self->addrs);
-  self->addrs = NULL;
+  prom_free(table);
+  atomic_store_explicit(&self->table, NULL, memory_order_relaxed);
 
   r = pthread_rwlock_destroy(self->rwlock);
   if (r) {
@@ -150,172 +223,208 @@ int prom_map_destroy(prom_map_t *self) {
   return ret;
 }
 
-static size_t prom_map_get_index_internal(const char *key, size_t *size, size_t *max_size) {
-  size_t index;
-  size_t a = 31415, b = 27183;
-  for (index = 0; *key != '\0'; key++, a = a * b % (*max_size - 1)) {
-    index = (a * index + *key) % *max_size;
-  }
-  return index;
+/**
+ * @brief API PRIVATE returns the home slot of the given key in the given prom_map.
+ */
+size_t prom_map_get_index(prom_map_t *self, const char *key) {
+  if (self->max_size == 0) return 0;
+  return prom_map_hash(key, strlen(key)) & (self->max_size - 1);
 }
 
+// The distance of the entry in slot i from its home slot
+static inline size_t prom_map_probe_distance(size_t hash, size_t i, size_t mask) { return (i - (hash & mask)) & mask; }
+
 /**
- * @brief API PRIVATE hash function that returns an array index from the given key and prom_map.
+ * @brief API PRIVATE returns the slot holding key or -1, and stores the node of that slot in node_out.
  *
- * The algorithm is based off of Horner's method. In a simpler version, you set the return value to 0. Next, for each
- * character in the string, you add the integer value of the current character to the product of the prime number and
- * the current return value, set the result to the return value, then finally return the return value.
+ * Entries are kept in Robin Hood order: along a probe sequence no entry is further from its home slot than the entry
+ * after it would be. A lookup can therefore stop at the first slot whose entry is closer to home than the distance
+ * already probed. Hashes are compared before keys, and keys are compared in place.
  *
- * In this version of the algorithm, we attempt to achieve a probabily of key to index conversion collisions to
- * 1/M (with M being the max_size of the map). This optimizes dispersion and consequently, evens out the performance
- * for gets and sets for each item. Instead of using a fixed prime number, we generate a coefficient for each iteration
- * through the loop.
- *
- * Reference:
- *   * Algorithms in C: Third Edition by Robert Sedgewick, p579
+ * Lookups may run while a writer moves entries. The probe is bounded by the table size, and a hash read from a slot is
+ * confirmed against the node that was read, so a torn slot can cause a miss but never a wrong hit.
  */
-size_t prom_map_get_index(prom_map_t *self, const char *key) {
-  return prom_map_get_index_internal(key, &self->size, &self->max_size);
+static ssize_t prom_map_find_internal(prom_map_table_t *table, const char *key, size_t hash,
+                                      prom_map_node_t **node_out) {
+  *node_out = NULL;
+  if (table == NULL) return -1;
+  size_t mask = table->max_size - 1;
+  for (size_t i = hash & mask, distance = 0; distance < table->max_size; i = (i + 1) & mask, distance++) {
+    prom_map_slot_t *slot = &table->slots[i];
+    prom_map_node_t *node = atomic_load_explicit(&slot->node, memory_order_acquire);
+    if (node == NULL) return -1;
+    size_t slot_hash = atomic_load_explicit(&slot->hash, memory_order_relaxed);
+    if (prom_map_probe_distance(slot_hash, i, mask) < distance) return -1;
+    if (slot_hash == hash && node->hash == hash && strcmp(node->key, key) == 0) {
+      *node_out = node;
+      return i;
+    }
+  }
+  return -1;
 }
 
-static void *prom_map_get_internal(const char *key, size_t *size, size_t *max_size, prom_linked_list_t *keys,
-                                   prom_linked_list_t **addrs, prom_map_node_free_value_fn free_value_fn) {
-  size_t index = prom_map_get_index_internal(key, size, max_size);
-  prom_linked_list_t *list = addrs[index];
-  prom_map_node_t *temp_map_node = prom_map_node_new(key, NULL, free_value_fn);
-
-  for (prom_linked_list_node_t *current_node = list->head; current_node != NULL; current_node = current_node->next) {
-    prom_map_node_t *current_map_node = (prom_map_node_t *)current_node->item;
-    prom_linked_list_compare_t result = prom_linked_list_compare(list, current_map_node, temp_map_node);
-    if (result == PROM_EQUAL) {
-      prom_map_node_destroy(temp_map_node);
-      temp_map_node = NULL;
-      return current_map_node->value;
+static inline void prom_map_slot_store(prom_map_slot_t *slot, size_t hash, prom_map_node_t *node) {
+  atomic_store_explicit(&slot->hash, hash, memory_order_relaxed);
+  atomic_store_explicit(&slot->node, node, memory_order_release);
+}
+
+// Places a node that is known to be absent, displacing entries that are closer to their home slot
+static void prom_map_insert_internal(prom_map_table_t *table, prom_map_node_t *node) {
+  size_t mask = table->max_size - 1;
+  size_t hash = node->hash;
+  for (size_t i = hash & mask, distance = 0;; i = (i + 1) & mask, distance++) {
+    prom_map_slot_t *slot = &table->slots[i];
+    prom_map_node_t *slot_node = atomic_load_explicit(&slot->node, memory_order_relaxed);
+    if (slot_node == NULL) {
+      prom_map_slot_store(slot, hash, node);
+      return;
+    }
+    size_t slot_hash = atomic_load_explicit(&slot->hash, memory_order_relaxed);
+    size_t slot_distance = prom_map_probe_distance(slot_hash, i, mask);
+    if (slot_distance < distance) {
+      prom_map_slot_store(slot, hash, node);
+      hash = slot_hash;
+      node = slot_node;
+      distance = slot_distance;
     }
   }
-  prom_map_node_destroy(temp_map_node);
-  temp_map_node = NULL;
-  return NULL;
 }
 
-void *prom_map_get(prom_map_t *self, const char *key) {
-  PROM_ASSERT(self != NULL);
-  int r = 0;
-  r = pthread_rwlock_wrlock(self->rwlock);
-  if (r) {
-    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
-    NULL;
-  }
-  void *payload =
-      prom_map_get_internal(key, &self->size, &self->max_size, self->keys, self->addrs, self->free_value_fn);
-  r = pthread_rwlock_unlock(self->rwlock);
-  if (r) {
-    PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);
-    return NULL;
-  }
-  return payload;
+// Writers make the version odd while they move entries within the current table. A lookup that misses during or
+// across such a window cannot trust the miss and probes again.
+static inline void prom_map_write_begin(prom_map_t *self) {
+  atomic_store_explicit(&self->version, atomic_load_explicit(&self->version, memory_order_relaxed) + 1,
+                        memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
 }
 
-static int prom_map_set_internal(const char *key, void *value, size_t *size, size_t *max_size, prom_linked_list_t *keys,
-                                 prom_linked_list_t **addrs, prom_map_node_free_value_fn free_value_fn,
-                                 bool destroy_current_value) {
-  prom_map_node_t *map_node = prom_map_node_new(key, value, free_value_fn);
-  if (map_node == NULL) return 1;
+static inline void prom_map_write_end(prom_map_t *self) {
+  atomic_store_explicit(&self->version, atomic_load_explicit(&self->version, memory_order_relaxed) + 1,
+                        memory_order_release);
+}
 
-  size_t index = prom_map_get_index_internal(key, size, max_size);
-  prom_linked_list_t *list = addrs[index];
-  for (prom_linked_list_node_t *current_node = list->head; current_node != NULL; current_node = current_node->next) {
-    prom_map_node_t *current_map_node = (prom_map_node_t *)current_node->item;
-    prom_linked_list_compare_t result = prom_linked_list_compare(list, current_map_node, map_node);
-    if (result == PROM_EQUAL) {
-      if (destroy_current_value) {
-        free_value_fn(current_map_node->value);
-        current_map_node->value = NULL;
+/**
+ * @brief API PRIVATE returns the value of key, or NULL, and raises the stamp of its node to stamp.
+ *
+ * Lookups take no lock. They run inside a prom_epoch critical section, which keeps the table and the nodes they read
+ * alive, and check the version to tell a real miss from one caused by a concurrent writer. A hit is always valid
+ * because nodes never change their key.
+ */
+static void *prom_map_lookup(prom_map_t *self, const char *key, uint64_t stamp) {
+  size_t hash = prom_map_hash(key, strlen(key));
+  void *payload = NULL;
+
+  prom_epoch_enter();
+  for (unsigned int spins = 0;; spins++) {
+    size_t version = atomic_load_explicit(&self->version, memory_order_acquire);
+    if (version & 1) {
+      if (spins >= PROM_MAP_READ_SPINS) sched_yield();
+      continue;
+    }
+    prom_map_node_t *node = NULL;
+    prom_map_find_internal(atomic_load_explicit(&self->table, memory_order_acquire), key, hash, &node);
+    if (node != NULL) {
+      payload = atomic_load_explicit(&node->value, memory_order_acquire);
+      // Stamps are raised at most once per sweep, so this rarely writes
+      uint64_t seen = atomic_load_explicit(&node->stamp, memory_order_relaxed);
+      while (seen < stamp && !atomic_compare_exchange_weak_explicit(&node->stamp, &seen, stamp, memory_order_relaxed,
+                                                                    memory_order_relaxed)) {
       }
-      prom_free((char *)current_map_node->key);
-      current_map_node->key = NULL;
-      prom_free(current_map_node);
-      current_map_node = NULL;
-      current_node->item = map_node;
-      return 0;
+      break;
     }
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&self->version, memory_order_relaxed) == version) break;
   }
-  prom_linked_list_append(list, map_node);
-  prom_linked_list_append(keys, (char *)map_node->key);
-  (*size)++;
-  return 0;
+  prom_epoch_exit();
+
+  return payload;
+}
+
+void *prom_map_get(prom_map_t *self, const char *key) {
+  PROM_ASSERT(self != NULL);
+  return prom_map_lookup(self, key, 0);
+}
+
+void *prom_map_touch(prom_map_t *self, const char *key, uint64_t stamp) {
+  PROM_ASSERT(self != NULL);
+  return prom_map_lookup(self, key, stamp);
 }
 
 int prom_map_ensure_space(prom_map_t *self) {
   PROM_ASSERT(self != NULL);
-  int r = 0;
 
-  if (self->size <= self->max_size / 2) {
+  if (self->max_size != 0 && self->size + 1 <= self->max_size / 2) {
     return 0;
   }
 
   // Increase the max size
-  size_t new_max = self->max_size * 2;
-  size_t new_size = 0;
-
-  // Create a new list of keys
-  prom_linked_list_t *new_keys = prom_linked_list_new();
-  if (new_keys == NULL) return 1;
-
-  r = prom_linked_list_set_free_fn(new_keys, prom_linked_list_no_op_free);
-  if (r) return r;
-
-  // Create a new array of addrs
-  prom_linked_list_t **new_addrs = prom_malloc(sizeof(prom_linked_list_t) * new_max);
-
-  // Initialize the new array
-  for (int i = 0; i < new_max; i++) {
-    new_addrs[i] = prom_linked_list_new();
-    r = prom_linked_list_set_free_fn(new_addrs[i], prom_map_node_free);
-    if (r) return r;
-    r = prom_linked_list_set_compare_fn(new_addrs[i], prom_map_node_compare);
-    if (r) return r;
+  size_t new_max = self->max_size == 0 ? PROM_MAP_INITIAL_SIZE : self->max_size * 2;
+  prom_map_table_t *new_table =
+      (prom_map_table_t *)prom_malloc(sizeof(prom_map_table_t) + sizeof(prom_map_slot_t) * new_max);
+  if (new_table == NULL) return 1;
+  memset(new_table->slots, 0, sizeof(prom_map_slot_t) * new_max);
+  new_table->max_size = new_max;
+
+  // Move each node into the new table using its cached hash. The nodes and their keys are reused, so the list of keys
+  // remains valid and keeps its order. Lookups keep using the old table until the new one is published.
+  prom_map_table_t *table = atomic_load_explicit(&self->table, memory_order_relaxed);
+  for (size_t i = 0; i < self->max_size; i++) {
+    prom_map_node_t *node = atomic_load_explicit(&table->slots[i].node, memory_order_relaxed);
+    if (node != NULL) prom_map_insert_internal(new_table, node);
   }
+  atomic_store_explicit(&self->table, new_table, memory_order_release);
+  self->max_size = new_max;
+  prom_epoch_retire(table, prom_map_free_retired);
 
-  // Iterate through each linked-list at each memory region in the map's backbone
-  for (int i = 0; i < self->max_size; i++) {
-    // Create a new map node for each node in the linked list and insert it into the new map. Afterwards, deallocate
-    // the old map node
-    prom_linked_list_t *list = self->addrs[i];
-    prom_linked_list_node_t *current_node = list->head;
-    while (current_node != NULL) {
-      prom_map_node_t *map_node = (prom_map_node_t *)current_node->item;
-      r = prom_map_set_internal(map_node->key, map_node->value, &new_size, &new_max, new_keys, new_addrs,
-                                self->free_value_fn, false);
-      if (r) return r;
-
-      prom_linked_list_node_t *next = current_node->next;
-      prom_free(current_node);
-      current_node = NULL;
-      prom_free((void *)map_node->key);
-      map_node->key = NULL;
-      prom_free(map_node);
-      map_node = NULL;
-      current_node = next;
-    }
-    // We're done deallocating each map node in the linked list, so deallocate the linked-list object
-    prom_free(self->addrs[i]);
-    self->addrs[i] = NULL;
+  return 0;
+}
+
+static int prom_map_set_internal(prom_map_t *self, const char *key, void *value) {
+  size_t len = strlen(key);
+  prom_map_node_t *current_map_node = NULL;
+  prom_map_find_internal(atomic_load_explicit(&self->table, memory_order_relaxed), key, prom_map_hash(key, len),
+                         &current_map_node);
+
+  // An existing key keeps its node and its place in the entries
+  if (current_map_node != NULL) {
+    void *current_value = atomic_load_explicit(&current_map_node->value, memory_order_relaxed);
+    prom_map_entries_t *entries = atomic_load_explicit(&self->entries, memory_order_relaxed);
+    atomic_store_explicit(&current_map_node->value, value, memory_order_release);
+    atomic_store_explicit(&entries->items[current_map_node->index].value, value, memory_order_release);
+    // Lookups may still be reading the value that was replaced, so it is freed through prom_epoch like a deleted one
+    if (current_value != value) prom_epoch_retire(current_value, current_map_node->free_value_fn);
+    current_map_node->free_value_fn = self->free_value_fn;
+    return 0;
   }
-  // Destroy the collection of keys in the map
-  prom_linked_list_destroy(self->keys);
-  self->keys = NULL;
 
-  // Deallocate the backbone of the map
-  prom_free(self->addrs);
-  self->addrs = NULL;
+  int r = prom_map_ensure_space(self);
+  if (r) return r;
 
-  // Update the members of the current map
-  self->size = new_size;
-  self->max_size = new_max;
-  self->keys = new_keys;
-  self->addrs = new_addrs;
+  // Make room for the entry before the node becomes visible, so that a failure leaves the map unchanged
+  prom_map_entries_t *entries = atomic_load_explicit(&self->entries, memory_order_relaxed);
+  size_t entries_size = entries == NULL ? 0 : atomic_load_explicit(&entries->size, memory_order_relaxed);
+  if (entries == NULL || entries_size == entries->capacity) {
+    prom_map_entries_t *new_entries =
+        prom_map_entries_new(entries == NULL ? PROM_MAP_INITIAL_SIZE / 2 : entries->capacity * 2);
+    if (new_entries == NULL) return 1;
+    if (entries != NULL) prom_map_entries_copy(new_entries, entries, entries_size);
+    atomic_store_explicit(&self->entries, new_entries, memory_order_release);
+    prom_epoch_retire(entries, prom_map_free_retired);
+    entries = new_entries;
+  }
 
+  prom_map_node_t *map_node = prom_map_node_new(key, value, self->free_value_fn);
+  if (map_node == NULL) return 1;
+  map_node->index = entries_size;
+  prom_map_write_begin(self);
+  prom_map_insert_internal(atomic_load_explicit(&self->table, memory_order_relaxed), map_node);
+  prom_map_write_end(self);
+
+  // The entry is filled in before the size that makes it visible to iteration
+  entries->items[entries_size].key = map_node->key;
+  atomic_init(&entries->items[entries_size].value, value);
+  atomic_store_explicit(&entries->size, entries_size + 1, memory_order_release);
+  self->size++;
   return 0;
 }
 
@@ -328,19 +437,7 @@ int prom_map_set(prom_map_t *self, const char *key, void *value) {
     return r;
   }
 
-  r = prom_map_ensure_space(self);
-  if (r) {
-    int rr = 0;
-    rr = pthread_rwlock_unlock(self->rwlock);
-    if (rr) {
-      PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);
-      return rr;
-    } else {
-      return r;
-    }
-  }
-  r = prom_map_set_internal(key, value, &self->size, &self->max_size, self->keys, self->addrs, self->free_value_fn,
-                            true);
+  r = prom_map_set_internal(self, key, value);
   if (r) {
     int rr = 0;
     rr = pthread_rwlock_unlock(self->rwlock);
@@ -358,30 +455,58 @@ int prom_map_set(prom_map_t *self, const char *key, void *value) {
   return r;
 }
 
-static int prom_map_delete_internal(const char *key, size_t *size, size_t *max_size, prom_linked_list_t *keys,
-                                    prom_linked_list_t **addrs, prom_map_node_free_value_fn free_value_fn) {
-  int r = 0;
-  size_t index = prom_map_get_index_internal(key, size, max_size);
-  prom_linked_list_t *list = addrs[index];
-  prom_map_node_t *temp_map_node = prom_map_node_new(key, NULL, free_value_fn);
-
-  for (prom_linked_list_node_t *current_node = list->head; current_node != NULL; current_node = current_node->next) {
-    prom_map_node_t *current_map_node = (prom_map_node_t *)current_node->item;
-    prom_linked_list_compare_t result = prom_linked_list_compare(list, current_map_node, temp_map_node);
-    if (result == PROM_EQUAL) {
-      r = prom_linked_list_remove(list, current_node);
-      if (r) return r;
+// Backward shift deletion: pull the entries after slot i one slot closer to home until one is already home. Call
+// between prom_map_write_begin and prom_map_write_end.
+static void prom_map_remove_slot(prom_map_table_t *table, size_t i) {
+  size_t mask = table->max_size - 1;
+  for (;;) {
+    size_t next = (i + 1) & mask;
+    prom_map_slot_t *slot = &table->slots[next];
+    prom_map_node_t *slot_node = atomic_load_explicit(&slot->node, memory_order_relaxed);
+    size_t slot_hash = atomic_load_explicit(&slot->hash, memory_order_relaxed);
+    if (slot_node == NULL || prom_map_probe_distance(slot_hash, next, mask) == 0) break;
+    prom_map_slot_store(&table->slots[i], slot_hash, slot_node);
+    i = next;
+  }
+  prom_map_slot_store(&table->slots[i], 0, NULL);
+}
 
-      r = prom_linked_list_remove(keys, (char *)current_map_node->key);
-      if (r) return r;
+// Releases a node that is no longer reachable from the table or the entries. Lookups and iterations may still be
+// reading the node and its value, so both are freed through prom_epoch.
+static void prom_map_retire_node(prom_map_node_t *node) {
+  void *value = atomic_load_explicit(&node->value, memory_order_relaxed);
+  if (value != NULL) prom_epoch_retire(value, node->free_value_fn);
+  prom_epoch_retire(node, prom_map_free_retired);
+}
 
-      (*size)--;
-      break;
-    }
+static int prom_map_delete_internal(prom_map_t *self, const char *key) {
+  prom_map_table_t *table = atomic_load_explicit(&self->table, memory_order_relaxed);
+  prom_map_node_t *map_node = NULL;
+  ssize_t found = prom_map_find_internal(table, key, prom_map_hash(key, strlen(key)), &map_node);
+  if (found < 0) return 0;
+
+  // The entries borrow the key from the map node, so the entry is removed before the map node is released. Iteration
+  // may be reading the current block, so the remaining entries are copied into a new one.
+  prom_map_entries_t *entries = atomic_load_explicit(&self->entries, memory_order_relaxed);
+  prom_map_entries_t *new_entries = prom_map_entries_new(entries->capacity);
+  if (new_entries == NULL) return 1;
+  prom_map_entries_copy(new_entries, entries, map_node->index);
+
+  prom_map_write_begin(self);
+  prom_map_remove_slot(table, found);
+  prom_map_write_end(self);
+
+  // Entries after the removed one moved down by one
+  for (size_t j = 0; j < self->max_size; j++) {
+    prom_map_node_t *node = atomic_load_explicit(&table->slots[j].node, memory_order_relaxed);
+    if (node != NULL && node->index > map_node->index) node->index--;
   }
-  r = prom_map_node_destroy(temp_map_node);
-  temp_map_node = NULL;
-  return r;
+  atomic_store_explicit(&self->entries, new_entries, memory_order_release);
+  prom_epoch_retire(entries, prom_map_free_retired);
+
+  prom_map_retire_node(map_node);
+  self->size--;
+  return 0;
 }
 
 int prom_map_delete(prom_map_t *self, const char *key) {
@@ -393,7 +518,7 @@ int prom_map_delete(prom_map_t *self, const char *key) {
     PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
     ret = r;
   }
-  r = prom_map_delete_internal(key, &self->size, &self->max_size, self->keys, self->addrs, self->free_value_fn);
+  r = prom_map_delete_internal(self, key);
   if (r) ret = r;
   r = pthread_rwlock_unlock(self->rwlock);
   if (r) {
@@ -403,6 +528,76 @@ int prom_map_delete(prom_map_t *self, const char *key) {
   return ret;
 }
 
+static size_t prom_map_sweep_internal(prom_map_t *self, uint64_t before) {
+  prom_map_entries_t *entries = atomic_load_explicit(&self->entries, memory_order_relaxed);
+  if (entries == NULL) return 0;
+  prom_map_table_t *table = atomic_load_explicit(&self->table, memory_order_relaxed);
+
+  // Most sweeps find nothing to remove, so look before copying the entries
+  bool stale = false;
+  for (size_t i = 0; i < table->max_size && !stale; i++) {
+    prom_map_node_t *node = atomic_load_explicit(&table->slots[i].node, memory_order_relaxed);
+    stale = node != NULL && atomic_load_explicit(&node->stamp, memory_order_relaxed) < before;
+  }
+  if (!stale) return 0;
+
+  prom_map_entries_t *new_entries = prom_map_entries_new(entries->capacity);
+  if (new_entries == NULL) return 0;
+
+  // Walk the entries in order so that the survivors keep it. A node is judged by a single read of its stamp; an update
+  // that races the sweep may land on a node that is already on its way out, which only loses that update.
+  size_t size = atomic_load_explicit(&entries->size, memory_order_relaxed);
+  size_t kept = 0;
+  size_t removed = 0;
+  prom_map_write_begin(self);
+  for (size_t i = 0; i < size; i++) {
+    const char *key = entries->items[i].key;
+    prom_map_node_t *node = NULL;
+    ssize_t found = prom_map_find_internal(table, key, prom_map_hash(key, strlen(key)), &node);
+    if (found < 0) continue;
+    if (atomic_load_explicit(&node->stamp, memory_order_relaxed) < before) {
+      prom_map_remove_slot(table, found);
+      prom_map_retire_node(node);
+      removed++;
+      continue;
+    }
+    new_entries->items[kept].key = node->key;
+    atomic_init(&new_entries->items[kept].value, atomic_load_explicit(&node->value, memory_order_relaxed));
+    node->index = kept++;
+  }
+  atomic_init(&new_entries->size, kept);
+  prom_map_write_end(self);
+
+  atomic_store_explicit(&self->entries, new_entries, memory_order_release);
+  prom_epoch_retire(entries, prom_map_free_retired);
+  self->size -= removed;
+  return removed;
+}
+
+size_t prom_map_sweep(prom_map_t *self, uint64_t before) {
+  PROM_ASSERT(self != NULL);
+  int r = pthread_rwlock_wrlock(self->rwlock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return 0;
+  }
+  size_t removed = prom_map_sweep_internal(self, before);
+  r = pthread_rwlock_unlock(self->rwlock);
+  if (r) PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);
+  return removed;
+}
+
+prom_map_entry_t *prom_map_entries(prom_map_t *self, size_t *size) {
+  PROM_ASSERT(self != NULL);
+  prom_map_entries_t *entries = atomic_load_explicit(&self->entries, memory_order_acquire);
+  if (entries == NULL) {
+    *size = 0;
+    return NULL;
+  }
+  *size = atomic_load_explicit(&entries->size, memory_order_acquire);
+  return entries->items;
+}
+
 int prom_map_set_free_value_fn(prom_map_t *self, prom_map_node_free_value_fn free_value_fn) {
   PROM_ASSERT(self != NULL);
   self->free_value_fn = free_value_fn;
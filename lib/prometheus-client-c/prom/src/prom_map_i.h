@@ -17,6 +17,8 @@
 #ifndef PROM_MAP_I_INCLUDED
 #define PROM_MAP_I_INCLUDED
 
+#include <stdint.h>
+
 #include "prom_map_t.h"
 
 prom_map_t *prom_map_new(void);
@@ -25,12 +27,34 @@ int prom_map_set_free_value_fn(prom_map_t *self, prom_map_node_free_value_fn fre
 
 void *prom_map_get(prom_map_t *self, const char *key);
 
+/**
+ * @brief API PRIVATE Returns the value of key, or NULL, like prom_map_get, and raises the stamp of its entry to stamp
+ * if it is lower. Stamping with PROM_MAP_STAMP_PINNED keeps the entry from being swept.
+ */
+void *prom_map_touch(prom_map_t *self, const char *key, uint64_t stamp);
+
 int prom_map_set(prom_map_t *self, const char *key, void *value);
 
 int prom_map_delete(prom_map_t *self, const char *key);
 
+/**
+ * @brief API PRIVATE Deletes every entry whose stamp is below before and returns how many were deleted.
+ *
+ * Deleted values are released through prom_epoch, so lookups and iterations that are still using them stay valid until
+ * they leave their critical section.
+ */
+size_t prom_map_sweep(prom_map_t *self, uint64_t before);
+
 int prom_map_destroy(prom_map_t *self);
 
+/**
+ * @brief API PRIVATE Returns the entries of the map in insertion order and stores their number in size.
+ *
+ * The entries are contiguous, so iterating them needs no further lookups. Call this inside a prom_epoch critical
+ * section; the returned entries stay valid until the section exits, and entries set meanwhile are not included.
+ */
+prom_map_entry_t *prom_map_entries(prom_map_t *self, size_t *size);
+
 size_t prom_map_size(prom_map_t *self);
 
 prom_map_node_t *prom_map_node_new(const char *key, void *value, prom_map_node_free_value_fn free_value_fn);
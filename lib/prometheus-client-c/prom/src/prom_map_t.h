@@ -18,27 +18,69 @@
 #define PROM_MAP_T_H
 
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
 
 // Public
 #include "prom_map.h"
 
-// Private
-#include "prom_linked_list_t.h"
-
 typedef void (*prom_map_node_free_value_fn)(void *);
 
+/**
+ * @brief API PRIVATE The stamp of entries that prom_map_sweep never removes
+ */
+#define PROM_MAP_STAMP_PINNED UINT64_MAX
+
 struct prom_map_node {
-  const char *key;
-  void *value;
+  const char *key;       /**< key is stored in the same allocation as the node */
+  size_t hash;           /**< hash of key, cached so that lookups and resizes do not rehash stored keys */
+  _Atomic(void *) value; /**< value is loaded by readers that do not hold the lock */
+  size_t index;          /**< the position of the node's entry in the map's entries */
+  _Atomic uint64_t stamp; /**< stamp only grows. prom_map_sweep removes nodes whose stamp is below its cutoff */
   prom_map_node_free_value_fn free_value_fn;
 };
 
+/**
+ * @brief API PRIVATE A slot of the open addressing table. The hash is stored inline so that probing compares hashes
+ * without dereferencing the node.
+ */
+typedef struct prom_map_slot {
+  _Atomic size_t hash;             /**< hash of the key of node */
+  _Atomic(prom_map_node_t *) node; /**< node is NULL when the slot is empty */
+} prom_map_slot_t;
+
+typedef struct prom_map_table {
+  size_t max_size;         /**< the number of slots, a power of two */
+  prom_map_slot_t slots[]; /**< Robin Hood hash table of max_size slots */
+} prom_map_table_t;
+
+/**
+ * @brief API PRIVATE An entry in the insertion ordered array of a map. The key is borrowed from the map node.
+ */
+typedef struct prom_map_entry {
+  const char *key;
+  _Atomic(void *) value;
+} prom_map_entry_t;
+
+/**
+ * @brief API PRIVATE The entries of a map in insertion order.
+ *
+ * Entries are appended in place below capacity. Removing an entry or growing past capacity copies the entries into a
+ * new block, so a block that readers obtained from prom_map_entries never shrinks or moves while they iterate it.
+ */
+typedef struct prom_map_entries {
+  size_t capacity;
+  _Atomic size_t size;
+  prom_map_entry_t items[];
+} prom_map_entries_t;
+
 struct prom_map {
-  size_t size;                /**< contains the size of the map */
-  size_t max_size;            /**< stores the current max_size */
-  prom_linked_list_t *keys;   /**< linked list containing containing all keys present */
-  prom_linked_list_t **addrs; /**< Sequence of linked lists. Each list contains nodes with the same index */
-  pthread_rwlock_t *rwlock;
+  size_t size;                           /**< contains the size of the map */
+  size_t max_size;                       /**< the number of slots, a power of two. 0 until the first key is set */
+  _Atomic(prom_map_entries_t *) entries; /**< the entries in insertion order, NULL until the first key is set */
+  _Atomic(prom_map_table_t *) table;     /**< the current table. Replaced tables are freed through prom_epoch */
+  _Atomic size_t version;                /**< odd while a writer is moving entries within the current table */
+  pthread_rwlock_t *rwlock;              /**< serializes writers. Lookups do not take it */
   prom_map_node_free_value_fn free_value_fn;
 };
 
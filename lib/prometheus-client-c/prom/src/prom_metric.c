@@ -18,6 +18,7 @@
 
 // Public
 #include "prom_alloc.h"
+#include "prom_collector_registry.h"
 #include "prom_histogram_buckets.h"
 
 // Private
@@ -29,32 +30,50 @@
 #include "prom_metric_i.h"
 #include "prom_metric_sample_histogram_i.h"
 #include "prom_metric_sample_i.h"
+#include "prom_metric_sample_native_histogram_i.h"
+#include "prom_metric_sample_summary_i.h"
 
-char *prom_metric_type_map[4] = {"counter", "gauge", "histogram", "summary"};
+// Most l_values fit in this many bytes, so sample lookups need not allocate
+#define PROM_METRIC_L_VALUE_STACK_SIZE 256
+
+char *prom_metric_type_map[5] = {"counter", "gauge", "histogram", "summary", "histogram"};
 
 prom_metric_t *prom_metric_new(prom_metric_type_t metric_type, const char *name, const char *help,
                                size_t label_key_count, const char **label_keys) {
   int r = 0;
+  // Names are checked before anything is allocated, so a rejected metric has nothing to tear down
+  if (prom_collector_registry_validate_metric_name(NULL, name)) return NULL;
+  for (int i = 0; i < label_key_count; i++) {
+    if (prom_collector_registry_validate_label_name(NULL, label_keys[i])) return NULL;
+    if (strcmp(label_keys[i], "le") == 0 || strcmp(label_keys[i], "quantile") == 0) {
+      PROM_LOG(PROM_METRIC_INVALID_LABEL_NAME);
+      return NULL;
+    }
+  }
+
   prom_metric_t *self = (prom_metric_t *)prom_malloc(sizeof(prom_metric_t));
   self->type = metric_type;
   self->name = name;
   self->help = help;
   self->buckets = NULL;
+  self->sharded = false;
+  self->integer = false;
+  self->quantiles = NULL;
+  self->quantile_count = 0;
+  self->max_age = 0.0;
+  self->schema = 0;
+  self->max_buckets = 0;
+  self->max_series = 0;
+  self->series_ttl = 0;
+  atomic_init(&self->sweeps, 0);
+  atomic_init(&self->dropped_series, 0);
+  atomic_init(&self->evicted_series, 0);
+  self->group = NULL;
 
   const char **k = (const char **)prom_malloc(sizeof(const char *) * label_key_count);
 
   for (int i = 0; i < label_key_count; i++) {
-    if (strcmp(label_keys[i], "le") == 0) {
-      PROM_LOG(PROM_METRIC_INVALID_LABEL_NAME);
-      prom_metric_destroy(self);
-      return NULL;
-    }
-    if (strcmp(label_keys[i], "quantile") == 0) {
-      PROM_LOG(PROM_METRIC_INVALID_LABEL_NAME);
-      prom_metric_destroy(self);
-      return NULL;
-    }
-    k[i] = prom_strdup(label_keys[i]);
+    k[i] = prom_intern(label_keys[i]);
   }
   self->label_keys = k;
   self->label_key_count = label_key_count;
@@ -66,6 +85,18 @@ prom_metric_t *prom_metric_new(prom_metric_type_t metric_type, const char *name,
       prom_metric_destroy(self);
       return NULL;
     }
+  } else if (metric_type == PROM_SUMMARY) {
+    r = prom_map_set_free_value_fn(self->samples, &prom_metric_sample_summary_free_generic);
+    if (r) {
+      prom_metric_destroy(self);
+      return NULL;
+    }
+  } else if (metric_type == PROM_NATIVE_HISTOGRAM) {
+    r = prom_map_set_free_value_fn(self->samples, &prom_metric_sample_native_histogram_free_generic);
+    if (r) {
+      prom_metric_destroy(self);
+      return NULL;
+    }
   } else {
     r = prom_map_set_free_value_fn(self->samples, &prom_metric_sample_free_generic);
     if (r) {
@@ -74,11 +105,6 @@ prom_metric_t *prom_metric_new(prom_metric_type_t metric_type, const char *name,
     }
   }
 
-  self->formatter = prom_metric_formatter_new();
-  if (self->formatter == NULL) {
-    prom_metric_destroy(self);
-    return NULL;
-  }
   self->rwlock = (pthread_rwlock_t *)prom_malloc(sizeof(pthread_rwlock_t));
   r = pthread_rwlock_init(self->rwlock, NULL);
   if (r) {
@@ -95,20 +121,20 @@ int prom_metric_destroy(prom_metric_t *self) {
   int r = 0;
   int ret = 0;
 
+  // Histogram and summary samples read the buckets and quantiles while they are destroyed, so those go last
+  r = prom_map_destroy(self->samples);
+  self->samples = NULL;
+  if (r) ret = r;
+
+  prom_free((void *)self->quantiles);
+  self->quantiles = NULL;
+
   if (self->buckets != NULL) {
     r = prom_histogram_buckets_destroy(self->buckets);
     self->buckets = NULL;
     if (r) ret = r;
   }
 
-  r = prom_map_destroy(self->samples);
-  self->samples = NULL;
-  if (r) ret = r;
-
-  r = prom_metric_formatter_destroy(self->formatter);
-  self->formatter = NULL;
-  if (r) ret = r;
-
   r = pthread_rwlock_destroy(self->rwlock);
   if (r) {
     PROM_LOG(PROM_PTHREAD_RWLOCK_DESTROY_ERROR);
@@ -119,7 +145,7 @@ int prom_metric_destroy(prom_metric_t *self) {
   self->rwlock = NULL;
 
   for (int i = 0; i < self->label_key_count; i++) {
-    prom_free((void *)self->label_keys[i]);
+    prom_intern_release(self->label_keys[i]);
     self->label_keys[i] = NULL;
   }
   prom_free(self->label_keys);
@@ -144,95 +170,184 @@ void prom_metric_free_generic(void *item) {
   prom_metric_destroy(self);
 }
 
-prom_metric_sample_t *prom_metric_sample_from_labels(prom_metric_t *self, const char **label_values) {
-  PROM_ASSERT(self != NULL);
+/**
+ * @brief API PRIVATE Looks up the sample stored under l_value, creating it with create_fn on a miss.
+ *
+ * The lookup does not take the metric lock, so updates to existing samples from many threads do not serialize here.
+ * Only a miss takes the write lock, and it looks the sample up again in case another thread created it meanwhile.
+ *
+ * The sample is stamped with the current sweep so that prom_metric_sweep can tell it is in use. A pinned sample is
+ * never swept. Pinning always takes the write lock, which a sweep holds, so the sample cannot be evicted between the
+ * lookup and the pin.
+ */
+static void *prom_metric_sample_lookup(prom_metric_t *self, const char **label_values,
+                                       void *(*create_fn)(prom_metric_t *, const char *, const char **), bool pin) {
   int r = 0;
-  r = pthread_rwlock_wrlock(self->rwlock);
-  if (r) {
-    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
-    return NULL;
-  }
-
-#define PROM_METRIC_SAMPLE_FROM_LABELS_HANDLE_UNLOCK() \
-  r = pthread_rwlock_unlock(self->rwlock);             \
-  if (r) PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);   \
-  return NULL;
-
-  // Get l_value
-  r = prom_metric_formatter_load_l_value(self->formatter, self->name, NULL, self->label_key_count, self->label_keys,
-                                         label_values);
-  if (r) {
-    PROM_METRIC_SAMPLE_FROM_LABELS_HANDLE_UNLOCK();
-  }
 
-  // This must be freed before returning
-  const char *l_value = prom_metric_formatter_dump(self->formatter);
-  if (l_value == NULL) {
-    PROM_METRIC_SAMPLE_FROM_LABELS_HANDLE_UNLOCK();
+  // The l_value is built on the stack unless it is unusually long. This must be freed before returning when it is not.
+  char buf[PROM_METRIC_L_VALUE_STACK_SIZE];
+  size_t len = prom_metric_formatter_write_l_value(buf, sizeof(buf), self->name, self->label_key_count,
+                                                   self->label_keys, label_values);
+  char *l_value = buf;
+  if (len >= sizeof(buf)) {
+    l_value = (char *)prom_malloc(len + 1);
+    prom_metric_formatter_write_l_value(l_value, len + 1, self->name, self->label_key_count, self->label_keys,
+                                        label_values);
   }
 
-  // Get sample
-  prom_metric_sample_t *sample = (prom_metric_sample_t *)prom_map_get(self->samples, l_value);
+  uint64_t stamp = pin ? PROM_MAP_STAMP_PINNED : atomic_load_explicit(&self->sweeps, memory_order_relaxed);
+  void *sample = pin ? NULL : prom_map_touch(self->samples, l_value, stamp);
   if (sample == NULL) {
-    sample = prom_metric_sample_new(self->type, l_value, 0.0);
-    r = prom_map_set(self->samples, l_value, sample);
+    r = pthread_rwlock_wrlock(self->rwlock);
     if (r) {
-      PROM_METRIC_SAMPLE_FROM_LABELS_HANDLE_UNLOCK();
+      PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+      if (l_value != buf) prom_free(l_value);
+      return NULL;
     }
+    sample = prom_map_touch(self->samples, l_value, stamp);
+    if (sample == NULL && self->max_series > 0 && prom_map_size(self->samples) >= self->max_series) {
+      atomic_fetch_add_explicit(&self->dropped_series, 1, memory_order_relaxed);
+    } else if (sample == NULL) {
+      sample = (*create_fn)(self, l_value, label_values);
+      if (sample != NULL) {
+        r = prom_map_set(self->samples, l_value, sample);
+        if (r) {
+          sample = NULL;
+        } else {
+          prom_map_touch(self->samples, l_value, stamp);
+        }
+      }
+    }
+    r = pthread_rwlock_unlock(self->rwlock);
+    if (r) PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);
+  }
+
+  if (l_value != buf) prom_free(l_value);
+  return sample;
+}
+
+static void *prom_metric_sample_create(prom_metric_t *self, const char *l_value, const char **label_values) {
+  prom_metric_sample_t *sample = prom_metric_sample_new(self->type, l_value, 0.0);
+  sample->integer = self->integer;
+  sample->group = self->group;
+  int r = prom_metric_sample_set_label_values(sample, self->label_key_count, label_values);
+  if (r == 0 && self->sharded) r = prom_metric_sample_enable_shards(sample);
+  if (r) {
+    prom_metric_sample_destroy(sample);
+    return NULL;
   }
-  pthread_rwlock_unlock(self->rwlock);
-  prom_free((void *)l_value);
   return sample;
 }
 
+static void *prom_metric_sample_histogram_create(prom_metric_t *self, const char *l_value, const char **label_values) {
+  return prom_metric_sample_histogram_new(self->name, self->buckets, self->label_key_count, self->label_keys,
+                                          label_values);
+}
+
+static void *prom_metric_sample_summary_create(prom_metric_t *self, const char *l_value, const char **label_values) {
+  return prom_metric_sample_summary_new(self->name, self->quantile_count, self->quantiles, self->max_age,
+                                        self->label_key_count, self->label_keys, label_values);
+}
+
+static void *prom_metric_sample_native_histogram_create(prom_metric_t *self, const char *l_value,
+                                                       const char **label_values) {
+  return prom_metric_sample_native_histogram_new(self->name, self->schema, self->max_buckets, self->label_key_count,
+                                                 self->label_keys, label_values);
+}
+
+prom_metric_sample_t *prom_metric_sample_from_labels(prom_metric_t *self, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  return (prom_metric_sample_t *)prom_metric_sample_lookup(self, label_values, prom_metric_sample_create, true);
+}
+
 prom_metric_sample_histogram_t *prom_metric_sample_histogram_from_labels(prom_metric_t *self,
                                                                          const char **label_values) {
   PROM_ASSERT(self != NULL);
+  return (prom_metric_sample_histogram_t *)prom_metric_sample_lookup(self, label_values,
+                                                                     prom_metric_sample_histogram_create, true);
+}
+
+prom_metric_sample_summary_t *prom_metric_sample_summary_from_labels(prom_metric_t *self, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  return (prom_metric_sample_summary_t *)prom_metric_sample_lookup(self, label_values,
+                                                                   prom_metric_sample_summary_create, true);
+}
 
-  int r = 0;
-  r = pthread_rwlock_wrlock(self->rwlock);
-  if (r) {
-    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
-    return NULL;
-  }
+prom_metric_sample_native_histogram_t *prom_metric_sample_native_histogram_from_labels(prom_metric_t *self,
+                                                                                       const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  return (prom_metric_sample_native_histogram_t *)prom_metric_sample_lookup(
+      self, label_values, prom_metric_sample_native_histogram_create, true);
+}
 
-#define PROM_METRIC_SAMPLE_HISTOGRAM_FROM_LABELS_HANDLE_UNLOCK() \
-  r = pthread_rwlock_unlock(self->rwlock);                       \
-  if (r) {                                                       \
-    PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);                  \
-    return NULL;                                                 \
-  }
+prom_metric_sample_t *prom_metric_sample_for_update(prom_metric_t *self, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  return (prom_metric_sample_t *)prom_metric_sample_lookup(self, label_values, prom_metric_sample_create, false);
+}
+
+prom_metric_sample_histogram_t *prom_metric_sample_histogram_for_update(prom_metric_t *self,
+                                                                        const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  return (prom_metric_sample_histogram_t *)prom_metric_sample_lookup(self, label_values,
+                                                                     prom_metric_sample_histogram_create, false);
+}
+
+prom_metric_sample_summary_t *prom_metric_sample_summary_for_update(prom_metric_t *self, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  return (prom_metric_sample_summary_t *)prom_metric_sample_lookup(self, label_values,
+                                                                   prom_metric_sample_summary_create, false);
+}
+
+prom_metric_sample_native_histogram_t *prom_metric_sample_native_histogram_for_update(prom_metric_t *self,
+                                                                                      const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  return (prom_metric_sample_native_histogram_t *)prom_metric_sample_lookup(
+      self, label_values, prom_metric_sample_native_histogram_create, false);
+}
+
+int prom_metric_set_max_series(prom_metric_t *self, size_t max_series) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  self->max_series = max_series;
+  return 0;
+}
+
+int prom_metric_set_series_ttl(prom_metric_t *self, uint64_t ttl) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  self->series_ttl = ttl;
+  return 0;
+}
 
-  // Load the l_value
-  r = prom_metric_formatter_load_l_value(self->formatter, self->name, NULL, self->label_key_count, self->label_keys,
-                                         label_values);
+uint64_t prom_metric_dropped_series(prom_metric_t *self) {
+  PROM_ASSERT(self != NULL);
+  return atomic_load_explicit(&self->dropped_series, memory_order_relaxed);
+}
+
+uint64_t prom_metric_evicted_series(prom_metric_t *self) {
+  PROM_ASSERT(self != NULL);
+  return atomic_load_explicit(&self->evicted_series, memory_order_relaxed);
+}
+
+size_t prom_metric_sweep(prom_metric_t *self) {
+  PROM_ASSERT(self != NULL);
+  int r = pthread_rwlock_wrlock(self->rwlock);
   if (r) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_FROM_LABELS_HANDLE_UNLOCK();
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return 0;
   }
 
-  // This must be freed before returning
-  const char *l_value = prom_metric_formatter_dump(self->formatter);
-  if (l_value == NULL) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_FROM_LABELS_HANDLE_UNLOCK();
+  // A sample updated during sweep s carries stamp s, so it has gone series_ttl sweeps unused once the count reaches
+  // s + series_ttl
+  uint64_t sweeps = atomic_load_explicit(&self->sweeps, memory_order_relaxed);
+  size_t evicted = 0;
+  if (self->series_ttl > 0 && sweeps >= self->series_ttl) {
+    evicted = prom_map_sweep(self->samples, sweeps - self->series_ttl + 1);
+    atomic_fetch_add_explicit(&self->evicted_series, evicted, memory_order_relaxed);
   }
+  atomic_store_explicit(&self->sweeps, sweeps + 1, memory_order_relaxed);
 
-  // Get sample
-  prom_metric_sample_histogram_t *sample = (prom_metric_sample_histogram_t *)prom_map_get(self->samples, l_value);
-  if (sample == NULL) {
-    sample = prom_metric_sample_histogram_new(self->name, self->buckets, self->label_key_count, self->label_keys,
-                                              label_values);
-    if (sample == NULL) {
-      prom_free((void *)l_value);
-      PROM_METRIC_SAMPLE_HISTOGRAM_FROM_LABELS_HANDLE_UNLOCK();
-    }
-    r = prom_map_set(self->samples, l_value, sample);
-    if (r) {
-      prom_free((void *)l_value);
-      pthread_rwlock_unlock(self->rwlock);
-      PROM_METRIC_SAMPLE_HISTOGRAM_FROM_LABELS_HANDLE_UNLOCK();
-    }
-  }
-  pthread_rwlock_unlock(self->rwlock);
-  prom_free((void *)l_value);
-  return sample;
+  r = pthread_rwlock_unlock(self->rwlock);
+  if (r) PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);
+  return evicted;
 }
@@ -14,22 +14,40 @@
  * limitations under the License.
  */
 
+#include <math.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 
 // Public
 #include "prom_alloc.h"
+#include "prom_summary.h"
 
 // Private
 #include "prom_assert.h"
 #include "prom_collector_t.h"
-#include "prom_linked_list_t.h"
+#include "prom_epoch_i.h"
+#include "prom_group_i.h"
 #include "prom_map_i.h"
 #include "prom_metric_formatter_i.h"
+#include "prom_metric_sample_histogram_i.h"
 #include "prom_metric_sample_histogram_t.h"
+#include "prom_metric_sample_i.h"
+#include "prom_metric_sample_native_histogram_t.h"
+#include "prom_metric_sample_summary_i.h"
+#include "prom_metric_sample_summary_t.h"
 #include "prom_metric_sample_t.h"
 #include "prom_metric_t.h"
+#include "prom_protobuf_i.h"
 #include "prom_string_builder_i.h"
 
+// The size of the stack buffer OpenMetrics family names are copied to
+#define PROM_METRIC_FORMATTER_FAMILY_STACK_SIZE 256
+
+// io.prometheus.client.MetricType values indexed by prom_metric_type_t
+static const uint64_t prom_metric_formatter_protobuf_type_map[5] = {0, 1, 4, 2, 4};
+
 prom_metric_formatter_t *prom_metric_formatter_new() {
   prom_metric_formatter_t *self = (prom_metric_formatter_t *)prom_malloc(sizeof(prom_metric_formatter_t));
   self->string_builder = prom_string_builder_new();
@@ -37,6 +55,11 @@ prom_metric_formatter_t *prom_metric_formatter_new() {
     prom_metric_formatter_destroy(self);
     return NULL;
   }
+  self->format = PROM_EXPOSITION_TEXT;
+  self->family_builder = NULL;
+  self->metric_builder = NULL;
+  self->value_builder = NULL;
+  self->scrape = 0;
   self->err_builder = prom_string_builder_new();
   if (self->err_builder == NULL) {
     prom_metric_formatter_destroy(self);
@@ -60,6 +83,24 @@ int prom_metric_formatter_destroy(prom_metric_formatter_t *self) {
   self->err_builder = NULL;
   if (r) ret = r;
 
+  if (self->family_builder != NULL) {
+    r = prom_string_builder_destroy(self->family_builder);
+    self->family_builder = NULL;
+    if (r) ret = r;
+  }
+
+  if (self->metric_builder != NULL) {
+    r = prom_string_builder_destroy(self->metric_builder);
+    self->metric_builder = NULL;
+    if (r) ret = r;
+  }
+
+  if (self->value_builder != NULL) {
+    r = prom_string_builder_destroy(self->value_builder);
+    self->value_builder = NULL;
+    if (r) ret = r;
+  }
+
   prom_free(self);
   self = NULL;
   return ret;
@@ -118,7 +159,7 @@ int prom_metric_formatter_load_l_value(prom_metric_formatter_t *self, const char
   if (r) return r;
 
   if (suffix != NULL) {
-    r = prom_string_builder_add_char(self->string_builder, '_');
+    r = prom_string_builder_add_n(self->string_builder, "_", 1);
     if (r) return r;
 
     r = prom_string_builder_add_str(self->string_builder, suffix);
@@ -128,54 +169,83 @@ int prom_metric_formatter_load_l_value(prom_metric_formatter_t *self, const char
   if (label_count == 0) return 0;
 
   for (int i = 0; i < label_count; i++) {
-    if (i == 0) {
-      r = prom_string_builder_add_char(self->string_builder, '{');
-      if (r) return r;
-    }
-    r = prom_string_builder_add_str(self->string_builder, (const char *)label_keys[i]);
+    // The closing quote of the previous value is appended together with the comma
+    r = prom_string_builder_add_str(self->string_builder, i == 0 ? "{" : "\",");
     if (r) return r;
 
-    r = prom_string_builder_add_char(self->string_builder, '=');
+    r = prom_string_builder_add_str(self->string_builder, (const char *)label_keys[i]);
     if (r) return r;
 
-    r = prom_string_builder_add_char(self->string_builder, '"');
+    r = prom_string_builder_add_n(self->string_builder, "=\"", 2);
     if (r) return r;
 
     r = prom_string_builder_add_str(self->string_builder, (const char *)label_values[i]);
     if (r) return r;
+  }
+  return prom_string_builder_add_n(self->string_builder, "\"}", 2);
+}
 
-    r = prom_string_builder_add_char(self->string_builder, '"');
-    if (r) return r;
-
-    if (i == label_count - 1) {
-      r = prom_string_builder_add_char(self->string_builder, '}');
-      if (r) return r;
-    } else {
-      r = prom_string_builder_add_char(self->string_builder, ',');
-      if (r) return r;
-    }
+size_t prom_metric_formatter_write_l_value(char *buf, size_t size, const char *name, size_t label_count,
+                                           const char **label_keys, const char **label_values) {
+  size_t name_len = strlen(name);
+  size_t len = name_len;
+  for (size_t i = 0; i < label_count; i++) {
+    // Each label adds key="value" and is followed by ',' or '}'
+    len += strlen(label_keys[i]) + strlen(label_values[i]) + 4;
   }
-  return 0;
+  if (label_count > 0) len++;
+  if (len >= size) return len;
+
+  char *p = buf;
+  memcpy(p, name, name_len);
+  p += name_len;
+  for (size_t i = 0; i < label_count; i++) {
+    *p++ = i == 0 ? '{' : ',';
+    size_t n = strlen(label_keys[i]);
+    memcpy(p, label_keys[i], n);
+    p += n;
+    *p++ = '=';
+    *p++ = '"';
+    n = strlen(label_values[i]);
+    memcpy(p, label_values[i], n);
+    p += n;
+    *p++ = '"';
+  }
+  if (label_count > 0) *p++ = '}';
+  *p = '\0';
+  return len;
 }
 
-int prom_metric_formatter_load_sample(prom_metric_formatter_t *self, prom_metric_sample_t *sample) {
-  PROM_ASSERT(self != NULL);
-  if (self == NULL) return 1;
+// The size of a buffer that holds a formatted value between the space and the newline that surround it on a line
+#define PROM_METRIC_FORMATTER_VALUE_SIZE 52
 
+// Appends l_value followed by the value in buffer, which was written at buffer + 1 and is len bytes long. The space and
+// newline around the value are written into buffer so that the rest of the line is appended at once.
+static int prom_metric_formatter_load_line_buffer(prom_metric_formatter_t *self, const char *l_value, char *buffer,
+                                                  size_t len) {
   int r = 0;
 
-  r = prom_string_builder_add_str(self->string_builder, sample->l_value);
+  r = prom_string_builder_add_str(self->string_builder, l_value);
   if (r) return r;
 
-  r = prom_string_builder_add_char(self->string_builder, ' ');
-  if (r) return r;
+  buffer[0] = ' ';
+  buffer[len + 1] = '\n';
+  return prom_string_builder_add_n(self->string_builder, buffer, len + 2);
+}
 
-  char buffer[50];
-  sprintf(buffer, "%.17g", sample->r_value);
-  r = prom_string_builder_add_str(self->string_builder, buffer);
-  if (r) return r;
+static int prom_metric_formatter_load_line(prom_metric_formatter_t *self, const char *l_value, double r_value) {
+  char buffer[PROM_METRIC_FORMATTER_VALUE_SIZE];
+  size_t len = prom_string_builder_format_double(buffer + 1, r_value);
+  return prom_metric_formatter_load_line_buffer(self, l_value, buffer, len);
+}
 
-  return prom_string_builder_add_char(self->string_builder, '\n');
+int prom_metric_formatter_load_sample(prom_metric_formatter_t *self, prom_metric_sample_t *sample) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  char buffer[PROM_METRIC_FORMATTER_VALUE_SIZE];
+  size_t len = prom_metric_sample_format_scrape_value(sample, buffer + 1, sizeof(buffer) - 2);
+  if (len >= sizeof(buffer) - 2) return 1;
+  return prom_metric_formatter_load_line_buffer(self, sample->l_value, buffer, len);
 }
 
 int prom_metric_formatter_clear(prom_metric_formatter_t *self) {
@@ -209,53 +279,668 @@ int prom_metric_formatter_load_metric(prom_metric_formatter_t *self, prom_metric
   r = prom_metric_formatter_load_type(self, metric->name, metric->type);
   if (r) return r;
 
-  for (prom_linked_list_node_t *current_node = metric->samples->keys->head; current_node != NULL;
-       current_node = current_node->next) {
-    const char *key = (const char *)current_node->item;
+  size_t sample_count = 0;
+  prom_map_entry_t *samples = prom_map_entries(metric->samples, &sample_count);
+  for (size_t i = 0; i < sample_count; i++) {
     if (metric->type == PROM_HISTOGRAM) {
-      prom_metric_sample_histogram_t *hist_sample =
-          (prom_metric_sample_histogram_t *)prom_map_get(metric->samples, key);
-
-      if (hist_sample == NULL) return 1;
+      prom_metric_sample_histogram_t *hist_sample = (prom_metric_sample_histogram_t *)samples[i].value;
+
+      // Bucket counters are not cumulative, so sum them as the buckets are rendered. The +Inf bucket is the count.
+      size_t bucket_count = prom_histogram_buckets_count(hist_sample->buckets);
+      uint64_t cumulative = 0;
+      for (size_t j = 0; j <= bucket_count; j++) {
+        cumulative += atomic_load_explicit(&hist_sample->bucket_counts[j], memory_order_relaxed);
+        r = prom_metric_formatter_load_line(self, hist_sample->l_values[j], (double)cumulative);
+        if (r) return r;
+      }
+      r = prom_metric_formatter_load_line(
+          self, hist_sample->l_values[bucket_count + PROM_METRIC_SAMPLE_HISTOGRAM_COUNT], (double)cumulative);
+      if (r) return r;
+      r = prom_metric_formatter_load_line(self, hist_sample->l_values[bucket_count + PROM_METRIC_SAMPLE_HISTOGRAM_SUM],
+                                          prom_metric_sample_histogram_sum(hist_sample));
+      if (r) return r;
+    } else if (metric->type == PROM_NATIVE_HISTOGRAM) {
+      prom_metric_sample_native_histogram_t *native_sample = (prom_metric_sample_native_histogram_t *)samples[i].value;
+      pthread_mutex_lock(&native_sample->lock);
+      uint64_t count = native_sample->count;
+      double sum = native_sample->sum;
+      pthread_mutex_unlock(&native_sample->lock);
+
+      r = prom_metric_formatter_load_line(self, native_sample->l_values[PROM_METRIC_SAMPLE_NATIVE_HISTOGRAM_INF],
+                                          (double)count);
+      if (r) return r;
+      r = prom_metric_formatter_load_line(self, native_sample->l_values[PROM_METRIC_SAMPLE_NATIVE_HISTOGRAM_COUNT],
+                                          (double)count);
+      if (r) return r;
+      r = prom_metric_formatter_load_line(self, native_sample->l_values[PROM_METRIC_SAMPLE_NATIVE_HISTOGRAM_SUM], sum);
+      if (r) return r;
+    } else if (metric->type == PROM_SUMMARY) {
+      prom_metric_sample_summary_t *summary_sample = (prom_metric_sample_summary_t *)samples[i].value;
+      double values[PROM_SUMMARY_MAX_QUANTILES];
+      uint64_t count = 0;
+      double sum = 0.0;
+      r = prom_metric_sample_summary_snapshot(summary_sample, values, &count, &sum);
+      if (r) return r;
 
-      for (prom_linked_list_node_t *current_hist_node = hist_sample->l_value_list->head; current_hist_node != NULL;
-           current_hist_node = current_hist_node->next) {
-        const char *hist_key = (const char *)current_hist_node->item;
-        prom_metric_sample_t *sample = (prom_metric_sample_t *)prom_map_get(hist_sample->samples, hist_key);
-        if (sample == NULL) return 1;
-        r = prom_metric_formatter_load_sample(self, sample);
+      size_t quantile_count = summary_sample->quantile_count;
+      for (size_t j = 0; j < quantile_count; j++) {
+        r = prom_metric_formatter_load_line(self, summary_sample->l_values[j], values[j]);
         if (r) return r;
       }
+      r = prom_metric_formatter_load_line(
+          self, summary_sample->l_values[quantile_count + PROM_METRIC_SAMPLE_SUMMARY_SUM], sum);
+      if (r) return r;
+      r = prom_metric_formatter_load_line(
+          self, summary_sample->l_values[quantile_count + PROM_METRIC_SAMPLE_SUMMARY_COUNT], (double)count);
+      if (r) return r;
     } else {
-      prom_metric_sample_t *sample = (prom_metric_sample_t *)prom_map_get(metric->samples, key);
-      if (sample == NULL) return 1;
-      r = prom_metric_formatter_load_sample(self, sample);
+      r = prom_metric_formatter_load_sample(self, (prom_metric_sample_t *)samples[i].value);
       if (r) return r;
     }
   }
   return prom_string_builder_add_char(self->string_builder, '\n');
 }
 
-int prom_metric_formatter_load_metrics(prom_metric_formatter_t *self, prom_map_t *collectors) {
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// OpenMetrics
+// Reference: https://github.com/OpenObservability/OpenMetrics/blob/main/specification/OpenMetrics.md
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int prom_metric_formatter_add_escaped(prom_string_builder_t *sb, const char *str) {
+  int r = 0;
+  // Copy the runs between characters that need escaping in one go. Most strings have none and take a single append.
+  for (;;) {
+    size_t run = strcspn(str, "\\\n\"");
+    r = prom_string_builder_add_n(sb, str, run);
+    if (r) return r;
+    str += run;
+    if (*str == '\0') return 0;
+    r = prom_string_builder_add_n(sb, *str == '\n' ? "\\n" : *str == '"' ? "\\\"" : "\\\\", 2);
+    if (r) return r;
+    str++;
+  }
+}
+
+// Writes value into buffer, which must hold at least 50 bytes, spelling NaN and the infinities as OpenMetrics does
+static void prom_metric_formatter_double_str(char *buffer, double value) {
+  if (isnan(value)) {
+    strcpy(buffer, "NaN");
+  } else if (isinf(value)) {
+    strcpy(buffer, value > 0 ? "+Inf" : "-Inf");
+  } else {
+    prom_string_builder_format_double(buffer, value);
+  }
+}
+
+static int prom_metric_formatter_add_double(prom_string_builder_t *sb, double value) {
+  if (isnan(value)) return prom_string_builder_add_n(sb, "NaN", 3);
+  if (isinf(value)) return prom_string_builder_add_n(sb, value > 0 ? "+Inf" : "-Inf", 4);
+  return prom_string_builder_add_double(sb, value);
+}
+
+// Appends {k="v",...} for the metric's labels followed by an optional extra label such as le. Nothing is appended
+// when there are no labels at all.
+static int prom_metric_formatter_add_labels(prom_string_builder_t *sb, size_t label_count, const char **label_keys,
+                                            const char **label_values, const char *extra_key,
+                                            const char *extra_value) {
+  int r = 0;
+  if (label_count == 0 && extra_key == NULL) return 0;
+
+  // The closing quote of each value is appended together with the separator or brace that follows it
+  r = prom_string_builder_add_n(sb, "{", 1);
+  if (r) return r;
+  for (size_t i = 0; i < label_count; i++) {
+    r = prom_string_builder_add_str(sb, label_keys[i]);
+    if (r) return r;
+    r = prom_string_builder_add_n(sb, "=\"", 2);
+    if (r) return r;
+    r = prom_metric_formatter_add_escaped(sb, label_values[i]);
+    if (r) return r;
+    r = prom_string_builder_add_n(sb, i + 1 < label_count || extra_key != NULL ? "\"," : "\"}", 2);
+    if (r) return r;
+  }
+  if (extra_key != NULL) {
+    r = prom_string_builder_add_str(sb, extra_key);
+    if (r) return r;
+    r = prom_string_builder_add_n(sb, "=\"", 2);
+    if (r) return r;
+    r = prom_string_builder_add_str(sb, extra_value);
+    if (r) return r;
+    r = prom_string_builder_add_n(sb, "\"}", 2);
+    if (r) return r;
+  }
+  return 0;
+}
+
+// Appends a complete sample line: name_suffix{labels} value[ # exemplar]. The value is already formatted.
+static int prom_metric_formatter_add_openmetrics_str_line(prom_string_builder_t *sb, const char *name,
+                                                          const char *suffix, size_t label_count,
+                                                          const char **label_keys, const char **label_values,
+                                                          const char *extra_key, const char *extra_value,
+                                                          const char *value, prom_metric_exemplar_t *exemplar) {
+  int r = 0;
+  r = prom_string_builder_add_str(sb, name);
+  if (r) return r;
+  if (suffix != NULL) {
+    r = prom_string_builder_add_str(sb, suffix);
+    if (r) return r;
+  }
+  r = prom_metric_formatter_add_labels(sb, label_count, label_keys, label_values, extra_key, extra_value);
+  if (r) return r;
+
+  // The space before the value and, without an exemplar, the newline after it are appended with the value
+  char buffer[PROM_METRIC_FORMATTER_VALUE_SIZE];
+  size_t len = strlen(value);
+  if (len > sizeof(buffer) - 2) return 1;
+  buffer[0] = ' ';
+  memcpy(buffer + 1, value, len);
+  if (exemplar == NULL) buffer[len + 1] = '\n';
+  r = prom_string_builder_add_n(sb, buffer, exemplar == NULL ? len + 2 : len + 1);
+  if (r || exemplar == NULL) return r;
+
+  r = prom_string_builder_add_n(sb, " # {", 4);
+  if (r) return r;
+  const char *label = exemplar->labels;
+  for (size_t i = 0; i < exemplar->label_count; i++) {
+    const char *key = label;
+    const char *val = key + strlen(key) + 1;
+    label = val + strlen(val) + 1;
+    if (i > 0) {
+      r = prom_string_builder_add_n(sb, ",", 1);
+      if (r) return r;
+    }
+    r = prom_string_builder_add_str(sb, key);
+    if (r) return r;
+    r = prom_string_builder_add_n(sb, "=\"", 2);
+    if (r) return r;
+    r = prom_metric_formatter_add_escaped(sb, val);
+    if (r) return r;
+    r = prom_string_builder_add_n(sb, "\"", 1);
+    if (r) return r;
+  }
+  r = prom_string_builder_add_n(sb, "} ", 2);
+  if (r) return r;
+  r = prom_metric_formatter_add_double(sb, exemplar->value);
+  if (r) return r;
+  r = prom_string_builder_add_n(sb, " ", 1);
+  if (r) return r;
+  r = prom_metric_formatter_add_double(sb, exemplar->timestamp);
+  if (r) return r;
+  return prom_string_builder_add_n(sb, "\n", 1);
+}
+
+static int prom_metric_formatter_add_openmetrics_line(prom_string_builder_t *sb, const char *name, const char *suffix,
+                                                      size_t label_count, const char **label_keys,
+                                                      const char **label_values, const char *extra_key,
+                                                      const char *extra_value, double value,
+                                                      prom_metric_exemplar_t *exemplar) {
+  char buffer[50];
+  prom_metric_formatter_double_str(buffer, value);
+  return prom_metric_formatter_add_openmetrics_str_line(sb, name, suffix, label_count, label_keys, label_values,
+                                                        extra_key, extra_value, buffer, exemplar);
+}
+
+int prom_metric_formatter_load_metric_openmetrics(prom_metric_formatter_t *self, prom_metric_t *metric) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+
+  int r = 0;
+  prom_string_builder_t *sb = self->string_builder;
+
+  // The family name of a counter excludes the _total suffix which is added back on its samples
+  size_t family_len = strlen(metric->name);
+  if (metric->type == PROM_COUNTER && family_len > 6 && strcmp(metric->name + family_len - 6, "_total") == 0) {
+    family_len -= 6;
+  }
+  // The family name is copied to the stack unless it is unusually long, so formatting does not allocate
+  char family_buf[PROM_METRIC_FORMATTER_FAMILY_STACK_SIZE];
+  char *family = family_buf;
+  if (family_len >= sizeof(family_buf)) family = (char *)prom_malloc(family_len + 1);
+  memcpy(family, metric->name, family_len);
+  family[family_len] = '\0';
+
+#define PROM_METRIC_FORMATTER_OPENMETRICS_CHECK(expr) \
+  r = (expr);                                         \
+  if (r) {                                            \
+    if (family != family_buf) prom_free(family);      \
+    return r;                                         \
+  }
+
+  PROM_METRIC_FORMATTER_OPENMETRICS_CHECK(prom_string_builder_add_str(sb, "# TYPE "));
+  PROM_METRIC_FORMATTER_OPENMETRICS_CHECK(prom_string_builder_add_str(sb, family));
+  PROM_METRIC_FORMATTER_OPENMETRICS_CHECK(prom_string_builder_add_char(sb, ' '));
+  PROM_METRIC_FORMATTER_OPENMETRICS_CHECK(prom_string_builder_add_str(sb, prom_metric_type_map[metric->type]));
+  PROM_METRIC_FORMATTER_OPENMETRICS_CHECK(prom_string_builder_add_str(sb, "\n# HELP "));
+  PROM_METRIC_FORMATTER_OPENMETRICS_CHECK(prom_string_builder_add_str(sb, family));
+  PROM_METRIC_FORMATTER_OPENMETRICS_CHECK(prom_string_builder_add_char(sb, ' '));
+  PROM_METRIC_FORMATTER_OPENMETRICS_CHECK(prom_metric_formatter_add_escaped(sb, metric->help));
+  PROM_METRIC_FORMATTER_OPENMETRICS_CHECK(prom_string_builder_add_char(sb, '\n'));
+
+  prom_metric_exemplar_t exemplar;
+  size_t sample_count = 0;
+  prom_map_entry_t *samples = prom_map_entries(metric->samples, &sample_count);
+  for (size_t j = 0; j < sample_count; j++) {
+    if (metric->type == PROM_HISTOGRAM) {
+      prom_metric_sample_histogram_t *hist_sample = (prom_metric_sample_histogram_t *)samples[j].value;
+      size_t label_count = hist_sample->label_count;
+      const char **label_values = hist_sample->label_values;
+
+      size_t bucket_count = prom_histogram_buckets_count(hist_sample->buckets);
+      for (size_t i = 0; i < bucket_count; i++) {
+        char le[PROM_METRIC_SAMPLE_HISTOGRAM_BUCKET_STR_SIZE];
+        prom_metric_sample_histogram_bucket_write(le, hist_sample->buckets->upper_bounds[i]);
+        PROM_METRIC_FORMATTER_OPENMETRICS_CHECK(prom_metric_formatter_add_openmetrics_line(
+            sb, family, "_bucket", label_count, metric->label_keys, label_values, "le", le,
+            prom_metric_sample_histogram_cumulative_count(hist_sample, i), NULL));
+      }
+      PROM_METRIC_FORMATTER_OPENMETRICS_CHECK(prom_metric_formatter_add_openmetrics_line(
+          sb, family, "_bucket", label_count, metric->label_keys, label_values, "le", "+Inf",
+          prom_metric_sample_histogram_cumulative_count(hist_sample, bucket_count), NULL));
+      PROM_METRIC_FORMATTER_OPENMETRICS_CHECK(prom_metric_formatter_add_openmetrics_line(
+          sb, family, "_count", label_count, metric->label_keys, label_values, NULL, NULL,
+          prom_metric_sample_histogram_count(hist_sample), NULL));
+      PROM_METRIC_FORMATTER_OPENMETRICS_CHECK(prom_metric_formatter_add_openmetrics_line(
+          sb, family, "_sum", label_count, metric->label_keys, label_values, NULL, NULL,
+          prom_metric_sample_histogram_sum(hist_sample), NULL));
+      PROM_METRIC_FORMATTER_OPENMETRICS_CHECK(prom_metric_formatter_add_openmetrics_line(
+          sb, family, "_created", label_count, metric->label_keys, label_values, NULL, NULL, hist_sample->created,
+          NULL));
+    } else if (metric->type == PROM_NATIVE_HISTOGRAM) {
+      prom_metric_sample_native_histogram_t *native_sample = (prom_metric_sample_native_histogram_t *)samples[j].value;
+      size_t label_count = native_sample->label_count;
+      const char **label_values = native_sample->label_values;
+
+      pthread_mutex_lock(&native_sample->lock);
+      uint64_t count = native_sample->count;
+      double sum = native_sample->sum;
+      pthread_mutex_unlock(&native_sample->lock);
+
+      PROM_METRIC_FORMATTER_OPENMETRICS_CHECK(prom_metric_formatter_add_openmetrics_line(
+          sb, family, "_bucket", label_count, metric->label_keys, label_values, "le", "+Inf", (double)count, NULL));
+      PROM_METRIC_FORMATTER_OPENMETRICS_CHECK(prom_metric_formatter_add_openmetrics_line(
+          sb, family, "_count", label_count, metric->label_keys, label_values, NULL, NULL, (double)count, NULL));
+      PROM_METRIC_FORMATTER_OPENMETRICS_CHECK(prom_metric_formatter_add_openmetrics_line(
+          sb, family, "_sum", label_count, metric->label_keys, label_values, NULL, NULL, sum, NULL));
+      PROM_METRIC_FORMATTER_OPENMETRICS_CHECK(prom_metric_formatter_add_openmetrics_line(
+          sb, family, "_created", label_count, metric->label_keys, label_values, NULL, NULL, native_sample->created,
+          NULL));
+    } else if (metric->type == PROM_SUMMARY) {
+      prom_metric_sample_summary_t *summary_sample = (prom_metric_sample_summary_t *)samples[j].value;
+      size_t label_count = summary_sample->label_count;
+      const char **label_values = summary_sample->label_values;
+
+      double values[PROM_SUMMARY_MAX_QUANTILES];
+      uint64_t count = 0;
+      double sum = 0.0;
+      PROM_METRIC_FORMATTER_OPENMETRICS_CHECK(
+          prom_metric_sample_summary_snapshot(summary_sample, values, &count, &sum));
+      for (size_t i = 0; i < summary_sample->quantile_count; i++) {
+        char quantile[50];
+        snprintf(quantile, sizeof(quantile), "%g", summary_sample->quantiles[i]);
+        PROM_METRIC_FORMATTER_OPENMETRICS_CHECK(prom_metric_formatter_add_openmetrics_line(
+            sb, family, NULL, label_count, metric->label_keys, label_values, "quantile", quantile, values[i], NULL));
+      }
+      PROM_METRIC_FORMATTER_OPENMETRICS_CHECK(prom_metric_formatter_add_openmetrics_line(
+          sb, family, "_count", label_count, metric->label_keys, label_values, NULL, NULL, (double)count, NULL));
+      PROM_METRIC_FORMATTER_OPENMETRICS_CHECK(prom_metric_formatter_add_openmetrics_line(
+          sb, family, "_sum", label_count, metric->label_keys, label_values, NULL, NULL, sum, NULL));
+      PROM_METRIC_FORMATTER_OPENMETRICS_CHECK(prom_metric_formatter_add_openmetrics_line(
+          sb, family, "_created", label_count, metric->label_keys, label_values, NULL, NULL, summary_sample->created,
+          NULL));
+    } else {
+      prom_metric_sample_t *sample = (prom_metric_sample_t *)samples[j].value;
+      char value[50];
+      if (sample->integer) {
+        prom_metric_sample_format_scrape_value(sample, value, sizeof(value));
+      } else {
+        prom_metric_formatter_double_str(value, prom_metric_sample_scrape_value(sample));
+      }
+      if (metric->type == PROM_COUNTER) {
+        bool has_exemplar = prom_metric_sample_exemplar_load(sample, &exemplar) == 0;
+        PROM_METRIC_FORMATTER_OPENMETRICS_CHECK(prom_metric_formatter_add_openmetrics_str_line(
+            sb, family, "_total", sample->label_count, metric->label_keys, sample->label_values, NULL, NULL, value,
+            has_exemplar ? &exemplar : NULL));
+        PROM_METRIC_FORMATTER_OPENMETRICS_CHECK(prom_metric_formatter_add_openmetrics_line(
+            sb, family, "_created", sample->label_count, metric->label_keys, sample->label_values, NULL, NULL,
+            sample->created, NULL));
+      } else {
+        PROM_METRIC_FORMATTER_OPENMETRICS_CHECK(prom_metric_formatter_add_openmetrics_str_line(
+            sb, family, NULL, sample->label_count, metric->label_keys, sample->label_values, NULL, NULL, value,
+            NULL));
+      }
+    }
+  }
+  if (family != family_buf) prom_free(family);
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Protobuf
+// Reference: https://github.com/prometheus/client_model/blob/master/io/prometheus/client/metrics.proto
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static size_t prom_metric_formatter_label_pair_size(const char *name, const char *value) {
+  return prom_protobuf_string_field_size(1, name) + prom_protobuf_string_field_size(2, value);
+}
+
+// Appends a LabelPair message as the given field
+static int prom_metric_formatter_add_label_pair(prom_string_builder_t *sb, uint32_t field, const char *name,
+                                                const char *value) {
+  int r = 0;
+  r = prom_protobuf_add_message_header(sb, field, prom_metric_formatter_label_pair_size(name, value));
+  if (r) return r;
+  r = prom_protobuf_add_string_field(sb, 1, name);
+  if (r) return r;
+  return prom_protobuf_add_string_field(sb, 2, value);
+}
+
+// Appends an Exemplar message as the given field
+static int prom_metric_formatter_add_exemplar(prom_string_builder_t *sb, uint32_t field,
+                                              prom_metric_exemplar_t *exemplar) {
+  int r = 0;
+  size_t len = prom_protobuf_double_field_size(2) + prom_protobuf_timestamp_field_size(3, exemplar->timestamp);
+  const char *label = exemplar->labels;
+  for (size_t i = 0; i < exemplar->label_count; i++) {
+    const char *key = label;
+    const char *val = key + strlen(key) + 1;
+    label = val + strlen(val) + 1;
+    len += prom_protobuf_len_field_size(1, prom_metric_formatter_label_pair_size(key, val));
+  }
+
+  r = prom_protobuf_add_message_header(sb, field, len);
+  if (r) return r;
+  label = exemplar->labels;
+  for (size_t i = 0; i < exemplar->label_count; i++) {
+    const char *key = label;
+    const char *val = key + strlen(key) + 1;
+    label = val + strlen(val) + 1;
+    r = prom_metric_formatter_add_label_pair(sb, 1, key, val);
+    if (r) return r;
+  }
+  r = prom_protobuf_add_double_field(sb, 2, exemplar->value);
+  if (r) return r;
+  return prom_protobuf_add_timestamp_field(sb, 3, exemplar->timestamp);
+}
+
+// Appends the content of scratch to sb as an embedded message field
+static int prom_metric_formatter_add_builder_field(prom_string_builder_t *sb, uint32_t field,
+                                                   prom_string_builder_t *scratch) {
+  size_t len = 0;
+  const char *data = prom_string_builder_view(scratch, &len);
+  return prom_protobuf_add_bytes_field(sb, field, data, len);
+}
+
+static int prom_metric_formatter_ensure_protobuf_builders(prom_metric_formatter_t *self) {
+  if (self->family_builder == NULL) self->family_builder = prom_string_builder_new();
+  if (self->metric_builder == NULL) self->metric_builder = prom_string_builder_new();
+  if (self->value_builder == NULL) self->value_builder = prom_string_builder_new();
+  if (self->family_builder == NULL || self->metric_builder == NULL || self->value_builder == NULL) return 1;
+  return 0;
+}
+
+// Appends BucketSpan { sint32 offset = 1; uint32 length = 2; } messages to span_field for every run of consecutive
+// indices, then the counts as packed deltas to delta_field. The first delta is the first count itself.
+static int prom_metric_formatter_add_native_buckets(prom_string_builder_t *sb, uint32_t span_field,
+                                                    uint32_t delta_field, prom_native_histogram_buckets_t *buckets) {
+  int r = 0;
+  if (buckets->count == 0) return 0;
+
+  size_t start = 0;
+  int32_t previous = 0;
+  for (size_t i = 1; i <= buckets->count; i++) {
+    if (i < buckets->count && buckets->indices[i] == buckets->indices[i - 1] + 1) continue;
+    // The first span is offset from index 0, later ones from the end of the previous span
+    int64_t offset = start == 0 ? buckets->indices[0] : (int64_t)buckets->indices[start] - previous - 1;
+    uint64_t length = i - start;
+    uint64_t zigzag = prom_protobuf_zigzag(offset);
+    r = prom_protobuf_add_message_header(
+        sb, span_field, prom_protobuf_varint_field_size(1, zigzag) + prom_protobuf_varint_field_size(2, length));
+    if (r) return r;
+    r = prom_protobuf_add_varint_field(sb, 1, zigzag);
+    if (r) return r;
+    r = prom_protobuf_add_varint_field(sb, 2, length);
+    if (r) return r;
+    previous = buckets->indices[i - 1];
+    start = i;
+  }
+
+  size_t len = 0;
+  for (size_t i = 0; i < buckets->count; i++) {
+    int64_t delta = (int64_t)buckets->counts[i] - (i > 0 ? (int64_t)buckets->counts[i - 1] : 0);
+    len += prom_protobuf_varint_size(prom_protobuf_zigzag(delta));
+  }
+  r = prom_protobuf_add_message_header(sb, delta_field, len);
+  if (r) return r;
+  for (size_t i = 0; i < buckets->count; i++) {
+    int64_t delta = (int64_t)buckets->counts[i] - (i > 0 ? (int64_t)buckets->counts[i - 1] : 0);
+    r = prom_protobuf_add_varint(sb, prom_protobuf_zigzag(delta));
+    if (r) return r;
+  }
+  return 0;
+}
+
+// Appends the fields of a native Histogram message. The caller holds the sample lock.
+static int prom_metric_formatter_add_native_histogram(prom_string_builder_t *v,
+                                                      prom_metric_sample_native_histogram_t *sample) {
+  int r = 0;
+
+  // Histogram { sample_count = 1; sample_sum = 2; schema = 5; zero_threshold = 6; zero_count = 7;
+  //             negative_span = 9; negative_delta = 10; positive_span = 12; positive_delta = 13;
+  //             created_timestamp = 15; }
+  r = prom_protobuf_add_varint_field(v, 1, sample->count);
+  if (r) return r;
+  r = prom_protobuf_add_double_field(v, 2, sample->sum);
+  if (r) return r;
+  r = prom_protobuf_add_sint_field(v, 5, sample->schema);
+  if (r) return r;
+  r = prom_protobuf_add_double_field(v, 6, sample->zero_threshold);
+  if (r) return r;
+  r = prom_protobuf_add_varint_field(v, 7, sample->zero_count);
+  if (r) return r;
+  r = prom_metric_formatter_add_native_buckets(v, 9, 10, &sample->negative);
+  if (r) return r;
+  r = prom_metric_formatter_add_native_buckets(v, 12, 13, &sample->positive);
+  if (r) return r;
+  return prom_protobuf_add_timestamp_field(v, 15, sample->created);
+}
+
+int prom_metric_formatter_load_metric_protobuf(prom_metric_formatter_t *self, prom_metric_t *metric) {
   PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+
   int r = 0;
-  for (prom_linked_list_node_t *current_node = collectors->keys->head; current_node != NULL;
-       current_node = current_node->next) {
-    const char *collector_name = (const char *)current_node->item;
-    prom_collector_t *collector = (prom_collector_t *)prom_map_get(collectors, collector_name);
-    if (collector == NULL) return 1;
+  r = prom_metric_formatter_ensure_protobuf_builders(self);
+  if (r) return r;
+
+  prom_string_builder_t *family = self->family_builder;
+  prom_string_builder_t *m = self->metric_builder;
+  prom_string_builder_t *v = self->value_builder;
+
+  // MetricFamily { name = 1; help = 2; type = 3; metric = 4; }
+  r = prom_string_builder_truncate(family, 0);
+  if (r) return r;
+  r = prom_protobuf_add_string_field(family, 1, metric->name);
+  if (r) return r;
+  r = prom_protobuf_add_string_field(family, 2, metric->help);
+  if (r) return r;
+  r = prom_protobuf_add_varint_field(family, 3, prom_metric_formatter_protobuf_type_map[metric->type]);
+  if (r) return r;
+
+  prom_metric_exemplar_t exemplar;
+  size_t sample_count = 0;
+  prom_map_entry_t *samples = prom_map_entries(metric->samples, &sample_count);
+  for (size_t j = 0; j < sample_count; j++) {
+    size_t label_count = 0;
+    const char **label_values = NULL;
+    prom_metric_sample_t *sample = NULL;
+    prom_metric_sample_histogram_t *hist_sample = NULL;
 
+    r = prom_string_builder_truncate(v, 0);
+    if (r) return r;
+
+    if (metric->type == PROM_HISTOGRAM) {
+      hist_sample = (prom_metric_sample_histogram_t *)samples[j].value;
+      label_count = hist_sample->label_count;
+      label_values = hist_sample->label_values;
+
+      // Histogram { sample_count = 1; sample_sum = 2; bucket = 3; created_timestamp = 15; }
+      // The +Inf bucket is implied by sample_count.
+      r = prom_protobuf_add_varint_field(v, 1, (uint64_t)prom_metric_sample_histogram_count(hist_sample));
+      if (r) return r;
+      r = prom_protobuf_add_double_field(v, 2, prom_metric_sample_histogram_sum(hist_sample));
+      if (r) return r;
+      size_t bucket_count = prom_histogram_buckets_count(hist_sample->buckets);
+      for (size_t i = 0; i < bucket_count; i++) {
+        // Bucket { cumulative_count = 1; upper_bound = 2; }
+        uint64_t cumulative = (uint64_t)prom_metric_sample_histogram_cumulative_count(hist_sample, i);
+        size_t len = prom_protobuf_varint_field_size(1, cumulative) + prom_protobuf_double_field_size(2);
+        r = prom_protobuf_add_message_header(v, 3, len);
+        if (r) return r;
+        r = prom_protobuf_add_varint_field(v, 1, cumulative);
+        if (r) return r;
+        r = prom_protobuf_add_double_field(v, 2, hist_sample->buckets->upper_bounds[i]);
+        if (r) return r;
+      }
+      r = prom_protobuf_add_timestamp_field(v, 15, hist_sample->created);
+      if (r) return r;
+    } else if (metric->type == PROM_NATIVE_HISTOGRAM) {
+      prom_metric_sample_native_histogram_t *native_sample = (prom_metric_sample_native_histogram_t *)samples[j].value;
+      label_count = native_sample->label_count;
+      label_values = native_sample->label_values;
+
+      pthread_mutex_lock(&native_sample->lock);
+      r = prom_metric_formatter_add_native_histogram(v, native_sample);
+      pthread_mutex_unlock(&native_sample->lock);
+      if (r) return r;
+    } else if (metric->type == PROM_SUMMARY) {
+      prom_metric_sample_summary_t *summary_sample = (prom_metric_sample_summary_t *)samples[j].value;
+      label_count = summary_sample->label_count;
+      label_values = summary_sample->label_values;
+
+      double values[PROM_SUMMARY_MAX_QUANTILES];
+      uint64_t count = 0;
+      double sum = 0.0;
+      r = prom_metric_sample_summary_snapshot(summary_sample, values, &count, &sum);
+      if (r) return r;
+
+      // Summary { sample_count = 1; sample_sum = 2; quantile = 3; created_timestamp = 4; }
+      r = prom_protobuf_add_varint_field(v, 1, count);
+      if (r) return r;
+      r = prom_protobuf_add_double_field(v, 2, sum);
+      if (r) return r;
+      for (size_t i = 0; i < summary_sample->quantile_count; i++) {
+        // Quantile { quantile = 1; value = 2; }
+        r = prom_protobuf_add_message_header(v, 3, 2 * prom_protobuf_double_field_size(1));
+        if (r) return r;
+        r = prom_protobuf_add_double_field(v, 1, summary_sample->quantiles[i]);
+        if (r) return r;
+        r = prom_protobuf_add_double_field(v, 2, values[i]);
+        if (r) return r;
+      }
+      r = prom_protobuf_add_timestamp_field(v, 4, summary_sample->created);
+      if (r) return r;
+    } else {
+      sample = (prom_metric_sample_t *)samples[j].value;
+      label_count = sample->label_count;
+      label_values = sample->label_values;
+
+      // Gauge { value = 1; } Counter { value = 1; exemplar = 2; created_timestamp = 3; }
+      r = prom_protobuf_add_double_field(v, 1, prom_metric_sample_scrape_value(sample));
+      if (r) return r;
+      if (metric->type == PROM_COUNTER) {
+        if (prom_metric_sample_exemplar_load(sample, &exemplar) == 0) {
+          r = prom_metric_formatter_add_exemplar(v, 2, &exemplar);
+          if (r) return r;
+        }
+        r = prom_protobuf_add_timestamp_field(v, 3, sample->created);
+        if (r) return r;
+      }
+    }
+
+    // Metric { label = 1; gauge = 2; counter = 3; summary = 4; histogram = 7; }
+    r = prom_string_builder_truncate(m, 0);
+    if (r) return r;
+    for (size_t i = 0; i < label_count; i++) {
+      r = prom_metric_formatter_add_label_pair(m, 1, metric->label_keys[i], label_values[i]);
+      if (r) return r;
+    }
+    uint32_t value_field = metric->type == PROM_HISTOGRAM || metric->type == PROM_NATIVE_HISTOGRAM ? 7
+                           : metric->type == PROM_SUMMARY                                        ? 4
+                           : metric->type == PROM_COUNTER ? 3
+                                                          : 2;
+    r = prom_metric_formatter_add_builder_field(m, value_field, v);
+    if (r) return r;
+
+    r = prom_metric_formatter_add_builder_field(family, 4, m);
+    if (r) return r;
+  }
+
+  // Each MetricFamily is prefixed with its length
+  size_t len = 0;
+  const char *data = prom_string_builder_view(family, &len);
+  r = prom_protobuf_add_varint(self->string_builder, len);
+  if (r) return r;
+  return prom_string_builder_add_n(self->string_builder, data, len);
+}
+
+int prom_metric_formatter_set_format(prom_metric_formatter_t *self, prom_exposition_format_t format) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  self->format = format;
+  return 0;
+}
+
+size_t prom_metric_formatter_len(prom_metric_formatter_t *self) {
+  PROM_ASSERT(self != NULL);
+  return prom_string_builder_len(self->string_builder);
+}
+
+const char *prom_metric_formatter_str(prom_metric_formatter_t *self) {
+  PROM_ASSERT(self != NULL);
+  return prom_string_builder_view(self->string_builder, NULL);
+}
+
+static int prom_metric_formatter_load_metrics_internal(prom_metric_formatter_t *self, prom_map_t *collectors) {
+  int r = 0;
+  size_t collector_count = 0;
+  prom_map_entry_t *collector_entries = prom_map_entries(collectors, &collector_count);
+  for (size_t i = 0; i < collector_count; i++) {
+    prom_collector_t *collector = (prom_collector_t *)collector_entries[i].value;
     prom_map_t *metrics = collector->collect_fn(collector);
     if (metrics == NULL) return 1;
 
-    for (prom_linked_list_node_t *current_node = metrics->keys->head; current_node != NULL;
-         current_node = current_node->next) {
-      const char *metric_name = (const char *)current_node->item;
-      prom_metric_t *metric = (prom_metric_t *)prom_map_get(metrics, metric_name);
-      if (metric == NULL) return 1;
-      r = prom_metric_formatter_load_metric(self, metric);
+    size_t metric_count = 0;
+    prom_map_entry_t *metric_entries = prom_map_entries(metrics, &metric_count);
+    for (size_t j = 0; j < metric_count; j++) {
+      prom_metric_t *metric = (prom_metric_t *)metric_entries[j].value;
+      // The first metric of a group to be rendered reads the whole group, so its metrics show the same commit
+      if (metric->group != NULL) prom_group_snapshot(metric->group, self->scrape);
+      switch (self->format) {
+        case PROM_EXPOSITION_OPENMETRICS:
+          r = prom_metric_formatter_load_metric_openmetrics(self, metric);
+          break;
+        case PROM_EXPOSITION_PROTOBUF:
+          r = prom_metric_formatter_load_metric_protobuf(self, metric);
+          break;
+        default:
+          r = prom_metric_formatter_load_metric(self, metric);
+          break;
+      }
       if (r) return r;
     }
   }
+  if (self->format == PROM_EXPOSITION_OPENMETRICS) {
+    r = prom_string_builder_add_str(self->string_builder, "# EOF\n");
+  }
+  return r;
+}
+
+int prom_metric_formatter_load_metrics(prom_metric_formatter_t *self, prom_map_t *collectors) {
+  PROM_ASSERT(self != NULL);
+  // The entries of every map are iterated in place, so the whole scrape is one epoch critical section
+  prom_epoch_enter();
+  self->scrape = prom_group_next_scrape();
+  int r = prom_metric_formatter_load_metrics_internal(self, collectors);
+  prom_epoch_exit();
   return r;
 }
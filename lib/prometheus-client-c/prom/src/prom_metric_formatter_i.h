@@ -56,6 +56,14 @@ int prom_metric_formatter_load_type(prom_metric_formatter_t *self, const char *n
 int prom_metric_formatter_load_l_value(prom_metric_formatter_t *metric_formatter, const char *name, const char *suffix,
                                        size_t label_count, const char **label_keys, const char **label_values);
 
+/**
+ * @brief API PRIVATE Writes the same L-value as prom_metric_formatter_load_l_value without a suffix into buf.
+ *
+ * Like snprintf, this returns the length of the L-value and writes it, terminated, only if it fits in size bytes.
+ */
+size_t prom_metric_formatter_write_l_value(char *buf, size_t size, const char *name, size_t label_count,
+                                           const char **label_keys, const char **label_values);
+
 /**
  * @brief API PRIVATE Loads the formatter with a metric sample
  */
@@ -67,10 +75,36 @@ int prom_metric_formatter_load_sample(prom_metric_formatter_t *metric_formatter,
 int prom_metric_formatter_load_metric(prom_metric_formatter_t *self, prom_metric_t *metric);
 
 /**
- * @brief API PRIVATE Loads the given metrics
+ * @brief API PRIVATE Loads a metric in the OpenMetrics text format
+ */
+int prom_metric_formatter_load_metric_openmetrics(prom_metric_formatter_t *self, prom_metric_t *metric);
+
+/**
+ * @brief API PRIVATE Loads a metric as a length-delimited protobuf MetricFamily
+ */
+int prom_metric_formatter_load_metric_protobuf(prom_metric_formatter_t *self, prom_metric_t *metric);
+
+/**
+ * @brief API PRIVATE Sets the exposition format used by prom_metric_formatter_load_metrics
+ */
+int prom_metric_formatter_set_format(prom_metric_formatter_t *self, prom_exposition_format_t format);
+
+/**
+ * @brief API PRIVATE Loads the given metrics in the formatter's exposition format
  */
 int prom_metric_formatter_load_metrics(prom_metric_formatter_t *self, prom_map_t *collectors);
 
+/**
+ * @brief API PRIVATE Returns the number of bytes loaded into the formatter
+ */
+size_t prom_metric_formatter_len(prom_metric_formatter_t *self);
+
+/**
+ * @brief API PRIVATE Returns the bytes loaded into the formatter without copying them. They stay valid until the
+ * formatter is next loaded or cleared.
+ */
+const char *prom_metric_formatter_str(prom_metric_formatter_t *self);
+
 /**
  * @brief API PRIVATE Clear the underlying string_builder
  */
@@ -17,11 +17,22 @@
 #ifndef PROM_METRIC_FORMATTER_T_H
 #define PROM_METRIC_FORMATTER_T_H
 
+#include <stdint.h>
+
+// Public
+#include "prom_collector_registry.h"
+
+// Private
 #include "prom_string_builder_t.h"
 
 typedef struct prom_metric_formatter {
   prom_string_builder_t *string_builder;
   prom_string_builder_t *err_builder;
+  prom_exposition_format_t format;       /**< format selects the output of prom_metric_formatter_load_metrics */
+  prom_string_builder_t *family_builder; /**< protobuf scratch space for a MetricFamily. Allocated on first use. */
+  prom_string_builder_t *metric_builder; /**< protobuf scratch space for a Metric. Allocated on first use. */
+  prom_string_builder_t *value_builder;  /**< protobuf scratch space for a metric value. Allocated on first use. */
+  uint64_t scrape;                       /**< scrape identifies the current prom_metric_formatter_load_metrics call */
 } prom_metric_formatter_t;
 
 #endif  // PROM_METRIC_FORMATTER_T_H
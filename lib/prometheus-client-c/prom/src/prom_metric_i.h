@@ -42,4 +42,35 @@ int prom_metric_destroy_generic(void *item);
  */
 void prom_metric_free_generic(void *item);
 
+/**
+ * @brief API PRIVATE Returns the sample of label_values for a single update, creating it if the metric has room.
+ *
+ * Unlike prom_metric_sample_from_labels the sample is not pinned, so prom_metric_sweep may evict it once it goes
+ * unused. Call this inside a prom_epoch critical section and do not use the sample after leaving it.
+ */
+prom_metric_sample_t *prom_metric_sample_for_update(prom_metric_t *self, const char **label_values);
+
+/**
+ * @brief API PRIVATE The histogram counterpart of prom_metric_sample_for_update
+ */
+prom_metric_sample_histogram_t *prom_metric_sample_histogram_for_update(prom_metric_t *self,
+                                                                        const char **label_values);
+
+/**
+ * @brief API PRIVATE The summary counterpart of prom_metric_sample_for_update
+ */
+prom_metric_sample_summary_t *prom_metric_sample_summary_for_update(prom_metric_t *self, const char **label_values);
+
+/**
+ * @brief API PRIVATE The native histogram counterpart of prom_metric_sample_for_update
+ */
+prom_metric_sample_native_histogram_t *prom_metric_sample_native_histogram_for_update(prom_metric_t *self,
+                                                                                      const char **label_values);
+
+/**
+ * @brief API PRIVATE Evicts the samples that have gone series_ttl sweeps without an update, then starts a new sweep
+ * interval. Returns the number of samples evicted.
+ */
+size_t prom_metric_sweep(prom_metric_t *self);
+
 #endif  // PROM_METRIC_I_INCLUDED
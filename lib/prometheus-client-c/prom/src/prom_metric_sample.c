@@ -14,7 +14,12 @@
  * limitations under the License.
  */
 
+#include <inttypes.h>
 #include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
 
 // Public
 #include "prom_alloc.h"
@@ -25,20 +30,158 @@
 #include "prom_log.h"
 #include "prom_metric_sample_i.h"
 #include "prom_metric_sample_t.h"
+#include "prom_string_builder_i.h"
 
 prom_metric_sample_t *prom_metric_sample_new(prom_metric_type_t type, const char *l_value, double r_value) {
   prom_metric_sample_t *self = (prom_metric_sample_t *)prom_malloc(sizeof(prom_metric_sample_t));
   self->type = type;
-  self->l_value = prom_strdup(l_value);
+  self->l_value = prom_intern(l_value);
   self->r_value = ATOMIC_VAR_INIT(r_value);
+  self->label_values = NULL;
+  self->label_count = 0;
+  self->created = prom_metric_sample_now();
+  atomic_init(&self->exemplar, NULL);
+  self->shards = NULL;
+  self->shards_block = NULL;
+  self->integer = false;
+  atomic_init(&self->i_value, 0);
+  self->group = NULL;
+  memcpy(&self->snapshots[0], &r_value, sizeof(double));
+  for (size_t i = 1; i < PROM_GROUP_SLOTS; i++) self->snapshots[i] = self->snapshots[0];
   return self;
 }
 
+// The next cell to hand to a thread that adds to a sharded sample for the first time, and the cell of this thread
+static _Atomic size_t prom_metric_sample_next_shard = 0;
+static _Thread_local size_t prom_metric_sample_shard = SIZE_MAX;
+
+static inline size_t prom_metric_sample_shard_index(void) {
+  if (prom_metric_sample_shard == SIZE_MAX) {
+    prom_metric_sample_shard =
+        atomic_fetch_add_explicit(&prom_metric_sample_next_shard, 1, memory_order_relaxed) % PROM_METRIC_SAMPLE_SHARDS;
+  }
+  return prom_metric_sample_shard;
+}
+
+int prom_metric_sample_enable_shards(prom_metric_sample_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self->type != PROM_COUNTER) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  // prom_malloc makes no alignment promise beyond max_align_t, so over-allocate by a line and align within the block
+  size_t size = sizeof(prom_metric_sample_shard_t) * PROM_METRIC_SAMPLE_SHARDS;
+  self->shards_block = prom_malloc(size + PROM_METRIC_SAMPLE_CACHE_LINE);
+  if (self->shards_block == NULL) return 1;
+  uintptr_t aligned = ((uintptr_t)self->shards_block + PROM_METRIC_SAMPLE_CACHE_LINE - 1) &
+                      ~(uintptr_t)(PROM_METRIC_SAMPLE_CACHE_LINE - 1);
+  self->shards = (prom_metric_sample_shard_t *)aligned;
+  for (size_t i = 0; i < PROM_METRIC_SAMPLE_SHARDS; i++) atomic_init(&self->shards[i].value, 0.0);
+  return 0;
+}
+
+double prom_metric_sample_value(prom_metric_sample_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self->integer) {
+    uint64_t value = atomic_load_explicit(&self->i_value, memory_order_relaxed);
+    return self->type == PROM_COUNTER ? (double)value : (double)(int64_t)value;
+  }
+  double value = atomic_load(&self->r_value);
+  if (self->shards == NULL) return value;
+  for (size_t i = 0; i < PROM_METRIC_SAMPLE_SHARDS; i++) {
+    value += atomic_load_explicit(&self->shards[i].value, memory_order_relaxed);
+  }
+  return value;
+}
+
+double prom_metric_sample_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Returns the value of the sample as i_value holds it for integer samples, or as the bits of the double otherwise.
+// Scrapes of a grouped sample read the group's current snapshot instead of the live value.
+static uint64_t prom_metric_sample_bits(prom_metric_sample_t *self, bool scrape) {
+  if (scrape && self->group != NULL) return self->snapshots[self->group->slot];
+  if (self->integer) return atomic_load_explicit(&self->i_value, memory_order_relaxed);
+  double value = prom_metric_sample_value(self);
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+static size_t prom_metric_sample_format_bits(prom_metric_sample_t *self, uint64_t value, char *buf, size_t size) {
+  double r_value;
+  if (!self->integer) memcpy(&r_value, &value, sizeof(r_value));
+  if (size < PROM_STRING_BUILDER_DOUBLE_SIZE) {
+    if (!self->integer) return (size_t)snprintf(buf, size, "%.17g", r_value);
+    if (self->type == PROM_COUNTER) return (size_t)snprintf(buf, size, "%" PRIu64, value);
+    return (size_t)snprintf(buf, size, "%" PRId64, (int64_t)value);
+  }
+
+  // Every value fits, so the digits are written directly rather than through snprintf
+  if (!self->integer) return prom_string_builder_format_double(buf, r_value);
+  if (self->type == PROM_COUNTER || (int64_t)value >= 0) return prom_string_builder_format_u64(buf, value);
+  buf[0] = '-';
+  return prom_string_builder_format_u64(buf + 1, -value) + 1;
+}
+
+size_t prom_metric_sample_format_value(prom_metric_sample_t *self, char *buf, size_t size) {
+  PROM_ASSERT(self != NULL);
+  return prom_metric_sample_format_bits(self, prom_metric_sample_bits(self, false), buf, size);
+}
+
+size_t prom_metric_sample_format_scrape_value(prom_metric_sample_t *self, char *buf, size_t size) {
+  PROM_ASSERT(self != NULL);
+  return prom_metric_sample_format_bits(self, prom_metric_sample_bits(self, true), buf, size);
+}
+
+double prom_metric_sample_scrape_value(prom_metric_sample_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self->group == NULL) return prom_metric_sample_value(self);
+  uint64_t value = prom_metric_sample_bits(self, true);
+  if (self->integer) return self->type == PROM_COUNTER ? (double)value : (double)(int64_t)value;
+  double r_value;
+  memcpy(&r_value, &value, sizeof(r_value));
+  return r_value;
+}
+
+void prom_metric_sample_snapshot(prom_metric_sample_t *self, size_t slot) {
+  PROM_ASSERT(self != NULL);
+  self->snapshots[slot] = prom_metric_sample_bits(self, false);
+}
+
+int prom_metric_sample_set_label_values(prom_metric_sample_t *self, size_t label_count, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  if (label_count == 0) return 0;
+  const char **v = (const char **)prom_malloc(sizeof(const char *) * label_count);
+  for (size_t i = 0; i < label_count; i++) {
+    v[i] = prom_intern(label_values[i]);
+  }
+  self->label_values = v;
+  self->label_count = label_count;
+  return 0;
+}
+
 int prom_metric_sample_destroy(prom_metric_sample_t *self) {
   PROM_ASSERT(self != NULL);
   if (self == NULL) return 0;
-  prom_free((void *)self->l_value);
+  prom_intern_release(self->l_value);
   self->l_value = NULL;
+  for (size_t i = 0; i < self->label_count; i++) {
+    prom_intern_release(self->label_values[i]);
+  }
+  prom_free((void *)self->label_values);
+  self->label_values = NULL;
+  prom_metric_exemplar_t *exemplar = atomic_load(&self->exemplar);
+  if (exemplar != NULL) {
+    pthread_mutex_destroy(&exemplar->lock);
+    prom_free(exemplar);
+  }
+  prom_free(self->shards_block);
+  self->shards = NULL;
+  self->shards_block = NULL;
   prom_free((void *)self);
   self = NULL;
   return 0;
@@ -58,15 +201,44 @@ void prom_metric_sample_free_generic(void *gen) {
   prom_metric_sample_destroy(self);
 }
 
+// Truncates r_value toward zero into the representation of an integer sample: a uint64_t for counters and an int64_t
+// for gauges. Converting NaN, an infinity or a value outside that range is undefined, so those fail instead.
+static int prom_metric_sample_integer(prom_metric_sample_t *self, double r_value, uint64_t *value) {
+  // 2^64 and 2^63 are exact as doubles, so the comparisons are exact too
+  if (self->type == PROM_COUNTER) {
+    if (!(r_value >= 0.0 && r_value < 18446744073709551616.0)) {
+      PROM_LOG(PROM_METRIC_INTEGER_RANGE_ERROR);
+      return 1;
+    }
+    *value = (uint64_t)r_value;
+    return 0;
+  }
+  if (!(r_value >= -9223372036854775808.0 && r_value < 9223372036854775808.0)) {
+    PROM_LOG(PROM_METRIC_INTEGER_RANGE_ERROR);
+    return 1;
+  }
+  *value = (uint64_t)(int64_t)r_value;
+  return 0;
+}
+
 int prom_metric_sample_add(prom_metric_sample_t *self, double r_value) {
   PROM_ASSERT(self != NULL);
   if (r_value < 0) {
     return 1;
   }
-  _Atomic double old = atomic_load(&self->r_value);
+  if (self->integer) {
+    uint64_t value = 0;
+    if (prom_metric_sample_integer(self, r_value, &value)) return 1;
+    atomic_fetch_add_explicit(&self->i_value, value, memory_order_relaxed);
+    return 0;
+  }
+  // A sharded sample takes the increment in this thread's cell, which no other thread touches until they outnumber
+  // the cells, so the compare and swap below rarely retries
+  _Atomic double *cell = self->shards != NULL ? &self->shards[prom_metric_sample_shard_index()].value : &self->r_value;
+  _Atomic double old = atomic_load(cell);
   for (;;) {
     _Atomic double new = ATOMIC_VAR_INIT(old + r_value);
-    if (atomic_compare_exchange_weak(&self->r_value, &old, new)) {
+    if (atomic_compare_exchange_weak(cell, &old, new)) {
       return 0;
     }
   }
@@ -78,6 +250,12 @@ int prom_metric_sample_sub(prom_metric_sample_t *self, double r_value) {
     PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
     return 1;
   }
+  if (self->integer) {
+    uint64_t value = 0;
+    if (prom_metric_sample_integer(self, r_value, &value)) return 1;
+    atomic_fetch_sub_explicit(&self->i_value, value, memory_order_relaxed);
+    return 0;
+  }
   _Atomic double old = atomic_load(&self->r_value);
   for (;;) {
     _Atomic double new = ATOMIC_VAR_INIT(old - r_value);
@@ -92,6 +270,118 @@ int prom_metric_sample_set(prom_metric_sample_t *self, double r_value) {
     PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
     return 1;
   }
-  atomic_store(&self->r_value, r_value);
+  // Nothing is published along with the value, so the store needs no ordering
+  if (self->integer) {
+    uint64_t value = 0;
+    if (prom_metric_sample_integer(self, r_value, &value)) return 1;
+    atomic_store_explicit(&self->i_value, value, memory_order_relaxed);
+  } else {
+    atomic_store_explicit(&self->r_value, r_value, memory_order_relaxed);
+  }
+  return 0;
+}
+
+int prom_metric_sample_add_u64(prom_metric_sample_t *self, uint64_t value) {
+  PROM_ASSERT(self != NULL);
+  if (self->type != PROM_COUNTER && self->type != PROM_GAUGE) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  if (!self->integer) return prom_metric_sample_add(self, (double)value);
+  atomic_fetch_add_explicit(&self->i_value, value, memory_order_relaxed);
+  return 0;
+}
+
+int prom_metric_sample_add_i64(prom_metric_sample_t *self, int64_t value) {
+  PROM_ASSERT(self != NULL);
+  if (self->type != PROM_GAUGE) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  if (!self->integer) {
+    return value < 0 ? prom_metric_sample_sub(self, -(double)value) : prom_metric_sample_add(self, (double)value);
+  }
+  // Unsigned addition wraps the same way two's complement addition does
+  atomic_fetch_add_explicit(&self->i_value, (uint64_t)value, memory_order_relaxed);
+  return 0;
+}
+
+int prom_metric_sample_set_i64(prom_metric_sample_t *self, int64_t value) {
+  PROM_ASSERT(self != NULL);
+  if (self->type != PROM_GAUGE) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  if (!self->integer) return prom_metric_sample_set(self, (double)value);
+  atomic_store_explicit(&self->i_value, (uint64_t)value, memory_order_relaxed);
+  return 0;
+}
+
+int prom_metric_sample_add_with_exemplar(prom_metric_sample_t *self, double r_value, size_t label_count,
+                                         const char **label_keys, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  if (self->type != PROM_COUNTER) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  if (r_value < 0) return 1;
+
+  // Validate the exemplar before touching the sample so that a rejected exemplar leaves the counter unchanged. Each pair
+  // is packed with two terminators, which count against the buffer but not against the OpenMetrics limit.
+  size_t chars = 0;
+  for (size_t i = 0; i < label_count; i++) {
+    chars += strlen(label_keys[i]) + strlen(label_values[i]);
+  }
+  if (chars > PROM_METRIC_EXEMPLAR_LABELS_MAX || chars + 2 * label_count > 2 * PROM_METRIC_EXEMPLAR_LABELS_MAX) {
+    PROM_LOG(PROM_METRIC_EXEMPLAR_TOO_LONG);
+    return 1;
+  }
+
+  prom_metric_exemplar_t *exemplar = atomic_load(&self->exemplar);
+  if (exemplar == NULL) {
+    prom_metric_exemplar_t *fresh = (prom_metric_exemplar_t *)prom_malloc(sizeof(prom_metric_exemplar_t));
+    memset(fresh, 0, sizeof(prom_metric_exemplar_t));
+    pthread_mutex_init(&fresh->lock, NULL);
+    if (atomic_compare_exchange_strong(&self->exemplar, &exemplar, fresh)) {
+      exemplar = fresh;
+    } else {
+      // Another thread installed one first; exemplar now holds it
+      pthread_mutex_destroy(&fresh->lock);
+      prom_free(fresh);
+    }
+  }
+
+  int r = prom_metric_sample_add(self, r_value);
+  if (r) return r;
+
+  pthread_mutex_lock(&exemplar->lock);
+  size_t pos = 0;
+  for (size_t i = 0; i < label_count; i++) {
+    size_t klen = strlen(label_keys[i]) + 1;
+    size_t vlen = strlen(label_values[i]) + 1;
+    memcpy(exemplar->labels + pos, label_keys[i], klen);
+    pos += klen;
+    memcpy(exemplar->labels + pos, label_values[i], vlen);
+    pos += vlen;
+  }
+  exemplar->label_count = label_count;
+  exemplar->labels_len = pos;
+  exemplar->value = r_value;
+  exemplar->timestamp = prom_metric_sample_now();
+  pthread_mutex_unlock(&exemplar->lock);
+  return 0;
+}
+
+int prom_metric_sample_exemplar_load(prom_metric_sample_t *self, prom_metric_exemplar_t *out) {
+  PROM_ASSERT(self != NULL);
+  prom_metric_exemplar_t *exemplar = atomic_load(&self->exemplar);
+  if (exemplar == NULL) return 1;
+  pthread_mutex_lock(&exemplar->lock);
+  out->label_count = exemplar->label_count;
+  out->labels_len = exemplar->labels_len;
+  memcpy(out->labels, exemplar->labels, exemplar->labels_len);
+  out->value = exemplar->value;
+  out->timestamp = exemplar->timestamp;
+  pthread_mutex_unlock(&exemplar->lock);
   return 0;
 }
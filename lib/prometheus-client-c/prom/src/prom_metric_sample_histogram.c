@@ -14,7 +14,7 @@
  * limitations under the License.
  */
 
-#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 
 // Public
@@ -23,10 +23,6 @@
 
 // Private
 #include "prom_assert.h"
-#include "prom_errors.h"
-#include "prom_linked_list_i.h"
-#include "prom_log.h"
-#include "prom_map_i.h"
 #include "prom_metric_formatter_i.h"
 #include "prom_metric_sample_histogram_i.h"
 #include "prom_metric_sample_i.h"
@@ -35,32 +31,13 @@
 // Static Declarations
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-static const char *prom_metric_sample_histogram_l_value_for_bucket(prom_metric_sample_histogram_t *self,
-                                                                   const char *name, size_t label_count,
-                                                                   const char **label_keys, const char **label_values,
-                                                                   double bucket);
+static const char *prom_metric_sample_histogram_l_value_for_le(prom_metric_formatter_t *formatter, const char *name,
+                                                               size_t label_count, const char **label_keys,
+                                                               const char **label_values, const char *le);
 
-static const char *prom_metric_sample_histogram_l_value_for_inf(prom_metric_sample_histogram_t *self, const char *name,
-                                                                size_t label_count, const char **label_keys,
-                                                                const char **label_values);
-
-static void prom_metric_sample_histogram_free_str_generic(void *gen);
-
-static int prom_metric_sample_histogram_init_bucket_samples(prom_metric_sample_histogram_t *self, const char *name,
-                                                            size_t label_count, const char **label_keys,
-                                                            const char **label_values);
-
-static int prom_metric_sample_histogram_init_inf(prom_metric_sample_histogram_t *self, const char *name,
-                                                 size_t label_count, const char **label_keys,
-                                                 const char **label_values);
-
-static int prom_metric_sample_histogram_init_count(prom_metric_sample_histogram_t *self, const char *name,
-                                                   size_t label_count, const char **label_keys,
-                                                   const char **label_values);
-
-static int prom_metric_sample_histogram_init_summary(prom_metric_sample_histogram_t *self, const char *name,
-                                                     size_t label_count, const char **label_keys,
-                                                     const char **label_values);
+static int prom_metric_sample_histogram_init_l_values(prom_metric_sample_histogram_t *self, const char *name,
+                                                      size_t label_count, const char **label_keys,
+                                                      const char **label_values);
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // End static declarations
@@ -69,95 +46,34 @@ static int prom_metric_sample_histogram_init_summary(prom_metric_sample_histogra
 prom_metric_sample_histogram_t *prom_metric_sample_histogram_new(const char *name, prom_histogram_buckets_t *buckets,
                                                                  size_t label_count, const char **label_keys,
                                                                  const char **label_values) {
-  // Capture return codes
-  int r = 0;
-
   // Allocate and set self
   prom_metric_sample_histogram_t *self =
       (prom_metric_sample_histogram_t *)prom_malloc(sizeof(prom_metric_sample_histogram_t));
-
-  // Allocate and set the l_value_list
-  self->l_value_list = prom_linked_list_new();
-  if (self->l_value_list == NULL) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
-  }
-
-  // Allocate and set the metric formatter
-  self->metric_formatter = prom_metric_formatter_new();
-  if (self->metric_formatter == NULL) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
-  }
-
-  // Store map of l_value/prom_metric_sample_t
-  self->samples = prom_map_new();
-  if (self->samples == NULL) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
-  }
-
-  // Set the free value function on the samples map
-  r = prom_map_set_free_value_fn(self->samples, &prom_metric_sample_free_generic);
-  if (r) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
-  }
-
-  // Set a map of bucket: l_value
-  self->l_values = prom_map_new();  // Store map of bucket/l_value
-  if (self->l_values == NULL) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
-  }
-
-  // Set the free value function for thhe l_values map
-  r = prom_map_set_free_value_fn(self->l_values, prom_metric_sample_histogram_free_str_generic);
-  if (r) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
-  }
-
   self->buckets = buckets;
-
-  // Allocate and initialize the lock
-  self->rwlock = (pthread_rwlock_t *)prom_malloc(sizeof(pthread_rwlock_t));
-  r = pthread_rwlock_init(self->rwlock, NULL);
-  if (r) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
-  }
-
-  // Allocate and initialize bucket metric samples
-  r = prom_metric_sample_histogram_init_bucket_samples(self, name, label_count, label_keys, label_values);
-  if (r) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
-  }
-
-  // Allocate and initialize the +Inf metric sample
-  r = prom_metric_sample_histogram_init_inf(self, name, label_count, label_keys, label_values);
-  if (r) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
-  }
-
-  // Allocate and initialize the count metric sample
-  r = prom_metric_sample_histogram_init_count(self, name, label_count, label_keys, label_values);
-  if (r) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
-  }
-
-  // Add summary sample
-  r = prom_metric_sample_histogram_init_summary(self, name, label_count, label_keys, label_values);
-  if (r) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
+  self->bucket_count = prom_histogram_buckets_count(buckets);
+  self->l_values = NULL;
+  self->label_values = NULL;
+  self->label_count = 0;
+  self->created = prom_metric_sample_now();
+  atomic_init(&self->sum, 0.0);
+
+  // One counter per bucket plus the +Inf bucket. Counters are not cumulative so that an observation touches only one
+  // of them; cumulative counts are summed when the histogram is rendered.
+  size_t bucket_count = prom_histogram_buckets_count(buckets);
+  self->bucket_counts = (_Atomic uint64_t *)prom_malloc(sizeof(_Atomic uint64_t) * (bucket_count + 1));
+  for (size_t i = 0; i <= bucket_count; i++) atomic_init(&self->bucket_counts[i], 0);
+
+  // Keep the user label values for exposition formats that emit labels as structured data
+  if (label_count > 0) {
+    self->label_values = (const char **)prom_malloc(sizeof(const char *) * label_count);
+    for (size_t i = 0; i < label_count; i++) {
+      self->label_values[i] = prom_intern(label_values[i]);
+    }
+    self->label_count = label_count;
   }
 
-  // The value of nodes in this map will be simple prom_metric_sample pointers.
-  r = prom_map_set_free_value_fn(self->samples, &prom_metric_sample_free_generic);
+  // Build the l_values of the text format once so that rendering does not format them on every scrape
+  int r = prom_metric_sample_histogram_init_l_values(self, name, label_count, label_keys, label_values);
   if (r) {
     prom_metric_sample_histogram_destroy(self);
     return NULL;
@@ -165,141 +81,94 @@ prom_metric_sample_histogram_t *prom_metric_sample_histogram_new(const char *nam
   return self;
 }
 
-static int prom_metric_sample_histogram_init_bucket_samples(prom_metric_sample_histogram_t *self, const char *name,
-                                                            size_t label_count, const char **label_keys,
-                                                            const char **label_values) {
-  PROM_ASSERT(self);
+static int prom_metric_sample_histogram_init_l_values(prom_metric_sample_histogram_t *self, const char *name,
+                                                      size_t label_count, const char **label_keys,
+                                                      const char **label_values) {
+  PROM_ASSERT(self != NULL);
   int r = 0;
-  int bucket_count = prom_histogram_buckets_count(self->buckets);
+  size_t bucket_count = prom_histogram_buckets_count(self->buckets);
+  size_t l_value_count = bucket_count + PROM_METRIC_SAMPLE_HISTOGRAM_SUM + 1;
 
-  // For each bucket, create an prom_metric_sample_t with an appropriate l_value and default value of 0.0. The
-  // l_value will contain the metric name, user labels, and finally, the le label and bucket value.
-  for (int i = 0; i < bucket_count; i++) {
-    const char *l_value = prom_metric_sample_histogram_l_value_for_bucket(self, name, label_count, label_keys,
-                                                                          label_values, self->buckets->upper_bounds[i]);
-    if (l_value == NULL) return 1;
+  self->l_values = (const char **)prom_malloc(sizeof(const char *) * l_value_count);
+  for (size_t i = 0; i < l_value_count; i++) self->l_values[i] = NULL;
 
-    r = prom_linked_list_append(self->l_value_list, prom_strdup(l_value));
-    if (r) return r;
+  prom_metric_formatter_t *formatter = prom_metric_formatter_new();
+  if (formatter == NULL) return 1;
 
-    const char *bucket_key = prom_metric_sample_histogram_bucket_to_str(self->buckets->upper_bounds[i]);
-    if (bucket_key == NULL) return 1;
-
-    r = prom_map_set(self->l_values, bucket_key, (char *)l_value);
-    if (r) return r;
+  // The l_value of each bucket contains the metric name, user labels, and finally, the le label and bucket value
+  for (size_t i = 0; i < bucket_count && r == 0; i++) {
+    char *le = prom_metric_sample_histogram_bucket_to_str(self->buckets->upper_bounds[i]);
+    self->l_values[i] =
+        prom_metric_sample_histogram_l_value_for_le(formatter, name, label_count, label_keys, label_values, le);
+    prom_free(le);
+    if (self->l_values[i] == NULL) r = 1;
+  }
 
-    prom_metric_sample_t *sample = prom_metric_sample_new(PROM_HISTOGRAM, l_value, 0.0);
-    if (sample == NULL) return 1;
+  if (r == 0) {
+    self->l_values[bucket_count + PROM_METRIC_SAMPLE_HISTOGRAM_INF] =
+        prom_metric_sample_histogram_l_value_for_le(formatter, name, label_count, label_keys, label_values, "+Inf");
+    if (self->l_values[bucket_count + PROM_METRIC_SAMPLE_HISTOGRAM_INF] == NULL) r = 1;
+  }
 
-    r = prom_map_set(self->samples, l_value, sample);
-    if (r) return r;
+  if (r == 0) r = prom_metric_formatter_load_l_value(formatter, name, "count", label_count, label_keys, label_values);
+  if (r == 0) {
+    self->l_values[bucket_count + PROM_METRIC_SAMPLE_HISTOGRAM_COUNT] = prom_metric_formatter_dump(formatter);
+    if (self->l_values[bucket_count + PROM_METRIC_SAMPLE_HISTOGRAM_COUNT] == NULL) r = 1;
+  }
 
-    prom_free((void *)bucket_key);
+  if (r == 0) r = prom_metric_formatter_load_l_value(formatter, name, "sum", label_count, label_keys, label_values);
+  if (r == 0) {
+    self->l_values[bucket_count + PROM_METRIC_SAMPLE_HISTOGRAM_SUM] = prom_metric_formatter_dump(formatter);
+    if (self->l_values[bucket_count + PROM_METRIC_SAMPLE_HISTOGRAM_SUM] == NULL) r = 1;
   }
-  return 0;
+
+  int rr = prom_metric_formatter_destroy(formatter);
+  return r ? r : rr;
 }
 
-static int prom_metric_sample_histogram_init_inf(prom_metric_sample_histogram_t *self, const char *name,
-                                                 size_t label_count, const char **label_keys,
-                                                 const char **label_values) {
+double prom_metric_sample_histogram_cumulative_count(prom_metric_sample_histogram_t *self, size_t i) {
   PROM_ASSERT(self != NULL);
-  int r = 0;
-  const char *inf_l_value =
-      prom_metric_sample_histogram_l_value_for_inf(self, name, label_count, label_keys, label_values);
-  if (inf_l_value == NULL) return 1;
-
-  r = prom_linked_list_append(self->l_value_list, prom_strdup(inf_l_value));
-  if (r) return r;
-
-  r = prom_map_set(self->l_values, "+Inf", (char *)inf_l_value);
-  if (r) return r;
-
-  prom_metric_sample_t *inf_sample = prom_metric_sample_new(PROM_HISTOGRAM, (char *)inf_l_value, 0.0);
-  if (inf_sample == NULL) return 1;
-
-  return prom_map_set(self->samples, inf_l_value, inf_sample);
+  uint64_t cumulative = 0;
+  for (size_t j = 0; j <= i; j++) {
+    cumulative += atomic_load_explicit(&self->bucket_counts[j], memory_order_relaxed);
+  }
+  return (double)cumulative;
 }
 
-static int prom_metric_sample_histogram_init_count(prom_metric_sample_histogram_t *self, const char *name,
-                                                   size_t label_count, const char **label_keys,
-                                                   const char **label_values) {
+double prom_metric_sample_histogram_count(prom_metric_sample_histogram_t *self) {
   PROM_ASSERT(self != NULL);
-  int r = 0;
-
-  r = prom_metric_formatter_load_l_value(self->metric_formatter, name, "count", label_count, label_keys, label_values);
-  if (r) return r;
-
-  const char *count_l_value = prom_metric_formatter_dump(self->metric_formatter);
-  if (count_l_value == NULL) return 1;
-
-  r = prom_linked_list_append(self->l_value_list, prom_strdup(count_l_value));
-  if (r) return r;
-
-  r = prom_map_set(self->l_values, "count", (char *)count_l_value);
-  if (r) return r;
-
-  prom_metric_sample_t *count_sample = prom_metric_sample_new(PROM_HISTOGRAM, count_l_value, 0.0);
-  if (count_sample == NULL) return 1;
-
-  return prom_map_set(self->samples, count_l_value, count_sample);
+  return prom_metric_sample_histogram_cumulative_count(self, prom_histogram_buckets_count(self->buckets));
 }
 
-static int prom_metric_sample_histogram_init_summary(prom_metric_sample_histogram_t *self, const char *name,
-                                                     size_t label_count, const char **label_keys,
-                                                     const char **label_values) {
+double prom_metric_sample_histogram_sum(prom_metric_sample_histogram_t *self) {
   PROM_ASSERT(self != NULL);
-  int r = 0;
-
-  r = prom_metric_formatter_load_l_value(self->metric_formatter, name, "sum", label_count, label_keys, label_values);
-  if (r) return r;
-
-  const char *sum_l_value = prom_metric_formatter_dump(self->metric_formatter);
-  if (sum_l_value == NULL) return 1;
-
-  r = prom_linked_list_append(self->l_value_list, prom_strdup(sum_l_value));
-  if (r) return r;
-
-  r = prom_map_set(self->l_values, "sum", (char *)sum_l_value);
-  if (r) return r;
-
-  prom_metric_sample_t *sum_sample = prom_metric_sample_new(PROM_HISTOGRAM, sum_l_value, 0.0);
-  if (sum_sample == NULL) return 1;
-
-  return prom_map_set(self->samples, sum_l_value, sum_sample);
+  return atomic_load_explicit(&self->sum, memory_order_relaxed);
 }
 
 int prom_metric_sample_histogram_destroy(prom_metric_sample_histogram_t *self) {
   PROM_ASSERT(self != NULL);
-  int r = 0;
-  int ret = 0;
-
   if (self == NULL) return 0;
 
-  r = prom_linked_list_destroy(self->l_value_list);
-  self->l_value_list = NULL;
-  if (r) ret = r;
-
-  r = prom_map_destroy(self->samples);
-  if (r) ret = r;
-  self->samples = NULL;
-
-  r = prom_map_destroy(self->l_values);
-  if (r) ret = r;
-  self->l_values = NULL;
-
-  r = prom_metric_formatter_destroy(self->metric_formatter);
-  if (r) ret = r;
-  self->metric_formatter = NULL;
+  if (self->l_values != NULL) {
+    // Evicted samples are freed after a grace period, possibly after the metric and its buckets are gone
+    size_t l_value_count = self->bucket_count + PROM_METRIC_SAMPLE_HISTOGRAM_SUM + 1;
+    for (size_t i = 0; i < l_value_count; i++) prom_free((void *)self->l_values[i]);
+    prom_free((void *)self->l_values);
+    self->l_values = NULL;
+  }
 
-  r = pthread_rwlock_destroy(self->rwlock);
-  if (r) ret = r;
+  for (size_t i = 0; i < self->label_count; i++) {
+    prom_intern_release(self->label_values[i]);
+  }
+  prom_free((void *)self->label_values);
+  self->label_values = NULL;
 
-  prom_free(self->rwlock);
-  self->rwlock = NULL;
+  prom_free((void *)self->bucket_counts);
+  self->bucket_counts = NULL;
 
   prom_free(self);
   self = NULL;
-  return ret;
+  return 0;
 }
 
 int prom_metric_sample_histogram_destroy_generic(void *gen) {
@@ -317,193 +186,62 @@ void prom_metric_sample_histogram_free_generic(void *gen) {
 }
 
 int prom_metric_sample_histogram_observe(prom_metric_sample_histogram_t *self, double value) {
-  int r = 0;
-
-  r = pthread_rwlock_wrlock(self->rwlock);
-  if (r) {
-    printf("RETURN CODE: %d\n", r);
-    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
-    return r;
-  }
-
-#define PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(r) \
-  int rr = 0;                                                 \
-  rr = pthread_rwlock_unlock(self->rwlock);                   \
-  if (rr) {                                                   \
-    PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);               \
-    return rr;                                                \
-  } else {                                                    \
-    return r;                                                 \
-  }
-
-  // Update the counter for the proper bucket if found
-  int bucket_count = prom_histogram_buckets_count(self->buckets);
-  for (int i = (bucket_count - 1); i >= 0; i--) {
-    if (value > self->buckets->upper_bounds[i]) {
-      break;
-    }
-
-    const char *bucket_key = prom_metric_sample_histogram_bucket_to_str(self->buckets->upper_bounds[i]);
-    if (bucket_key == NULL) {
-      PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1)
-    }
-
-    const char *l_value = prom_map_get(self->l_values, bucket_key);
-    if (l_value == NULL) {
-      prom_free((void *)bucket_key);
-      PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1)
-    }
-
-    prom_metric_sample_t *sample = prom_map_get(self->samples, l_value);
-    if (sample == NULL) {
-      prom_free((void *)bucket_key);
-      PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1)
-    }
-
-    prom_free((void *)bucket_key);
-    r = prom_metric_sample_add(sample, 1.0);
-    if (r) {
-      PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(r);
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+
+  // Binary search for the first bucket whose upper bound is greater than or equal to value. Values above every bound,
+  // and NaN, fall through to the +Inf bucket at index bucket count.
+  const double *upper_bounds = self->buckets->upper_bounds;
+  size_t low = 0;
+  size_t high = prom_histogram_buckets_count(self->buckets);
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (value <= upper_bounds[mid]) {
+      high = mid;
+    } else {
+      low = mid + 1;
     }
   }
+  atomic_fetch_add_explicit(&self->bucket_counts[low], 1, memory_order_relaxed);
 
-  // Update the +Inf and count samples
-  const char *inf_l_value = prom_map_get(self->l_values, "+Inf");
-  if (inf_l_value == NULL) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1);
-  }
-
-  prom_metric_sample_t *inf_sample = prom_map_get(self->samples, inf_l_value);
-  if (inf_sample == NULL) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1);
-  }
-
-  r = prom_metric_sample_add(inf_sample, 1.0);
-  if (r) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1);
-  }
-
-  const char *count_l_value = prom_map_get(self->l_values, "count");
-  if (count_l_value == NULL) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1);
-  }
-
-  prom_metric_sample_t *count_sample = prom_map_get(self->samples, count_l_value);
-  if (count_sample == NULL) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1);
-  }
-
-  r = prom_metric_sample_add(count_sample, 1.0);
-  if (r) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1);
-  }
-
-  // Update the sum sample
-  const char *sum_l_value = prom_map_get(self->l_values, "sum");
-  if (sum_l_value == NULL) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1);
-  }
-
-  prom_metric_sample_t *sum_sample = prom_map_get(self->samples, sum_l_value);
-  if (sum_sample == NULL) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1);
+  double sum = atomic_load_explicit(&self->sum, memory_order_relaxed);
+  while (!atomic_compare_exchange_weak_explicit(&self->sum, &sum, sum + value, memory_order_relaxed,
+                                                memory_order_relaxed)) {
   }
-
-  r = prom_metric_sample_add(sum_sample, value);
-  PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(r);
-  return r;
+  return 0;
 }
 
-static const char *prom_metric_sample_histogram_l_value_for_bucket(prom_metric_sample_histogram_t *self,
-                                                                   const char *name, size_t label_count,
-                                                                   const char **label_keys, const char **label_values,
-                                                                   double bucket) {
-  PROM_ASSERT(self != NULL);
-  int r = 0;
+static const char *prom_metric_sample_histogram_l_value_for_le(prom_metric_formatter_t *formatter, const char *name,
+                                                               size_t label_count, const char **label_keys,
+                                                               const char **label_values, const char *le) {
+  PROM_ASSERT(formatter != NULL);
 
-#define PROM_METRIC_SAMPLE_HISTOGRAM_L_VALUE_FOR_BUCKET_CLEANUP() \
-  for (size_t i = 0; i < label_count + 1; i++) {                  \
-    prom_free((char *)new_keys[i]);                               \
-    prom_free((char *)new_values[i]);                             \
-  }                                                               \
-  prom_free(new_keys);                                            \
-  prom_free(new_values);
-
-  // Make new array to hold label_keys with le label key
+  // Make new arrays to hold the user labels followed by the le label. The strings are borrowed from the caller.
   const char **new_keys = (const char **)prom_malloc((label_count + 1) * sizeof(char *));
-  for (size_t i = 0; i < label_count; i++) {
-    new_keys[i] = prom_strdup(label_keys[i]);
-  }
-  new_keys[label_count] = prom_strdup("le");
-
-  // Make new array to hold label_values with le label value
   const char **new_values = (const char **)prom_malloc((label_count + 1) * sizeof(char *));
   for (size_t i = 0; i < label_count; i++) {
-    new_values[i] = prom_strdup(label_values[i]);
-  }
-
-  new_values[label_count] = prom_metric_sample_histogram_bucket_to_str(bucket);
-
-  r = prom_metric_formatter_load_l_value(self->metric_formatter, name, NULL, label_count + 1, new_keys, new_values);
-  if (r) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_L_VALUE_FOR_BUCKET_CLEANUP();
-    return NULL;
+    new_keys[i] = label_keys[i];
+    new_values[i] = label_values[i];
   }
-  const char *ret = (const char *)prom_metric_formatter_dump(self->metric_formatter);
-  PROM_METRIC_SAMPLE_HISTOGRAM_L_VALUE_FOR_BUCKET_CLEANUP();
-  return ret;
-}
-
-static const char *prom_metric_sample_histogram_l_value_for_inf(prom_metric_sample_histogram_t *self, const char *name,
-                                                                size_t label_count, const char **label_keys,
-                                                                const char **label_values) {
-  PROM_ASSERT(self != NULL);
-  int r = 0;
+  new_keys[label_count] = "le";
+  new_values[label_count] = le;
 
-#define PROM_METRIC_SAMPLE_HISTOGRAM_L_VALUE_FOR_INF_CLEANUP() \
-  for (size_t i = 0; i < label_count + 1; i++) {               \
-    prom_free((char *)new_keys[i]);                            \
-    prom_free((char *)new_values[i]);                          \
-  }                                                            \
-  prom_free(new_keys);                                         \
+  int r = prom_metric_formatter_load_l_value(formatter, name, NULL, label_count + 1, new_keys, new_values);
+  const char *ret = r ? NULL : (const char *)prom_metric_formatter_dump(formatter);
+  prom_free(new_keys);
   prom_free(new_values);
-
-  // Make new array to hold label_keys with le label key
-  const char **new_keys = (const char **)prom_malloc((label_count + 1) * sizeof(char *));
-  for (size_t i = 0; i < label_count; i++) {
-    new_keys[i] = prom_strdup(label_keys[i]);
-  }
-  new_keys[label_count] = prom_strdup("le");
-
-  // Make new array to hold label_values with le label value
-  const char **new_values = (const char **)prom_malloc((label_count + 1) * sizeof(char *));
-  for (size_t i = 0; i < label_count; i++) {
-    new_values[i] = prom_strdup(label_values[i]);
-  }
-
-  new_values[label_count] = prom_strdup("+Inf");
-
-  r = prom_metric_formatter_load_l_value(self->metric_formatter, name, NULL, label_count + 1, new_keys, new_values);
-  if (r) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_L_VALUE_FOR_INF_CLEANUP()
-    return NULL;
-  }
-  const char *ret = (const char *)prom_metric_formatter_dump(self->metric_formatter);
-  PROM_METRIC_SAMPLE_HISTOGRAM_L_VALUE_FOR_INF_CLEANUP()
   return ret;
 }
 
-static void prom_metric_sample_histogram_free_str_generic(void *gen) {
-  char *str = (char *)gen;
-  prom_free((void *)str);
-  str = NULL;
-}
-
-char *prom_metric_sample_histogram_bucket_to_str(double bucket) {
-  char *buf = (char *)prom_malloc(sizeof(char) * 50);
+void prom_metric_sample_histogram_bucket_write(char *buf, double bucket) {
   sprintf(buf, "%g", bucket);
   if (!strchr(buf, '.')) {
     strcat(buf, ".0");
   }
+}
+
+char *prom_metric_sample_histogram_bucket_to_str(double bucket) {
+  char *buf = (char *)prom_malloc(sizeof(char) * PROM_METRIC_SAMPLE_HISTOGRAM_BUCKET_STR_SIZE);
+  prom_metric_sample_histogram_bucket_write(buf, bucket);
   return buf;
 }
@@ -23,6 +23,12 @@
 // Private
 #include "prom_metric_sample_histogram_t.h"
 
+/**
+ * @brief API PRIVATE The size of a buffer that holds any bucket upper bound written by
+ * prom_metric_sample_histogram_bucket_write
+ */
+#define PROM_METRIC_SAMPLE_HISTOGRAM_BUCKET_STR_SIZE 50
+
 /**
  * @brief API PRIVATE Create a pointer to a prom_metric_sample_histogram_t
  */
@@ -42,6 +48,28 @@ int prom_metric_sample_histogram_destroy_generic(void *gen);
 
 char *prom_metric_sample_histogram_bucket_to_str(double bucket);
 
+/**
+ * @brief API PRIVATE Writes the le label value of a bucket upper bound to buf, which must hold at least
+ * PROM_METRIC_SAMPLE_HISTOGRAM_BUCKET_STR_SIZE bytes
+ */
+void prom_metric_sample_histogram_bucket_write(char *buf, double bucket);
+
+/**
+ * @brief API PRIVATE Returns the number of observations less than or equal to the upper bound of bucket i. Passing
+ * the bucket count returns the +Inf bucket. Buckets are stored non-cumulatively, so this sums buckets 0 through i.
+ */
+double prom_metric_sample_histogram_cumulative_count(prom_metric_sample_histogram_t *self, size_t i);
+
+/**
+ * @brief API PRIVATE Returns the total number of observations, which is the cumulative count of the +Inf bucket
+ */
+double prom_metric_sample_histogram_count(prom_metric_sample_histogram_t *self);
+
+/**
+ * @brief API PRIVATE Returns the sum of all observations
+ */
+double prom_metric_sample_histogram_sum(prom_metric_sample_histogram_t *self);
+
 void prom_metric_sample_histogram_free_generic(void *gen);
 
 #endif  // PROM_METRIC_HISTOGRAM_SAMPLE_I_H
@@ -14,26 +14,33 @@
  * limitations under the License.
  */
 
-#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
 
 // Public
 #include "prom_histogram_buckets.h"
 #include "prom_metric_sample_histogram.h"
 
-// Private
-#include "prom_map_t.h"
-#include "prom_metric_formatter_t.h"
-
 #ifndef PROM_METRIC_HISTOGRAM_SAMPLE_T_H
 #define PROM_METRIC_HISTOGRAM_SAMPLE_T_H
 
+/**
+ * @brief PROM_METRIC_SAMPLE_HISTOGRAM_INF, PROM_METRIC_SAMPLE_HISTOGRAM_COUNT and PROM_METRIC_SAMPLE_HISTOGRAM_SUM are
+ * offsets from the bucket count into l_values
+ */
+#define PROM_METRIC_SAMPLE_HISTOGRAM_INF 0
+#define PROM_METRIC_SAMPLE_HISTOGRAM_COUNT 1
+#define PROM_METRIC_SAMPLE_HISTOGRAM_SUM 2
+
 struct prom_metric_sample_histogram {
-  prom_linked_list_t *l_value_list;
-  prom_map_t *l_values;
-  prom_map_t *samples;
-  prom_metric_formatter_t *metric_formatter;
   prom_histogram_buckets_t *buckets;
-  pthread_rwlock_t *rwlock;
+  size_t bucket_count; /**< count of buckets, kept so that destroying the sample does not read the buckets */
+  _Atomic uint64_t *bucket_counts; /**< observations per bucket, not cumulative; the last entry is the +Inf bucket */
+  _Atomic double sum;              /**< sum of all observations */
+  const char **l_values;           /**< text format l_values in order: buckets, +Inf, count and sum */
+  const char **label_values;       /**< owned copies of the user label values */
+  size_t label_count;              /**< number of entries in label_values */
+  double created;                  /**< unix time at which the sample was created */
 };
 
 #endif  // PROM_METRIC_HISTOGRAM_SAMPLE_T_H
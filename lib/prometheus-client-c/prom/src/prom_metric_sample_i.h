@@ -29,6 +29,57 @@
  */
 prom_metric_sample_t *prom_metric_sample_new(prom_metric_type_t type, const char *l_value, double r_value);
 
+/**
+ * @brief API PRIVATE Copies the given label values onto the sample so that exposition formats with structured labels
+ * can be produced without parsing the l_value.
+ */
+int prom_metric_sample_set_label_values(prom_metric_sample_t *self, size_t label_count, const char **label_values);
+
+/**
+ * @brief API PRIVATE Gives the sample PROM_METRIC_SAMPLE_SHARDS cells that prom_metric_sample_add spreads increments
+ * over. Must be called before the sample is shared with other threads.
+ */
+int prom_metric_sample_enable_shards(prom_metric_sample_t *self);
+
+/**
+ * @brief API PRIVATE Returns the value of the sample. Integer samples are converted to a double. For a sharded sample
+ * this is the sum of its cells, so concurrent increments may or may not be included, but each one is counted exactly
+ * once across scrapes.
+ */
+double prom_metric_sample_value(prom_metric_sample_t *self);
+
+/**
+ * @brief API PRIVATE Writes the value of the sample into buf like snprintf. Integer samples are printed as integers so
+ * that no precision is lost above 2^53; other samples are printed with %.17g.
+ */
+size_t prom_metric_sample_format_value(prom_metric_sample_t *self, char *buf, size_t size);
+
+/**
+ * @brief API PRIVATE Returns the value of the sample as a scrape sees it. That is the group's latest snapshot when the
+ * sample's metric belongs to a prom_group_t, and the live value otherwise.
+ */
+double prom_metric_sample_scrape_value(prom_metric_sample_t *self);
+
+/**
+ * @brief API PRIVATE Writes the value of the sample as a scrape sees it into buf, like prom_metric_sample_format_value
+ */
+size_t prom_metric_sample_format_scrape_value(prom_metric_sample_t *self, char *buf, size_t size);
+
+/**
+ * @brief API PRIVATE Copies the live value of the sample into the given snapshot slot. Called by prom_group_snapshot.
+ */
+void prom_metric_sample_snapshot(prom_metric_sample_t *self, size_t slot);
+
+/**
+ * @brief API PRIVATE Copies the current exemplar into out. Returns non-zero if the sample has no exemplar.
+ */
+int prom_metric_sample_exemplar_load(prom_metric_sample_t *self, prom_metric_exemplar_t *out);
+
+/**
+ * @brief API PRIVATE Returns the current unix time in seconds
+ */
+double prom_metric_sample_now(void);
+
 /**
  * @brief API PRIVATE Destroy the prom_metric_sample**
  */
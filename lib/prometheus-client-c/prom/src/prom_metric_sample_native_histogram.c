@@ -0,0 +1,327 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <float.h>
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+
+// Public
+#include "prom_alloc.h"
+#include "prom_native_histogram.h"
+
+// Private
+#include "prom_assert.h"
+#include "prom_metric_formatter_i.h"
+#include "prom_metric_sample_i.h"
+#include "prom_metric_sample_native_histogram_i.h"
+#include "prom_metric_sample_native_histogram_t.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Static Declarations
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int prom_metric_sample_native_histogram_init_l_values(prom_metric_sample_native_histogram_t *self,
+                                                             const char *name, size_t label_count,
+                                                             const char **label_keys, const char **label_values);
+
+static void prom_metric_sample_native_histogram_downscale(prom_metric_sample_native_histogram_t *self);
+
+static void prom_metric_sample_native_histogram_widen_zero_bucket(prom_metric_sample_native_histogram_t *self);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// End static declarations
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The fraction bounds of the buckets at the highest schema: entry j is 2^(j / 256 - 1). A lower positive schema s uses
+// every 2^(8 - s)th entry.
+static double prom_native_histogram_bounds[1 << PROM_NATIVE_HISTOGRAM_MAX_SCHEMA];
+static pthread_once_t prom_native_histogram_bounds_once = PTHREAD_ONCE_INIT;
+
+static void prom_native_histogram_bounds_init(void) {
+  size_t n = 1 << PROM_NATIVE_HISTOGRAM_MAX_SCHEMA;
+  for (size_t j = 0; j < n; j++) prom_native_histogram_bounds[j] = exp2((double)j / (double)n - 1.0);
+}
+
+prom_metric_sample_native_histogram_t *prom_metric_sample_native_histogram_new(const char *name, int32_t schema,
+                                                                               size_t max_buckets, size_t label_count,
+                                                                               const char **label_keys,
+                                                                               const char **label_values) {
+  prom_metric_sample_native_histogram_t *self =
+      (prom_metric_sample_native_histogram_t *)prom_malloc(sizeof(prom_metric_sample_native_histogram_t));
+  pthread_mutex_init(&self->lock, NULL);
+  self->schema = schema;
+  self->max_buckets = max_buckets;
+  self->zero_threshold = PROM_NATIVE_HISTOGRAM_ZERO_THRESHOLD;
+  self->zero_count = 0;
+  self->count = 0;
+  self->sum = 0.0;
+  self->l_values = NULL;
+  self->label_values = NULL;
+  self->label_count = 0;
+  self->created = prom_metric_sample_now();
+
+  // Either sign may end up holding every bucket, so both get the full capacity and observing never allocates
+  prom_native_histogram_buckets_t *signs[] = {&self->positive, &self->negative};
+  for (size_t i = 0; i < 2; i++) {
+    signs[i]->indices = (int32_t *)prom_malloc(sizeof(int32_t) * max_buckets);
+    signs[i]->counts = (uint64_t *)prom_malloc(sizeof(uint64_t) * max_buckets);
+    signs[i]->count = 0;
+  }
+
+  // Keep the user label values for exposition formats that emit labels as structured data
+  if (label_count > 0) {
+    self->label_values = (const char **)prom_malloc(sizeof(const char *) * label_count);
+    for (size_t i = 0; i < label_count; i++) {
+      self->label_values[i] = prom_intern(label_values[i]);
+    }
+    self->label_count = label_count;
+  }
+
+  int r = prom_metric_sample_native_histogram_init_l_values(self, name, label_count, label_keys, label_values);
+  if (r) {
+    prom_metric_sample_native_histogram_destroy(self);
+    return NULL;
+  }
+  return self;
+}
+
+static int prom_metric_sample_native_histogram_init_l_values(prom_metric_sample_native_histogram_t *self,
+                                                             const char *name, size_t label_count,
+                                                             const char **label_keys, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  int r = 0;
+  size_t l_value_count = PROM_METRIC_SAMPLE_NATIVE_HISTOGRAM_SUM + 1;
+
+  self->l_values = (const char **)prom_malloc(sizeof(const char *) * l_value_count);
+  for (size_t i = 0; i < l_value_count; i++) self->l_values[i] = NULL;
+
+  prom_metric_formatter_t *formatter = prom_metric_formatter_new();
+  if (formatter == NULL) return 1;
+
+  // Text formats cannot carry the sparse buckets, so they only get the +Inf bucket, count and sum
+  const char **keys = (const char **)prom_malloc((label_count + 1) * sizeof(char *));
+  const char **values = (const char **)prom_malloc((label_count + 1) * sizeof(char *));
+  for (size_t i = 0; i < label_count; i++) {
+    keys[i] = label_keys[i];
+    values[i] = label_values[i];
+  }
+  keys[label_count] = "le";
+  values[label_count] = "+Inf";
+  r = prom_metric_formatter_load_l_value(formatter, name, "bucket", label_count + 1, keys, values);
+  prom_free(keys);
+  prom_free(values);
+  if (r == 0) {
+    self->l_values[PROM_METRIC_SAMPLE_NATIVE_HISTOGRAM_INF] = prom_metric_formatter_dump(formatter);
+    if (self->l_values[PROM_METRIC_SAMPLE_NATIVE_HISTOGRAM_INF] == NULL) r = 1;
+  }
+
+  if (r == 0) r = prom_metric_formatter_load_l_value(formatter, name, "count", label_count, label_keys, label_values);
+  if (r == 0) {
+    self->l_values[PROM_METRIC_SAMPLE_NATIVE_HISTOGRAM_COUNT] = prom_metric_formatter_dump(formatter);
+    if (self->l_values[PROM_METRIC_SAMPLE_NATIVE_HISTOGRAM_COUNT] == NULL) r = 1;
+  }
+
+  if (r == 0) r = prom_metric_formatter_load_l_value(formatter, name, "sum", label_count, label_keys, label_values);
+  if (r == 0) {
+    self->l_values[PROM_METRIC_SAMPLE_NATIVE_HISTOGRAM_SUM] = prom_metric_formatter_dump(formatter);
+    if (self->l_values[PROM_METRIC_SAMPLE_NATIVE_HISTOGRAM_SUM] == NULL) r = 1;
+  }
+
+  int rr = prom_metric_formatter_destroy(formatter);
+  return r ? r : rr;
+}
+
+int prom_metric_sample_native_histogram_destroy(prom_metric_sample_native_histogram_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 0;
+
+  if (self->l_values != NULL) {
+    for (size_t i = 0; i <= PROM_METRIC_SAMPLE_NATIVE_HISTOGRAM_SUM; i++) prom_free((void *)self->l_values[i]);
+    prom_free((void *)self->l_values);
+    self->l_values = NULL;
+  }
+
+  for (size_t i = 0; i < self->label_count; i++) {
+    prom_intern_release(self->label_values[i]);
+  }
+  prom_free((void *)self->label_values);
+  self->label_values = NULL;
+
+  prom_free(self->positive.indices);
+  prom_free(self->positive.counts);
+  prom_free(self->negative.indices);
+  prom_free(self->negative.counts);
+
+  pthread_mutex_destroy(&self->lock);
+  prom_free(self);
+  self = NULL;
+  return 0;
+}
+
+int prom_metric_sample_native_histogram_destroy_generic(void *gen) {
+  int r = 0;
+
+  prom_metric_sample_native_histogram_t *self = (prom_metric_sample_native_histogram_t *)gen;
+  r = prom_metric_sample_native_histogram_destroy(self);
+  self = NULL;
+  return r;
+}
+
+void prom_metric_sample_native_histogram_free_generic(void *gen) {
+  prom_metric_sample_native_histogram_t *self = (prom_metric_sample_native_histogram_t *)gen;
+  prom_metric_sample_native_histogram_destroy(self);
+}
+
+int32_t prom_metric_sample_native_histogram_index(double value, int32_t schema) {
+  // Infinities land in the bucket of the largest finite value
+  int exp = 0;
+  double frac = frexp(isinf(value) ? DBL_MAX : fabs(value), &exp);
+
+  if (schema > 0) {
+    // Find the first bound of the octave at or above frac. frac is in [0.5, 1), so the bucket is one of the 2^schema
+    // that split the octave (2^(exp - 1), 2^exp].
+    pthread_once(&prom_native_histogram_bounds_once, &prom_native_histogram_bounds_init);
+    size_t n = (size_t)1 << schema;
+    size_t stride = (size_t)1 << (PROM_NATIVE_HISTOGRAM_MAX_SCHEMA - schema);
+    size_t low = 0;
+    size_t high = n;
+    while (low < high) {
+      size_t mid = low + (high - low) / 2;
+      if (prom_native_histogram_bounds[mid * stride] >= frac) {
+        high = mid;
+      } else {
+        low = mid + 1;
+      }
+    }
+    return (int32_t)low + (exp - 1) * (int32_t)n;
+  }
+
+  // At schema 0 and below every bucket spans 2^-schema whole octaves. Powers of two belong to the bucket below.
+  int32_t index = exp;
+  if (frac == 0.5) index--;
+  int32_t offset = (1 << -schema) - 1;
+  return (index + offset) >> -schema;
+}
+
+// Returns the position of index in buckets, or the position at which it would be inserted
+static size_t prom_native_histogram_buckets_search(prom_native_histogram_buckets_t *buckets, int32_t index) {
+  size_t low = 0;
+  size_t high = buckets->count;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (buckets->indices[mid] < index) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+int prom_metric_sample_native_histogram_observe(prom_metric_sample_native_histogram_t *self, double value) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+
+  pthread_mutex_lock(&self->lock);
+  self->count++;
+  self->sum += value;
+
+  if (isnan(value)) {
+    pthread_mutex_unlock(&self->lock);
+    return 0;
+  }
+
+  prom_native_histogram_buckets_t *buckets = value > 0 ? &self->positive : &self->negative;
+  for (;;) {
+    if (fabs(value) <= self->zero_threshold) {
+      self->zero_count++;
+      break;
+    }
+
+    int32_t index = prom_metric_sample_native_histogram_index(value, self->schema);
+    size_t pos = prom_native_histogram_buckets_search(buckets, index);
+    if (pos < buckets->count && buckets->indices[pos] == index) {
+      buckets->counts[pos]++;
+      break;
+    }
+
+    if (self->positive.count + self->negative.count < self->max_buckets) {
+      size_t tail = buckets->count - pos;
+      memmove(&buckets->indices[pos + 1], &buckets->indices[pos], tail * sizeof(int32_t));
+      memmove(&buckets->counts[pos + 1], &buckets->counts[pos], tail * sizeof(uint64_t));
+      buckets->indices[pos] = index;
+      buckets->counts[pos] = 1;
+      buckets->count++;
+      break;
+    }
+
+    // Out of buckets: halve the resolution, merging neighbouring buckets, and retry. Once the resolution is as low as
+    // it goes, fold the buckets nearest to zero into the zero bucket instead.
+    if (self->schema > PROM_NATIVE_HISTOGRAM_MIN_SCHEMA) {
+      prom_metric_sample_native_histogram_downscale(self);
+    } else {
+      prom_metric_sample_native_histogram_widen_zero_bucket(self);
+    }
+  }
+
+  pthread_mutex_unlock(&self->lock);
+  return 0;
+}
+
+// Lowers the schema by one. Bucket i becomes bucket ceil(i / 2), so pairs of neighbours merge.
+static void prom_metric_sample_native_histogram_downscale(prom_metric_sample_native_histogram_t *self) {
+  prom_native_histogram_buckets_t *signs[] = {&self->positive, &self->negative};
+  for (size_t s = 0; s < 2; s++) {
+    prom_native_histogram_buckets_t *buckets = signs[s];
+    size_t out = 0;
+    for (size_t i = 0; i < buckets->count; i++) {
+      int32_t index = (buckets->indices[i] + 1) >> 1;
+      if (out > 0 && buckets->indices[out - 1] == index) {
+        buckets->counts[out - 1] += buckets->counts[i];
+      } else {
+        buckets->indices[out] = index;
+        buckets->counts[out] = buckets->counts[i];
+        out++;
+      }
+    }
+    buckets->count = out;
+  }
+  self->schema--;
+}
+
+// Moves the bucket nearest to zero, and any bucket of the other sign below its upper bound, into the zero bucket
+static void prom_metric_sample_native_histogram_widen_zero_bucket(prom_metric_sample_native_histogram_t *self) {
+  int32_t lowest = INT32_MAX;
+  if (self->positive.count > 0) lowest = self->positive.indices[0];
+  if (self->negative.count > 0 && self->negative.indices[0] < lowest) lowest = self->negative.indices[0];
+  if (lowest == INT32_MAX) return;
+
+  prom_native_histogram_buckets_t *signs[] = {&self->positive, &self->negative};
+  for (size_t s = 0; s < 2; s++) {
+    prom_native_histogram_buckets_t *buckets = signs[s];
+    size_t drop = 0;
+    while (drop < buckets->count && buckets->indices[drop] <= lowest) {
+      self->zero_count += buckets->counts[drop];
+      drop++;
+    }
+    memmove(&buckets->indices[0], &buckets->indices[drop], (buckets->count - drop) * sizeof(int32_t));
+    memmove(&buckets->counts[0], &buckets->counts[drop], (buckets->count - drop) * sizeof(uint64_t));
+    buckets->count -= drop;
+  }
+  self->zero_threshold = ldexp(1.0, lowest * (1 << -self->schema));
+}
@@ -0,0 +1,60 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PROM_METRIC_SAMPLE_NATIVE_HISTOGRAM_I_H
+#define PROM_METRIC_SAMPLE_NATIVE_HISTOGRAM_I_H
+
+#include <stdint.h>
+
+// Public
+#include "prom_metric_sample_native_histogram.h"
+
+// Private
+#include "prom_metric_sample_native_histogram_t.h"
+
+/**
+ * @brief API PRIVATE Returns a *prom_metric_sample_native_histogram starting at the given schema. All bucket storage is
+ * allocated up front.
+ */
+prom_metric_sample_native_histogram_t *prom_metric_sample_native_histogram_new(const char *name, int32_t schema,
+                                                                               size_t max_buckets, size_t label_count,
+                                                                               const char **label_keys,
+                                                                               const char **label_values);
+
+/**
+ * @brief API PRIVATE Destroys a *prom_metric_sample_native_histogram
+ */
+int prom_metric_sample_native_histogram_destroy(prom_metric_sample_native_histogram_t *self);
+
+/**
+ * @brief API PRIVATE takes a generic item, casts to a *prom_metric_sample_native_histogram_t and destroys it
+ */
+int prom_metric_sample_native_histogram_destroy_generic(void *gen);
+
+/**
+ * @brief API PRIVATE takes a generic item, casts to a *prom_metric_sample_native_histogram_t and destroys it. Discards
+ * any errors.
+ */
+void prom_metric_sample_native_histogram_free_generic(void *gen);
+
+/**
+ * @brief API PRIVATE Returns the index of the bucket holding the absolute value of value at the given schema. value
+ * must be non-zero and not NaN.
+ */
+int32_t prom_metric_sample_native_histogram_index(double value, int32_t schema);
+
+#endif  // PROM_METRIC_SAMPLE_NATIVE_HISTOGRAM_I_H
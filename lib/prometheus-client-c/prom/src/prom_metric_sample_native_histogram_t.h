@@ -0,0 +1,57 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PROM_METRIC_SAMPLE_NATIVE_HISTOGRAM_T_H
+#define PROM_METRIC_SAMPLE_NATIVE_HISTOGRAM_T_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+// Public
+#include "prom_metric_sample_native_histogram.h"
+
+#define PROM_METRIC_SAMPLE_NATIVE_HISTOGRAM_INF 0
+#define PROM_METRIC_SAMPLE_NATIVE_HISTOGRAM_COUNT 1
+#define PROM_METRIC_SAMPLE_NATIVE_HISTOGRAM_SUM 2
+
+/**
+ * @brief API PRIVATE The buckets of one sign, sorted by index. Bucket i holds the observations whose absolute value is
+ * in (2^((i - 1) * 2^-schema), 2^(i * 2^-schema)].
+ */
+typedef struct prom_native_histogram_buckets {
+  int32_t *indices;  /**< bucket indices in increasing order */
+  uint64_t *counts;  /**< observations per bucket, not cumulative */
+  size_t count;      /**< number of used entries */
+} prom_native_histogram_buckets_t;
+
+struct prom_metric_sample_native_histogram {
+  pthread_mutex_t lock;                      /**< guards every member below up to l_values */
+  int32_t schema;                            /**< current resolution; lowered when the buckets outgrow max_buckets */
+  size_t max_buckets;                        /**< most positive and negative buckets the sample may hold together */
+  double zero_threshold;                     /**< observations with an absolute value up to this go to zero_count */
+  uint64_t zero_count;                       /**< observations in the zero bucket */
+  uint64_t count;                            /**< number of observations, NaN included */
+  double sum;                                /**< sum of observations */
+  prom_native_histogram_buckets_t positive;  /**< buckets of positive observations */
+  prom_native_histogram_buckets_t negative;  /**< buckets of negative observations, indexed by absolute value */
+  const char **l_values;                     /**< text format l_values in order: +Inf bucket, count and sum */
+  const char **label_values;                 /**< owned copies of the user label values */
+  size_t label_count;                        /**< number of entries in label_values */
+  double created;                            /**< unix time at which the sample was created */
+};
+
+#endif  // PROM_METRIC_SAMPLE_NATIVE_HISTOGRAM_T_H
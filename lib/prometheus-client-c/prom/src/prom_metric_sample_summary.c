@@ -0,0 +1,246 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+
+// Public
+#include "prom_alloc.h"
+#include "prom_metric_sample_summary.h"
+
+// Private
+#include "prom_assert.h"
+#include "prom_errors.h"
+#include "prom_log.h"
+#include "prom_metric_formatter_i.h"
+#include "prom_metric_sample_i.h"
+#include "prom_metric_sample_summary_i.h"
+#include "prom_metric_sample_summary_t.h"
+#include "prom_tdigest_i.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Static Declarations
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static double prom_metric_sample_summary_monotonic(void);
+
+static void prom_metric_sample_summary_rotate(prom_metric_sample_summary_t *self, double now);
+
+static int prom_metric_sample_summary_init_l_values(prom_metric_sample_summary_t *self, const char *name,
+                                                    size_t label_count, const char **label_keys,
+                                                    const char **label_values);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// End static declarations
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+prom_metric_sample_summary_t *prom_metric_sample_summary_new(const char *name, size_t quantile_count,
+                                                             const double *quantiles, double max_age,
+                                                             size_t label_count, const char **label_keys,
+                                                             const char **label_values) {
+  prom_metric_sample_summary_t *self =
+      (prom_metric_sample_summary_t *)prom_malloc(sizeof(prom_metric_sample_summary_t));
+  pthread_mutex_init(&self->lock, NULL);
+  for (size_t i = 0; i < PROM_SUMMARY_AGE_BUCKETS; i++) prom_tdigest_reset(&self->digests[i]);
+  self->head = 0;
+  self->bucket_age = max_age / PROM_SUMMARY_AGE_BUCKETS;
+  self->head_expires = prom_metric_sample_summary_monotonic() + self->bucket_age;
+  self->count = 0;
+  self->sum = 0.0;
+  self->quantiles = quantiles;
+  self->quantile_count = quantile_count;
+  self->l_values = NULL;
+  self->label_values = NULL;
+  self->label_count = 0;
+  self->created = prom_metric_sample_now();
+
+  // Keep the user label values for exposition formats that emit labels as structured data
+  if (label_count > 0) {
+    self->label_values = (const char **)prom_malloc(sizeof(const char *) * label_count);
+    for (size_t i = 0; i < label_count; i++) {
+      self->label_values[i] = prom_intern(label_values[i]);
+    }
+    self->label_count = label_count;
+  }
+
+  int r = prom_metric_sample_summary_init_l_values(self, name, label_count, label_keys, label_values);
+  if (r) {
+    prom_metric_sample_summary_destroy(self);
+    return NULL;
+  }
+  return self;
+}
+
+static int prom_metric_sample_summary_init_l_values(prom_metric_sample_summary_t *self, const char *name,
+                                                    size_t label_count, const char **label_keys,
+                                                    const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  int r = 0;
+  size_t l_value_count = self->quantile_count + PROM_METRIC_SAMPLE_SUMMARY_COUNT + 1;
+
+  self->l_values = (const char **)prom_malloc(sizeof(const char *) * l_value_count);
+  for (size_t i = 0; i < l_value_count; i++) self->l_values[i] = NULL;
+
+  prom_metric_formatter_t *formatter = prom_metric_formatter_new();
+  if (formatter == NULL) return 1;
+
+  // The l_value of each quantile holds the user labels followed by the quantile label. The strings are borrowed.
+  const char **keys = (const char **)prom_malloc((label_count + 1) * sizeof(char *));
+  const char **values = (const char **)prom_malloc((label_count + 1) * sizeof(char *));
+  for (size_t i = 0; i < label_count; i++) {
+    keys[i] = label_keys[i];
+    values[i] = label_values[i];
+  }
+  keys[label_count] = "quantile";
+
+  for (size_t i = 0; i < self->quantile_count && r == 0; i++) {
+    char quantile[50];
+    snprintf(quantile, sizeof(quantile), "%g", self->quantiles[i]);
+    values[label_count] = quantile;
+    r = prom_metric_formatter_load_l_value(formatter, name, NULL, label_count + 1, keys, values);
+    if (r == 0) {
+      self->l_values[i] = prom_metric_formatter_dump(formatter);
+      if (self->l_values[i] == NULL) r = 1;
+    }
+  }
+  prom_free(keys);
+  prom_free(values);
+
+  size_t sum = self->quantile_count + PROM_METRIC_SAMPLE_SUMMARY_SUM;
+  if (r == 0) r = prom_metric_formatter_load_l_value(formatter, name, "sum", label_count, label_keys, label_values);
+  if (r == 0) {
+    self->l_values[sum] = prom_metric_formatter_dump(formatter);
+    if (self->l_values[sum] == NULL) r = 1;
+  }
+
+  size_t count = self->quantile_count + PROM_METRIC_SAMPLE_SUMMARY_COUNT;
+  if (r == 0) r = prom_metric_formatter_load_l_value(formatter, name, "count", label_count, label_keys, label_values);
+  if (r == 0) {
+    self->l_values[count] = prom_metric_formatter_dump(formatter);
+    if (self->l_values[count] == NULL) r = 1;
+  }
+
+  int rr = prom_metric_formatter_destroy(formatter);
+  return r ? r : rr;
+}
+
+int prom_metric_sample_summary_destroy(prom_metric_sample_summary_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 0;
+
+  if (self->l_values != NULL) {
+    size_t l_value_count = self->quantile_count + PROM_METRIC_SAMPLE_SUMMARY_COUNT + 1;
+    for (size_t i = 0; i < l_value_count; i++) prom_free((void *)self->l_values[i]);
+    prom_free((void *)self->l_values);
+    self->l_values = NULL;
+  }
+
+  for (size_t i = 0; i < self->label_count; i++) {
+    prom_intern_release(self->label_values[i]);
+  }
+  prom_free((void *)self->label_values);
+  self->label_values = NULL;
+
+  pthread_mutex_destroy(&self->lock);
+  prom_free(self);
+  self = NULL;
+  return 0;
+}
+
+int prom_metric_sample_summary_destroy_generic(void *gen) {
+  int r = 0;
+
+  prom_metric_sample_summary_t *self = (prom_metric_sample_summary_t *)gen;
+  r = prom_metric_sample_summary_destroy(self);
+  self = NULL;
+  return r;
+}
+
+void prom_metric_sample_summary_free_generic(void *gen) {
+  prom_metric_sample_summary_t *self = (prom_metric_sample_summary_t *)gen;
+  prom_metric_sample_summary_destroy(self);
+}
+
+int prom_metric_sample_summary_observe(prom_metric_sample_summary_t *self, double value) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (isnan(value)) return 1;
+
+  double now = prom_metric_sample_summary_monotonic();
+  pthread_mutex_lock(&self->lock);
+  prom_metric_sample_summary_rotate(self, now);
+  prom_tdigest_add(&self->digests[self->head], value, 1.0);
+  self->count++;
+  self->sum += value;
+  pthread_mutex_unlock(&self->lock);
+  return 0;
+}
+
+int prom_metric_sample_summary_snapshot(prom_metric_sample_summary_t *self, double *values, uint64_t *count,
+                                        double *sum) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+
+  // The window is merged into a scratch digest on the stack so that observers only wait for the copy, not for the
+  // quantile queries
+  prom_tdigest_t window;
+  prom_tdigest_reset(&window);
+
+  double now = prom_metric_sample_summary_monotonic();
+  pthread_mutex_lock(&self->lock);
+  prom_metric_sample_summary_rotate(self, now);
+  for (size_t i = 0; i < PROM_SUMMARY_AGE_BUCKETS; i++) prom_tdigest_merge(&window, &self->digests[i]);
+  *count = self->count;
+  *sum = self->sum;
+  pthread_mutex_unlock(&self->lock);
+
+  for (size_t i = 0; i < self->quantile_count; i++) values[i] = prom_tdigest_quantile(&window, self->quantiles[i]);
+  return 0;
+}
+
+/**
+ * @brief Slides the window up to now, resetting every digest whose observations have aged out. Must hold the lock.
+ */
+static void prom_metric_sample_summary_rotate(prom_metric_sample_summary_t *self, double now) {
+  if (now < self->head_expires) return;
+
+  size_t steps = (size_t)((now - self->head_expires) / self->bucket_age) + 1;
+  if (steps > PROM_SUMMARY_AGE_BUCKETS) steps = PROM_SUMMARY_AGE_BUCKETS;
+  for (size_t i = 0; i < steps; i++) {
+    self->head = (self->head + 1) % PROM_SUMMARY_AGE_BUCKETS;
+    prom_tdigest_reset(&self->digests[self->head]);
+  }
+  // Align the next expiry with the bucket boundaries rather than with now, unless the window went idle entirely
+  self->head_expires += self->bucket_age * (double)steps;
+  if (self->head_expires <= now) self->head_expires = now + self->bucket_age;
+}
+
+/**
+ * @brief Returns a monotonic time in seconds. The window only needs coarse resolution, which Linux serves without
+ * reading the clock source.
+ */
+static double prom_metric_sample_summary_monotonic(void) {
+  struct timespec ts;
+#ifdef CLOCK_MONOTONIC_COARSE
+  clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+#else
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
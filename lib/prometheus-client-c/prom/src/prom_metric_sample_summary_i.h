@@ -0,0 +1,63 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PROM_METRIC_SAMPLE_SUMMARY_I_H
+#define PROM_METRIC_SAMPLE_SUMMARY_I_H
+
+#include <stdint.h>
+
+// Public
+#include "prom_metric_sample_summary.h"
+
+// Private
+#include "prom_metric_sample_summary_t.h"
+
+/**
+ * @brief API PRIVATE Returns a *prom_metric_sample_summary reporting the given quantiles over the last max_age
+ * seconds. The quantiles are borrowed and must outlive the sample.
+ */
+prom_metric_sample_summary_t *prom_metric_sample_summary_new(const char *name, size_t quantile_count,
+                                                             const double *quantiles, double max_age,
+                                                             size_t label_count, const char **label_keys,
+                                                             const char **label_values);
+
+/**
+ * @brief API PRIVATE Destroys a *prom_metric_sample_summary
+ */
+int prom_metric_sample_summary_destroy(prom_metric_sample_summary_t *self);
+
+/**
+ * @brief API PRIVATE takes a generic item, casts to a *prom_metric_sample_summary_t and destroys it
+ */
+int prom_metric_sample_summary_destroy_generic(void *gen);
+
+/**
+ * @brief API PRIVATE takes a generic item, casts to a *prom_metric_sample_summary_t and destroys it. Discards any
+ * errors.
+ */
+void prom_metric_sample_summary_free_generic(void *gen);
+
+/**
+ * @brief API PRIVATE Takes a consistent snapshot of the summary.
+ *
+ * values receives one estimate per quantile of the sample, computed over the observations of the sliding window, or
+ * NaN when the window is empty. count and sum cover every observation since the sample was created.
+ */
+int prom_metric_sample_summary_snapshot(prom_metric_sample_summary_t *self, double *values, uint64_t *count,
+                                        double *sum);
+
+#endif  // PROM_METRIC_SAMPLE_SUMMARY_I_H
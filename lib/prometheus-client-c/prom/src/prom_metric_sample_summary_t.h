@@ -0,0 +1,55 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PROM_METRIC_SAMPLE_SUMMARY_T_H
+#define PROM_METRIC_SAMPLE_SUMMARY_T_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+// Public
+#include "prom_metric_sample_summary.h"
+
+// Private
+#include "prom_tdigest_t.h"
+
+/**
+ * @brief API PRIVATE The number of digests the sliding window of a summary is split into. Each one covers
+ * max_age / PROM_SUMMARY_AGE_BUCKETS seconds, and the oldest is reset as the window slides past it.
+ */
+#define PROM_SUMMARY_AGE_BUCKETS 5
+
+#define PROM_METRIC_SAMPLE_SUMMARY_SUM 0
+#define PROM_METRIC_SAMPLE_SUMMARY_COUNT 1
+
+struct prom_metric_sample_summary {
+  pthread_mutex_t lock;                             /**< guards the digests, the window position, count and sum */
+  prom_tdigest_t digests[PROM_SUMMARY_AGE_BUCKETS]; /**< ring of digests; observations go to digests[head] */
+  size_t head;                                      /**< index of the digest that receives observations */
+  double head_expires;                              /**< monotonic time at which head moves to the next digest */
+  double bucket_age;                                /**< seconds of observations covered by each digest */
+  uint64_t count;                                   /**< number of observations since the sample was created */
+  double sum;                                       /**< sum of observations since the sample was created */
+  const double *quantiles;                          /**< quantiles to report, borrowed from the metric */
+  size_t quantile_count;                            /**< number of entries in quantiles */
+  const char **l_values;     /**< text format l_values in order: quantiles, sum and count */
+  const char **label_values; /**< owned copies of the user label values */
+  size_t label_count;        /**< number of entries in label_values */
+  double created;            /**< unix time at which the sample was created */
+};
+
+#endif  // PROM_METRIC_SAMPLE_SUMMARY_T_H
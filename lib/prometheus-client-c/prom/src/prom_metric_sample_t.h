@@ -17,13 +17,65 @@
 #ifndef PROM_METRIC_SAMPLE_T_H
 #define PROM_METRIC_SAMPLE_T_H
 
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "prom_group_t.h"
 #include "prom_metric_sample.h"
 #include "prom_metric_t.h"
 
+/**
+ * @brief API PRIVATE The combined length of exemplar label names and values. OpenMetrics limits the label set of an
+ * exemplar to 128 UTF-8 characters.
+ */
+#define PROM_METRIC_EXEMPLAR_LABELS_MAX 128
+
+/**
+ * @brief API PRIVATE The most recent exemplar recorded on a sample. Labels are packed as "key\0value\0key\0value\0".
+ */
+typedef struct prom_metric_exemplar {
+  pthread_mutex_t lock; /**< lock guards every other member */
+  size_t label_count;   /**< label_count is the number of packed key/value pairs */
+  size_t labels_len;    /**< labels_len is the number of bytes used in labels */
+  char labels[2 * PROM_METRIC_EXEMPLAR_LABELS_MAX]; /**< labels holds the names and values plus their terminators */
+  double value;     /**< value is the value that was observed */
+  double timestamp; /**< timestamp is the unix time of the observation in seconds */
+} prom_metric_exemplar_t;
+
+/**
+ * @brief API PRIVATE The number of cells a sharded counter sample spreads its increments over. Threads are handed cells
+ * round robin, so two threads only share a cell once there are more threads than cells.
+ */
+#define PROM_METRIC_SAMPLE_SHARDS 16
+
+/**
+ * @brief API PRIVATE The cache line size that each shard is padded to
+ */
+#define PROM_METRIC_SAMPLE_CACHE_LINE 64
+
+/**
+ * @brief API PRIVATE One cell of a sharded counter sample. Cells are padded to a cache line so that threads adding to
+ * different cells do not contend for the same line.
+ */
+typedef struct prom_metric_sample_shard {
+  _Alignas(PROM_METRIC_SAMPLE_CACHE_LINE) _Atomic double value; /**< value is the amount added through this cell */
+} prom_metric_sample_shard_t;
+
 struct prom_metric_sample {
-  prom_metric_type_t type; /**< type is the metric type for the sample */
-  char *l_value;           /**< l_value is the full metric name and label set represeted as a string */
-  _Atomic double r_value;  /**< r_value is the value of the metric sample */
+  prom_metric_type_t type;                  /**< type is the metric type for the sample */
+  const char *l_value;                      /**< l_value is the full metric name and label set represeted as a string */
+  _Atomic double r_value;                   /**< r_value is the value of the metric sample */
+  bool integer;                             /**< integer is true when the value is kept in i_value instead */
+  _Atomic uint64_t i_value; /**< i_value is the value of an integer sample; gauges read it as an int64_t */
+  const char **label_values;                /**< label_values are owned copies of the values of the metric's labels */
+  size_t label_count;                       /**< label_count is the number of entries in label_values */
+  double created;                           /**< created is the unix time at which the sample was created */
+  _Atomic(prom_metric_exemplar_t *) exemplar; /**< exemplar is NULL until an exemplar is recorded */
+  prom_metric_sample_shard_t *shards; /**< shards is NULL unless the sample belongs to a sharded counter */
+  void *shards_block;                 /**< shards_block is the allocation that shards is aligned within */
+  prom_group_t *group;                /**< group is the group of the sample's metric, or NULL */
+  uint64_t snapshots[PROM_GROUP_SLOTS]; /**< snapshots are values read by scrapes of group, as i_value or as bits */
 };
 
 #endif  // PROM_METRIC_SAMPLE_T_H
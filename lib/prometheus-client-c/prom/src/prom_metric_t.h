@@ -18,8 +18,12 @@
 #define PROM_METRIC_T_H
 
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
 
 // Public
+#include "prom_group.h"
 #include "prom_histogram_buckets.h"
 #include "prom_metric.h"
 
@@ -31,16 +35,21 @@
 /**
  * @brief API PRIVATE Contains metric type constants
  */
-typedef enum prom_metric_type { PROM_COUNTER, PROM_GAUGE, PROM_HISTOGRAM, PROM_SUMMARY } prom_metric_type_t;
+typedef enum prom_metric_type {
+  PROM_COUNTER,
+  PROM_GAUGE,
+  PROM_HISTOGRAM,
+  PROM_SUMMARY,
+  PROM_NATIVE_HISTOGRAM
+} prom_metric_type_t;
 
 /**
  * @brief API PRIVATE Maps metric type constants to human readable string values
  */
-extern char *prom_metric_type_map[4];
+extern char *prom_metric_type_map[5];
 
 /**
- * @brief API PRIVATE An opaque struct to users containing metric metadata; one or more metric samples; and a metric
- * formatter for locating metric samples and exporting metric data
+ * @brief API PRIVATE An opaque struct to users containing metric metadata and one or more metric samples
  */
 struct prom_metric {
   prom_metric_type_t type;            /**< metric_type      The type of metric */
@@ -49,9 +58,21 @@ struct prom_metric {
   prom_map_t *samples;                /**< samples          Map comprised of samples for the given metric */
   prom_histogram_buckets_t *buckets;  /**< buckets          Array of histogram bucket upper bound values */
   size_t label_key_count;             /**< label_keys_count The count of labe_keys*/
-  prom_metric_formatter_t *formatter; /**< formatter        The metric formatter  */
   pthread_rwlock_t *rwlock;           /**< rwlock           Required for locking on certain non-atomic operations */
   const char **label_keys;            /**< labels           Array comprised of const char **/
+  bool sharded;                       /**< sharded          Counter samples spread increments over per-thread cells */
+  bool integer;                       /**< integer          Samples hold a 64-bit integer instead of a double */
+  const double *quantiles;            /**< quantiles        Quantiles reported by a summary, owned by the metric */
+  size_t quantile_count;              /**< quantile_count   The count of quantiles */
+  double max_age;                     /**< max_age          Seconds of observations a summary's quantiles cover */
+  int32_t schema;                     /**< schema           Starting resolution of native histogram samples */
+  size_t max_buckets;                 /**< max_buckets      Most buckets a native histogram sample may hold */
+  size_t max_series;                  /**< max_series       Most samples the metric may hold. 0 for no limit */
+  uint64_t series_ttl;                /**< series_ttl       Sweeps a sample may go without updates. 0 keeps them all */
+  _Atomic uint64_t sweeps;            /**< sweeps           Sweeps so far. Updates stamp their sample with it */
+  _Atomic uint64_t dropped_series;    /**< dropped_series   Lookups refused because the metric held max_series */
+  _Atomic uint64_t evicted_series;    /**< evicted_series   Samples removed for going series_ttl sweeps unused */
+  prom_group_t *group;                /**< group            Group the metric is published with, or NULL */
 };
 
 #endif  // PROM_METRIC_T_H
@@ -0,0 +1,81 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// Public
+#include "prom_alloc.h"
+#include "prom_native_histogram.h"
+
+// Private
+#include "prom_assert.h"
+#include "prom_epoch_i.h"
+#include "prom_errors.h"
+#include "prom_log.h"
+#include "prom_metric_i.h"
+#include "prom_metric_sample_native_histogram_i.h"
+#include "prom_metric_t.h"
+
+prom_native_histogram_t *prom_native_histogram_new(const char *name, const char *help, int32_t schema,
+                                                   size_t max_buckets, size_t label_key_count,
+                                                   const char **label_keys) {
+  if (schema < PROM_NATIVE_HISTOGRAM_MIN_SCHEMA || schema > PROM_NATIVE_HISTOGRAM_MAX_SCHEMA) {
+    PROM_LOG(PROM_NATIVE_HISTOGRAM_INVALID_SCHEMA);
+    return NULL;
+  }
+
+  prom_native_histogram_t *self = (prom_native_histogram_t *)prom_metric_new(PROM_NATIVE_HISTOGRAM, name, help,
+                                                                             label_key_count, label_keys);
+  if (self == NULL) return NULL;
+  self->schema = schema;
+  self->max_buckets = max_buckets > 0 ? max_buckets : PROM_NATIVE_HISTOGRAM_DEFAULT_MAX_BUCKETS;
+  return self;
+}
+
+int prom_native_histogram_destroy(prom_native_histogram_t *self) {
+  PROM_ASSERT(self != NULL);
+
+  int r = 0;
+
+  if (self == NULL) return r;
+  r = prom_metric_destroy(self);
+  self = NULL;
+  return r;
+}
+
+int prom_native_histogram_observe(prom_native_histogram_t *self, double value, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (self->type != PROM_NATIVE_HISTOGRAM) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  prom_epoch_enter();
+  prom_metric_sample_native_histogram_t *sample = prom_metric_sample_native_histogram_for_update(self, label_values);
+  int r = sample == NULL ? 1 : prom_metric_sample_native_histogram_observe(sample, value);
+  prom_epoch_exit();
+  return r;
+}
+
+prom_metric_sample_native_histogram_t *prom_native_histogram_child(prom_native_histogram_t *self,
+                                                                   const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return NULL;
+  if (self->type != PROM_NATIVE_HISTOGRAM) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return NULL;
+  }
+  return prom_metric_sample_native_histogram_from_labels(self, label_values);
+}
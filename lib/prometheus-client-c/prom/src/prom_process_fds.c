@@ -14,8 +14,11 @@
  * limitations under the License.
  */
 
-#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -26,40 +29,59 @@
 // Private
 #include "prom_errors.h"
 #include "prom_log.h"
+#include "prom_process_fds_i.h"
 #include "prom_process_fds_t.h"
 
 prom_gauge_t *prom_process_open_fds;
 
+// The record getdents64 fills the buffer with. glibc only declares a wrapper from 2.30, so the system call is made
+// directly.
+typedef struct prom_process_fds_dirent {
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+} prom_process_fds_dirent_t;
+
 int prom_process_fds_count(const char *path) {
-  int count = 0;
-  int r = 0;
-  struct dirent *de;
-  DIR *d;
+  int fd;
   if (path) {
-    d = opendir(path);
-    if (d == NULL) {
-      PROM_LOG(PROM_STDIO_OPEN_DIR_ERROR);
-      return -1;
-    }
+    fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
   } else {
     int pid = (int)getpid();
     char p[50];
     sprintf(p, "/proc/%d/fd", pid);
-    d = opendir(p);
-    if (d == NULL) {
-      PROM_LOG(PROM_STDIO_OPEN_DIR_ERROR);
-      return -1;
-    }
+    fd = open(p, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  }
+  if (fd < 0) {
+    PROM_LOG(PROM_STDIO_OPEN_DIR_ERROR);
+    return -1;
   }
 
-  while ((de = readdir(d)) != NULL) {
-    if (strcmp(".", de->d_name) == 0 || strcmp("..", de->d_name) == 0) {
-      continue;
+  // Each call fills the buffer with as many entries as fit. As with readdir, the descriptor used for the walk is one
+  // of the entries counted.
+  _Alignas(prom_process_fds_dirent_t) char buf[PROM_PROCESS_FDS_BUF_SIZE];
+  int count = 0;
+  for (;;) {
+    long n = syscall(SYS_getdents64, fd, buf, sizeof(buf));
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) {
+      PROM_LOG(PROM_STDIO_READ_DIR_ERROR);
+      close(fd);
+      return -1;
+    }
+    if (n == 0) break;
+    for (long offset = 0; offset < n;) {
+      prom_process_fds_dirent_t *de = (prom_process_fds_dirent_t *)(buf + offset);
+      offset += de->d_reclen;
+      const char *name = de->d_name;
+      if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+      count++;
     }
-    count++;
   }
-  r = closedir(d);
-  if (r) {
+
+  if (close(fd)) {
     PROM_LOG(PROM_STDIO_CLOSE_DIR_ERROR);
     return -1;
   }
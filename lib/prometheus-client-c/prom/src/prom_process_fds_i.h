@@ -17,6 +17,16 @@
 #ifndef PROM_PROESS_FDS_I_INCLUDED
 #define PROM_PROESS_FDS_I_INCLUDED
 
+/**
+ * @brief API PRIVATE The size of the buffer prom_process_fds_count reads directory entries into. At 24 to 32 bytes an
+ * entry, a call returns over a thousand descriptors.
+ */
+#define PROM_PROCESS_FDS_BUF_SIZE 32768
+
+/**
+ * @brief API PRIVATE Returns the number of entries in the directory at path, or in /proc/[pid]/fd if path is NULL.
+ * Returns -1 upon failure.
+ */
 int prom_process_fds_count(const char *path);
 int prom_process_fds_init(void);
 
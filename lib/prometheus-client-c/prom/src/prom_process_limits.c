@@ -18,6 +18,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -206,6 +207,37 @@ prom_map_t *prom_process_limits(prom_process_limits_file_t *f) {
   return m;
 }
 
+int prom_process_limits_soft(prom_process_limits_file_t *f, const char *limit, double *soft) {
+  PROM_ASSERT(f != NULL);
+  size_t limit_len = strlen(limit);
+  const char *line = f->buf;
+  const char *end = f->buf + f->size - 1;
+  while (line < end) {
+    const char *eol = memchr(line, '\n', end - line);
+    if (eol == NULL) eol = end;
+
+    // Columns are separated by at least two spaces, which tells a limit from a longer one it is a prefix of
+    if ((size_t)(eol - line) > limit_len + 2 && memcmp(line, limit, limit_len) == 0 && line[limit_len] == ' ' &&
+        line[limit_len + 1] == ' ') {
+      const char *value = line + limit_len;
+      while (value < eol && *value == ' ') value++;
+      size_t unlimited_len = strlen(PROM_PROCESS_LIMITS_RDP_UNLIMITED);
+      if ((size_t)(eol - value) >= unlimited_len &&
+          memcmp(value, PROM_PROCESS_LIMITS_RDP_UNLIMITED, unlimited_len) == 0) {
+        *soft = -1;
+        return 0;
+      }
+      char *value_end = NULL;
+      unsigned long long n = strtoull(value, &value_end, 10);
+      if (value_end == value) return 1;
+      *soft = (double)n;
+      return 0;
+    }
+    line = eol + 1;
+  }
+  return 1;
+}
+
 bool prom_process_limits_rdp_file(prom_process_limits_file_t *f, prom_map_t *map,
                                   prom_process_limits_current_row_t *current_row) {
   if (!prom_process_limits_rdp_first_line(f, map, current_row)) return false;
@@ -41,6 +41,12 @@ prom_process_limits_file_t *prom_process_limits_file_new(const char *path);
 int prom_process_limits_file_destroy(prom_process_limits_file_t *self);
 
 prom_map_t *prom_process_limits(prom_process_limits_file_t *f);
+
+/**
+ * @brief API PRIVATE Reads the soft value of one limit, such as "Max open files", from f without allocating.
+ * "unlimited" reads as -1, as it does in prom_process_limits. Returns non-zero if the limit is not found.
+ */
+int prom_process_limits_soft(prom_process_limits_file_t *f, const char *limit, double *soft);
 bool prom_process_limits_rdp_file(prom_process_limits_file_t *f, prom_map_t *data,
                                   prom_process_limits_current_row_t *current_row);
 bool prom_process_limits_rdp_first_line(prom_process_limits_file_t *f, prom_map_t *data,
@@ -21,8 +21,12 @@
 
 prom_process_stat_file_t *prom_process_stat_file_new(const char *path);
 int prom_process_stat_file_destroy(prom_process_stat_file_t *self);
-prom_process_stat_t *prom_process_stat_new(prom_process_stat_file_t *stat_f);
-int prom_process_stat_destroy(prom_process_stat_t *self);
+
+/**
+ * @brief API PRIVATE Parses the contents of stat_f into self, which is typically kept across collections. Returns
+ * non-zero if the fields up to rss cannot be read.
+ */
+int prom_process_stat_parse(prom_process_stat_t *self, prom_process_stat_file_t *stat_f);
 int prom_process_stats_init(void);
 
 #endif  // PROM_PROCESS_STATS_I_H
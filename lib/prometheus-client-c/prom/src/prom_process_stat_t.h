@@ -25,12 +25,17 @@ extern prom_gauge_t *prom_process_virtual_memory_bytes;
 extern prom_gauge_t *prom_process_resident_memory_bytes;
 extern prom_gauge_t *prom_process_start_time_seconds;
 
+/**
+ * @brief API PRIVATE The size of prom_process_stat_t.comm. The kernel truncates comm to 15 characters.
+ */
+#define PROM_PROCESS_STAT_COMM_SIZE 128
+
 /**
  * @brief Refer to man proc and search for /proc/[pid]/stat
  */
 typedef struct prom_process_stat {
   int pid;                                   // (1) pid  %d
-  char *comm;                                // (2) comm  %s
+  char comm[PROM_PROCESS_STAT_COMM_SIZE];    // (2) comm  %s
   char state;                                // (3) state  %c
   int ppid;                                  // (4) ppid  %d
   int pgrp;                                  // (5) pgrp  %d
@@ -15,10 +15,10 @@
  */
 
 #include <errno.h>
-#include <stdio.h>
-#include <stdlib.h>
+#include <fcntl.h>
 #include <string.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 // Public
 #include "prom_alloc.h"
@@ -28,72 +28,76 @@
 #include "prom_log.h"
 #include "prom_procfs_i.h"
 
-static int prom_procfs_ensure_buf_size(prom_procfs_buf_t *self) {
-  PROM_ASSERT(self != NULL);
-  if (self->allocated >= self->size + 1) return 0;
-  while (self->allocated < self->size + 1) self->allocated <<= 1;
-  self->buf = (char *)prom_realloc(self->buf, self->allocated);
-  return 0;
+static void prom_procfs_log_errno(void) {
+  char errbuf[100];
+  strerror_r(errno, errbuf, sizeof(errbuf));
+  PROM_LOG(errbuf);
 }
 
 prom_procfs_buf_t *prom_procfs_buf_new(const char *path) {
-  int r = 0;
-
-  FILE *f = fopen(path, "r");
-  char errbuf[100];
-
-  if (f == NULL) {
-    strerror_r(errno, errbuf, 100);
-    PROM_LOG(errbuf);
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    prom_procfs_log_errno();
     return NULL;
   }
 
-#define PROM_PROCFS_BUF_NEW_HANDLE_F_CLOSE(f) \
-  r = fclose(f);                              \
-  if (r) {                                    \
-    strerror_r(errno, errbuf, 100);           \
-    PROM_LOG(errbuf);                         \
-  }
-
-  unsigned short int initial_size = 32;
   prom_procfs_buf_t *self = prom_malloc(sizeof(prom_procfs_buf_t));
-  self->buf = prom_malloc(initial_size);
+  if (self == NULL) {
+    close(fd);
+    return NULL;
+  }
+  self->fd = fd;
   self->size = 0;
   self->index = 0;
-  self->allocated = initial_size;
-
-  for (int current_char = getc(f), i = 0; current_char != EOF; current_char = getc(f), i++) {
-    r = prom_procfs_ensure_buf_size(self);
-    if (r) {
-      prom_procfs_buf_destroy(self);
-      self = NULL;
-      PROM_PROCFS_BUF_NEW_HANDLE_F_CLOSE(f);
-      return NULL;
-    }
-    self->buf[i] = current_char;
-    self->size++;
-  }
-  r = prom_procfs_ensure_buf_size(self);
-  if (r) {
+  self->allocated = PROM_PROCFS_BUF_INITIAL_SIZE;
+  self->buf = prom_malloc(self->allocated);
+  if (self->buf == NULL || prom_procfs_buf_read(self)) {
     prom_procfs_buf_destroy(self);
-    self = NULL;
-    PROM_PROCFS_BUF_NEW_HANDLE_F_CLOSE(f);
     return NULL;
   }
+  return self;
+}
 
-  self->buf[self->size] = '\0';
-  self->size++;
+int prom_procfs_buf_read(prom_procfs_buf_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL || self->fd < 0) return 1;
 
-  PROM_PROCFS_BUF_NEW_HANDLE_F_CLOSE(f);
-  if (r) return NULL;
-  return self;
+  // procfs generates the contents on every read from offset 0, so pread needs no seek and sees a fresh copy
+  size_t len = 0;
+  for (;;) {
+    if (len + 1 == self->allocated) {
+      char *buf = (char *)prom_realloc(self->buf, self->allocated * 2);
+      if (buf == NULL) return 1;
+      self->buf = buf;
+      self->allocated *= 2;
+    }
+    ssize_t n = pread(self->fd, self->buf + len, self->allocated - 1 - len, (off_t)len);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      prom_procfs_log_errno();
+      return 1;
+    }
+    if (n == 0) break;
+    len += (size_t)n;
+  }
+
+  // size counts the terminating NUL
+  self->buf[len] = '\0';
+  self->size = len + 1;
+  self->index = 0;
+  return 0;
 }
 
 int prom_procfs_buf_destroy(prom_procfs_buf_t *self) {
   PROM_ASSERT(self != NULL);
   if (self == NULL) return 0;
+  int r = 0;
+  if (self->fd >= 0) {
+    r = close(self->fd);
+    if (r) prom_procfs_log_errno();
+  }
   prom_free(self->buf);
   prom_free(self);
   self = NULL;
-  return 0;
+  return r;
 }
@@ -19,8 +19,18 @@
 
 #include "prom_procfs_t.h"
 
+/**
+ * @brief API PRIVATE Opens the file at path and reads all of it into a new buffer. The file stays open until the
+ * buffer is destroyed.
+ */
 prom_procfs_buf_t *prom_procfs_buf_new(const char *path);
 
+/**
+ * @brief API PRIVATE Reads the file again from the start into the same buffer, which only grows when the contents no
+ * longer fit. Returns non-zero upon failure.
+ */
+int prom_procfs_buf_read(prom_procfs_buf_t *self);
+
 int prom_procfs_buf_destroy(prom_procfs_buf_t *self);
 
 #endif  // PROM_PROCFS_I_H
@@ -17,11 +17,20 @@
 #ifndef PROM_PROCFS_T_H
 #define PROM_PROCFS_T_H
 
+#include <stddef.h>
+
+/**
+ * @brief API PRIVATE The size a procfs buffer starts at. /proc/self/stat and /proc/self/limits fit, so each is read
+ * with one read(2) plus the one that reports the end of the file.
+ */
+#define PROM_PROCFS_BUF_INITIAL_SIZE 4096
+
 typedef struct prom_procfs_buf {
   size_t allocated;
   size_t size;
   size_t index;
   char *buf;
+  int fd; /**< fd stays open so that prom_procfs_buf_read can read the file again. -1 if the file is not open */
 } prom_procfs_buf_t;
 
 #endif  // PROM_PROCFS_T_H
@@ -0,0 +1,150 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+// Private
+#include "prom_assert.h"
+#include "prom_protobuf_i.h"
+#include "prom_string_builder_i.h"
+
+size_t prom_protobuf_varint_size(uint64_t value) {
+  size_t size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    size++;
+  }
+  return size;
+}
+
+uint64_t prom_protobuf_zigzag(int64_t value) { return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63); }
+
+size_t prom_protobuf_len_field_size(uint32_t field, size_t len) {
+  return prom_protobuf_varint_size((uint64_t)field << 3) + prom_protobuf_varint_size(len) + len;
+}
+
+size_t prom_protobuf_varint_field_size(uint32_t field, uint64_t value) {
+  return prom_protobuf_varint_size((uint64_t)field << 3) + prom_protobuf_varint_size(value);
+}
+
+size_t prom_protobuf_string_field_size(uint32_t field, const char *str) {
+  if (str == NULL || *str == '\0') return 0;
+  return prom_protobuf_len_field_size(field, strlen(str));
+}
+
+size_t prom_protobuf_double_field_size(uint32_t field) { return prom_protobuf_varint_size((uint64_t)field << 3) + 8; }
+
+// Splits unix_seconds into the seconds and nanos members of a google.protobuf.Timestamp and returns the size of the
+// encoded message content
+static size_t prom_protobuf_timestamp_split(double unix_seconds, int64_t *seconds, int64_t *nanos) {
+  *seconds = (int64_t)unix_seconds;
+  if ((double)*seconds > unix_seconds) (*seconds)--;
+  *nanos = (int64_t)((unix_seconds - (double)*seconds) * 1e9);
+
+  size_t len = 0;
+  if (*seconds != 0) len += prom_protobuf_varint_field_size(1, (uint64_t)*seconds);
+  if (*nanos != 0) len += prom_protobuf_varint_field_size(2, (uint64_t)*nanos);
+  return len;
+}
+
+size_t prom_protobuf_timestamp_field_size(uint32_t field, double unix_seconds) {
+  int64_t seconds, nanos;
+  return prom_protobuf_len_field_size(field, prom_protobuf_timestamp_split(unix_seconds, &seconds, &nanos));
+}
+
+int prom_protobuf_add_varint(prom_string_builder_t *sb, uint64_t value) {
+  PROM_ASSERT(sb != NULL);
+  char buf[10];
+  size_t i = 0;
+  while (value >= 0x80) {
+    buf[i++] = (char)((value & 0x7F) | 0x80);
+    value >>= 7;
+  }
+  buf[i++] = (char)value;
+  return prom_string_builder_add_n(sb, buf, i);
+}
+
+int prom_protobuf_add_tag(prom_string_builder_t *sb, uint32_t field, prom_protobuf_wire_type_t wire_type) {
+  return prom_protobuf_add_varint(sb, ((uint64_t)field << 3) | wire_type);
+}
+
+int prom_protobuf_add_varint_field(prom_string_builder_t *sb, uint32_t field, uint64_t value) {
+  int r = 0;
+  r = prom_protobuf_add_tag(sb, field, PROM_PROTOBUF_VARINT);
+  if (r) return r;
+  return prom_protobuf_add_varint(sb, value);
+}
+
+int prom_protobuf_add_int_field(prom_string_builder_t *sb, uint32_t field, int64_t value) {
+  return prom_protobuf_add_varint_field(sb, field, (uint64_t)value);
+}
+
+int prom_protobuf_add_sint_field(prom_string_builder_t *sb, uint32_t field, int64_t value) {
+  return prom_protobuf_add_varint_field(sb, field, prom_protobuf_zigzag(value));
+}
+
+int prom_protobuf_add_double_field(prom_string_builder_t *sb, uint32_t field, double value) {
+  int r = 0;
+  r = prom_protobuf_add_tag(sb, field, PROM_PROTOBUF_FIXED64);
+  if (r) return r;
+
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  char buf[8];
+  for (int i = 0; i < 8; i++) {
+    buf[i] = (char)(bits >> (8 * i));
+  }
+  return prom_string_builder_add_n(sb, buf, sizeof(buf));
+}
+
+int prom_protobuf_add_message_header(prom_string_builder_t *sb, uint32_t field, size_t len) {
+  int r = 0;
+  r = prom_protobuf_add_tag(sb, field, PROM_PROTOBUF_LEN);
+  if (r) return r;
+  return prom_protobuf_add_varint(sb, len);
+}
+
+int prom_protobuf_add_bytes_field(prom_string_builder_t *sb, uint32_t field, const char *data, size_t len) {
+  int r = 0;
+  r = prom_protobuf_add_message_header(sb, field, len);
+  if (r) return r;
+  return prom_string_builder_add_n(sb, data, len);
+}
+
+int prom_protobuf_add_string_field(prom_string_builder_t *sb, uint32_t field, const char *str) {
+  if (str == NULL || *str == '\0') return 0;
+  return prom_protobuf_add_bytes_field(sb, field, str, strlen(str));
+}
+
+int prom_protobuf_add_timestamp_field(prom_string_builder_t *sb, uint32_t field, double unix_seconds) {
+  int r = 0;
+  int64_t seconds, nanos;
+
+  // google.protobuf.Timestamp { int64 seconds = 1; int32 nanos = 2; }
+  size_t len = prom_protobuf_timestamp_split(unix_seconds, &seconds, &nanos);
+
+  r = prom_protobuf_add_message_header(sb, field, len);
+  if (r) return r;
+  if (seconds != 0) {
+    r = prom_protobuf_add_int_field(sb, 1, seconds);
+    if (r) return r;
+  }
+  if (nanos != 0) {
+    r = prom_protobuf_add_int_field(sb, 2, nanos);
+    if (r) return r;
+  }
+  return 0;
+}
@@ -0,0 +1,125 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Reference: https://protobuf.dev/programming-guides/encoding/
+
+#ifndef PROM_PROTOBUF_I_H
+#define PROM_PROTOBUF_I_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Private
+#include "prom_string_builder_t.h"
+
+/**
+ * @brief API PRIVATE Protocol buffer wire types
+ */
+typedef enum prom_protobuf_wire_type {
+  PROM_PROTOBUF_VARINT = 0,
+  PROM_PROTOBUF_FIXED64 = 1,
+  PROM_PROTOBUF_LEN = 2,
+  PROM_PROTOBUF_FIXED32 = 5
+} prom_protobuf_wire_type_t;
+
+/**
+ * @brief API PRIVATE Returns the number of bytes required to encode value as a varint
+ */
+size_t prom_protobuf_varint_size(uint64_t value);
+
+/**
+ * @brief API PRIVATE Returns the zigzag encoding of a signed value, as used by sint32 and sint64 fields
+ */
+uint64_t prom_protobuf_zigzag(int64_t value);
+
+/**
+ * @brief API PRIVATE Returns the number of bytes required to encode a length-delimited field holding len bytes
+ */
+size_t prom_protobuf_len_field_size(uint32_t field, size_t len);
+
+/**
+ * @brief API PRIVATE Returns the number of bytes required to encode an unsigned varint field
+ */
+size_t prom_protobuf_varint_field_size(uint32_t field, uint64_t value);
+
+/**
+ * @brief API PRIVATE Returns the number of bytes required to encode a string field. Empty strings take no space.
+ */
+size_t prom_protobuf_string_field_size(uint32_t field, const char *str);
+
+/**
+ * @brief API PRIVATE Returns the number of bytes required to encode a double field
+ */
+size_t prom_protobuf_double_field_size(uint32_t field);
+
+/**
+ * @brief API PRIVATE Returns the number of bytes required to encode a google.protobuf.Timestamp message field
+ */
+size_t prom_protobuf_timestamp_field_size(uint32_t field, double unix_seconds);
+
+/**
+ * @brief API PRIVATE Appends value as a base 128 varint
+ */
+int prom_protobuf_add_varint(prom_string_builder_t *sb, uint64_t value);
+
+/**
+ * @brief API PRIVATE Appends a field tag
+ */
+int prom_protobuf_add_tag(prom_string_builder_t *sb, uint32_t field, prom_protobuf_wire_type_t wire_type);
+
+/**
+ * @brief API PRIVATE Appends an unsigned varint field (uint32, uint64, enum, bool)
+ */
+int prom_protobuf_add_varint_field(prom_string_builder_t *sb, uint32_t field, uint64_t value);
+
+/**
+ * @brief API PRIVATE Appends a signed varint field (int32, int64). Negative values are sign extended as required by
+ * the specification.
+ */
+int prom_protobuf_add_int_field(prom_string_builder_t *sb, uint32_t field, int64_t value);
+
+/**
+ * @brief API PRIVATE Appends a zigzag encoded varint field (sint32, sint64)
+ */
+int prom_protobuf_add_sint_field(prom_string_builder_t *sb, uint32_t field, int64_t value);
+
+/**
+ * @brief API PRIVATE Appends a double field
+ */
+int prom_protobuf_add_double_field(prom_string_builder_t *sb, uint32_t field, double value);
+
+/**
+ * @brief API PRIVATE Appends a length-delimited field holding len bytes of data
+ */
+int prom_protobuf_add_bytes_field(prom_string_builder_t *sb, uint32_t field, const char *data, size_t len);
+
+/**
+ * @brief API PRIVATE Appends a string field. Empty strings are omitted as they are the proto3 default.
+ */
+int prom_protobuf_add_string_field(prom_string_builder_t *sb, uint32_t field, const char *str);
+
+/**
+ * @brief API PRIVATE Appends the tag and length prefix of an embedded message whose encoded size is len. The caller
+ * MUST append exactly len bytes of message content afterwards.
+ */
+int prom_protobuf_add_message_header(prom_string_builder_t *sb, uint32_t field, size_t len);
+
+/**
+ * @brief API PRIVATE Appends a google.protobuf.Timestamp message field for the given unix time in seconds
+ */
+int prom_protobuf_add_timestamp_field(prom_string_builder_t *sb, uint32_t field, double unix_seconds);
+
+#endif  // PROM_PROTOBUF_I_H
@@ -0,0 +1,179 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Public
+#include "prom_alloc.h"
+#include "prom_rate.h"
+
+// Private
+#include "prom_assert.h"
+#include "prom_errors.h"
+#include "prom_log.h"
+#include "prom_metric_sample_t.h"
+#include "prom_rate_i.h"
+#include "prom_rate_t.h"
+
+prom_rate_t *prom_rate_new(void) {
+  prom_rate_t *self = (prom_rate_t *)prom_malloc(sizeof(prom_rate_t));
+  if (self == NULL) return NULL;
+  self->count = 0;
+  self->capacity = 0;
+  self->raw = NULL;
+  self->previous = NULL;
+  self->mask = NULL;
+  self->increase = NULL;
+  self->stamp = NULL;
+  self->rate = NULL;
+  self->observed = NULL;
+  self->primed = NULL;
+  self->counters = NULL;
+  self->rates = NULL;
+  return self;
+}
+
+int prom_rate_destroy(prom_rate_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 0;
+  prom_free(self->raw);
+  prom_free(self->previous);
+  prom_free(self->mask);
+  prom_free(self->increase);
+  prom_free(self->stamp);
+  prom_free(self->rate);
+  prom_free(self->observed);
+  prom_free(self->primed);
+  prom_free(self->counters);
+  prom_free(self->rates);
+  prom_free(self);
+  self = NULL;
+  return 0;
+}
+
+// Grows one array to the given number of series. The array is left as it was on failure.
+static int prom_rate_grow_array(void **array, size_t capacity, size_t size) {
+  void *grown = prom_realloc(*array, capacity * size);
+  if (grown == NULL) return 1;
+  *array = grown;
+  return 0;
+}
+
+static int prom_rate_grow(prom_rate_t *self) {
+  size_t capacity = self->capacity == 0 ? PROM_RATE_INITIAL_CAPACITY : self->capacity * 2;
+  // Arrays grown before a failure keep their larger size, which is harmless as capacity is only raised on success
+  if (prom_rate_grow_array((void **)&self->raw, capacity, sizeof(uint64_t))) return 1;
+  if (prom_rate_grow_array((void **)&self->previous, capacity, sizeof(uint64_t))) return 1;
+  if (prom_rate_grow_array((void **)&self->mask, capacity, sizeof(uint64_t))) return 1;
+  if (prom_rate_grow_array((void **)&self->increase, capacity, sizeof(uint64_t))) return 1;
+  if (prom_rate_grow_array((void **)&self->stamp, capacity, sizeof(double))) return 1;
+  if (prom_rate_grow_array((void **)&self->rate, capacity, sizeof(double))) return 1;
+  if (prom_rate_grow_array((void **)&self->observed, capacity, sizeof(uint8_t))) return 1;
+  if (prom_rate_grow_array((void **)&self->primed, capacity, sizeof(uint8_t))) return 1;
+  if (prom_rate_grow_array((void **)&self->counters, capacity, sizeof(prom_metric_sample_t *))) return 1;
+  if (prom_rate_grow_array((void **)&self->rates, capacity, sizeof(prom_metric_sample_t *))) return 1;
+  self->capacity = capacity;
+  return 0;
+}
+
+int prom_rate_add(prom_rate_t *self, prom_metric_sample_t *counter, prom_metric_sample_t *rate, unsigned int bits,
+                  size_t *index) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL || counter == NULL || index == NULL) return 1;
+  if (counter->type != PROM_COUNTER || (rate != NULL && rate->type != PROM_GAUGE)) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  if (bits == 0 || bits > 64) {
+    PROM_LOG(PROM_RATE_BITS_ERROR);
+    return 1;
+  }
+  if (self->count == self->capacity && prom_rate_grow(self)) return 1;
+
+  size_t i = self->count++;
+  self->raw[i] = 0;
+  self->previous[i] = 0;
+  self->mask[i] = bits == 64 ? UINT64_MAX : (UINT64_C(1) << bits) - 1;
+  self->increase[i] = 0;
+  self->stamp[i] = 0.0;
+  self->rate[i] = 0.0;
+  self->observed[i] = 0;
+  self->primed[i] = 0;
+  self->counters[i] = counter;
+  self->rates[i] = rate;
+  *index = i;
+  return 0;
+}
+
+int prom_rate_observe(prom_rate_t *self, size_t index, uint64_t value) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (index >= self->count) {
+    PROM_LOG(PROM_RATE_INDEX_ERROR);
+    return 1;
+  }
+  self->raw[index] = value & self->mask[index];
+  self->observed[index] = 1;
+  return 0;
+}
+
+// No early exits or calls in the loop, so that the compiler can vectorize it. Series that were not observed go through
+// the same arithmetic and have its results discarded by the selects at the end.
+void prom_rate_compute(size_t count, double now, const uint64_t *restrict raw, const uint64_t *restrict mask,
+                       const uint8_t *restrict observed, uint64_t *restrict previous, uint64_t *restrict increase,
+                       double *restrict stamp, double *restrict rate, uint8_t *restrict primed) {
+  for (size_t i = 0; i < count; i++) {
+    uint64_t value = raw[i];
+    uint64_t last = previous[i];
+    int decreased = value < last;
+    // Only counters narrower than 64 bits wrap in practice, and only from close to the top of their range
+    int wrapped = decreased & (mask[i] != UINT64_MAX) & (last > mask[i] - (mask[i] >> 2));
+    uint64_t delta = wrapped ? (value - last) & mask[i] : decreased ? value : value - last;
+    double elapsed = now - stamp[i];
+    // isgreater is a quiet comparison, and dividing unconditionally keeps the division out of a branch
+    int timed = isgreater(elapsed, 0.0);
+    double per_second = (double)delta / (timed ? elapsed : 1.0);
+    per_second = primed[i] ? per_second : 0.0;
+    // A series observed twice at the same time keeps its rate
+    int refresh = observed[i] & (timed | !primed[i]);
+
+    increase[i] = observed[i] ? delta : 0;
+    rate[i] = refresh ? per_second : rate[i];
+    previous[i] = observed[i] ? value : last;
+    stamp[i] = observed[i] ? now : stamp[i];
+    primed[i] |= observed[i];
+  }
+}
+
+int prom_rate_update(prom_rate_t *self, double now) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  prom_rate_compute(self->count, now, self->raw, self->mask, self->observed, self->previous, self->increase,
+                    self->stamp, self->rate, self->primed);
+
+  int r = 0;
+  for (size_t i = 0; i < self->count; i++) {
+    if (!self->observed[i]) continue;
+    self->observed[i] = 0;
+    if (self->increase[i] != 0 && prom_metric_sample_add_u64(self->counters[i], self->increase[i])) r = 1;
+    if (self->rates[i] != NULL && prom_metric_sample_set(self->rates[i], self->rate[i])) r = 1;
+  }
+  return r;
+}
@@ -0,0 +1,38 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#ifndef PROM_RATE_I_H
+#define PROM_RATE_I_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Private
+#include "prom_rate_t.h"
+
+/**
+ * @brief API PRIVATE Computes the increase and rate of count series in one pass over the arrays of a prom_rate_t*.
+ *
+ * The arrays are passed as restrict parameters rather than read from the struct, and the function is kept out of line,
+ * because that is what lets the compiler vectorize the pass without checking the arrays for overlap.
+ */
+void prom_rate_compute(size_t count, double now, const uint64_t *restrict raw, const uint64_t *restrict mask,
+                       const uint8_t *restrict observed, uint64_t *restrict previous, uint64_t *restrict increase,
+                       double *restrict stamp, double *restrict rate, uint8_t *restrict primed);
+
+#endif  // PROM_RATE_I_H
@@ -0,0 +1,50 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#ifndef PROM_RATE_T_H
+#define PROM_RATE_T_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Public
+#include "prom_metric_sample.h"
+#include "prom_rate.h"
+
+/**
+ * @brief API PRIVATE The number of series a prom_rate_t* makes room for when it first grows
+ */
+#define PROM_RATE_INITIAL_CAPACITY 16
+
+// The series are stored as parallel arrays indexed by series, so that prom_rate_update walks each field contiguously
+struct prom_rate {
+  size_t count;                    /**< count is the number of series */
+  size_t capacity;                 /**< capacity is the number of series the arrays have room for */
+  uint64_t *raw;                   /**< raw holds the values staged by prom_rate_observe */
+  uint64_t *previous;              /**< previous holds the raw values seen by the last update that observed a series */
+  uint64_t *mask;                  /**< mask holds the largest raw value of each series */
+  uint64_t *increase;              /**< increase holds the increases computed by the last update */
+  double *stamp;                   /**< stamp holds the time of the last update that observed a series */
+  double *rate;                    /**< rate holds the per-second rates computed by the last update */
+  uint8_t *observed;               /**< observed is set for the series staged since the last update */
+  uint8_t *primed;                 /**< primed is set for the series that have been through an update */
+  prom_metric_sample_t **counters; /**< counters are the samples that receive the increases */
+  prom_metric_sample_t **rates;    /**< rates are the samples set to the rates, NULL for series without one */
+};
+
+#endif  // PROM_RATE_T_H
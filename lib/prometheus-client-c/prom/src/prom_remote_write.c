@@ -0,0 +1,815 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <errno.h>
+#include <netdb.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+// Public
+#include "prom_alloc.h"
+#include "prom_remote_write.h"
+#include "prom_summary.h"
+
+// Private
+#include "prom_assert.h"
+#include "prom_collector_registry_i.h"
+#include "prom_collector_registry_t.h"
+#include "prom_log.h"
+#include "prom_metric_sample_histogram_i.h"
+#include "prom_metric_sample_histogram_t.h"
+#include "prom_metric_sample_i.h"
+#include "prom_metric_sample_native_histogram_t.h"
+#include "prom_metric_sample_summary_i.h"
+#include "prom_metric_sample_summary_t.h"
+#include "prom_metric_sample_t.h"
+#include "prom_metric_t.h"
+#include "prom_protobuf_i.h"
+#include "prom_remote_write_i.h"
+#include "prom_remote_write_t.h"
+#include "prom_remote_write_wal_i.h"
+#include "prom_snappy_i.h"
+#include "prom_string_builder_i.h"
+
+#define PROM_REMOTE_WRITE_DEFAULT_WAL_MAX_BYTES (64 * 1024 * 1024)
+#define PROM_REMOTE_WRITE_DEFAULT_CONCURRENCY 1
+#define PROM_REMOTE_WRITE_DEFAULT_QUEUE_CAPACITY 16
+#define PROM_REMOTE_WRITE_DEFAULT_MAX_RETRIES 3
+#define PROM_REMOTE_WRITE_DEFAULT_RETRY_BACKOFF_MS 100
+#define PROM_REMOTE_WRITE_DEFAULT_TIMEOUT_MS 5000
+#define PROM_REMOTE_WRITE_MAX_REPLAY_BACKOFF_MS 30000
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Static Declarations
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int prom_remote_write_parse_url(prom_remote_write_t *self, const char *url);
+
+static void *prom_remote_write_sender(void *arg);
+
+static void prom_remote_write_deadline(struct timespec *ts, unsigned int ms);
+
+static void prom_remote_write_spill(prom_remote_write_shard_t *shard, prom_remote_write_batch_t *batch);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// End static declarations
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+prom_remote_write_t *prom_remote_write_new(const prom_remote_write_config_t *config) {
+  PROM_ASSERT(config != NULL);
+  if (config == NULL || config->url == NULL) return NULL;
+
+  prom_remote_write_t *self = (prom_remote_write_t *)prom_malloc(sizeof(prom_remote_write_t));
+  memset(self, 0, sizeof(prom_remote_write_t));
+  pthread_mutex_init(&self->push_lock, NULL);
+  pthread_mutex_init(&self->lock, NULL);
+  pthread_cond_init(&self->cond, NULL);
+
+  if (prom_remote_write_parse_url(self, config->url)) {
+    PROM_LOG("invalid remote write url");
+    prom_remote_write_destroy(self);
+    return NULL;
+  }
+
+  self->config = *config;
+  self->config.url = NULL;
+  self->config.wal_path = NULL;
+  if (self->config.wal_max_bytes == 0) self->config.wal_max_bytes = PROM_REMOTE_WRITE_DEFAULT_WAL_MAX_BYTES;
+  if (self->config.concurrency == 0) self->config.concurrency = PROM_REMOTE_WRITE_DEFAULT_CONCURRENCY;
+  if (self->config.queue_capacity == 0) self->config.queue_capacity = PROM_REMOTE_WRITE_DEFAULT_QUEUE_CAPACITY;
+  if (self->config.max_retries == 0) self->config.max_retries = PROM_REMOTE_WRITE_DEFAULT_MAX_RETRIES;
+  if (self->config.retry_backoff_ms == 0) self->config.retry_backoff_ms = PROM_REMOTE_WRITE_DEFAULT_RETRY_BACKOFF_MS;
+  if (self->config.timeout_ms == 0) self->config.timeout_ms = PROM_REMOTE_WRITE_DEFAULT_TIMEOUT_MS;
+
+  self->snappy_builder = prom_string_builder_new();
+  self->builders =
+      (prom_string_builder_t **)prom_malloc(sizeof(prom_string_builder_t *) * self->config.concurrency);
+  self->shards =
+      (prom_remote_write_shard_t *)prom_malloc(sizeof(prom_remote_write_shard_t) * self->config.concurrency);
+  memset(self->shards, 0, sizeof(prom_remote_write_shard_t) * self->config.concurrency);
+  for (unsigned int i = 0; i < self->config.concurrency; i++) {
+    prom_remote_write_shard_t *shard = &self->shards[i];
+    self->builders[i] = prom_string_builder_new();
+    shard->parent = self;
+    shard->queue =
+        (prom_remote_write_batch_t *)prom_malloc(sizeof(prom_remote_write_batch_t) * self->config.queue_capacity);
+    shard->replay_backoff_ms = self->config.retry_backoff_ms;
+    clock_gettime(CLOCK_REALTIME, &shard->replay_at);
+  }
+
+  // Each shard keeps its own WAL so that its records replay in order. The first uses the configured path, which
+  // keeps the WAL of a single sender where it was before sharding.
+  if (config->wal_path != NULL) {
+    size_t path_len = strlen(config->wal_path) + sizeof(".4294967295");
+    char *path = (char *)prom_malloc(path_len);
+    for (unsigned int i = 0; i < self->config.concurrency; i++) {
+      if (i == 0) {
+        snprintf(path, path_len, "%s", config->wal_path);
+      } else {
+        snprintf(path, path_len, "%s.%u", config->wal_path, i);
+      }
+      self->shards[i].wal =
+          prom_remote_write_wal_new(path, self->config.wal_max_bytes / self->config.concurrency);
+      if (self->shards[i].wal == NULL) {
+        prom_free(path);
+        prom_remote_write_destroy(self);
+        return NULL;
+      }
+    }
+    prom_free(path);
+  }
+
+  for (unsigned int i = 0; i < self->config.concurrency; i++) {
+    if (pthread_create(&self->shards[i].sender, NULL, &prom_remote_write_sender, &self->shards[i])) {
+      PROM_LOG("failed to start a remote write sender");
+      prom_remote_write_destroy(self);
+      return NULL;
+    }
+    self->shards[i].started = true;
+  }
+  return self;
+}
+
+int prom_remote_write_destroy(prom_remote_write_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 0;
+
+  int r = 0;
+  int ret = 0;
+
+  pthread_mutex_lock(&self->lock);
+  self->shutdown = true;
+  pthread_cond_broadcast(&self->cond);
+  pthread_mutex_unlock(&self->lock);
+
+  if (self->shards != NULL) {
+    for (unsigned int i = 0; i < self->config.concurrency; i++) {
+      prom_remote_write_shard_t *shard = &self->shards[i];
+      if (shard->started) {
+        r = pthread_join(shard->sender, NULL);
+        if (r) ret = r;
+        shard->started = false;
+      }
+
+      // Keep whatever was not sent for the next process, behind the records already in the WAL
+      while (shard->queue_len > 0) {
+        prom_remote_write_spill(shard, &shard->queue[shard->queue_head]);
+        shard->queue_head = (shard->queue_head + 1) % self->config.queue_capacity;
+        shard->queue_len--;
+      }
+      if (shard->wal != NULL) {
+        r = prom_remote_write_wal_destroy(shard->wal);
+        shard->wal = NULL;
+        if (r) ret = r;
+      }
+      prom_free(shard->queue);
+      shard->queue = NULL;
+    }
+    prom_free(self->shards);
+    self->shards = NULL;
+  }
+
+  if (self->builders != NULL) {
+    for (unsigned int i = 0; i < self->config.concurrency; i++) {
+      r = prom_string_builder_destroy(self->builders[i]);
+      if (r) ret = r;
+    }
+    prom_free(self->builders);
+    self->builders = NULL;
+  }
+  if (self->snappy_builder != NULL) {
+    r = prom_string_builder_destroy(self->snappy_builder);
+    self->snappy_builder = NULL;
+    if (r) ret = r;
+  }
+  pthread_cond_destroy(&self->cond);
+  pthread_mutex_destroy(&self->lock);
+  pthread_mutex_destroy(&self->push_lock);
+  prom_free(self->host);
+  prom_free(self->port);
+  prom_free(self->path);
+  prom_free(self);
+  self = NULL;
+  return ret;
+}
+
+static int prom_remote_write_parse_url(prom_remote_write_t *self, const char *url) {
+  const char *scheme = "http://";
+  if (strncmp(url, scheme, strlen(scheme)) != 0) return 1;
+
+  const char *host = url + strlen(scheme);
+  const char *host_end = NULL;
+  const char *rest = NULL;
+  if (*host == '[') {
+    // An IPv6 literal such as [::1]:9090
+    host++;
+    host_end = strchr(host, ']');
+    if (host_end == NULL) return 1;
+    rest = host_end + 1;
+  } else {
+    host_end = host + strcspn(host, ":/");
+    rest = host_end;
+  }
+  if (host_end == host) return 1;
+
+  const char *port = "80";
+  size_t port_len = 2;
+  if (*rest == ':') {
+    port = rest + 1;
+    port_len = strcspn(port, "/");
+    if (port_len == 0) return 1;
+    rest = port + port_len;
+  }
+
+  self->host = prom_strndup(host, host_end - host);
+  self->port = prom_strndup(port, port_len);
+  self->path = prom_strdup(*rest == '/' ? rest : "/");
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Encoding
+// Reference: https://github.com/prometheus/prometheus/blob/main/prompb/remote.proto
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct prom_remote_write_label {
+  const char *name;
+  const char *value;
+} prom_remote_write_label_t;
+
+static int prom_remote_write_label_cmp(const void *a, const void *b) {
+  return strcmp(((const prom_remote_write_label_t *)a)->name, ((const prom_remote_write_label_t *)b)->name);
+}
+
+static size_t prom_remote_write_label_size(prom_remote_write_label_t *label) {
+  return prom_protobuf_string_field_size(1, label->name) + prom_protobuf_string_field_size(2, label->value);
+}
+
+// Appends TimeSeries { repeated Label labels = 1; repeated Sample samples = 2; }. The receiver requires the labels to
+// be sorted by name.
+static int prom_remote_write_add_series(prom_string_builder_t *out, prom_remote_write_label_t *labels, size_t count,
+                                        double value, int64_t timestamp_ms) {
+  int r = 0;
+  qsort(labels, count, sizeof(prom_remote_write_label_t), &prom_remote_write_label_cmp);
+
+  // Sample { double value = 1; int64 timestamp = 2; }
+  size_t sample_len = prom_protobuf_double_field_size(1) + prom_protobuf_varint_field_size(2, (uint64_t)timestamp_ms);
+  size_t len = prom_protobuf_len_field_size(2, sample_len);
+  for (size_t i = 0; i < count; i++) {
+    len += prom_protobuf_len_field_size(1, prom_remote_write_label_size(&labels[i]));
+  }
+
+  r = prom_protobuf_add_message_header(out, 1, len);
+  if (r) return r;
+  for (size_t i = 0; i < count; i++) {
+    r = prom_protobuf_add_message_header(out, 1, prom_remote_write_label_size(&labels[i]));
+    if (r) return r;
+    r = prom_protobuf_add_string_field(out, 1, labels[i].name);
+    if (r) return r;
+    r = prom_protobuf_add_string_field(out, 2, labels[i].value);
+    if (r) return r;
+  }
+  r = prom_protobuf_add_message_header(out, 2, sample_len);
+  if (r) return r;
+  r = prom_protobuf_add_double_field(out, 1, value);
+  if (r) return r;
+  return prom_protobuf_add_int_field(out, 2, timestamp_ms);
+}
+
+// Fills labels with __name__ and the sample's labels and returns the number of labels written
+static size_t prom_remote_write_load_labels(prom_remote_write_label_t *labels, const char *name, prom_metric_t *metric,
+                                            size_t label_count, const char **label_values) {
+  labels[0].name = "__name__";
+  labels[0].value = name;
+  for (size_t i = 0; i < label_count; i++) {
+    labels[i + 1].name = metric->label_keys[i];
+    labels[i + 1].value = label_values[i];
+  }
+  return label_count + 1;
+}
+
+// Appends one series of a histogram: name with the given suffix, the sample's labels and an optional le label
+static int prom_remote_write_add_histogram_series(prom_string_builder_t *out, prom_metric_t *metric,
+                                                  prom_metric_sample_histogram_t *hist_sample,
+                                                  prom_remote_write_label_t *labels, char *name, size_t name_len,
+                                                  const char *suffix, const char *le, double value,
+                                                  int64_t timestamp_ms) {
+  strcpy(name + name_len, suffix);
+  size_t count =
+      prom_remote_write_load_labels(labels, name, metric, hist_sample->label_count, hist_sample->label_values);
+  if (le != NULL) {
+    labels[count].name = "le";
+    labels[count].value = le;
+    count++;
+  }
+  return prom_remote_write_add_series(out, labels, count, value, timestamp_ms);
+}
+
+static int prom_remote_write_encode_histogram(prom_string_builder_t *out, prom_metric_t *metric,
+                                              prom_metric_sample_histogram_t *hist_sample,
+                                              prom_remote_write_label_t *labels, int64_t timestamp_ms) {
+  int r = 0;
+  size_t name_len = strlen(metric->name);
+  char *name = (char *)prom_malloc(name_len + sizeof("_bucket"));
+  memcpy(name, metric->name, name_len);
+
+  size_t bucket_count = prom_histogram_buckets_count(hist_sample->buckets);
+  for (size_t i = 0; i <= bucket_count && r == 0; i++) {
+    char *le = i < bucket_count ? prom_metric_sample_histogram_bucket_to_str(hist_sample->buckets->upper_bounds[i])
+                                : prom_strdup("+Inf");
+    r = prom_remote_write_add_histogram_series(out, metric, hist_sample, labels, name, name_len, "_bucket", le,
+                                               prom_metric_sample_histogram_cumulative_count(hist_sample, i),
+                                               timestamp_ms);
+    prom_free(le);
+  }
+  if (r == 0) {
+    r = prom_remote_write_add_histogram_series(out, metric, hist_sample, labels, name, name_len, "_count", NULL,
+                                               prom_metric_sample_histogram_count(hist_sample), timestamp_ms);
+  }
+  if (r == 0) {
+    r = prom_remote_write_add_histogram_series(out, metric, hist_sample, labels, name, name_len, "_sum", NULL,
+                                               prom_metric_sample_histogram_sum(hist_sample), timestamp_ms);
+  }
+  prom_free(name);
+  return r;
+}
+
+// Native histograms are sent as their +Inf bucket, _count and _sum series, like a classic histogram without buckets
+static int prom_remote_write_encode_native_histogram(prom_string_builder_t *out, prom_metric_t *metric,
+                                                     prom_metric_sample_native_histogram_t *native_sample,
+                                                     prom_remote_write_label_t *labels, int64_t timestamp_ms) {
+  int r = 0;
+  pthread_mutex_lock(&native_sample->lock);
+  double count = (double)native_sample->count;
+  double sum = native_sample->sum;
+  pthread_mutex_unlock(&native_sample->lock);
+
+  size_t name_len = strlen(metric->name);
+  char *name = (char *)prom_malloc(name_len + sizeof("_bucket"));
+  memcpy(name, metric->name, name_len);
+
+  const char *suffixes[] = {"_bucket", "_count", "_sum"};
+  double values[] = {count, count, sum};
+  for (size_t i = 0; i < 3 && r == 0; i++) {
+    strcpy(name + name_len, suffixes[i]);
+    size_t label_count = prom_remote_write_load_labels(labels, name, metric, native_sample->label_count,
+                                                       native_sample->label_values);
+    if (i == 0) {
+      labels[label_count].name = "le";
+      labels[label_count].value = "+Inf";
+      label_count++;
+    }
+    r = prom_remote_write_add_series(out, labels, label_count, values[i], timestamp_ms);
+  }
+  prom_free(name);
+  return r;
+}
+
+static int prom_remote_write_encode_summary(prom_string_builder_t *out, prom_metric_t *metric,
+                                            prom_metric_sample_summary_t *summary_sample,
+                                            prom_remote_write_label_t *labels, int64_t timestamp_ms) {
+  int r = 0;
+  double values[PROM_SUMMARY_MAX_QUANTILES];
+  uint64_t sample_count = 0;
+  double sum = 0.0;
+  r = prom_metric_sample_summary_snapshot(summary_sample, values, &sample_count, &sum);
+  if (r) return r;
+
+  size_t count = 0;
+  for (size_t i = 0; i < summary_sample->quantile_count && r == 0; i++) {
+    char quantile[50];
+    snprintf(quantile, sizeof(quantile), "%g", summary_sample->quantiles[i]);
+    count = prom_remote_write_load_labels(labels, metric->name, metric, summary_sample->label_count,
+                                          summary_sample->label_values);
+    labels[count].name = "quantile";
+    labels[count].value = quantile;
+    r = prom_remote_write_add_series(out, labels, count + 1, values[i], timestamp_ms);
+  }
+  if (r) return r;
+
+  size_t name_len = strlen(metric->name);
+  char *name = (char *)prom_malloc(name_len + sizeof("_count"));
+  memcpy(name, metric->name, name_len);
+  strcpy(name + name_len, "_count");
+  count = prom_remote_write_load_labels(labels, name, metric, summary_sample->label_count,
+                                        summary_sample->label_values);
+  r = prom_remote_write_add_series(out, labels, count, (double)sample_count, timestamp_ms);
+  if (r == 0) {
+    strcpy(name + name_len, "_sum");
+    count = prom_remote_write_load_labels(labels, name, metric, summary_sample->label_count,
+                                          summary_sample->label_values);
+    r = prom_remote_write_add_series(out, labels, count, sum, timestamp_ms);
+  }
+  prom_free(name);
+  return r;
+}
+
+// Picks the request of a sample's shard from the FNV-1a hash of the metric name and the label values. Every series
+// derived from one sample, such as the buckets of a histogram, hashes the same, so each series is always sent by the
+// same sender and reaches the receiver in order.
+static prom_string_builder_t *prom_remote_write_shard_out(prom_string_builder_t **out, size_t shard_count,
+                                                          prom_metric_t *metric, size_t label_count,
+                                                          const char **label_values) {
+  if (shard_count == 1) return out[0];
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i <= label_count; i++) {
+    // Hash the terminators too so that the values "a", "bc" and "ab", "c" differ
+    const char *s = i == 0 ? metric->name : label_values[i - 1];
+    size_t len = strlen(s) + 1;
+    for (size_t j = 0; j < len; j++) {
+      hash ^= (unsigned char)s[j];
+      hash *= 1099511628211ULL;
+    }
+  }
+  return out[hash % shard_count];
+}
+
+// The state of one encoding that prom_remote_write_encode_sample is handed with each sample
+typedef struct prom_remote_write_pass {
+  prom_string_builder_t **out;
+  size_t shard_count;
+  int64_t timestamp_ms;
+  prom_remote_write_label_t *labels; /**< labels holds __name__, a metric's labels and le or quantile */
+  size_t labels_cap;                 /**< labels_cap is the number of labels allocated. It is kept between samples */
+} prom_remote_write_pass_t;
+
+static int prom_remote_write_encode_sample(prom_metric_t *metric, void *sample, void *data) {
+  prom_remote_write_pass_t *pass = (prom_remote_write_pass_t *)data;
+  prom_string_builder_t **out = pass->out;
+  size_t shard_count = pass->shard_count;
+  int64_t timestamp_ms = pass->timestamp_ms;
+
+  if (pass->labels_cap < metric->label_key_count + 2) {
+    pass->labels_cap = metric->label_key_count + 2;
+    pass->labels = (prom_remote_write_label_t *)prom_realloc(pass->labels,
+                                                             sizeof(prom_remote_write_label_t) * pass->labels_cap);
+  }
+  prom_remote_write_label_t *labels = pass->labels;
+
+  if (metric->type == PROM_HISTOGRAM) {
+    prom_metric_sample_histogram_t *hist_sample = (prom_metric_sample_histogram_t *)sample;
+    return prom_remote_write_encode_histogram(
+        prom_remote_write_shard_out(out, shard_count, metric, hist_sample->label_count, hist_sample->label_values),
+        metric, hist_sample, labels, timestamp_ms);
+  } else if (metric->type == PROM_NATIVE_HISTOGRAM) {
+    prom_metric_sample_native_histogram_t *native_sample = (prom_metric_sample_native_histogram_t *)sample;
+    return prom_remote_write_encode_native_histogram(
+        prom_remote_write_shard_out(out, shard_count, metric, native_sample->label_count, native_sample->label_values),
+        metric, native_sample, labels, timestamp_ms);
+  } else if (metric->type == PROM_SUMMARY) {
+    prom_metric_sample_summary_t *summary_sample = (prom_metric_sample_summary_t *)sample;
+    return prom_remote_write_encode_summary(
+        prom_remote_write_shard_out(out, shard_count, metric, summary_sample->label_count,
+                                    summary_sample->label_values),
+        metric, summary_sample, labels, timestamp_ms);
+  }
+  prom_metric_sample_t *counter_sample = (prom_metric_sample_t *)sample;
+  size_t count = prom_remote_write_load_labels(labels, metric->name, metric, counter_sample->label_count,
+                                               counter_sample->label_values);
+  return prom_remote_write_add_series(
+      prom_remote_write_shard_out(out, shard_count, metric, counter_sample->label_count, counter_sample->label_values),
+      labels, count, prom_metric_sample_scrape_value(counter_sample), timestamp_ms);
+}
+
+int prom_remote_write_encode(prom_string_builder_t **out, size_t shard_count, prom_collector_registry_t *registry,
+                             int64_t timestamp_ms) {
+  PROM_ASSERT(out != NULL);
+  PROM_ASSERT(shard_count > 0);
+  PROM_ASSERT(registry != NULL);
+
+  // WriteRequest { repeated TimeSeries timeseries = 1; }
+  prom_remote_write_pass_t pass = {
+      .out = out, .shard_count = shard_count, .timestamp_ms = timestamp_ms, .labels = NULL, .labels_cap = 0};
+  int r = prom_collector_registry_foreach_sample(registry, &prom_remote_write_encode_sample, &pass);
+  prom_free(pass.labels);
+  return r;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Transport
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int prom_remote_write_send_full(int fd, const char *buf, size_t len) {
+  while (len > 0) {
+    ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return 1;
+    buf += n;
+    len -= n;
+  }
+  return 0;
+}
+
+static int prom_remote_write_connect(prom_remote_write_t *self) {
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+
+  struct addrinfo *addrs = NULL;
+  if (getaddrinfo(self->host, self->port, &hints, &addrs)) return -1;
+
+  struct timeval timeout;
+  timeout.tv_sec = self->config.timeout_ms / 1000;
+  timeout.tv_usec = (self->config.timeout_ms % 1000) * 1000;
+
+  int fd = -1;
+  for (struct addrinfo *addr = addrs; addr != NULL; addr = addr->ai_next) {
+    fd = socket(addr->ai_family, addr->ai_socktype | SOCK_CLOEXEC, addr->ai_protocol);
+    if (fd < 0) continue;
+    // On Linux the send timeout also bounds connect
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    if (connect(fd, addr->ai_addr, addr->ai_addrlen) == 0) break;
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(addrs);
+  return fd;
+}
+
+prom_remote_write_result_t prom_remote_write_send(prom_remote_write_t *self, const char *data, size_t len) {
+  PROM_ASSERT(self != NULL);
+  int fd = prom_remote_write_connect(self);
+  if (fd < 0) return PROM_REMOTE_WRITE_RETRY;
+
+  char header[512];
+  int header_len = snprintf(header, sizeof(header),
+                            "POST %s HTTP/1.1\r\n"
+                            "Host: %s:%s\r\n"
+                            "User-Agent: prometheus-client-c\r\n"
+                            "Content-Type: application/x-protobuf\r\n"
+                            "Content-Encoding: snappy\r\n"
+                            "X-Prometheus-Remote-Write-Version: 0.1.0\r\n"
+                            "Content-Length: %zu\r\n"
+                            "Connection: close\r\n\r\n",
+                            self->path, self->host, self->port, len);
+  if (header_len < 0 || (size_t)header_len >= sizeof(header) ||
+      prom_remote_write_send_full(fd, header, header_len) || prom_remote_write_send_full(fd, data, len)) {
+    close(fd);
+    return PROM_REMOTE_WRITE_RETRY;
+  }
+
+  // Only the status line matters
+  char status[64];
+  size_t status_len = 0;
+  while (status_len < sizeof(status) - 1 && memchr(status, '\n', status_len) == NULL) {
+    ssize_t n = recv(fd, status + status_len, sizeof(status) - 1 - status_len, 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    status_len += n;
+  }
+  close(fd);
+  status[status_len] = '\0';
+
+  int code = 0;
+  if (sscanf(status, "HTTP/%*d.%*d %d", &code) != 1) return PROM_REMOTE_WRITE_RETRY;
+  if (code >= 200 && code < 300) return PROM_REMOTE_WRITE_OK;
+  // Throttling and server errors are worth another attempt; anything else will fail the same way again
+  if (code == 429 || code >= 500) return PROM_REMOTE_WRITE_RETRY;
+  return PROM_REMOTE_WRITE_PERMANENT;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Queueing
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void prom_remote_write_deadline(struct timespec *ts, unsigned int ms) {
+  clock_gettime(CLOCK_REALTIME, ts);
+  ts->tv_sec += ms / 1000;
+  ts->tv_nsec += (long)(ms % 1000) * 1000000;
+  if (ts->tv_nsec >= 1000000000) {
+    ts->tv_sec++;
+    ts->tv_nsec -= 1000000000;
+  }
+}
+
+// Moves an undeliverable batch to the end of the shard's WAL and frees it. Must be called with the lock held.
+static void prom_remote_write_spill(prom_remote_write_shard_t *shard, prom_remote_write_batch_t *batch) {
+  if (shard->wal == NULL || prom_remote_write_wal_append(shard->wal, batch->data, batch->len)) {
+    shard->parent->stats.requests_dropped++;
+  }
+  prom_free(batch->data);
+  batch->data = NULL;
+}
+
+// Adds a batch behind everything the shard has not delivered yet. Must be called with the lock held.
+static void prom_remote_write_enqueue(prom_remote_write_shard_t *shard, prom_remote_write_batch_t *batch) {
+  prom_remote_write_t *self = shard->parent;
+  if (shard->queue_len == self->config.queue_capacity) {
+    if (shard->sending) {
+      // The batch being sent may still go to the WAL, and nothing newer may get there before it
+      self->stats.requests_dropped++;
+      prom_free(batch->data);
+      batch->data = NULL;
+      return;
+    }
+    // The WAL is older than the queue, so its oldest batch moves to the end of the WAL
+    prom_remote_write_spill(shard, &shard->queue[shard->queue_head]);
+    shard->queue_head = (shard->queue_head + 1) % self->config.queue_capacity;
+    shard->queue_len--;
+  }
+  shard->queue[(shard->queue_head + shard->queue_len) % self->config.queue_capacity] = *batch;
+  shard->queue_len++;
+}
+
+// Sends a batch, retrying with exponential backoff. Must be called without the lock held.
+static prom_remote_write_result_t prom_remote_write_deliver(prom_remote_write_t *self,
+                                                            prom_remote_write_batch_t *batch) {
+  unsigned int backoff_ms = self->config.retry_backoff_ms;
+  for (unsigned int attempt = 0;; attempt++) {
+    prom_remote_write_result_t result = prom_remote_write_send(self, batch->data, batch->len);
+
+    pthread_mutex_lock(&self->lock);
+    if (result == PROM_REMOTE_WRITE_OK) {
+      self->stats.requests_sent++;
+    } else {
+      self->stats.requests_failed++;
+    }
+    if (result != PROM_REMOTE_WRITE_RETRY || attempt >= self->config.max_retries) {
+      pthread_mutex_unlock(&self->lock);
+      return result;
+    }
+
+    struct timespec deadline;
+    prom_remote_write_deadline(&deadline, backoff_ms);
+    while (!self->shutdown && pthread_cond_timedwait(&self->cond, &self->lock, &deadline) != ETIMEDOUT) {
+    }
+    bool shutdown = self->shutdown;
+    pthread_mutex_unlock(&self->lock);
+    if (shutdown) return PROM_REMOTE_WRITE_RETRY;
+    backoff_ms *= 2;
+  }
+}
+
+// Sends the oldest WAL record of a shard once. Must be called with the lock held; the lock is released while sending.
+static void prom_remote_write_replay(prom_remote_write_shard_t *shard) {
+  prom_remote_write_t *self = shard->parent;
+  char *data = NULL;
+  size_t len = 0;
+  if (prom_remote_write_wal_peek(shard->wal, &data, &len)) return;
+
+  shard->replaying = true;
+  pthread_mutex_unlock(&self->lock);
+  prom_remote_write_result_t result = prom_remote_write_send(self, data, len);
+  prom_free(data);
+  pthread_mutex_lock(&self->lock);
+  shard->replaying = false;
+
+  if (result == PROM_REMOTE_WRITE_RETRY) {
+    self->stats.requests_failed++;
+    prom_remote_write_deadline(&shard->replay_at, shard->replay_backoff_ms);
+    shard->replay_backoff_ms *= 2;
+    if (shard->replay_backoff_ms > PROM_REMOTE_WRITE_MAX_REPLAY_BACKOFF_MS) {
+      shard->replay_backoff_ms = PROM_REMOTE_WRITE_MAX_REPLAY_BACKOFF_MS;
+    }
+  } else {
+    if (result == PROM_REMOTE_WRITE_OK) {
+      self->stats.requests_sent++;
+    } else {
+      self->stats.requests_failed++;
+      self->stats.requests_dropped++;
+    }
+    if (prom_remote_write_wal_advance(shard->wal)) PROM_LOG("failed to advance the remote write WAL");
+    shard->replay_backoff_ms = self->config.retry_backoff_ms;
+  }
+  pthread_cond_broadcast(&self->cond);
+}
+
+static void *prom_remote_write_sender(void *arg) {
+  prom_remote_write_shard_t *shard = (prom_remote_write_shard_t *)arg;
+  prom_remote_write_t *self = shard->parent;
+
+  pthread_mutex_lock(&self->lock);
+  while (!self->shutdown) {
+    // The WAL holds the oldest undelivered batches, so it is drained before the queue
+    if (shard->wal != NULL && prom_remote_write_wal_pending(shard->wal) > 0) {
+      struct timespec now;
+      clock_gettime(CLOCK_REALTIME, &now);
+      if (now.tv_sec > shard->replay_at.tv_sec ||
+          (now.tv_sec == shard->replay_at.tv_sec && now.tv_nsec >= shard->replay_at.tv_nsec)) {
+        prom_remote_write_replay(shard);
+      } else {
+        pthread_cond_timedwait(&self->cond, &self->lock, &shard->replay_at);
+      }
+      continue;
+    }
+
+    if (shard->queue_len > 0) {
+      // The batch stays at the head while it is sent: pushes only spill the head when it is not being sent
+      prom_remote_write_batch_t batch = shard->queue[shard->queue_head];
+      shard->sending = true;
+      pthread_mutex_unlock(&self->lock);
+
+      prom_remote_write_result_t result = prom_remote_write_deliver(self, &batch);
+
+      pthread_mutex_lock(&self->lock);
+      shard->sending = false;
+      shard->queue_head = (shard->queue_head + 1) % self->config.queue_capacity;
+      shard->queue_len--;
+      if (result == PROM_REMOTE_WRITE_RETRY) {
+        // The WAL was empty, so the batch stays ahead of the rest of the queue
+        prom_remote_write_spill(shard, &batch);
+      } else {
+        if (result == PROM_REMOTE_WRITE_PERMANENT) self->stats.requests_dropped++;
+        prom_free(batch.data);
+      }
+      pthread_cond_broadcast(&self->cond);
+      continue;
+    }
+
+    pthread_cond_wait(&self->cond, &self->lock);
+  }
+  pthread_mutex_unlock(&self->lock);
+  return NULL;
+}
+
+int prom_remote_write_push(prom_remote_write_t *self, prom_collector_registry_t *registry) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL || registry == NULL) return 1;
+
+  int r = 0;
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  int64_t timestamp_ms = (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+
+  pthread_mutex_lock(&self->push_lock);
+  for (unsigned int i = 0; i < self->config.concurrency; i++) {
+    prom_string_builder_truncate(self->builders[i], 0);
+  }
+  r = prom_remote_write_encode(self->builders, self->config.concurrency, registry, timestamp_ms);
+  for (unsigned int i = 0; i < self->config.concurrency && r == 0; i++) {
+    size_t len = 0;
+    const char *request = prom_string_builder_view(self->builders[i], &len);
+    if (len == 0) continue;
+
+    prom_string_builder_truncate(self->snappy_builder, 0);
+    r = prom_snappy_compress(self->snappy_builder, request, len);
+    if (r) break;
+    prom_remote_write_batch_t batch;
+    batch.len = prom_string_builder_len(self->snappy_builder);
+    batch.data = prom_string_builder_dump(self->snappy_builder);
+
+    pthread_mutex_lock(&self->lock);
+    prom_remote_write_enqueue(&self->shards[i], &batch);
+    pthread_cond_broadcast(&self->cond);
+    pthread_mutex_unlock(&self->lock);
+  }
+  pthread_mutex_unlock(&self->push_lock);
+  return r;
+}
+
+int prom_remote_write_flush(prom_remote_write_t *self, unsigned int timeout_ms) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+
+  int r = 0;
+  struct timespec deadline;
+  prom_remote_write_deadline(&deadline, timeout_ms);
+
+  pthread_mutex_lock(&self->lock);
+  for (unsigned int i = 0; i < self->config.concurrency && r == 0; i++) {
+    prom_remote_write_shard_t *shard = &self->shards[i];
+    while (shard->queue_len > 0 || shard->sending || shard->replaying ||
+           (shard->wal != NULL && prom_remote_write_wal_pending(shard->wal) > 0)) {
+      if (pthread_cond_timedwait(&self->cond, &self->lock, &deadline) == ETIMEDOUT) {
+        r = 1;
+        break;
+      }
+    }
+  }
+  pthread_mutex_unlock(&self->lock);
+  return r;
+}
+
+int prom_remote_write_stats(prom_remote_write_t *self, prom_remote_write_stats_t *stats) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL || stats == NULL) return 1;
+  pthread_mutex_lock(&self->lock);
+  *stats = self->stats;
+  stats->wal_pending_bytes = 0;
+  for (unsigned int i = 0; i < self->config.concurrency; i++) {
+    if (self->shards[i].wal != NULL) stats->wal_pending_bytes += prom_remote_write_wal_pending(self->shards[i].wal);
+  }
+  pthread_mutex_unlock(&self->lock);
+  return 0;
+}
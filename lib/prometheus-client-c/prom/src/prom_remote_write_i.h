@@ -0,0 +1,43 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PROM_REMOTE_WRITE_I_H
+#define PROM_REMOTE_WRITE_I_H
+
+#include <stdint.h>
+
+// Public
+#include "prom_collector_registry.h"
+
+// Private
+#include "prom_remote_write_t.h"
+#include "prom_string_builder_t.h"
+
+/**
+ * @brief API PRIVATE Appends every sample of the registry to one of shard_count prometheus.WriteRequest in out,
+ * chosen by the hash of the series so that a series always lands in the same request. All samples are stamped with
+ * timestamp_ms.
+ */
+int prom_remote_write_encode(prom_string_builder_t **out, size_t shard_count, prom_collector_registry_t *registry,
+                             int64_t timestamp_ms);
+
+/**
+ * @brief API PRIVATE Sends one compressed request to the receiver
+ */
+prom_remote_write_result_t prom_remote_write_send(prom_remote_write_t *self, const char *data, size_t len);
+
+#endif  // PROM_REMOTE_WRITE_I_H
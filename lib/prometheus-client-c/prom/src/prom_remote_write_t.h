@@ -0,0 +1,85 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PROM_REMOTE_WRITE_T_H
+#define PROM_REMOTE_WRITE_T_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <time.h>
+
+// Public
+#include "prom_remote_write.h"
+
+// Private
+#include "prom_remote_write_wal_t.h"
+#include "prom_string_builder_t.h"
+
+/**
+ * @brief API PRIVATE A compressed WriteRequest waiting to be sent
+ */
+typedef struct prom_remote_write_batch {
+  char *data; /**< data is the snappy compressed request body */
+  size_t len; /**< len is the number of bytes in data */
+} prom_remote_write_batch_t;
+
+/**
+ * @brief API PRIVATE The outcome of a single request
+ */
+typedef enum prom_remote_write_result {
+  PROM_REMOTE_WRITE_OK,        /**< The receiver accepted the request */
+  PROM_REMOTE_WRITE_RETRY,     /**< The request may succeed if it is sent again */
+  PROM_REMOTE_WRITE_PERMANENT  /**< The receiver rejected the request */
+} prom_remote_write_result_t;
+
+/**
+ * @brief API PRIVATE The series whose hash falls in one shard, with the sender that delivers them in order.
+ *
+ * Undelivered requests form a single FIFO per shard: the WAL holds the oldest, the queue the newer ones. The sender
+ * replays the WAL before it sends from the queue, and sends one request at a time, so the receiver sees the samples
+ * of every series in order.
+ */
+typedef struct prom_remote_write_shard {
+  struct prom_remote_write *parent;       /**< parent is the client that owns the shard */
+  prom_remote_write_wal_t *wal;           /**< wal is NULL when the WAL is disabled */
+  prom_remote_write_batch_t *queue;       /**< queue is a ring of config.queue_capacity batches */
+  size_t queue_head;                      /**< queue_head is the index of the oldest batch */
+  size_t queue_len;                       /**< queue_len is the number of queued batches */
+  bool sending;                           /**< sending is set while the oldest queued batch is being sent */
+  bool replaying;                         /**< replaying is set while the oldest WAL record is being sent */
+  unsigned int replay_backoff_ms;         /**< replay_backoff_ms is the delay before the next replay attempt */
+  struct timespec replay_at;              /**< replay_at is the earliest time of the next replay attempt */
+  pthread_t sender;                       /**< sender is the thread delivering the shard's requests */
+  bool started;                           /**< started is set once sender is running */
+} prom_remote_write_shard_t;
+
+struct prom_remote_write {
+  char *host;                            /**< host is the receiver host name */
+  char *port;                            /**< port is the receiver port */
+  char *path;                            /**< path is the request target */
+  prom_remote_write_config_t config;     /**< config holds the options with defaults applied */
+  prom_string_builder_t **builders;      /**< builders hold the encoded request of each shard during a push */
+  prom_string_builder_t *snappy_builder; /**< snappy_builder holds a compressed request during a push */
+  pthread_mutex_t push_lock;             /**< push_lock serializes pushes which share the builders */
+  pthread_mutex_t lock;                  /**< lock guards the queues, flags and WALs of shards and the members below */
+  pthread_cond_t cond;                   /**< cond is signalled whenever a queue or a WAL changes */
+  bool shutdown;                         /**< shutdown asks the senders to exit */
+  prom_remote_write_stats_t stats;       /**< stats are the delivery statistics */
+  prom_remote_write_shard_t *shards;     /**< shards are config.concurrency shards */
+};
+
+#endif  // PROM_REMOTE_WRITE_T_H
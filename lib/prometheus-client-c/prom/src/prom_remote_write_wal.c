@@ -0,0 +1,187 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Public
+#include "prom_alloc.h"
+
+// Private
+#include "prom_assert.h"
+#include "prom_log.h"
+#include "prom_remote_write_wal_i.h"
+#include "prom_remote_write_wal_t.h"
+
+#define PROM_REMOTE_WRITE_WAL_HEADER_SIZE 8
+
+static uint32_t prom_remote_write_wal_checksum(const char *data, size_t len) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; i++) {
+    h ^= (unsigned char)data[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static void prom_remote_write_wal_put32(char *buf, uint32_t v) {
+  for (int i = 0; i < 4; i++) buf[i] = (char)(v >> (8 * i));
+}
+
+static uint32_t prom_remote_write_wal_get32(const char *buf) {
+  uint32_t v = 0;
+  for (int i = 0; i < 4; i++) v |= (uint32_t)(unsigned char)buf[i] << (8 * i);
+  return v;
+}
+
+static int prom_remote_write_wal_pread_full(int fd, char *buf, size_t len, off_t offset) {
+  while (len > 0) {
+    ssize_t n = pread(fd, buf, len, offset);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return 1;
+    buf += n;
+    len -= n;
+    offset += n;
+  }
+  return 0;
+}
+
+static int prom_remote_write_wal_write_full(int fd, const char *buf, size_t len) {
+  while (len > 0) {
+    ssize_t n = write(fd, buf, len);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return 1;
+    buf += n;
+    len -= n;
+  }
+  return 0;
+}
+
+// Reads the record at offset, verifying its checksum. Returns non-zero if there is no intact record there.
+static int prom_remote_write_wal_read_record(prom_remote_write_wal_t *self, off_t offset, off_t limit, char **data,
+                                             size_t *len) {
+  char header[PROM_REMOTE_WRITE_WAL_HEADER_SIZE];
+  if (limit - offset < PROM_REMOTE_WRITE_WAL_HEADER_SIZE) return 1;
+  if (prom_remote_write_wal_pread_full(self->fd, header, sizeof(header), offset)) return 1;
+
+  size_t record_len = prom_remote_write_wal_get32(header);
+  if ((off_t)record_len > limit - offset - PROM_REMOTE_WRITE_WAL_HEADER_SIZE) return 1;
+
+  char *record = (char *)prom_malloc(record_len + 1);
+  if (prom_remote_write_wal_pread_full(self->fd, record, record_len, offset + PROM_REMOTE_WRITE_WAL_HEADER_SIZE) ||
+      prom_remote_write_wal_checksum(record, record_len) != prom_remote_write_wal_get32(header + 4)) {
+    prom_free(record);
+    return 1;
+  }
+  *data = record;
+  *len = record_len;
+  return 0;
+}
+
+prom_remote_write_wal_t *prom_remote_write_wal_new(const char *path, size_t max_bytes) {
+  PROM_ASSERT(path != NULL);
+  int fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+  if (fd < 0) {
+    PROM_LOG("failed to open the remote write WAL");
+    return NULL;
+  }
+
+  prom_remote_write_wal_t *self = (prom_remote_write_wal_t *)prom_malloc(sizeof(prom_remote_write_wal_t));
+  self->fd = fd;
+  self->size = 0;
+  self->read_offset = 0;
+  self->next_offset = 0;
+  self->max_bytes = max_bytes;
+
+  struct stat st;
+  if (fstat(fd, &st)) {
+    prom_remote_write_wal_destroy(self);
+    return NULL;
+  }
+
+  // Keep every intact record. Anything after the first bad one was torn by a crash mid-append.
+  off_t offset = 0;
+  char *data = NULL;
+  size_t len = 0;
+  while (prom_remote_write_wal_read_record(self, offset, st.st_size, &data, &len) == 0) {
+    prom_free(data);
+    offset += PROM_REMOTE_WRITE_WAL_HEADER_SIZE + len;
+  }
+  if (offset != st.st_size && ftruncate(fd, offset)) {
+    prom_remote_write_wal_destroy(self);
+    return NULL;
+  }
+  self->size = offset;
+  return self;
+}
+
+int prom_remote_write_wal_destroy(prom_remote_write_wal_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 0;
+  int r = close(self->fd);
+  prom_free(self);
+  return r;
+}
+
+int prom_remote_write_wal_append(prom_remote_write_wal_t *self, const char *data, size_t len) {
+  PROM_ASSERT(self != NULL);
+  if (len > UINT32_MAX) return 1;
+  if ((size_t)self->size + PROM_REMOTE_WRITE_WAL_HEADER_SIZE + len > self->max_bytes) return 1;
+
+  char header[PROM_REMOTE_WRITE_WAL_HEADER_SIZE];
+  prom_remote_write_wal_put32(header, (uint32_t)len);
+  prom_remote_write_wal_put32(header + 4, prom_remote_write_wal_checksum(data, len));
+  if (prom_remote_write_wal_write_full(self->fd, header, sizeof(header)) ||
+      prom_remote_write_wal_write_full(self->fd, data, len)) {
+    // Drop the partial record so that later appends stay readable
+    if (ftruncate(self->fd, self->size)) PROM_LOG("failed to truncate the remote write WAL");
+    return 1;
+  }
+  self->size += PROM_REMOTE_WRITE_WAL_HEADER_SIZE + len;
+  return fdatasync(self->fd);
+}
+
+int prom_remote_write_wal_peek(prom_remote_write_wal_t *self, char **data, size_t *len) {
+  PROM_ASSERT(self != NULL);
+  if (self->read_offset >= self->size) return 1;
+  if (prom_remote_write_wal_read_record(self, self->read_offset, self->size, data, len)) return 1;
+  self->next_offset = self->read_offset + PROM_REMOTE_WRITE_WAL_HEADER_SIZE + *len;
+  return 0;
+}
+
+int prom_remote_write_wal_advance(prom_remote_write_wal_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self->next_offset <= self->read_offset) return 1;
+  self->read_offset = self->next_offset;
+  if (self->read_offset < self->size) return 0;
+
+  // Everything has been replayed
+  if (ftruncate(self->fd, 0)) return 1;
+  self->size = 0;
+  self->read_offset = 0;
+  self->next_offset = 0;
+  return 0;
+}
+
+size_t prom_remote_write_wal_pending(prom_remote_write_wal_t *self) {
+  PROM_ASSERT(self != NULL);
+  return (size_t)(self->size - self->read_offset);
+}
@@ -0,0 +1,55 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PROM_REMOTE_WRITE_WAL_I_H
+#define PROM_REMOTE_WRITE_WAL_I_H
+
+// Private
+#include "prom_remote_write_wal_t.h"
+
+/**
+ * @brief API PRIVATE Opens or creates the log at path. A torn or corrupt tail left by a crash is discarded.
+ */
+prom_remote_write_wal_t *prom_remote_write_wal_new(const char *path, size_t max_bytes);
+
+/**
+ * @brief API PRIVATE Closes the log. Unconsumed records remain on disk to be replayed by the next process.
+ */
+int prom_remote_write_wal_destroy(prom_remote_write_wal_t *self);
+
+/**
+ * @brief API PRIVATE Appends and syncs a record. Returns non-zero if the record does not fit or cannot be written.
+ */
+int prom_remote_write_wal_append(prom_remote_write_wal_t *self, const char *data, size_t len);
+
+/**
+ * @brief API PRIVATE Reads the oldest unconsumed record into a buffer that MUST be freed. Returns non-zero if the log
+ * is empty or cannot be read.
+ */
+int prom_remote_write_wal_peek(prom_remote_write_wal_t *self, char **data, size_t *len);
+
+/**
+ * @brief API PRIVATE Consumes the record returned by the last call to prom_remote_write_wal_peek
+ */
+int prom_remote_write_wal_advance(prom_remote_write_wal_t *self);
+
+/**
+ * @brief API PRIVATE Returns the number of bytes of unconsumed records
+ */
+size_t prom_remote_write_wal_pending(prom_remote_write_wal_t *self);
+
+#endif  // PROM_REMOTE_WRITE_WAL_I_H
@@ -0,0 +1,38 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PROM_REMOTE_WRITE_WAL_T_H
+#define PROM_REMOTE_WRITE_WAL_T_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * @brief API PRIVATE An append-only log of compressed remote write requests that could not be delivered.
+ *
+ * Each record is a 4 byte little endian length, a 4 byte FNV-1a checksum of the payload and the payload itself.
+ * Records are consumed from the front; once every record has been consumed the file is truncated.
+ */
+typedef struct prom_remote_write_wal {
+  int fd;             /**< fd is the open log file */
+  off_t size;         /**< size is the number of valid bytes in the log */
+  off_t read_offset;  /**< read_offset is the offset of the oldest record that has not been consumed */
+  off_t next_offset;  /**< next_offset is the offset following the record returned by the last peek */
+  size_t max_bytes;   /**< max_bytes bounds size. Appends that would exceed it are rejected. */
+} prom_remote_write_wal_t;
+
+#endif  // PROM_REMOTE_WRITE_WAL_T_H
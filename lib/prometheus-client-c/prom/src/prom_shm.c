@@ -0,0 +1,273 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <assert.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Public
+#include "prom_alloc.h"
+#include "prom_shm.h"
+
+// Private
+#include "prom_assert.h"
+#include "prom_collector_registry_i.h"
+#include "prom_collector_registry_t.h"
+#include "prom_log.h"
+#include "prom_map_i.h"
+#include "prom_metric_sample_i.h"
+#include "prom_metric_sample_t.h"
+#include "prom_metric_t.h"
+#include "prom_shm_i.h"
+#include "prom_shm_t.h"
+
+// The layout is shared with other processes, so it must not depend on the compiler
+static_assert(sizeof(prom_shm_header_t) == 128, "prom_shm_header_t must be 128 bytes");
+static_assert(sizeof(prom_shm_descriptor_t) == 256, "prom_shm_descriptor_t must be 256 bytes");
+
+size_t prom_shm_segment_size(size_t capacity) {
+  return sizeof(prom_shm_header_t) + capacity * (sizeof(prom_shm_descriptor_t) + sizeof(double));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// prom_shm_publisher
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+prom_shm_publisher_t *prom_shm_publisher_new(const char *name, size_t capacity) {
+  PROM_ASSERT(name != NULL);
+  if (name == NULL || capacity == 0 || capacity > UINT32_MAX) return NULL;
+
+  // Start from an empty segment so that readers never see slots assigned by a previous process
+  shm_unlink(name);
+  int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    PROM_LOG("failed to create the shared memory segment");
+    return NULL;
+  }
+  size_t size = prom_shm_segment_size(capacity);
+  if (ftruncate(fd, size)) {
+    PROM_LOG("failed to size the shared memory segment");
+    close(fd);
+    shm_unlink(name);
+    return NULL;
+  }
+  void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    PROM_LOG("failed to map the shared memory segment");
+    shm_unlink(name);
+    return NULL;
+  }
+
+  prom_shm_publisher_t *self = (prom_shm_publisher_t *)prom_malloc(sizeof(prom_shm_publisher_t));
+  self->name = prom_strdup(name);
+  self->base = base;
+  self->size = size;
+  self->header = (prom_shm_header_t *)base;
+  self->descriptors = (prom_shm_descriptor_t *)((char *)base + sizeof(prom_shm_header_t));
+  self->values = (double *)((char *)self->descriptors + capacity * sizeof(prom_shm_descriptor_t));
+  self->staging = (double *)prom_malloc(capacity * sizeof(double));
+  self->count = 0;
+  self->slots = prom_map_new();
+  pthread_mutex_init(&self->lock, NULL);
+
+  // ftruncate zero filled the segment. The magic is written last so that readers reject a half initialized header.
+  self->header->version = PROM_SHM_VERSION;
+  self->header->capacity = (uint32_t)capacity;
+  self->header->descriptor_size = sizeof(prom_shm_descriptor_t);
+  self->header->descriptors_offset = (char *)self->descriptors - (char *)base;
+  self->header->values_offset = (char *)self->values - (char *)base;
+  atomic_thread_fence(memory_order_release);
+  self->header->magic = PROM_SHM_MAGIC;
+  return self;
+}
+
+int prom_shm_publisher_destroy(prom_shm_publisher_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 0;
+
+  int r = 0;
+  int ret = 0;
+
+  r = munmap(self->base, self->size);
+  if (r) ret = r;
+  r = shm_unlink(self->name);
+  if (r) ret = r;
+  r = prom_map_destroy(self->slots);
+  if (r) ret = r;
+  pthread_mutex_destroy(&self->lock);
+  prom_free(self->staging);
+  prom_free(self->name);
+  prom_free(self);
+  self = NULL;
+  return ret;
+}
+
+// Returns the slot of the series, assigning and describing a new one on first sight. Returns -1 when full.
+static ssize_t prom_shm_publisher_slot(prom_shm_publisher_t *self, prom_metric_t *metric,
+                                       prom_metric_sample_t *sample) {
+  uintptr_t slot = (uintptr_t)prom_map_get(self->slots, sample->l_value);
+  if (slot != 0) return slot - 1;
+  if (self->count == self->header->capacity) return -1;
+
+  // Readers do not look at slots at or above header->count, so the descriptor can be written outside the seqlock
+  prom_shm_descriptor_t *descriptor = &self->descriptors[self->count];
+  size_t name_len = strlen(sample->l_value);
+  if (name_len >= PROM_SHM_NAME_MAX) name_len = PROM_SHM_NAME_MAX - 1;
+  descriptor->type = metric->type == PROM_COUNTER ? PROM_SHM_COUNTER : PROM_SHM_GAUGE;
+  descriptor->name_len = (uint32_t)name_len;
+  memcpy(descriptor->name, sample->l_value, name_len);
+  descriptor->name[name_len] = '\0';
+
+  self->count++;
+  prom_map_set(self->slots, sample->l_value, (void *)(uintptr_t)self->count);
+  return self->count - 1;
+}
+
+// The state of one publish that prom_shm_publisher_stage_sample is handed with each sample
+typedef struct prom_shm_publisher_pass {
+  prom_shm_publisher_t *publisher;
+  uint64_t dropped; /**< dropped is the number of samples that found no free slot */
+} prom_shm_publisher_pass_t;
+
+static int prom_shm_publisher_stage_sample(prom_metric_t *metric, void *sample, void *data) {
+  prom_shm_publisher_pass_t *pass = (prom_shm_publisher_pass_t *)data;
+  if (metric->type != PROM_COUNTER && metric->type != PROM_GAUGE) return 0;
+  ssize_t slot = prom_shm_publisher_slot(pass->publisher, metric, (prom_metric_sample_t *)sample);
+  if (slot < 0) {
+    pass->dropped++;
+    return 0;
+  }
+  pass->publisher->staging[slot] = prom_metric_sample_scrape_value((prom_metric_sample_t *)sample);
+  return 0;
+}
+
+int prom_shm_publisher_publish(prom_shm_publisher_t *self, prom_collector_registry_t *registry) {
+  PROM_ASSERT(self != NULL);
+  PROM_ASSERT(registry != NULL);
+  if (self == NULL || registry == NULL) return 1;
+
+  pthread_mutex_lock(&self->lock);
+  for (size_t i = 0; i < self->count; i++) self->staging[i] = NAN;
+
+  // Collect into staging first so that the seqlock is held only for a memcpy
+  prom_shm_publisher_pass_t pass = {.publisher = self, .dropped = 0};
+  int r = prom_collector_registry_foreach_sample(registry, &prom_shm_publisher_stage_sample, &pass);
+  uint64_t dropped = pass.dropped;
+
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+
+  // Writer side of the seqlock: odd, release fence, data, even with release
+  uint64_t seq = atomic_load_explicit(&self->header->seq, memory_order_relaxed);
+  atomic_store_explicit(&self->header->seq, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  memcpy(self->values, self->staging, self->count * sizeof(double));
+  self->header->count = self->count;
+  self->header->timestamp_ms = (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+  self->header->dropped = dropped;
+  atomic_store_explicit(&self->header->seq, seq + 2, memory_order_release);
+
+  pthread_mutex_unlock(&self->lock);
+  return r;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// prom_shm_reader
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+prom_shm_reader_t *prom_shm_reader_open(const char *name) {
+  PROM_ASSERT(name != NULL);
+  if (name == NULL) return NULL;
+
+  int fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+  if (fd < 0) return NULL;
+  struct stat st;
+  if (fstat(fd, &st) || (size_t)st.st_size < sizeof(prom_shm_header_t)) {
+    close(fd);
+    return NULL;
+  }
+  size_t size = st.st_size;
+  void *base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) return NULL;
+
+  prom_shm_header_t *header = (prom_shm_header_t *)base;
+  if (header->magic != PROM_SHM_MAGIC || header->version != PROM_SHM_VERSION ||
+      header->descriptor_size != sizeof(prom_shm_descriptor_t) || prom_shm_segment_size(header->capacity) > size) {
+    munmap(base, size);
+    return NULL;
+  }
+  atomic_thread_fence(memory_order_acquire);
+
+  prom_shm_reader_t *self = (prom_shm_reader_t *)prom_malloc(sizeof(prom_shm_reader_t));
+  self->base = base;
+  self->size = size;
+  self->header = header;
+  self->capacity = header->capacity;
+  self->descriptors = (const prom_shm_descriptor_t *)((char *)base + header->descriptors_offset);
+  self->values = (const double *)((char *)base + header->values_offset);
+  return self;
+}
+
+int prom_shm_reader_close(prom_shm_reader_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 0;
+  int r = munmap(self->base, self->size);
+  prom_free(self);
+  self = NULL;
+  return r;
+}
+
+size_t prom_shm_reader_capacity(prom_shm_reader_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 0;
+  return self->capacity;
+}
+
+const prom_shm_descriptor_t *prom_shm_reader_descriptor(prom_shm_reader_t *self, size_t i) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL || i >= self->capacity) return NULL;
+  return &self->descriptors[i];
+}
+
+int prom_shm_reader_snapshot(prom_shm_reader_t *self, double *values, size_t *count, uint64_t *timestamp_ms) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL || values == NULL || count == NULL) return 1;
+
+  // Reader side of the seqlock: an even sequence number that is unchanged after the copy means no write overlapped
+  for (unsigned int attempt = 0; attempt < PROM_SHM_READ_ATTEMPTS; attempt++) {
+    uint64_t seq = atomic_load_explicit(&self->header->seq, memory_order_acquire);
+    if (seq & 1) continue;
+    size_t n = self->header->count;
+    uint64_t timestamp = self->header->timestamp_ms;
+    if (n > self->capacity) n = self->capacity;
+    memcpy(values, self->values, n * sizeof(double));
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&self->header->seq, memory_order_relaxed) != seq) continue;
+    *count = n;
+    if (timestamp_ms != NULL) *timestamp_ms = timestamp;
+    return 0;
+  }
+  return 1;
+}
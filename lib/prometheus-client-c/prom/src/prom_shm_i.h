@@ -0,0 +1,36 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PROM_SHM_I_H
+#define PROM_SHM_I_H
+
+#include <stdlib.h>
+
+// Private
+#include "prom_shm_t.h"
+
+/**
+ * @brief API PRIVATE The number of snapshot attempts before a reader gives up on a publisher stuck mid-write
+ */
+#define PROM_SHM_READ_ATTEMPTS (1 << 20)
+
+/**
+ * @brief API PRIVATE Returns the size in bytes of a segment with the given capacity
+ */
+size_t prom_shm_segment_size(size_t capacity);
+
+#endif  // PROM_SHM_I_H
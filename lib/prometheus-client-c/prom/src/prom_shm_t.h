@@ -0,0 +1,51 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PROM_SHM_T_H
+#define PROM_SHM_T_H
+
+#include <pthread.h>
+
+// Public
+#include "prom_shm.h"
+
+// Private
+#include "prom_map_t.h"
+
+struct prom_shm_publisher {
+  char *name;                         /**< name is the shared memory object name */
+  void *base;                         /**< base is the start of the mapping */
+  size_t size;                        /**< size is the length of the mapping */
+  prom_shm_header_t *header;          /**< header is at base */
+  prom_shm_descriptor_t *descriptors; /**< descriptors is the descriptor table in the segment */
+  double *values;                     /**< values is the values array in the segment */
+  double *staging;                    /**< staging collects the values of a publication before they are copied */
+  size_t count;                       /**< count is the number of slots that have been assigned */
+  prom_map_t *slots;                  /**< slots maps a series to its slot index plus one */
+  pthread_mutex_t lock;               /**< lock serializes publications */
+};
+
+struct prom_shm_reader {
+  void *base;                               /**< base is the start of the read only mapping */
+  size_t size;                              /**< size is the length of the mapping */
+  prom_shm_header_t *header;                /**< header is at base */
+  const prom_shm_descriptor_t *descriptors; /**< descriptors is the descriptor table in the segment */
+  const double *values;                     /**< values is the values array in the segment */
+  size_t capacity;                          /**< capacity is header->capacity as validated on open */
+};
+
+#endif  // PROM_SHM_T_H
@@ -0,0 +1,356 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/**
+ * @file prom_slab.c
+ * @brief Size class slabs and a string interning table over one reserved arena
+ *
+ * The arena is a single reservation of address space. Pages are carved from it in order and, once empty, handed back
+ * to the kernel and kept for reuse, so the memory in use follows the live blocks while the address space never
+ * shrinks. Because every slab page lies within the arena, prom_slab_free tells its own blocks from libc's with one
+ * range check.
+ *
+ * This file must not use the prom_alloc.h hooks: they are routed here in PROM_SLAB builds.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Public
+#include "prom_slab.h"
+
+// Private
+#include "prom_slab_t.h"
+
+static const size_t prom_slab_sizes[PROM_SLAB_CLASS_COUNT] = {16,  32,  48,  64,  80,  96,  112, 128, 160, 192,
+                                                              224, 256, 320, 384, 448, 512, 640, 768, 896, 1024};
+
+// The size class of each multiple of 16 up to PROM_SLAB_MAX_SIZE
+static uint8_t prom_slab_class_of[PROM_SLAB_MAX_SIZE / 16 + 1];
+
+static prom_slab_arena_t prom_slab_arena;
+static pthread_once_t prom_slab_once = PTHREAD_ONCE_INIT;
+
+static void prom_slab_init(void) {
+  prom_slab_arena_t *a = &prom_slab_arena;
+  pthread_mutex_init(&a->lock, NULL);
+  pthread_mutex_init(&a->intern_lock, NULL);
+  for (size_t i = 0, c = 0; i <= PROM_SLAB_MAX_SIZE / 16; i++) {
+    while (prom_slab_sizes[c] < i * 16) c++;
+    prom_slab_class_of[i] = (uint8_t)c;
+  }
+  for (size_t i = 0; i < PROM_SLAB_CLASS_COUNT; i++) {
+    pthread_mutex_init(&a->classes[i].lock, NULL);
+    a->classes[i].size = prom_slab_sizes[i];
+  }
+  long os_page_size = sysconf(_SC_PAGESIZE);
+  a->os_page_size = os_page_size > 0 ? (size_t)os_page_size : 4096;
+
+  // Reserve a page more than the arena so that its base can be aligned to the page size. Untouched pages cost no
+  // memory. If the reservation fails the arena stays empty and every request goes to libc.
+  void *reservation = mmap(NULL, PROM_SLAB_ARENA_SIZE + PROM_SLAB_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (reservation == MAP_FAILED) return;
+  a->base = (char *)(((uintptr_t)reservation + PROM_SLAB_PAGE_SIZE - 1) & ~(uintptr_t)(PROM_SLAB_PAGE_SIZE - 1));
+  a->size = PROM_SLAB_ARENA_SIZE;
+}
+
+static int prom_slab_owns(const void *ptr) {
+  return (uintptr_t)ptr - (uintptr_t)prom_slab_arena.base < prom_slab_arena.size;
+}
+
+static prom_slab_page_t *prom_slab_page_of(const void *ptr) {
+  return (prom_slab_page_t *)((uintptr_t)ptr & ~(uintptr_t)(PROM_SLAB_PAGE_SIZE - 1));
+}
+
+static prom_slab_page_t *prom_slab_page_new(uint32_t size_class) {
+  prom_slab_arena_t *a = &prom_slab_arena;
+  prom_slab_page_t *page = NULL;
+  pthread_mutex_lock(&a->lock);
+  if (a->free_pages != NULL) {
+    page = a->free_pages;
+    a->free_pages = page->next;
+    a->free_page_count--;
+  } else if (a->carved + PROM_SLAB_PAGE_SIZE <= a->size) {
+    page = (prom_slab_page_t *)(a->base + a->carved);
+    a->carved += PROM_SLAB_PAGE_SIZE;
+  }
+  pthread_mutex_unlock(&a->lock);
+  if (page == NULL) return NULL;
+
+  page->prev = NULL;
+  page->next = NULL;
+  page->free = NULL;
+  page->carved = sizeof(prom_slab_page_t);
+  page->live = 0;
+  page->size_class = size_class;
+  page->partial = 0;
+  return page;
+}
+
+static void prom_slab_page_release(prom_slab_page_t *page) {
+  prom_slab_arena_t *a = &prom_slab_arena;
+  // The body goes back to the kernel. The first OS page stays resident because the header links the page into
+  // free_pages.
+  if (a->os_page_size < PROM_SLAB_PAGE_SIZE) {
+    madvise((char *)page + a->os_page_size, PROM_SLAB_PAGE_SIZE - a->os_page_size, MADV_DONTNEED);
+  }
+  pthread_mutex_lock(&a->lock);
+  page->next = a->free_pages;
+  a->free_pages = page;
+  a->free_page_count++;
+  pthread_mutex_unlock(&a->lock);
+}
+
+static void prom_slab_partial_push(prom_slab_class_t *c, prom_slab_page_t *page) {
+  page->prev = NULL;
+  page->next = c->partial;
+  if (c->partial != NULL) c->partial->prev = page;
+  c->partial = page;
+  page->partial = 1;
+}
+
+static void prom_slab_partial_remove(prom_slab_class_t *c, prom_slab_page_t *page) {
+  if (page->prev != NULL) {
+    page->prev->next = page->next;
+  } else {
+    c->partial = page->next;
+  }
+  if (page->next != NULL) page->next->prev = page->prev;
+  page->prev = NULL;
+  page->next = NULL;
+  page->partial = 0;
+}
+
+static void *prom_slab_class_alloc(uint32_t index) {
+  prom_slab_class_t *c = &prom_slab_arena.classes[index];
+  pthread_mutex_lock(&c->lock);
+  prom_slab_page_t *page = c->partial;
+  if (page == NULL) {
+    page = prom_slab_page_new(index);
+    if (page == NULL) {
+      pthread_mutex_unlock(&c->lock);
+      return NULL;
+    }
+    prom_slab_partial_push(c, page);
+    c->pages++;
+  }
+
+  // Reuse a freed block before carving a new one, so that the pages of a class stay dense
+  void *block = page->free;
+  if (block != NULL) {
+    page->free = *(void **)block;
+  } else {
+    block = (char *)page + page->carved;
+    page->carved += c->size;
+  }
+  page->live++;
+  if (page->free == NULL && page->carved + c->size > PROM_SLAB_PAGE_SIZE) prom_slab_partial_remove(c, page);
+  c->live++;
+  c->allocs++;
+  pthread_mutex_unlock(&c->lock);
+  return block;
+}
+
+static void prom_slab_class_free(prom_slab_page_t *page, void *block) {
+  // The size class of the page cannot change while the page holds the block being freed
+  prom_slab_class_t *c = &prom_slab_arena.classes[page->size_class];
+  pthread_mutex_lock(&c->lock);
+  *(void **)block = page->free;
+  page->free = block;
+  page->live--;
+  c->live--;
+  c->frees++;
+  if (!page->partial) prom_slab_partial_push(c, page);
+
+  // An empty page goes back to the arena unless it is the only room the class has left. Keeping one avoids carving
+  // and releasing a page over and over when a single block is allocated and freed in a loop.
+  int release = page->live == 0 && (c->partial != page || page->next != NULL);
+  if (release) {
+    prom_slab_partial_remove(c, page);
+    c->pages--;
+  }
+  pthread_mutex_unlock(&c->lock);
+  if (release) prom_slab_page_release(page);
+}
+
+void *prom_slab_malloc(size_t size) {
+  pthread_once(&prom_slab_once, &prom_slab_init);
+  if (size <= PROM_SLAB_MAX_SIZE) {
+    void *block = prom_slab_class_alloc(prom_slab_class_of[(size + 15) >> 4]);
+    if (block != NULL) return block;
+  }
+  atomic_fetch_add_explicit(&prom_slab_arena.libc_allocs, 1, memory_order_relaxed);
+  return malloc(size);
+}
+
+void *prom_slab_realloc(void *ptr, size_t size) {
+  if (ptr == NULL) return prom_slab_malloc(size);
+  if (!prom_slab_owns(ptr)) {
+    atomic_fetch_add_explicit(&prom_slab_arena.libc_allocs, 1, memory_order_relaxed);
+    return realloc(ptr, size);
+  }
+
+  prom_slab_page_t *page = prom_slab_page_of(ptr);
+  size_t have = prom_slab_sizes[page->size_class];
+  if (size <= have) return ptr;
+  void *fresh = prom_slab_malloc(size);
+  if (fresh == NULL) return NULL;
+  memcpy(fresh, ptr, have);
+  prom_slab_class_free(page, ptr);
+  return fresh;
+}
+
+char *prom_slab_strdup(const char *str) { return prom_slab_strndup(str, SIZE_MAX); }
+
+char *prom_slab_strndup(const char *str, size_t len) {
+  len = strnlen(str, len);
+  char *self = (char *)prom_slab_malloc(len + 1);
+  if (self == NULL) return NULL;
+  memcpy(self, str, len);
+  self[len] = '\0';
+  return self;
+}
+
+void prom_slab_free(void *ptr) {
+  if (ptr == NULL) return;
+  if (prom_slab_owns(ptr)) {
+    prom_slab_class_free(prom_slab_page_of(ptr), ptr);
+  } else {
+    free(ptr);
+  }
+}
+
+// FNV-1a. Interned strings are label keys, label values and l_values, which are short.
+static size_t prom_slab_hash(const char *str, size_t len) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < len; i++) hash = (hash ^ (unsigned char)str[i]) * 1099511628211ULL;
+  return (size_t)hash;
+}
+
+/**
+ * @brief API PRIVATE Doubles the buckets of the intern table. Must be called with the intern lock held.
+ */
+static int prom_slab_intern_grow(prom_slab_arena_t *a) {
+  size_t bucket_count = a->bucket_count == 0 ? 64 : a->bucket_count * 2;
+  prom_slab_intern_entry_t **buckets = (prom_slab_intern_entry_t **)calloc(bucket_count, sizeof(*buckets));
+  if (buckets == NULL) return 1;
+  atomic_fetch_add_explicit(&a->libc_allocs, 1, memory_order_relaxed);
+  for (size_t i = 0; i < a->bucket_count; i++) {
+    prom_slab_intern_entry_t *entry = a->buckets[i];
+    while (entry != NULL) {
+      prom_slab_intern_entry_t *next = entry->next;
+      size_t j = entry->hash & (bucket_count - 1);
+      entry->next = buckets[j];
+      buckets[j] = entry;
+      entry = next;
+    }
+  }
+  free(a->buckets);
+  a->buckets = buckets;
+  a->bucket_count = bucket_count;
+  return 0;
+}
+
+const char *prom_slab_intern(const char *str) {
+  pthread_once(&prom_slab_once, &prom_slab_init);
+  prom_slab_arena_t *a = &prom_slab_arena;
+  size_t len = strlen(str);
+  size_t hash = prom_slab_hash(str, len);
+
+  pthread_mutex_lock(&a->intern_lock);
+  if (a->bucket_count > 0) {
+    for (prom_slab_intern_entry_t *entry = a->buckets[hash & (a->bucket_count - 1)]; entry; entry = entry->next) {
+      if (entry->hash == hash && entry->len == len && memcmp(entry->str, str, len) == 0) {
+        entry->refs++;
+        a->intern_hits++;
+        pthread_mutex_unlock(&a->intern_lock);
+        return entry->str;
+      }
+    }
+  }
+
+  if (a->interned >= a->bucket_count && prom_slab_intern_grow(a) && a->bucket_count == 0) {
+    pthread_mutex_unlock(&a->intern_lock);
+    return NULL;
+  }
+  prom_slab_intern_entry_t *entry = (prom_slab_intern_entry_t *)prom_slab_malloc(sizeof(*entry) + len + 1);
+  if (entry == NULL) {
+    pthread_mutex_unlock(&a->intern_lock);
+    return NULL;
+  }
+  entry->hash = hash;
+  entry->refs = 1;
+  entry->len = len;
+  memcpy(entry->str, str, len + 1);
+  size_t i = hash & (a->bucket_count - 1);
+  entry->next = a->buckets[i];
+  a->buckets[i] = entry;
+  a->interned++;
+  pthread_mutex_unlock(&a->intern_lock);
+  return entry->str;
+}
+
+void prom_slab_intern_release(const char *str) {
+  if (str == NULL) return;
+  prom_slab_arena_t *a = &prom_slab_arena;
+  prom_slab_intern_entry_t *entry = (prom_slab_intern_entry_t *)(str - offsetof(prom_slab_intern_entry_t, str));
+
+  pthread_mutex_lock(&a->intern_lock);
+  if (--entry->refs > 0) {
+    pthread_mutex_unlock(&a->intern_lock);
+    return;
+  }
+  prom_slab_intern_entry_t **link = &a->buckets[entry->hash & (a->bucket_count - 1)];
+  while (*link != entry) link = &(*link)->next;
+  *link = entry->next;
+  a->interned--;
+  pthread_mutex_unlock(&a->intern_lock);
+  prom_slab_free(entry);
+}
+
+void prom_slab_stats(prom_slab_stats_t *stats) {
+  pthread_once(&prom_slab_once, &prom_slab_init);
+  prom_slab_arena_t *a = &prom_slab_arena;
+  memset(stats, 0, sizeof(*stats));
+  stats->arena_bytes = a->size;
+
+  pthread_mutex_lock(&a->lock);
+  stats->page_bytes = a->carved - a->free_page_count * PROM_SLAB_PAGE_SIZE;
+  pthread_mutex_unlock(&a->lock);
+
+  for (size_t i = 0; i < PROM_SLAB_CLASS_COUNT; i++) {
+    prom_slab_class_t *c = &a->classes[i];
+    pthread_mutex_lock(&c->lock);
+    stats->used_bytes += c->live * c->size;
+    stats->allocs += c->allocs;
+    stats->frees += c->frees;
+    pthread_mutex_unlock(&c->lock);
+  }
+  stats->libc_allocs = atomic_load_explicit(&a->libc_allocs, memory_order_relaxed);
+
+  pthread_mutex_lock(&a->intern_lock);
+  stats->interned_strings = a->interned;
+  stats->intern_hits = a->intern_hits;
+  pthread_mutex_unlock(&a->intern_lock);
+}
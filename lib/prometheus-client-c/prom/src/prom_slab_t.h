@@ -0,0 +1,106 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PROM_SLAB_T_H
+#define PROM_SLAB_T_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Public
+#include "prom_slab.h"
+
+/**
+ * @brief API PRIVATE The size of a slab page. Pages are aligned to their size within the arena, so the page of a block
+ * is found by masking its address.
+ */
+#define PROM_SLAB_PAGE_SIZE ((size_t)1 << 16)
+
+/**
+ * @brief API PRIVATE The address space reserved for the arena. Only the pages in use are backed by memory.
+ */
+#ifndef PROM_SLAB_ARENA_SIZE
+#define PROM_SLAB_ARENA_SIZE (sizeof(void *) == 8 ? (size_t)1 << 30 : (size_t)1 << 26)
+#endif
+
+/**
+ * @brief API PRIVATE The number of size classes, from 16 bytes to PROM_SLAB_MAX_SIZE
+ */
+#define PROM_SLAB_CLASS_COUNT 20
+
+/**
+ * @brief API PRIVATE The header at the start of every slab page. Blocks follow it, so its size keeps them aligned.
+ */
+typedef struct prom_slab_page {
+  _Alignas(64) struct prom_slab_page *prev; /**< neighbour on the partial list of the size class */
+  struct prom_slab_page *next;              /**< next page on the partial list of the size class, or on free_pages */
+  void *free;                               /**< freed blocks of the page, linked through their first word */
+  size_t carved;                            /**< offset of the first block that was never handed out */
+  uint32_t live;                            /**< blocks of the page that are handed out */
+  uint32_t size_class;                      /**< index of the size class the page serves */
+  int partial;                              /**< the page is on the partial list of its size class */
+} prom_slab_page_t;
+
+/**
+ * @brief API PRIVATE A size class. Blocks are taken from the first page of the partial list, which holds every page of
+ * the class that has room.
+ */
+typedef struct prom_slab_class {
+  pthread_mutex_t lock;
+  size_t size;                /**< the size of the blocks */
+  prom_slab_page_t *partial;  /**< pages with room for another block */
+  size_t pages;               /**< pages serving the class */
+  size_t live;                /**< blocks handed out */
+  uint64_t allocs;
+  uint64_t frees;
+} prom_slab_class_t;
+
+/**
+ * @brief API PRIVATE An interned string. Interned strings are blocks of the slab allocator, or of libc once they are
+ * too long for a size class, linked into the buckets of the intern table.
+ */
+typedef struct prom_slab_intern_entry {
+  struct prom_slab_intern_entry *next;
+  size_t hash;
+  size_t refs; /**< outstanding prom_slab_intern calls that returned str */
+  size_t len;
+  char str[];
+} prom_slab_intern_entry_t;
+
+/**
+ * @brief API PRIVATE The arena all slab pages are carved from.
+ */
+typedef struct prom_slab_arena {
+  char *base;                   /**< start of the reserved address space, aligned to PROM_SLAB_PAGE_SIZE */
+  size_t size;                  /**< bytes reserved from base. 0 if the reservation failed. */
+  size_t os_page_size;          /**< granularity in which page bodies are handed back to the kernel */
+  pthread_mutex_t lock;         /**< guards carved and free_pages */
+  size_t carved;                /**< bytes of the arena carved into pages so far */
+  prom_slab_page_t *free_pages; /**< carved pages that serve no size class */
+  size_t free_page_count;
+  prom_slab_class_t classes[PROM_SLAB_CLASS_COUNT];
+  _Atomic uint64_t libc_allocs;
+  pthread_mutex_t intern_lock;  /**< guards the intern table */
+  prom_slab_intern_entry_t **buckets;
+  size_t bucket_count;          /**< a power of two */
+  size_t interned;
+  uint64_t intern_hits;
+} prom_slab_arena_t;
+
+#endif  // PROM_SLAB_T_H
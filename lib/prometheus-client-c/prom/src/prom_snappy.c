@@ -0,0 +1,211 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdint.h>
+#include <string.h>
+
+// Public
+#include "prom_alloc.h"
+
+// Private
+#include "prom_assert.h"
+#include "prom_protobuf_i.h"
+#include "prom_snappy_i.h"
+#include "prom_string_builder_i.h"
+
+// Input is compressed in blocks of this size so that every copy offset fits in two bytes
+#define PROM_SNAPPY_BLOCK_SIZE (1 << 16)
+
+// The number of entries in the match finder's hash table
+#define PROM_SNAPPY_HASH_BITS 14
+
+// Snappy element tags
+#define PROM_SNAPPY_LITERAL 0
+#define PROM_SNAPPY_COPY_1 1
+#define PROM_SNAPPY_COPY_2 2
+#define PROM_SNAPPY_COPY_4 3
+
+static uint32_t prom_snappy_load32(const char *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static uint32_t prom_snappy_hash(uint32_t v) { return (v * 0x1e35a7bd) >> (32 - PROM_SNAPPY_HASH_BITS); }
+
+static int prom_snappy_emit_literal(prom_string_builder_t *out, const char *src, size_t len) {
+  int r = 0;
+  if (len == 0) return 0;
+
+  char tag[5];
+  size_t tag_len = 0;
+  size_t n = len - 1;
+  if (n < 60) {
+    tag[tag_len++] = (char)(n << 2 | PROM_SNAPPY_LITERAL);
+  } else {
+    // 60 to 63 indicate that the length follows in 1 to 4 little endian bytes
+    size_t bytes = 0;
+    for (size_t v = n; v > 0; v >>= 8) bytes++;
+    tag[tag_len++] = (char)((59 + bytes) << 2 | PROM_SNAPPY_LITERAL);
+    for (size_t i = 0; i < bytes; i++) tag[tag_len++] = (char)(n >> (8 * i));
+  }
+  r = prom_string_builder_add_n(out, tag, tag_len);
+  if (r) return r;
+  return prom_string_builder_add_n(out, src, len);
+}
+
+static int prom_snappy_emit_copy(prom_string_builder_t *out, size_t offset, size_t len) {
+  int r = 0;
+  char tag[3];
+  while (len > 0) {
+    // Keep at least 4 bytes for the last element so that it can always be encoded
+    size_t n = len;
+    if (n > 64) n = len - 64 < 4 ? 60 : 64;
+
+    if (n >= 4 && n <= 11 && offset < 2048) {
+      tag[0] = (char)((offset >> 8) << 5 | (n - 4) << 2 | PROM_SNAPPY_COPY_1);
+      tag[1] = (char)offset;
+      r = prom_string_builder_add_n(out, tag, 2);
+    } else {
+      tag[0] = (char)((n - 1) << 2 | PROM_SNAPPY_COPY_2);
+      tag[1] = (char)offset;
+      tag[2] = (char)(offset >> 8);
+      r = prom_string_builder_add_n(out, tag, 3);
+    }
+    if (r) return r;
+    len -= n;
+  }
+  return 0;
+}
+
+static int prom_snappy_compress_block(prom_string_builder_t *out, const char *src, size_t len, uint16_t *table) {
+  int r = 0;
+  memset(table, 0, sizeof(uint16_t) << PROM_SNAPPY_HASH_BITS);
+
+  size_t literal_start = 0;
+  size_t i = 1;
+  if (len >= 4) {
+    table[prom_snappy_hash(prom_snappy_load32(src))] = 0;
+    while (i + 4 <= len) {
+      uint32_t v = prom_snappy_load32(src + i);
+      uint32_t h = prom_snappy_hash(v);
+      size_t candidate = table[h];
+      table[h] = (uint16_t)i;
+      if (candidate >= i || prom_snappy_load32(src + candidate) != v) {
+        i++;
+        continue;
+      }
+
+      size_t match = 4;
+      while (i + match < len && src[candidate + match] == src[i + match]) match++;
+
+      r = prom_snappy_emit_literal(out, src + literal_start, i - literal_start);
+      if (r) return r;
+      r = prom_snappy_emit_copy(out, i - candidate, match);
+      if (r) return r;
+
+      i += match;
+      literal_start = i;
+    }
+  }
+  return prom_snappy_emit_literal(out, src + literal_start, len - literal_start);
+}
+
+int prom_snappy_compress(prom_string_builder_t *out, const char *src, size_t len) {
+  PROM_ASSERT(out != NULL);
+  int r = 0;
+
+  // The preamble is the uncompressed length
+  r = prom_protobuf_add_varint(out, len);
+  if (r) return r;
+
+  uint16_t *table = (uint16_t *)prom_malloc(sizeof(uint16_t) << PROM_SNAPPY_HASH_BITS);
+  for (size_t offset = 0; offset < len; offset += PROM_SNAPPY_BLOCK_SIZE) {
+    size_t block_len = len - offset < PROM_SNAPPY_BLOCK_SIZE ? len - offset : PROM_SNAPPY_BLOCK_SIZE;
+    r = prom_snappy_compress_block(out, src + offset, block_len, table);
+    if (r) break;
+  }
+  prom_free(table);
+  return r;
+}
+
+char *prom_snappy_uncompress(const char *src, size_t len, size_t *out_len) {
+  const unsigned char *p = (const unsigned char *)src;
+  const unsigned char *end = p + len;
+
+  uint64_t expected = 0;
+  for (int shift = 0;; shift += 7) {
+    if (p == end || shift > 63) return NULL;
+    expected |= (uint64_t)(*p & 0x7F) << shift;
+    if (*p++ < 0x80) break;
+  }
+
+  char *out = (char *)prom_malloc(expected + 1);
+  size_t pos = 0;
+  while (p < end) {
+    unsigned char tag = *p++;
+    size_t n = 0;
+    size_t offset = 0;
+    switch (tag & 3) {
+      case PROM_SNAPPY_LITERAL:
+        n = tag >> 2;
+        if (n >= 60) {
+          size_t bytes = n - 59;
+          if ((size_t)(end - p) < bytes) goto malformed;
+          n = 0;
+          for (size_t i = 0; i < bytes; i++) n |= (size_t)p[i] << (8 * i);
+          p += bytes;
+        }
+        n++;
+        if ((size_t)(end - p) < n || expected - pos < n) goto malformed;
+        memcpy(out + pos, p, n);
+        p += n;
+        pos += n;
+        continue;
+      case PROM_SNAPPY_COPY_1:
+        if (end - p < 1) goto malformed;
+        n = ((tag >> 2) & 7) + 4;
+        offset = (size_t)(tag >> 5) << 8 | p[0];
+        p += 1;
+        break;
+      case PROM_SNAPPY_COPY_2:
+        if (end - p < 2) goto malformed;
+        n = (tag >> 2) + 1;
+        offset = (size_t)p[0] | (size_t)p[1] << 8;
+        p += 2;
+        break;
+      default:
+        if (end - p < 4) goto malformed;
+        n = (tag >> 2) + 1;
+        offset = (size_t)p[0] | (size_t)p[1] << 8 | (size_t)p[2] << 16 | (size_t)p[3] << 24;
+        p += 4;
+        break;
+    }
+    if (offset == 0 || offset > pos || expected - pos < n) goto malformed;
+    // Copies may overlap their own output, so they are made one byte at a time
+    for (size_t i = 0; i < n; i++, pos++) out[pos] = out[pos - offset];
+  }
+  if (pos != expected) goto malformed;
+
+  out[pos] = '\0';
+  *out_len = pos;
+  return out;
+
+malformed:
+  prom_free(out);
+  return NULL;
+}
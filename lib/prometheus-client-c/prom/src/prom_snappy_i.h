@@ -0,0 +1,43 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// Reference: https://github.com/google/snappy/blob/main/format_description.txt
+
+#ifndef PROM_SNAPPY_I_H
+#define PROM_SNAPPY_I_H
+
+#include <stddef.h>
+
+// Private
+#include "prom_string_builder_t.h"
+
+/**
+ * @brief API PRIVATE Appends the snappy block compressed form of the len bytes at src to out.
+ *
+ * This is the raw block format required by the remote write protocol, not the framing format.
+ */
+int prom_snappy_compress(prom_string_builder_t *out, const char *src, size_t len);
+
+/**
+ * @brief API PRIVATE Decompresses a snappy block. Returns a buffer that MUST be freed or NULL if src is malformed.
+ * @param src The compressed block
+ * @param len The number of bytes in src
+ * @param out_len Set to the number of bytes in the returned buffer
+ */
+char *prom_snappy_uncompress(const char *src, size_t len, size_t *out_len);
+
+#endif  // PROM_SNAPPY_I_H
@@ -14,7 +14,10 @@
  * limitations under the License.
  */
 
+#include <math.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 
 // Public
 #include "prom_alloc.h"
@@ -27,14 +30,23 @@
 // The initial size of a string created via prom_string_builder
 #define PROM_STRING_BUILDER_INIT_SIZE 32
 
+// The number of clears between checks of whether the allocation has outgrown the strings built in it
+#define PROM_STRING_BUILDER_TRIM_INTERVAL 16
+
+// The allocation is trimmed when it is at least this many times larger than the longest recent string
+#define PROM_STRING_BUILDER_TRIM_FACTOR 4
+
+
 // prom_string_builder_init prototype declaration
 int prom_string_builder_init(prom_string_builder_t *self);
 
 struct prom_string_builder {
-  char *str;        /**< the target string  */
-  size_t allocated; /**< the size allocated to the string in bytes */
-  size_t len;       /**< the length of str */
-  size_t init_size; /**< the initialize size of space to allocate */
+  char *str;         /**< the target string  */
+  size_t allocated;  /**< the size allocated to the string in bytes */
+  size_t len;        /**< the length of str */
+  size_t init_size;  /**< the initialize size of space to allocate */
+  size_t high_water; /**< the longest string cleared since the allocation was last checked for trimming */
+  size_t clears;     /**< the number of clears since the allocation was last checked for trimming */
 };
 
 prom_string_builder_t *prom_string_builder_new(void) {
@@ -58,6 +70,8 @@ int prom_string_builder_init(prom_string_builder_t *self) {
   *self->str = '\0';
   self->allocated = self->init_size;
   self->len = 0;
+  self->high_water = 0;
+  self->clears = 0;
   return 0;
 }
 
@@ -103,6 +117,22 @@ int prom_string_builder_add_str(prom_string_builder_t *self, const char *str) {
   return 0;
 }
 
+int prom_string_builder_add_n(prom_string_builder_t *self, const char *data, size_t len) {
+  PROM_ASSERT(self != NULL);
+  int r = 0;
+
+  if (self == NULL) return 1;
+  if (data == NULL || len == 0) return 0;
+
+  r = prom_string_builder_ensure_space(self, len);
+  if (r) return r;
+
+  memcpy(self->str + self->len, data, len);
+  self->len += len;
+  self->str[self->len] = '\0';
+  return 0;
+}
+
 int prom_string_builder_add_char(prom_string_builder_t *self, char c) {
   PROM_ASSERT(self != NULL);
   int r = 0;
@@ -117,6 +147,57 @@ int prom_string_builder_add_char(prom_string_builder_t *self, char c) {
   return 0;
 }
 
+size_t prom_string_builder_format_u64(char *buf, uint64_t value) {
+  // Digits are produced from the least significant end, so they are written to the end of digits first
+  char digits[20];
+  char *p = digits + sizeof(digits);
+  do {
+    *--p = (char)('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+  size_t len = (size_t)(digits + sizeof(digits) - p);
+  memcpy(buf, p, len);
+  buf[len] = '\0';
+  return len;
+}
+
+size_t prom_string_builder_format_double(char *buf, double value) {
+  // "%.17g" prints integers below 10^17 as their plain digits, so those up to 2^53, which every double in that range
+  // can represent exactly, skip snprintf. This is the common case for counters and many gauges. -0 keeps its sign.
+  if (value >= -9007199254740992.0 && value <= 9007199254740992.0 && value == (double)(int64_t)value &&
+      !(value == 0.0 && signbit(value))) {
+    if (value >= 0.0) return prom_string_builder_format_u64(buf, (uint64_t)value);
+    buf[0] = '-';
+    return prom_string_builder_format_u64(buf + 1, (uint64_t)-(int64_t)value) + 1;
+  }
+  int len = snprintf(buf, PROM_STRING_BUILDER_DOUBLE_SIZE, "%.17g", value);
+  return len < 0 ? 0 : (size_t)len;
+}
+
+int prom_string_builder_add_u64(prom_string_builder_t *self, uint64_t value) {
+  PROM_ASSERT(self != NULL);
+  int r = 0;
+
+  if (self == NULL) return 1;
+  r = prom_string_builder_ensure_space(self, PROM_STRING_BUILDER_DOUBLE_SIZE);
+  if (r) return r;
+
+  self->len += prom_string_builder_format_u64(self->str + self->len, value);
+  return 0;
+}
+
+int prom_string_builder_add_double(prom_string_builder_t *self, double value) {
+  PROM_ASSERT(self != NULL);
+  int r = 0;
+
+  if (self == NULL) return 1;
+  r = prom_string_builder_ensure_space(self, PROM_STRING_BUILDER_DOUBLE_SIZE);
+  if (r) return r;
+
+  self->len += prom_string_builder_format_double(self->str + self->len, value);
+  return 0;
+}
+
 int prom_string_builder_truncate(prom_string_builder_t *self, size_t len) {
   PROM_ASSERT(self != NULL);
   if (self == NULL) return 1;
@@ -129,9 +210,28 @@ int prom_string_builder_truncate(prom_string_builder_t *self, size_t len) {
 
 int prom_string_builder_clear(prom_string_builder_t *self) {
   PROM_ASSERT(self != NULL);
-  prom_free(self->str);
-  self->str = NULL;
-  return prom_string_builder_init(self);
+  if (self == NULL) return 1;
+
+  // The allocation is kept so that a builder which is filled and cleared in cycles stops allocating once it has grown
+  // to fit the largest string. If the strings shrink for good, such as after series were removed, the allocation is
+  // brought back down to fit the longest string seen over the last PROM_STRING_BUILDER_TRIM_INTERVAL clears.
+  if (self->len > self->high_water) self->high_water = self->len;
+  if (++self->clears == PROM_STRING_BUILDER_TRIM_INTERVAL) {
+    size_t fit = self->init_size;
+    while (fit < self->high_water + 1) fit <<= 1;
+    if (self->allocated >= fit * PROM_STRING_BUILDER_TRIM_FACTOR) {
+      char *str = (char *)prom_realloc(self->str, fit);
+      if (str != NULL) {
+        self->str = str;
+        self->allocated = fit;
+      }
+    }
+    self->high_water = 0;
+    self->clears = 0;
+  }
+  self->len = 0;
+  self->str[0] = '\0';
+  return 0;
 }
 
 size_t prom_string_builder_len(prom_string_builder_t *self) {
@@ -151,3 +251,10 @@ char *prom_string_builder_str(prom_string_builder_t *self) {
   PROM_ASSERT(self != NULL);
   return self->str;
 }
+
+const char *prom_string_builder_view(prom_string_builder_t *self, size_t *len) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return NULL;
+  if (len != NULL) *len = self->len;
+  return self->str;
+}
@@ -18,9 +18,17 @@
 #define PROM_STRING_BUILDER_I_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include "prom_string_builder_t.h"
 
+/**
+ * API PRIVATE
+ * @brief The size of a buffer that holds any number written by prom_string_builder_format_u64 or
+ * prom_string_builder_format_double, including the terminating NUL. "%.17g" needs at most 25 bytes.
+ */
+#define PROM_STRING_BUILDER_DOUBLE_SIZE 32
+
 /**
  * API PRIVATE
  * @brief Constructor for prom_string_builder
@@ -39,6 +47,12 @@ int prom_string_builder_destroy(prom_string_builder_t *self);
  */
 int prom_string_builder_add_str(prom_string_builder_t *self, const char *str);
 
+/**
+ * API PRIVATE
+ * @brief Adds len bytes from data. Unlike prom_string_builder_add_str, data may contain NUL bytes.
+ */
+int prom_string_builder_add_n(prom_string_builder_t *self, const char *data, size_t len);
+
 /**
  * API PRIVATE
  * @brief Adds a char
@@ -47,7 +61,36 @@ int prom_string_builder_add_char(prom_string_builder_t *self, char c);
 
 /**
  * API PRIVATE
- * @brief Clear the string
+ * @brief Adds the decimal digits of value
+ */
+int prom_string_builder_add_u64(prom_string_builder_t *self, uint64_t value);
+
+/**
+ * API PRIVATE
+ * @brief Adds value formatted as prom_string_builder_format_double does. The value is written in place, without a
+ * temporary copy.
+ */
+int prom_string_builder_add_double(prom_string_builder_t *self, double value);
+
+/**
+ * API PRIVATE
+ * @brief Writes the decimal digits of value and a terminating NUL to buf, which must hold at least
+ * PROM_STRING_BUILDER_DOUBLE_SIZE bytes. Returns the number of digits.
+ */
+size_t prom_string_builder_format_u64(char *buf, uint64_t value);
+
+/**
+ * API PRIVATE
+ * @brief Writes value to buf exactly as "%.17g" would, which round-trips, followed by a terminating NUL. buf must hold
+ * at least PROM_STRING_BUILDER_DOUBLE_SIZE bytes. Integral values are written without going through snprintf. Returns
+ * the number of bytes written excluding the NUL.
+ */
+size_t prom_string_builder_format_double(char *buf, double value);
+
+/**
+ * API PRIVATE
+ * @brief Clear the string. The allocated space is kept for reuse, unless it has stayed several times larger than the
+ * strings built in it over the last few clears, in which case it is shrunk to fit them.
  */
 int prom_string_builder_clear(prom_string_builder_t *self);
 
@@ -55,7 +98,7 @@ int prom_string_builder_clear(prom_string_builder_t *self);
  * API PRIVATE
  * @brief Remove data from the end
  */
-int prom_string_buillder_truncate(prom_string_builder_t *self, size_t len);
+int prom_string_builder_truncate(prom_string_builder_t *self, size_t len);
 
 /**
  * API PRIVATE
@@ -75,4 +118,11 @@ char *prom_string_builder_dump(prom_string_builder_t *self);
  */
 char *prom_string_builder_str(prom_string_builder_t *self);
 
+/**
+ * API PRIVATE
+ * @brief Borrows the string without copying it and sets len to its length when len is not NULL. The string is owned by
+ * the builder and stays valid until the builder is next modified or destroyed.
+ */
+const char *prom_string_builder_view(prom_string_builder_t *self, size_t *len);
+
 #endif  // PROM_STRING_BUILDER_I_H
@@ -0,0 +1,99 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <string.h>
+
+// Public
+#include "prom_alloc.h"
+#include "prom_summary.h"
+
+// Private
+#include "prom_assert.h"
+#include "prom_epoch_i.h"
+#include "prom_errors.h"
+#include "prom_log.h"
+#include "prom_metric_i.h"
+#include "prom_metric_sample_summary_i.h"
+#include "prom_metric_t.h"
+
+static const double prom_summary_default_quantiles[] = {0.5, 0.9, 0.99};
+
+#define PROM_SUMMARY_DEFAULT_MAX_AGE 600.0
+
+prom_summary_t *prom_summary_new(const char *name, const char *help, size_t quantile_count, const double *quantiles,
+                                 double max_age, size_t label_key_count, const char **label_keys) {
+  if (quantile_count == 0) {
+    quantiles = prom_summary_default_quantiles;
+    quantile_count = sizeof(prom_summary_default_quantiles) / sizeof(prom_summary_default_quantiles[0]);
+  }
+  if (quantile_count > PROM_SUMMARY_MAX_QUANTILES) {
+    PROM_LOG(PROM_SUMMARY_INVALID_QUANTILES);
+    return NULL;
+  }
+  // Ensure the quantiles are increasing and within [0, 1]. The negated comparisons also reject NaN.
+  for (size_t i = 0; i < quantile_count; i++) {
+    if (!(quantiles[i] >= 0.0 && quantiles[i] <= 1.0) || (i > 0 && !(quantiles[i - 1] < quantiles[i]))) {
+      PROM_LOG(PROM_SUMMARY_INVALID_QUANTILES);
+      return NULL;
+    }
+  }
+
+  prom_summary_t *self = (prom_summary_t *)prom_metric_new(PROM_SUMMARY, name, help, label_key_count, label_keys);
+  if (self == NULL) return NULL;
+
+  double *q = (double *)prom_malloc(sizeof(double) * quantile_count);
+  memcpy(q, quantiles, sizeof(double) * quantile_count);
+  self->quantiles = q;
+  self->quantile_count = quantile_count;
+  self->max_age = max_age > 0.0 ? max_age : PROM_SUMMARY_DEFAULT_MAX_AGE;
+  return self;
+}
+
+int prom_summary_destroy(prom_summary_t *self) {
+  PROM_ASSERT(self != NULL);
+
+  int r = 0;
+
+  if (self == NULL) return r;
+  r = prom_metric_destroy(self);
+  self = NULL;
+  return r;
+}
+
+int prom_summary_observe(prom_summary_t *self, double value, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (self->type != PROM_SUMMARY) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  prom_epoch_enter();
+  prom_metric_sample_summary_t *s_sample = prom_metric_sample_summary_for_update(self, label_values);
+  int r = s_sample == NULL ? 1 : prom_metric_sample_summary_observe(s_sample, value);
+  prom_epoch_exit();
+  return r;
+}
+
+prom_metric_sample_summary_t *prom_summary_child(prom_summary_t *self, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return NULL;
+  if (self->type != PROM_SUMMARY) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return NULL;
+  }
+  return prom_metric_sample_summary_from_labels(self, label_values);
+}
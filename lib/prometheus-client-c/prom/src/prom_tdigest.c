@@ -0,0 +1,156 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/**
+ * @file prom_tdigest.c
+ * @brief A merging t-digest for streaming quantiles in fixed memory
+ *
+ * Reference: Dunning and Ertl, "Computing Extremely Accurate Quantiles Using t-Digests". Points are buffered and
+ * periodically sorted together with the existing centroids, then swept left to right, merging neighbours for as long
+ * as the merged centroid spans at most one unit of the k1 scale function k(q) = compression / (2 pi) * asin(2q - 1).
+ * k1 is steep near q = 0 and q = 1, which keeps centroids small, and quantiles accurate, in the tails.
+ */
+
+#include <math.h>
+#include <stddef.h>
+
+// Private
+#include "prom_assert.h"
+#include "prom_tdigest_i.h"
+
+static double prom_tdigest_k(double q) { return PROM_TDIGEST_COMPRESSION / (2.0 * M_PI) * asin(2.0 * q - 1.0); }
+
+static double prom_tdigest_q(double k) {
+  // k1 ranges over [-compression / 4, compression / 4]
+  if (k >= PROM_TDIGEST_COMPRESSION / 4.0) return 1.0;
+  return (sin(k * 2.0 * M_PI / PROM_TDIGEST_COMPRESSION) + 1.0) / 2.0;
+}
+
+// Shell sort by mean. qsort is avoided because glibc allocates a merge buffer for arrays of this size, and digests are
+// compressed while scraping, which must not allocate. The gaps are Ciura's, which cover a full digest.
+static void prom_tdigest_sort(prom_tdigest_centroid_t *c, size_t n) {
+  static const size_t gaps[] = {132, 57, 23, 10, 4, 1};
+  for (size_t g = 0; g < sizeof(gaps) / sizeof(gaps[0]); g++) {
+    size_t gap = gaps[g];
+    for (size_t i = gap; i < n; i++) {
+      prom_tdigest_centroid_t item = c[i];
+      size_t j = i;
+      for (; j >= gap && c[j - gap].mean > item.mean; j -= gap) c[j] = c[j - gap];
+      c[j] = item;
+    }
+  }
+}
+
+void prom_tdigest_reset(prom_tdigest_t *self) {
+  PROM_ASSERT(self != NULL);
+  self->merged_count = 0;
+  self->count = 0;
+  self->min = INFINITY;
+  self->max = -INFINITY;
+}
+
+int prom_tdigest_add(prom_tdigest_t *self, double value, double weight) {
+  PROM_ASSERT(self != NULL);
+  if (isnan(value)) return 1;
+  if (self->count == PROM_TDIGEST_CAPACITY + PROM_TDIGEST_BUFFER) prom_tdigest_compress(self);
+  self->centroids[self->count].mean = value;
+  self->centroids[self->count].weight = weight;
+  self->count++;
+  if (value < self->min) self->min = value;
+  if (value > self->max) self->max = value;
+  return 0;
+}
+
+void prom_tdigest_merge(prom_tdigest_t *self, const prom_tdigest_t *other) {
+  PROM_ASSERT(self != NULL);
+  PROM_ASSERT(other != NULL);
+  for (size_t i = 0; i < other->count; i++) {
+    prom_tdigest_add(self, other->centroids[i].mean, other->centroids[i].weight);
+  }
+  // Merged centroids carry their means rather than the extremes, so bring those over as well
+  if (other->count > 0) {
+    if (other->min < self->min) self->min = other->min;
+    if (other->max > self->max) self->max = other->max;
+  }
+}
+
+double prom_tdigest_weight(const prom_tdigest_t *self) {
+  PROM_ASSERT(self != NULL);
+  double weight = 0.0;
+  for (size_t i = 0; i < self->count; i++) weight += self->centroids[i].weight;
+  return weight;
+}
+
+void prom_tdigest_compress(prom_tdigest_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self->count == self->merged_count) return;
+
+  prom_tdigest_centroid_t *c = self->centroids;
+  prom_tdigest_sort(c, self->count);
+  double total = prom_tdigest_weight(self);
+
+  // Sweep in place: the write index never passes the read index. weight_before is the weight of the centroids already
+  // written, and limit the cumulative weight the centroid being built may reach.
+  size_t out = 0;
+  double weight_before = 0.0;
+  double limit = total * prom_tdigest_q(prom_tdigest_k(0.0) + 1.0);
+  for (size_t i = 1; i < self->count; i++) {
+    double weight = c[out].weight + c[i].weight;
+    // The capacity check only matters for floating point ties at the boundaries; it keeps the digest within bounds
+    if (weight_before + weight <= limit || out == PROM_TDIGEST_CAPACITY - 1) {
+      c[out].mean += (c[i].mean - c[out].mean) * c[i].weight / weight;
+      c[out].weight = weight;
+    } else {
+      weight_before += c[out].weight;
+      limit = total * prom_tdigest_q(prom_tdigest_k(weight_before / total) + 1.0);
+      c[++out] = c[i];
+    }
+  }
+  self->merged_count = out + 1;
+  self->count = out + 1;
+}
+
+double prom_tdigest_quantile(prom_tdigest_t *self, double q) {
+  PROM_ASSERT(self != NULL);
+  prom_tdigest_compress(self);
+  if (self->count == 0) return NAN;
+  if (q <= 0.0) return self->min;
+  if (q >= 1.0) return self->max;
+
+  const prom_tdigest_centroid_t *c = self->centroids;
+  size_t n = self->count;
+  double total = prom_tdigest_weight(self);
+  double index = q * total;
+
+  // Each centroid's weight is taken to be centred on its mean. Below the first centre and above the last, interpolate
+  // towards the observed extremes.
+  if (index < c[0].weight / 2.0) {
+    return self->min + (c[0].mean - self->min) * index / (c[0].weight / 2.0);
+  }
+  double cumulative = c[0].weight / 2.0;
+  for (size_t i = 0; i + 1 < n; i++) {
+    double step = (c[i].weight + c[i + 1].weight) / 2.0;
+    if (index < cumulative + step) {
+      return c[i].mean + (c[i + 1].mean - c[i].mean) * (index - cumulative) / step;
+    }
+    cumulative += step;
+  }
+  double tail = c[n - 1].weight / 2.0;
+  if (tail <= 0.0) return self->max;
+  double offset = index - cumulative;
+  return c[n - 1].mean + (self->max - c[n - 1].mean) * (offset < tail ? offset / tail : 1.0);
+}
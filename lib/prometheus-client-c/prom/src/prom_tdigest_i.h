@@ -0,0 +1,54 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PROM_TDIGEST_I_H
+#define PROM_TDIGEST_I_H
+
+#include "prom_tdigest_t.h"
+
+/**
+ * @brief API PRIVATE Empties the digest
+ */
+void prom_tdigest_reset(prom_tdigest_t *self);
+
+/**
+ * @brief API PRIVATE Adds a point of the given weight. Returns non-zero if value is NaN, which is not added.
+ */
+int prom_tdigest_add(prom_tdigest_t *self, double value, double weight);
+
+/**
+ * @brief API PRIVATE Adds every centroid and buffered point of other to self. other is not modified.
+ */
+void prom_tdigest_merge(prom_tdigest_t *self, const prom_tdigest_t *other);
+
+/**
+ * @brief API PRIVATE Merges the buffered points into the centroids
+ */
+void prom_tdigest_compress(prom_tdigest_t *self);
+
+/**
+ * @brief API PRIVATE Returns the total weight of the points added since the digest was reset
+ */
+double prom_tdigest_weight(const prom_tdigest_t *self);
+
+/**
+ * @brief API PRIVATE Returns an estimate of the q quantile, 0 <= q <= 1, or NaN if the digest is empty. Compresses the
+ * digest first.
+ */
+double prom_tdigest_quantile(prom_tdigest_t *self, double q);
+
+#endif  // PROM_TDIGEST_I_H
@@ -0,0 +1,61 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PROM_TDIGEST_T_H
+#define PROM_TDIGEST_T_H
+
+#include <stddef.h>
+
+/**
+ * @brief API PRIVATE The compression of a t-digest. The k1 scale function spans compression / 2, so a compressed
+ * digest holds at most compression + 1 centroids. Larger values trade memory for accuracy.
+ */
+#define PROM_TDIGEST_COMPRESSION 100
+
+/**
+ * @brief API PRIVATE The most centroids a compressed digest can hold
+ */
+#define PROM_TDIGEST_CAPACITY (PROM_TDIGEST_COMPRESSION + 1)
+
+/**
+ * @brief API PRIVATE The number of points buffered before they are merged into the centroids
+ */
+#define PROM_TDIGEST_BUFFER 128
+
+/**
+ * @brief API PRIVATE A cluster of points summarized by their mean and total weight
+ */
+typedef struct prom_tdigest_centroid {
+  double mean;
+  double weight;
+} prom_tdigest_centroid_t;
+
+/**
+ * @brief API PRIVATE A merging t-digest with fixed storage.
+ *
+ * The first merged_count centroids are compressed and sorted by mean. New points are appended after them and merged in
+ * once the buffer fills, so adding a point never allocates.
+ */
+typedef struct prom_tdigest {
+  size_t merged_count; /**< number of compressed centroids at the start of centroids */
+  size_t count;        /**< number of used entries in centroids: compressed centroids followed by buffered points */
+  double min;          /**< smallest point added since the digest was reset */
+  double max;          /**< largest point added since the digest was reset */
+  prom_tdigest_centroid_t centroids[PROM_TDIGEST_CAPACITY + PROM_TDIGEST_BUFFER];
+} prom_tdigest_t;
+
+#endif  // PROM_TDIGEST_T_H
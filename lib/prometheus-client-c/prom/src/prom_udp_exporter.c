@@ -0,0 +1,338 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// sendmmsg and struct mmsghdr
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <math.h>
+#include <netdb.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+// Public
+#include "prom_alloc.h"
+#include "prom_udp_exporter.h"
+
+// Private
+#include "prom_assert.h"
+#include "prom_collector_registry_i.h"
+#include "prom_collector_registry_t.h"
+#include "prom_log.h"
+#include "prom_metric_sample_i.h"
+#include "prom_metric_sample_t.h"
+#include "prom_metric_t.h"
+#include "prom_udp_exporter_i.h"
+#include "prom_udp_exporter_t.h"
+
+#define PROM_UDP_EXPORTER_DEFAULT_HOST "127.0.0.1"
+#define PROM_UDP_EXPORTER_DEFAULT_INFLUX_PORT 8089
+#define PROM_UDP_EXPORTER_DEFAULT_STATSD_PORT 8125
+#define PROM_UDP_EXPORTER_DEFAULT_MTU 1432
+#define PROM_UDP_EXPORTER_INITIAL_BUF_CAP 4096
+#define PROM_UDP_EXPORTER_INITIAL_DATAGRAM_CAP 16
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Static Declarations
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int prom_udp_exporter_connect(prom_udp_exporter_t *self, const char *host);
+
+static void prom_udp_exporter_reserve(prom_udp_exporter_t *self, size_t len);
+
+static void prom_udp_exporter_close_datagram(prom_udp_exporter_t *self, size_t end);
+
+static void prom_udp_exporter_serialize_sample(prom_udp_exporter_t *self, prom_metric_t *metric,
+                                               prom_metric_sample_t *sample, int64_t timestamp_ns);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// End static declarations
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+prom_udp_exporter_t *prom_udp_exporter_new(const prom_udp_exporter_config_t *config) {
+  PROM_ASSERT(config != NULL);
+  if (config == NULL) return NULL;
+
+  prom_udp_exporter_t *self = (prom_udp_exporter_t *)prom_malloc(sizeof(prom_udp_exporter_t));
+  memset(self, 0, sizeof(prom_udp_exporter_t));
+  self->fd = -1;
+
+  self->config = *config;
+  self->config.host = NULL;
+  if (self->config.port == 0) {
+    self->config.port = self->config.format == PROM_UDP_EXPORTER_STATSD ? PROM_UDP_EXPORTER_DEFAULT_STATSD_PORT
+                                                                        : PROM_UDP_EXPORTER_DEFAULT_INFLUX_PORT;
+  }
+  if (self->config.mtu == 0) self->config.mtu = PROM_UDP_EXPORTER_DEFAULT_MTU;
+
+  if (prom_udp_exporter_connect(self, config->host != NULL ? config->host : PROM_UDP_EXPORTER_DEFAULT_HOST)) {
+    PROM_LOG("failed to connect the udp exporter");
+    prom_udp_exporter_destroy(self);
+    return NULL;
+  }
+
+  self->buf_cap = PROM_UDP_EXPORTER_INITIAL_BUF_CAP;
+  self->buf = (char *)prom_malloc(self->buf_cap);
+  self->datagram_cap = PROM_UDP_EXPORTER_INITIAL_DATAGRAM_CAP;
+  self->ends = (size_t *)prom_malloc(sizeof(size_t) * self->datagram_cap);
+  self->iov = (struct iovec *)prom_malloc(sizeof(struct iovec) * self->datagram_cap);
+  self->msgs = (struct mmsghdr *)prom_malloc(sizeof(struct mmsghdr) * self->datagram_cap);
+  pthread_mutex_init(&self->lock, NULL);
+  return self;
+}
+
+int prom_udp_exporter_destroy(prom_udp_exporter_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 0;
+
+  int r = 0;
+  if (self->fd >= 0) r = close(self->fd);
+  if (self->buf != NULL) {
+    // The buffers are allocated together with the lock
+    pthread_mutex_destroy(&self->lock);
+    prom_free(self->buf);
+    prom_free(self->ends);
+    prom_free(self->iov);
+    prom_free(self->msgs);
+  }
+  prom_free(self);
+  self = NULL;
+  return r;
+}
+
+static int prom_udp_exporter_connect(prom_udp_exporter_t *self, const char *host) {
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_DGRAM;
+
+  char port[8];
+  snprintf(port, sizeof(port), "%hu", self->config.port);
+
+  struct addrinfo *addrs = NULL;
+  if (getaddrinfo(host, port, &hints, &addrs)) return 1;
+
+  for (struct addrinfo *addr = addrs; addr != NULL; addr = addr->ai_next) {
+    self->fd = socket(addr->ai_family, addr->ai_socktype | SOCK_CLOEXEC, addr->ai_protocol);
+    if (self->fd < 0) continue;
+    // A connected socket lets every message leave msg_name unset
+    if (connect(self->fd, addr->ai_addr, addr->ai_addrlen) == 0) break;
+    close(self->fd);
+    self->fd = -1;
+  }
+  freeaddrinfo(addrs);
+  return self->fd < 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Serialization
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Grows buf so that len more bytes fit. Once a cycle has been seen the buffer is large enough for the next one.
+static void prom_udp_exporter_reserve(prom_udp_exporter_t *self, size_t len) {
+  if (self->buf_len + len <= self->buf_cap) return;
+  while (self->buf_len + len > self->buf_cap) self->buf_cap *= 2;
+  self->buf = (char *)prom_realloc(self->buf, self->buf_cap);
+}
+
+static void prom_udp_exporter_close_datagram(prom_udp_exporter_t *self, size_t end) {
+  if (self->datagram_count == self->datagram_cap) {
+    self->datagram_cap *= 2;
+    self->ends = (size_t *)prom_realloc(self->ends, sizeof(size_t) * self->datagram_cap);
+    self->iov = (struct iovec *)prom_realloc(self->iov, sizeof(struct iovec) * self->datagram_cap);
+    self->msgs = (struct mmsghdr *)prom_realloc(self->msgs, sizeof(struct mmsghdr) * self->datagram_cap);
+  }
+  self->ends[self->datagram_count++] = end;
+}
+
+static inline void prom_udp_exporter_put(prom_udp_exporter_t *self, const char *str, size_t len) {
+  memcpy(self->buf + self->buf_len, str, len);
+  self->buf_len += len;
+}
+
+// Copies str, escaping the characters in special with a backslash (InfluxDB) or replacing them with '_' (StatsD).
+// The caller reserves 2 * strlen(str) bytes.
+static void prom_udp_exporter_put_escaped(prom_udp_exporter_t *self, const char *str, const char *special) {
+  bool statsd = self->config.format == PROM_UDP_EXPORTER_STATSD;
+  for (const char *c = str; *c != '\0'; c++) {
+    if (strchr(special, *c) == NULL) {
+      self->buf[self->buf_len++] = *c;
+    } else if (statsd) {
+      self->buf[self->buf_len++] = '_';
+    } else {
+      self->buf[self->buf_len++] = '\\';
+      self->buf[self->buf_len++] = *c;
+    }
+  }
+}
+
+static void prom_udp_exporter_put_statsd_gauge(prom_udp_exporter_t *self, prom_metric_t *metric,
+                                               prom_metric_sample_t *sample, const char *value, size_t value_len) {
+  prom_udp_exporter_put_escaped(self, metric->name, ":|@");
+  self->buf[self->buf_len++] = ':';
+  prom_udp_exporter_put(self, value, value_len);
+  prom_udp_exporter_put(self, "|g", 2);
+  for (size_t i = 0; i < sample->label_count; i++) {
+    // DogStatsD tags: |#key:value,key:value
+    prom_udp_exporter_put(self, i == 0 ? "|#" : ",", i == 0 ? 2 : 1);
+    prom_udp_exporter_put_escaped(self, metric->label_keys[i], ":|@,#");
+    self->buf[self->buf_len++] = ':';
+    prom_udp_exporter_put_escaped(self, sample->label_values[i], "|@,#");
+  }
+  self->buf[self->buf_len++] = '\n';
+}
+
+static void prom_udp_exporter_serialize_sample(prom_udp_exporter_t *self, prom_metric_t *metric,
+                                               prom_metric_sample_t *sample, int64_t timestamp_ns) {
+  double r_value = prom_metric_sample_scrape_value(sample);
+  if (!isfinite(r_value)) return;
+
+  char value[32];
+  size_t value_len = prom_metric_sample_format_scrape_value(sample, value, sizeof(value));
+
+  // Upper bound of the line: every name character escaped plus the separators, value and timestamp
+  size_t len = 2 * strlen(metric->name) + 2 * value_len + 64;
+  for (size_t i = 0; i < sample->label_count; i++) {
+    len += 2 * (strlen(metric->label_keys[i]) + strlen(sample->label_values[i])) + 3;
+  }
+  prom_udp_exporter_reserve(self, 2 * len);
+
+  size_t line_start = self->buf_len;
+  if (self->config.format == PROM_UDP_EXPORTER_STATSD) {
+    // A leading sign makes a StatsD gauge relative, so negative values are sent as a reset to 0 followed by the delta
+    if (r_value < 0) prom_udp_exporter_put_statsd_gauge(self, metric, sample, "0", 1);
+    prom_udp_exporter_put_statsd_gauge(self, metric, sample, value, value_len);
+  } else {
+    prom_udp_exporter_put_escaped(self, metric->name, ", ");
+    for (size_t i = 0; i < sample->label_count; i++) {
+      // InfluxDB rejects empty tag values
+      if (sample->label_values[i][0] == '\0') continue;
+      self->buf[self->buf_len++] = ',';
+      prom_udp_exporter_put_escaped(self, metric->label_keys[i], ",= ");
+      self->buf[self->buf_len++] = '=';
+      prom_udp_exporter_put_escaped(self, sample->label_values[i], ",= ");
+    }
+    prom_udp_exporter_put(self, " value=", 7);
+    prom_udp_exporter_put(self, value, value_len);
+    if (timestamp_ns != 0) {
+      self->buf_len += (size_t)sprintf(self->buf + self->buf_len, " %lld", (long long)timestamp_ns);
+    }
+    self->buf[self->buf_len++] = '\n';
+  }
+
+  // Lines never straddle datagrams. A line longer than the MTU is sent on its own.
+  size_t datagram_start = self->datagram_count > 0 ? self->ends[self->datagram_count - 1] : 0;
+  if (line_start > datagram_start && self->buf_len - datagram_start > self->config.mtu) {
+    prom_udp_exporter_close_datagram(self, line_start);
+  }
+}
+
+// The state of one serialization that prom_udp_exporter_visit_sample is handed with each sample
+typedef struct prom_udp_exporter_pass {
+  prom_udp_exporter_t *exporter;
+  int64_t timestamp_ns;
+} prom_udp_exporter_pass_t;
+
+static int prom_udp_exporter_visit_sample(prom_metric_t *metric, void *sample, void *data) {
+  prom_udp_exporter_pass_t *pass = (prom_udp_exporter_pass_t *)data;
+  if (metric->type != PROM_COUNTER && metric->type != PROM_GAUGE) return 0;
+  prom_udp_exporter_serialize_sample(pass->exporter, metric, (prom_metric_sample_t *)sample, pass->timestamp_ns);
+  return 0;
+}
+
+int prom_udp_exporter_serialize(prom_udp_exporter_t *self, prom_collector_registry_t *registry, int64_t timestamp_ns) {
+  PROM_ASSERT(self != NULL);
+  PROM_ASSERT(registry != NULL);
+
+  self->buf_len = 0;
+  self->datagram_count = 0;
+
+  prom_udp_exporter_pass_t pass = {.exporter = self, .timestamp_ns = timestamp_ns};
+  int r = prom_collector_registry_foreach_sample(registry, &prom_udp_exporter_visit_sample, &pass);
+
+  size_t datagram_start = self->datagram_count > 0 ? self->ends[self->datagram_count - 1] : 0;
+  if (self->buf_len > datagram_start) prom_udp_exporter_close_datagram(self, self->buf_len);
+  return r;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Transport
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int prom_udp_exporter_send(prom_udp_exporter_t *self, prom_collector_registry_t *registry) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL || registry == NULL) return 1;
+
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  int64_t timestamp_ns = (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+
+  pthread_mutex_lock(&self->lock);
+  int r = prom_udp_exporter_serialize(self, registry, timestamp_ns);
+  if (r) {
+    pthread_mutex_unlock(&self->lock);
+    return r;
+  }
+
+  // buf may have moved while it grew, so the vectors are filled in only now
+  size_t start = 0;
+  for (size_t i = 0; i < self->datagram_count; i++) {
+    self->iov[i].iov_base = self->buf + start;
+    self->iov[i].iov_len = self->ends[i] - start;
+    memset(&self->msgs[i], 0, sizeof(struct mmsghdr));
+    self->msgs[i].msg_hdr.msg_iov = &self->iov[i];
+    self->msgs[i].msg_hdr.msg_iovlen = 1;
+    start = self->ends[i];
+  }
+
+  // One call normally covers the whole cycle. The loop only repeats when the kernel accepts part of the batch.
+  size_t sent = 0;
+  while (sent < self->datagram_count) {
+    int n = sendmmsg(self->fd, self->msgs + sent, self->datagram_count - sent, MSG_DONTWAIT);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        self->stats.datagrams_dropped += self->datagram_count - sent;
+        break;
+      }
+      // E.g. ECONNREFUSED reported for an earlier datagram, or EMSGSIZE. Skip the datagram and keep going.
+      self->stats.datagrams_dropped++;
+      sent++;
+      continue;
+    }
+    for (size_t i = sent; i < sent + n; i++) self->stats.bytes_sent += self->msgs[i].msg_len;
+    self->stats.datagrams_sent += n;
+    sent += n;
+  }
+  pthread_mutex_unlock(&self->lock);
+  return 0;
+}
+
+int prom_udp_exporter_stats(prom_udp_exporter_t *self, prom_udp_exporter_stats_t *stats) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL || stats == NULL) return 1;
+  pthread_mutex_lock(&self->lock);
+  *stats = self->stats;
+  pthread_mutex_unlock(&self->lock);
+  return 0;
+}
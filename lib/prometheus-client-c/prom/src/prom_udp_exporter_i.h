@@ -0,0 +1,35 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PROM_UDP_EXPORTER_I_H
+#define PROM_UDP_EXPORTER_I_H
+
+#include <stdint.h>
+
+// Public
+#include "prom_collector_registry.h"
+
+// Private
+#include "prom_udp_exporter_t.h"
+
+/**
+ * @brief API PRIVATE Serializes every counter and gauge sample of the registry into self->buf and records where each
+ * datagram ends. A timestamp_ns of 0 leaves InfluxDB lines without a timestamp.
+ */
+int prom_udp_exporter_serialize(prom_udp_exporter_t *self, prom_collector_registry_t *registry, int64_t timestamp_ns);
+
+#endif  // PROM_UDP_EXPORTER_I_H
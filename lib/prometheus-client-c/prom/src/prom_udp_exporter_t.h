@@ -0,0 +1,41 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PROM_UDP_EXPORTER_T_H
+#define PROM_UDP_EXPORTER_T_H
+
+#include <pthread.h>
+
+// Public
+#include "prom_udp_exporter.h"
+
+struct prom_udp_exporter {
+  int fd;                            /**< fd is a UDP socket connected to the receiver */
+  prom_udp_exporter_config_t config; /**< config holds the options with defaults applied */
+  char *buf;                         /**< buf holds the lines of the current cycle back to back */
+  size_t buf_len;                    /**< buf_len is the number of bytes used in buf */
+  size_t buf_cap;                    /**< buf_cap is the allocated size of buf */
+  size_t *ends;                      /**< ends are the offsets in buf at which each datagram ends */
+  struct iovec *iov;                 /**< iov has one entry per datagram */
+  struct mmsghdr *msgs;              /**< msgs has one entry per datagram */
+  size_t datagram_count;             /**< datagram_count is the number of datagrams in the current cycle */
+  size_t datagram_cap;               /**< datagram_cap is the allocated length of ends, iov and msgs */
+  pthread_mutex_t lock;              /**< lock serializes sends which share the buffers */
+  prom_udp_exporter_stats_t stats;   /**< stats are the delivery statistics */
+};
+
+#endif  // PROM_UDP_EXPORTER_T_H
@@ -96,11 +96,118 @@ void test_prom_collector_registry_bridge(void) {
   prom_registry_test_destroy();
 }
 
+void test_prom_collector_registry_negotiate_format(void) {
+  TEST_ASSERT_EQUAL_INT(PROM_EXPOSITION_TEXT, prom_collector_registry_negotiate_format(NULL));
+  TEST_ASSERT_EQUAL_INT(PROM_EXPOSITION_TEXT, prom_collector_registry_negotiate_format("*/*"));
+  TEST_ASSERT_EQUAL_INT(PROM_EXPOSITION_TEXT, prom_collector_registry_negotiate_format("application/json"));
+  TEST_ASSERT_EQUAL_INT(PROM_EXPOSITION_OPENMETRICS,
+                        prom_collector_registry_negotiate_format(
+                            "application/openmetrics-text;version=1.0.0,text/plain;version=0.0.4;q=0.5,*/*;q=0.1"));
+  TEST_ASSERT_EQUAL_INT(PROM_EXPOSITION_PROTOBUF,
+                        prom_collector_registry_negotiate_format(
+                            "application/vnd.google.protobuf;proto=io.prometheus.client.MetricFamily;"
+                            "encoding=delimited;q=0.7,text/plain;version=0.0.4;q=0.3"));
+  // Protobuf without the delimited encoding is not something we can produce
+  TEST_ASSERT_EQUAL_INT(PROM_EXPOSITION_TEXT,
+                        prom_collector_registry_negotiate_format(
+                            "application/vnd.google.protobuf;proto=io.prometheus.client.MetricFamily;encoding=text"));
+  // Ties go to the earliest media range
+  TEST_ASSERT_EQUAL_INT(PROM_EXPOSITION_TEXT, prom_collector_registry_negotiate_format(
+                                                  "text/plain; q=0.5, application/openmetrics-text; q=0.5"));
+  TEST_ASSERT_EQUAL_INT(PROM_EXPOSITION_TEXT,
+                        prom_collector_registry_negotiate_format("application/openmetrics-text;q=0, text/plain"));
+  TEST_ASSERT_NOT_NULL(strstr(prom_collector_registry_content_type(PROM_EXPOSITION_OPENMETRICS),
+                              "application/openmetrics-text"));
+}
+
+void test_prom_collector_registry_bridge_format(void) {
+  prom_registry_test_init();
+  const char *labels[] = {"foo"};
+  prom_counter_inc(test_counter, labels);
+
+  size_t len = 0;
+  const char *result = prom_collector_registry_bridge_format(PROM_COLLECTOR_REGISTRY_DEFAULT,
+                                                             PROM_EXPOSITION_OPENMETRICS, &len);
+  TEST_ASSERT_EQUAL_INT(strlen(result), len);
+  TEST_ASSERT_NOT_NULL(strstr(result, "test_counter_total{label=\"foo\"} 1\n"));
+  TEST_ASSERT_EQUAL_STRING("# EOF\n", result + len - 6);
+  free((char *)result);
+
+  // Within a generation the cached rendering is served
+  prom_collector_registry_advance_generation(PROM_COLLECTOR_REGISTRY_DEFAULT);
+  result = prom_collector_registry_bridge_format(PROM_COLLECTOR_REGISTRY_DEFAULT, PROM_EXPOSITION_TEXT, NULL);
+  TEST_ASSERT_NOT_NULL(strstr(result, "test_counter{label=\"foo\"} 1\n"));
+  free((char *)result);
+
+  prom_counter_inc(test_counter, labels);
+  result = prom_collector_registry_bridge_format(PROM_COLLECTOR_REGISTRY_DEFAULT, PROM_EXPOSITION_TEXT, NULL);
+  TEST_ASSERT_NOT_NULL(strstr(result, "test_counter{label=\"foo\"} 1\n"));
+  free((char *)result);
+
+  prom_collector_registry_advance_generation(PROM_COLLECTOR_REGISTRY_DEFAULT);
+  result = prom_collector_registry_bridge_format(PROM_COLLECTOR_REGISTRY_DEFAULT, PROM_EXPOSITION_TEXT, NULL);
+  TEST_ASSERT_NOT_NULL(strstr(result, "test_counter{label=\"foo\"} 2\n"));
+  free((char *)result);
+
+  result = prom_collector_registry_bridge_format(PROM_COLLECTOR_REGISTRY_DEFAULT, PROM_EXPOSITION_PROTOBUF, &len);
+  TEST_ASSERT_TRUE(len > 0);
+  TEST_ASSERT_TRUE(len > strlen(result));
+  free((char *)result);
+  result = NULL;
+
+  prom_registry_test_destroy();
+}
+
 void test_prom_collector_registry_validate_metric_name(void) {
   prom_registry_test_init();
 
   TEST_ASSERT_EQUAL_INT(
       0, prom_collector_registry_validate_metric_name(PROM_COLLECTOR_REGISTRY_DEFAULT, "this_is_a_name09"));
+  TEST_ASSERT_EQUAL_INT(0, prom_collector_registry_validate_metric_name(PROM_COLLECTOR_REGISTRY_DEFAULT, ":rule:sum"));
+  TEST_ASSERT_EQUAL_INT(0, prom_collector_registry_validate_metric_name(PROM_COLLECTOR_REGISTRY_DEFAULT, "_Z"));
+  TEST_ASSERT_TRUE(prom_collector_registry_validate_metric_name(PROM_COLLECTOR_REGISTRY_DEFAULT, ""));
+  TEST_ASSERT_TRUE(prom_collector_registry_validate_metric_name(PROM_COLLECTOR_REGISTRY_DEFAULT, "9lives"));
+  TEST_ASSERT_TRUE(prom_collector_registry_validate_metric_name(PROM_COLLECTOR_REGISTRY_DEFAULT, "with-dash"));
+  TEST_ASSERT_TRUE(prom_collector_registry_validate_metric_name(PROM_COLLECTOR_REGISTRY_DEFAULT, "with space"));
+  TEST_ASSERT_TRUE(prom_collector_registry_validate_metric_name(PROM_COLLECTOR_REGISTRY_DEFAULT, "caf\xc3\xa9"));
+  prom_registry_test_destroy();
+}
+
+void test_prom_collector_registry_validate_label_name(void) {
+  prom_registry_test_init();
+
+  TEST_ASSERT_EQUAL_INT(0, prom_collector_registry_validate_label_name(PROM_COLLECTOR_REGISTRY_DEFAULT, "method"));
+  TEST_ASSERT_EQUAL_INT(0, prom_collector_registry_validate_label_name(PROM_COLLECTOR_REGISTRY_DEFAULT, "_status2"));
+  TEST_ASSERT_TRUE(prom_collector_registry_validate_label_name(PROM_COLLECTOR_REGISTRY_DEFAULT, ""));
+  TEST_ASSERT_TRUE(prom_collector_registry_validate_label_name(PROM_COLLECTOR_REGISTRY_DEFAULT, "2xx"));
+  TEST_ASSERT_TRUE(prom_collector_registry_validate_label_name(PROM_COLLECTOR_REGISTRY_DEFAULT, "job:name"));
+  TEST_ASSERT_TRUE(prom_collector_registry_validate_label_name(PROM_COLLECTOR_REGISTRY_DEFAULT, "__name__"));
+  prom_registry_test_destroy();
+}
+
+void test_prom_collector_registry_sweep(void) {
+  prom_registry_test_init();
+
+  // Without limits a sweep adds nothing to the output
+  TEST_ASSERT_EQUAL_INT(0, prom_collector_registry_sweep(PROM_COLLECTOR_REGISTRY_DEFAULT));
+  const char *result = prom_collector_registry_bridge(PROM_COLLECTOR_REGISTRY_DEFAULT);
+  TEST_ASSERT_NULL(strstr(result, "prom_series_"));
+  free((char *)result);
+
+  prom_metric_set_series_ttl(test_gauge, 1);
+  prom_metric_set_max_series(test_gauge, 1);
+  prom_gauge_set(test_gauge, 1.0, (const char *[]){"veth0"});
+  prom_gauge_set(test_gauge, 1.0, (const char *[]){"veth1"});
+  TEST_ASSERT_EQUAL_INT(0, prom_collector_registry_sweep(PROM_COLLECTOR_REGISTRY_DEFAULT));
+  TEST_ASSERT_EQUAL_INT(0, prom_collector_registry_sweep(PROM_COLLECTOR_REGISTRY_DEFAULT));
+
+  result = prom_collector_registry_bridge(PROM_COLLECTOR_REGISTRY_DEFAULT);
+  TEST_ASSERT_NULL(strstr(result, "test_gauge{label=\"veth0\"}"));
+  TEST_ASSERT_NOT_NULL(strstr(result, "prom_series_dropped_total{metric=\"test_gauge\"} 1\n"));
+  TEST_ASSERT_NOT_NULL(strstr(result, "prom_series_evicted_total{metric=\"test_gauge\"} 1\n"));
+  TEST_ASSERT_NULL(strstr(result, "metric=\"test_counter\""));
+  free((char *)result);
+
   prom_registry_test_destroy();
 }
 
@@ -125,7 +232,11 @@ int main(int argc, const char **argv) {
   UNITY_BEGIN();
   // RUN_TEST(test_prom_collector_registry_must_register);
   RUN_TEST(test_prom_collector_registry_bridge);
-  // RUN_TEST(test_prom_collector_registry_validate_metric_name);
+  RUN_TEST(test_prom_collector_registry_negotiate_format);
+  RUN_TEST(test_prom_collector_registry_bridge_format);
+  RUN_TEST(test_prom_collector_registry_validate_metric_name);
+  RUN_TEST(test_prom_collector_registry_validate_label_name);
+  RUN_TEST(test_prom_collector_registry_sweep);
   // RUN_TEST(test_large_registry);
   return UNITY_END();
 }
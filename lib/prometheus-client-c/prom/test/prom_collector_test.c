@@ -14,6 +14,9 @@
  * limitations under the License.
  */
 
+#include <pthread.h>
+#include <unistd.h>
+
 #include "prom_test_helpers.h"
 
 void test_prom_collector(void) {
@@ -35,9 +38,116 @@ void test_prom_process_collector(void) {
   collector = NULL;
 }
 
+// Writes the fixture limits file to path with the given soft limit on open files
+static void test_write_limits(const char *path, const char *max_open_files) {
+  FILE *in = fopen("/code/prom/test/fixtures/limits", "r");
+  FILE *out = fopen(path, "w");
+  TEST_ASSERT_NOT_NULL(in);
+  TEST_ASSERT_NOT_NULL(out);
+  char line[256];
+  while (fgets(line, sizeof(line), in) != NULL) {
+    if (strncmp(line, "Max open files", 14) == 0) {
+      fprintf(out, "Max open files            %-20s 1048576              files     \n", max_open_files);
+    } else {
+      fputs(line, out);
+    }
+  }
+  fclose(in);
+  fclose(out);
+}
+
+static double test_max_fds(void) {
+  return prom_metric_sample_value(prom_metric_sample_from_labels(prom_process_max_fds, NULL));
+}
+
+void test_prom_process_collector_limits_cache(void) {
+  char path[64];
+  sprintf(path, "/tmp/prom_collector_test_limits_%d", (int)getpid());
+  test_write_limits(path, "1024");
+
+  prom_collector_t *collector = prom_collector_process_new(path, "/code/prom/test/fixtures/stat");
+  TEST_ASSERT_NOT_NULL(collector->collect_fn(collector));
+  TEST_ASSERT_EQUAL_DOUBLE(1024.0, test_max_fds());
+
+  // The limits are reused until they are refreshed
+  test_write_limits(path, "2048");
+  TEST_ASSERT_NOT_NULL(collector->collect_fn(collector));
+  TEST_ASSERT_EQUAL_DOUBLE(1024.0, test_max_fds());
+  prom_collector_process_refresh_limits();
+  TEST_ASSERT_NOT_NULL(collector->collect_fn(collector));
+  TEST_ASSERT_EQUAL_DOUBLE(2048.0, test_max_fds());
+
+  prom_collector_destroy(collector);
+  collector = NULL;
+  unlink(path);
+}
+
+static int test_visit_sample(prom_metric_t *metric, void *sample, void *data) { return 0; }
+
+static void *test_scrape_concurrently(void *arg) {
+  prom_collector_registry_t *registry = (prom_collector_registry_t *)arg;
+  for (int i = 0; i < 500; i++) {
+    // Refreshing makes every collection read the limits file as well as the stat file
+    prom_collector_process_refresh_limits();
+    const char *result = prom_collector_registry_bridge(registry);
+    if (result == NULL) return (void *)1;
+    free((char *)result);
+  }
+  return NULL;
+}
+
+static void *test_export_concurrently(void *arg) {
+  prom_collector_registry_t *registry = (prom_collector_registry_t *)arg;
+  for (int i = 0; i < 500; i++) {
+    prom_collector_process_refresh_limits();
+    if (prom_collector_registry_foreach_sample(registry, &test_visit_sample, NULL)) return (void *)1;
+  }
+  return NULL;
+}
+
+void test_prom_process_collector_concurrent(void) {
+  prom_collector_registry_t *registry = prom_collector_registry_new("test");
+  prom_collector_t *collector =
+      prom_collector_process_new("/code/prom/test/fixtures/limits", "/code/prom/test/fixtures/stat");
+  TEST_ASSERT_EQUAL_INT(0, prom_collector_registry_register_collector(registry, collector));
+
+  // Scrapes and exporters collect from their own threads and share the procfs buffers
+  pthread_t threads[4];
+  for (int i = 0; i < 4; i++) {
+    pthread_create(&threads[i], NULL, i % 2 == 0 ? &test_scrape_concurrently : &test_export_concurrently, registry);
+  }
+  for (int i = 0; i < 4; i++) {
+    void *failed = NULL;
+    pthread_join(threads[i], &failed);
+    TEST_ASSERT_NULL(failed);
+  }
+  TEST_ASSERT_EQUAL_DOUBLE(1048576.0, test_max_fds());
+
+  prom_collector_registry_destroy(registry);
+  registry = NULL;
+}
+
+void test_prom_process_fds_count(void) {
+  int before = prom_process_fds_count(NULL);
+  TEST_ASSERT_TRUE(before > 0);
+
+  // Enough descriptors that getdents64 needs more than one call, as far as the descriptor limit allows
+  int fds[2000];
+  int opened = 0;
+  while (opened < 2000 && (fds[opened] = dup(0)) >= 0) opened++;
+  // Counting opens the directory, so leave a descriptor free if the limit was reached
+  if (opened < 2000 && opened > 0) close(fds[--opened]);
+  TEST_ASSERT_EQUAL_INT(before + opened, prom_process_fds_count(NULL));
+  for (int i = 0; i < opened; i++) close(fds[i]);
+  TEST_ASSERT_EQUAL_INT(before, prom_process_fds_count(NULL));
+}
+
 int main(int argc, const char **argv) {
   UNITY_BEGIN();
   RUN_TEST(test_prom_collector);
   RUN_TEST(test_prom_process_collector);
+  RUN_TEST(test_prom_process_collector_limits_cache);
+  RUN_TEST(test_prom_process_collector_concurrent);
+  RUN_TEST(test_prom_process_fds_count);
   return UNITY_END();
 }
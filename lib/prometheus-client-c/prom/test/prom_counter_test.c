@@ -15,6 +15,8 @@
  */
 
 #include <assert.h>
+#include <math.h>
+#include <pthread.h>
 
 #include "prom_test_helpers.h"
 
@@ -52,9 +54,120 @@ void test_counter_add(void) {
   c = NULL;
 }
 
+void test_counter_child(void) {
+  prom_counter_t *c = prom_counter_new("test_counter", "counter under test", 2, (const char *[]){"foo", "bar"});
+  TEST_ASSERT(c);
+
+  prom_metric_sample_t *child = prom_counter_child(c, sample_labels_a);
+  TEST_ASSERT_NOT_NULL(child);
+  TEST_ASSERT_EQUAL_PTR(child, prom_metric_sample_from_labels(c, sample_labels_a));
+
+  TEST_ASSERT_EQUAL_INT(0, prom_metric_sample_add(child, 2.0));
+  prom_counter_inc(c, sample_labels_a);
+  TEST_ASSERT_EQUAL_DOUBLE(3.0, child->r_value);
+
+  // Counter children cannot be set or decreased
+  TEST_ASSERT_NOT_EQUAL(0, prom_metric_sample_set(child, 1.0));
+  TEST_ASSERT_NOT_EQUAL(0, prom_metric_sample_add(child, -1.0));
+  TEST_ASSERT_EQUAL_DOUBLE(3.0, child->r_value);
+
+  prom_counter_destroy(c);
+  c = NULL;
+}
+
+void test_counter_u64(void) {
+  prom_counter_t *c = prom_counter_u64_new("test_counter", "counter under test", 0, NULL);
+  TEST_ASSERT(c);
+
+  // 2^53 + 3 is not representable as a double
+  TEST_ASSERT_EQUAL_INT(0, prom_counter_add_u64(c, (UINT64_C(1) << 53) + 1, NULL));
+  TEST_ASSERT_EQUAL_INT(0, prom_counter_inc(c, NULL));
+  TEST_ASSERT_EQUAL_INT(0, prom_counter_add(c, 1.5, NULL));
+  prom_metric_sample_t *sample = prom_metric_sample_from_labels(c, NULL);
+  TEST_ASSERT_EQUAL_UINT64((UINT64_C(1) << 53) + 3, sample->i_value);
+
+  prom_metric_formatter_t *mf = prom_metric_formatter_new();
+  TEST_ASSERT_EQUAL_INT(0, prom_metric_formatter_load_sample(mf, sample));
+  char *result = prom_metric_formatter_dump(mf);
+  TEST_ASSERT_EQUAL_STRING("test_counter 9007199254740995\n", result);
+  prom_free(result);
+  prom_metric_formatter_destroy(mf);
+
+  // Counters still refuse to go down or be set
+  TEST_ASSERT_NOT_EQUAL(0, prom_counter_add(c, -1.0, NULL));
+  TEST_ASSERT_NOT_EQUAL(0, prom_metric_sample_set_i64(sample, 0));
+
+  prom_counter_destroy(c);
+  c = NULL;
+}
+
+void test_counter_u64_non_integral(void) {
+  prom_counter_t *c = prom_counter_u64_new("test_counter", "counter under test", 0, NULL);
+  TEST_ASSERT(c);
+  TEST_ASSERT_EQUAL_INT(0, prom_counter_add(c, 5.0, NULL));
+
+  // Values with no uint64_t to truncate to are refused and leave the counter unchanged
+  TEST_ASSERT_NOT_EQUAL(0, prom_counter_add(c, NAN, NULL));
+  TEST_ASSERT_NOT_EQUAL(0, prom_counter_add(c, INFINITY, NULL));
+  TEST_ASSERT_NOT_EQUAL(0, prom_counter_add(c, -INFINITY, NULL));
+  TEST_ASSERT_NOT_EQUAL(0, prom_counter_add(c, 18446744073709551616.0, NULL));
+  TEST_ASSERT_NOT_EQUAL(0, prom_counter_add(c, 1e300, NULL));
+  TEST_ASSERT_EQUAL_UINT64(5, prom_metric_sample_from_labels(c, NULL)->i_value);
+
+  // The largest double below 2^64 still fits
+  TEST_ASSERT_EQUAL_INT(0, prom_counter_add(c, 18446744073709549568.0, NULL));
+  TEST_ASSERT_EQUAL_UINT64(UINT64_C(18446744073709549573), prom_metric_sample_from_labels(c, NULL)->i_value);
+
+  prom_counter_destroy(c);
+  c = NULL;
+}
+
+#define SHARDED_THREADS 8
+#define SHARDED_INCS 10000
+
+static void *sharded_inc(void *arg) {
+  prom_counter_t *c = (prom_counter_t *)arg;
+  for (int i = 0; i < SHARDED_INCS; i++) prom_counter_inc(c, sample_labels_a);
+  return NULL;
+}
+
+void test_counter_sharded(void) {
+  prom_counter_t *c =
+      prom_counter_sharded_new("test_counter", "counter under test", 2, (const char *[]){"foo", "bar"});
+  TEST_ASSERT(c);
+
+  // More threads than would fit if each held a cell of its own for the whole run
+  pthread_t threads[SHARDED_THREADS];
+  for (int i = 0; i < SHARDED_THREADS; i++) pthread_create(&threads[i], NULL, sharded_inc, c);
+  for (int i = 0; i < SHARDED_THREADS; i++) pthread_join(threads[i], NULL);
+
+  prom_metric_sample_t *sample = prom_metric_sample_from_labels(c, sample_labels_a);
+  TEST_ASSERT_NOT_NULL(sample->shards);
+  TEST_ASSERT_EQUAL_DOUBLE(SHARDED_THREADS * SHARDED_INCS, prom_metric_sample_value(sample));
+
+  prom_counter_add(c, 0.5, sample_labels_a);
+  TEST_ASSERT_EQUAL_DOUBLE(SHARDED_THREADS * SHARDED_INCS + 0.5, prom_metric_sample_value(sample));
+  TEST_ASSERT_NOT_EQUAL(0, prom_metric_sample_add(sample, -1.0));
+
+  // The formatter reports the sum of the cells
+  prom_metric_formatter_t *mf = prom_metric_formatter_new();
+  TEST_ASSERT_EQUAL_INT(0, prom_metric_formatter_load_sample(mf, sample));
+  char *result = prom_metric_formatter_dump(mf);
+  TEST_ASSERT_EQUAL_STRING("test_counter{foo=\"f\",bar=\"b\"} 80000.5\n", result);
+  prom_free(result);
+  prom_metric_formatter_destroy(mf);
+
+  prom_counter_destroy(c);
+  c = NULL;
+}
+
 int main(int argc, const char **argv) {
   UNITY_BEGIN();
   RUN_TEST(test_counter_inc);
   RUN_TEST(test_counter_add);
+  RUN_TEST(test_counter_child);
+  RUN_TEST(test_counter_u64);
+  RUN_TEST(test_counter_u64_non_integral);
+  RUN_TEST(test_counter_sharded);
   return UNITY_END();
 }
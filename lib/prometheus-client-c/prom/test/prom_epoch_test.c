@@ -0,0 +1,63 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "prom_test_helpers.h"
+
+static int test_freed;
+
+static void test_count_free(void *item) {
+  test_freed++;
+  free(item);
+}
+
+// Reclaims until nothing is pending or the attempts run out, which happens while a reader is inside
+static size_t test_reclaim(void) {
+  size_t pending = 0;
+  for (int i = 0; i < 4; i++) pending = prom_epoch_reclaim();
+  return pending;
+}
+
+void test_prom_epoch_retire(void) {
+  test_freed = 0;
+  prom_epoch_retire(malloc(16), test_count_free);
+  TEST_ASSERT_EQUAL_INT(0, test_reclaim());
+  TEST_ASSERT_EQUAL_INT(1, test_freed);
+}
+
+void test_prom_epoch_retire_while_reading(void) {
+  test_freed = 0;
+
+  // Nested sections keep memory alive until the outermost one exits
+  prom_epoch_enter();
+  prom_epoch_enter();
+  prom_epoch_retire(malloc(16), test_count_free);
+  TEST_ASSERT_EQUAL_INT(1, test_reclaim());
+  prom_epoch_exit();
+  TEST_ASSERT_EQUAL_INT(1, test_reclaim());
+  TEST_ASSERT_EQUAL_INT(0, test_freed);
+  prom_epoch_exit();
+
+  TEST_ASSERT_EQUAL_INT(0, test_reclaim());
+  TEST_ASSERT_EQUAL_INT(1, test_freed);
+}
+
+int main(int argc, const char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_prom_epoch_retire);
+  RUN_TEST(test_prom_epoch_retire_while_reading);
+  return UNITY_END();
+}
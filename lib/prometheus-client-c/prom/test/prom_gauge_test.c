@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include <math.h>
+
 #include "prom_test_helpers.h"
 
 const char *sample_labels_a[] = {"f", "b"};
@@ -100,6 +102,100 @@ void test_gauge_set(void) {
   g = NULL;
 }
 
+void test_gauge_child(void) {
+  prom_gauge_t *g = prom_gauge_new("test_gauge", "gauge under test", 2, (const char *[]){"foo", "bar"});
+  TEST_ASSERT(g);
+
+  // A child is the sample of its label values, and updates through either path are seen by both
+  prom_metric_sample_t *child = prom_gauge_child(g, sample_labels_a);
+  TEST_ASSERT_NOT_NULL(child);
+  TEST_ASSERT_EQUAL_PTR(child, prom_metric_sample_from_labels(g, sample_labels_a));
+  TEST_ASSERT_EQUAL_PTR(child, prom_gauge_child(g, sample_labels_a));
+
+  TEST_ASSERT_EQUAL_INT(0, prom_metric_sample_set(child, 7.0));
+  prom_gauge_add(g, 1.0, sample_labels_a);
+  TEST_ASSERT_EQUAL_INT(0, prom_metric_sample_sub(child, 0.5));
+  TEST_ASSERT_EQUAL_DOUBLE(7.5, child->r_value);
+
+  prom_metric_sample_t *other = prom_gauge_child(g, sample_labels_b);
+  TEST_ASSERT_NOT_NULL(other);
+  TEST_ASSERT_TRUE(other != child);
+  TEST_ASSERT_EQUAL_DOUBLE(0.0, other->r_value);
+
+  // Counters do not hand out gauge children
+  prom_counter_t *c = prom_counter_new("test_counter", "counter under test", 0, NULL);
+  TEST_ASSERT_NULL(prom_gauge_child(c, NULL));
+  prom_counter_destroy(c);
+
+  prom_gauge_destroy(g);
+  g = NULL;
+}
+
+static void assert_sample_text(prom_metric_sample_t *sample, const char *expected) {
+  prom_metric_formatter_t *mf = prom_metric_formatter_new();
+  TEST_ASSERT_EQUAL_INT(0, prom_metric_formatter_load_sample(mf, sample));
+  char *result = prom_metric_formatter_dump(mf);
+  TEST_ASSERT_EQUAL_STRING(expected, result);
+  prom_free(result);
+  prom_metric_formatter_destroy(mf);
+}
+
+void test_gauge_i64(void) {
+  prom_gauge_t *g = prom_gauge_i64_new("test_gauge", "gauge under test", 2, (const char *[]){"foo", "bar"});
+  TEST_ASSERT(g);
+
+  TEST_ASSERT_EQUAL_INT(0, prom_gauge_set_i64(g, -5, sample_labels_a));
+  TEST_ASSERT_EQUAL_INT(0, prom_gauge_add_i64(g, 7, sample_labels_a));
+  TEST_ASSERT_EQUAL_INT(0, prom_gauge_dec(g, sample_labels_a));
+  prom_metric_sample_t *sample = prom_metric_sample_from_labels(g, sample_labels_a);
+  TEST_ASSERT_TRUE(sample->integer);
+  TEST_ASSERT_EQUAL_DOUBLE(1.0, prom_metric_sample_value(sample));
+  assert_sample_text(sample, "test_gauge{foo=\"f\",bar=\"b\"} 1\n");
+
+  // Doubles are truncated toward zero
+  TEST_ASSERT_EQUAL_INT(0, prom_gauge_set(g, -3.9, sample_labels_a));
+  assert_sample_text(sample, "test_gauge{foo=\"f\",bar=\"b\"} -3\n");
+
+  // Values beyond 2^53 are kept exactly
+  TEST_ASSERT_EQUAL_INT(0, prom_gauge_set_i64(g, INT64_MAX, sample_labels_a));
+  assert_sample_text(sample, "test_gauge{foo=\"f\",bar=\"b\"} 9223372036854775807\n");
+
+  // The integer functions also work on regular gauges
+  prom_gauge_t *d = prom_gauge_new("test_gauge", "gauge under test", 0, NULL);
+  TEST_ASSERT_EQUAL_INT(0, prom_gauge_set_i64(d, 3, NULL));
+  TEST_ASSERT_EQUAL_INT(0, prom_gauge_add_i64(d, -5, NULL));
+  TEST_ASSERT_EQUAL_DOUBLE(-2.0, prom_metric_sample_from_labels(d, NULL)->r_value);
+
+  prom_gauge_destroy(d);
+  prom_gauge_destroy(g);
+  g = NULL;
+}
+
+void test_gauge_i64_non_integral(void) {
+  prom_gauge_t *g = prom_gauge_i64_new("test_gauge", "gauge under test", 0, NULL);
+  TEST_ASSERT(g);
+  TEST_ASSERT_EQUAL_INT(0, prom_gauge_set(g, 5.0, NULL));
+  prom_metric_sample_t *sample = prom_metric_sample_from_labels(g, NULL);
+
+  // Values with no int64_t to truncate to are refused by every double function and leave the gauge unchanged
+  const double refused[] = {NAN, INFINITY, -INFINITY, 9223372036854775808.0, -9223372036854777856.0, 1e300};
+  for (size_t i = 0; i < sizeof(refused) / sizeof(refused[0]); i++) {
+    TEST_ASSERT_NOT_EQUAL(0, prom_gauge_set(g, refused[i], NULL));
+    TEST_ASSERT_NOT_EQUAL(0, prom_gauge_add(g, refused[i], NULL));
+    TEST_ASSERT_NOT_EQUAL(0, prom_gauge_sub(g, refused[i], NULL));
+  }
+  assert_sample_text(sample, "test_gauge 5\n");
+
+  // The bounds of int64_t that a double can hold still fit
+  TEST_ASSERT_EQUAL_INT(0, prom_gauge_set(g, -9223372036854775808.0, NULL));
+  assert_sample_text(sample, "test_gauge -9223372036854775808\n");
+  TEST_ASSERT_EQUAL_INT(0, prom_gauge_set(g, 9223372036854774784.0, NULL));
+  assert_sample_text(sample, "test_gauge 9223372036854774784\n");
+
+  prom_gauge_destroy(g);
+  g = NULL;
+}
+
 int main(int argc, const char **argv) {
   UNITY_BEGIN();
   RUN_TEST(test_gauge_inc);
@@ -107,5 +203,8 @@ int main(int argc, const char **argv) {
   RUN_TEST(test_gauge_add);
   RUN_TEST(test_gauge_sub);
   RUN_TEST(test_gauge_set);
+  RUN_TEST(test_gauge_child);
+  RUN_TEST(test_gauge_i64);
+  RUN_TEST(test_gauge_i64_non_integral);
   return UNITY_END();
 }
@@ -0,0 +1,193 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include "prom_test_helpers.h"
+
+static prom_collector_registry_t *registry;
+static prom_group_t *group;
+static prom_gauge_t *total_gauge;
+static prom_gauge_t *used_gauge;
+
+static void test_registry_init(void) {
+  registry = prom_collector_registry_new("group_test");
+  group = prom_group_new();
+  total_gauge = prom_gauge_new("test_total", "total under test", 0, NULL);
+  used_gauge = prom_gauge_i64_new("test_used", "used under test", 0, NULL);
+  TEST_ASSERT_EQUAL_INT(0, prom_group_add(group, total_gauge));
+  TEST_ASSERT_EQUAL_INT(0, prom_group_add(group, used_gauge));
+  prom_collector_t *collector = prom_collector_new("group");
+  prom_collector_add_metric(collector, total_gauge);
+  prom_collector_add_metric(collector, used_gauge);
+  prom_collector_registry_register_collector(registry, collector);
+}
+
+static void test_registry_destroy(void) {
+  prom_collector_registry_destroy(registry);
+  registry = NULL;
+  prom_group_destroy(group);
+  group = NULL;
+}
+
+// Reads the values of both gauges from one scrape
+static void test_scrape(double *total, long long *used) {
+  const char *result = prom_collector_registry_bridge(registry);
+  TEST_ASSERT_NOT_NULL(result);
+  const char *line = strstr(result, "\ntest_total ");
+  TEST_ASSERT_NOT_NULL(line);
+  TEST_ASSERT_EQUAL_INT(1, sscanf(line, "\ntest_total %lf", total));
+  line = strstr(result, "\ntest_used ");
+  TEST_ASSERT_NOT_NULL(line);
+  TEST_ASSERT_EQUAL_INT(1, sscanf(line, "\ntest_used %lld", used));
+  free((char *)result);
+}
+
+void test_prom_group_add(void) {
+  prom_group_t *g = prom_group_new();
+  prom_gauge_t *gauge = prom_gauge_new("test_gauge", "gauge under test", 0, NULL);
+  prom_histogram_t *histogram = prom_histogram_new("test_histogram", "histogram under test", NULL, 0, NULL);
+
+  TEST_ASSERT_EQUAL_INT(0, prom_group_add(g, gauge));
+  TEST_ASSERT_NOT_EQUAL(0, prom_group_add(g, gauge));
+  TEST_ASSERT_NOT_EQUAL(0, prom_group_add(g, histogram));
+
+  // Staging does not nest
+  TEST_ASSERT_NOT_EQUAL(0, prom_group_commit(g));
+  TEST_ASSERT_EQUAL_INT(0, prom_group_begin(g));
+  TEST_ASSERT_NOT_EQUAL(0, prom_group_begin(g));
+  TEST_ASSERT_EQUAL_INT(0, prom_group_commit(g));
+
+  prom_histogram_destroy(histogram);
+  prom_gauge_destroy(gauge);
+  prom_group_destroy(g);
+}
+
+void test_prom_group_commit(void) {
+  test_registry_init();
+  double total = 0.0;
+  long long used = 0;
+
+  prom_group_begin(group);
+  prom_gauge_set(total_gauge, 10.5, NULL);
+  prom_gauge_set_i64(used_gauge, 5, NULL);
+  prom_group_commit(group);
+  test_scrape(&total, &used);
+  TEST_ASSERT_EQUAL_DOUBLE(10.5, total);
+  TEST_ASSERT_EQUAL_INT(5, used);
+
+  // Staged values stay hidden until the commit
+  prom_group_begin(group);
+  prom_gauge_set(total_gauge, 20.5, NULL);
+  test_scrape(&total, &used);
+  TEST_ASSERT_EQUAL_DOUBLE(10.5, total);
+  TEST_ASSERT_EQUAL_INT(5, used);
+  prom_gauge_set_i64(used_gauge, -7, NULL);
+  prom_group_commit(group);
+  test_scrape(&total, &used);
+  TEST_ASSERT_EQUAL_DOUBLE(20.5, total);
+  TEST_ASSERT_EQUAL_INT(-7, used);
+
+  test_registry_destroy();
+}
+
+void test_prom_group_exporters(void) {
+  test_registry_init();
+  prom_group_begin(group);
+  prom_gauge_set(total_gauge, 10.5, NULL);
+  prom_gauge_set_i64(used_gauge, 5, NULL);
+  prom_group_commit(group);
+
+  prom_udp_exporter_config_t config;
+  memset(&config, 0, sizeof(config));
+  config.host = "127.0.0.1";
+  config.port = 9;
+  config.format = PROM_UDP_EXPORTER_INFLUX;
+  prom_udp_exporter_t *exporter = prom_udp_exporter_new(&config);
+  TEST_ASSERT_NOT_NULL(exporter);
+  TEST_ASSERT_EQUAL_INT(0, prom_udp_exporter_serialize(exporter, registry, 1000));
+
+  // Once the exporters have read a commit, they keep reading it while the next one is staged
+  prom_group_begin(group);
+  prom_gauge_set(total_gauge, 20.5, NULL);
+  prom_gauge_set_i64(used_gauge, -7, NULL);
+  TEST_ASSERT_EQUAL_INT(0, prom_udp_exporter_serialize(exporter, registry, 1000));
+  TEST_ASSERT_NOT_NULL(memmem(exporter->buf, exporter->buf_len, "test_total value=10.5 ", 22));
+  TEST_ASSERT_NOT_NULL(memmem(exporter->buf, exporter->buf_len, "test_used value=5 ", 18));
+  prom_udp_exporter_destroy(exporter);
+
+  prom_string_builder_t *sb = prom_string_builder_new();
+  TEST_ASSERT_EQUAL_INT(0, prom_remote_write_encode(&sb, 1, registry, 1000));
+  double committed = 10.5;
+  double staged = 20.5;
+  const char *request = prom_string_builder_str(sb);
+  size_t len = prom_string_builder_len(sb);
+  TEST_ASSERT_NOT_NULL(memmem(request, len, &committed, sizeof(committed)));
+  TEST_ASSERT_NULL(memmem(request, len, &staged, sizeof(staged)));
+  prom_string_builder_destroy(sb);
+
+  prom_group_commit(group);
+  test_registry_destroy();
+}
+
+static _Atomic bool committing;
+
+static void *test_writer_run(void *arg) {
+  for (int i = 1; atomic_load(&committing); i++) {
+    prom_group_begin(group);
+    prom_gauge_set(total_gauge, (double)i, NULL);
+    prom_gauge_set_i64(used_gauge, i, NULL);
+    prom_group_commit(group);
+  }
+  return NULL;
+}
+
+void test_prom_group_consistency(void) {
+  test_registry_init();
+  prom_group_begin(group);
+  prom_gauge_set(total_gauge, 0.0, NULL);
+  prom_gauge_set_i64(used_gauge, 0, NULL);
+  prom_group_commit(group);
+
+  atomic_store(&committing, true);
+  pthread_t thread;
+  pthread_create(&thread, NULL, &test_writer_run, NULL);
+
+  // Every scrape shows both gauges from the same commit
+  for (int i = 0; i < 2000; i++) {
+    double total = 0.0;
+    long long used = 0;
+    test_scrape(&total, &used);
+    TEST_ASSERT_EQUAL_DOUBLE(total, (double)used);
+  }
+
+  atomic_store(&committing, false);
+  pthread_join(thread, NULL);
+  test_registry_destroy();
+}
+
+int main(int argc, const char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_prom_group_add);
+  RUN_TEST(test_prom_group_commit);
+  RUN_TEST(test_prom_group_exporters);
+  RUN_TEST(test_prom_group_consistency);
+  return UNITY_END();
+}
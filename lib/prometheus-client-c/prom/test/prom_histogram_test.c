@@ -27,47 +27,50 @@ void test_prom_histogram(void) {
 
   prom_metric_sample_histogram_t *h_sample = prom_metric_sample_histogram_from_labels(h, NULL);
 
-  // Test counter for each bucket
-  char *bucket_key = prom_metric_sample_histogram_bucket_to_str(5.0);
-  const char *l_value = prom_map_get(h_sample->l_values, bucket_key);
-  prom_metric_sample_t *sample = (prom_metric_sample_t *)prom_map_get(h_sample->samples, l_value);
-  TEST_ASSERT_EQUAL_STRING("test_histogram{le=\"5.0\"}", sample->l_value);
-  TEST_ASSERT_EQUAL_DOUBLE(1.0, sample->r_value);
-  free((char *)bucket_key);
-  bucket_key = NULL;
-
-  bucket_key = prom_metric_sample_histogram_bucket_to_str(10.0);
-  l_value = prom_map_get(h_sample->l_values, bucket_key);
-  sample = (prom_metric_sample_t *)prom_map_get(h_sample->samples, l_value);
-  TEST_ASSERT_EQUAL_STRING("test_histogram{le=\"10.0\"}", sample->l_value);
-  TEST_ASSERT_EQUAL_DOUBLE(2.0, sample->r_value);
-  free((char *)bucket_key);
-  bucket_key = NULL;
-
-  bucket_key = prom_metric_sample_histogram_bucket_to_str(15.0);
-  l_value = prom_map_get(h_sample->l_values, bucket_key);
-  sample = (prom_metric_sample_t *)prom_map_get(h_sample->samples, l_value);
-  TEST_ASSERT_EQUAL_STRING("test_histogram{le=\"15.0\"}", sample->l_value);
-  TEST_ASSERT_EQUAL_DOUBLE(3.0, sample->r_value);
-  free((char *)bucket_key);
-  bucket_key = NULL;
-
-  l_value = prom_map_get(h_sample->l_values, "+Inf");
-  sample = (prom_metric_sample_t *)prom_map_get(h_sample->samples, l_value);
-  TEST_ASSERT_EQUAL_STRING("test_histogram{le=\"+Inf\"}", sample->l_value);
-  TEST_ASSERT_EQUAL_DOUBLE(4.0, sample->r_value);
+  // Test the cumulative count of each bucket
+  TEST_ASSERT_EQUAL_STRING("test_histogram{le=\"5.0\"}", h_sample->l_values[0]);
+  TEST_ASSERT_EQUAL_DOUBLE(1.0, prom_metric_sample_histogram_cumulative_count(h_sample, 0));
+
+  TEST_ASSERT_EQUAL_STRING("test_histogram{le=\"10.0\"}", h_sample->l_values[1]);
+  TEST_ASSERT_EQUAL_DOUBLE(2.0, prom_metric_sample_histogram_cumulative_count(h_sample, 1));
+
+  TEST_ASSERT_EQUAL_STRING("test_histogram{le=\"15.0\"}", h_sample->l_values[2]);
+  TEST_ASSERT_EQUAL_DOUBLE(3.0, prom_metric_sample_histogram_cumulative_count(h_sample, 2));
+
+  TEST_ASSERT_EQUAL_STRING("test_histogram{le=\"+Inf\"}", h_sample->l_values[3 + PROM_METRIC_SAMPLE_HISTOGRAM_INF]);
+  TEST_ASSERT_EQUAL_DOUBLE(4.0, prom_metric_sample_histogram_cumulative_count(h_sample, 3));
 
   // Test total count. Should equal value ini +Inf
-  l_value = prom_map_get(h_sample->l_values, "count");
-  prom_metric_sample_t *sample_count = (prom_metric_sample_t *)prom_map_get(h_sample->samples, l_value);
-  TEST_ASSERT_EQUAL_STRING("test_histogram_count", sample_count->l_value);
-  TEST_ASSERT_EQUAL_DOUBLE(4.0, sample_count->r_value);
+  TEST_ASSERT_EQUAL_STRING("test_histogram_count", h_sample->l_values[3 + PROM_METRIC_SAMPLE_HISTOGRAM_COUNT]);
+  TEST_ASSERT_EQUAL_DOUBLE(4.0, prom_metric_sample_histogram_count(h_sample));
 
   // Test sum
-  l_value = prom_map_get(h_sample->l_values, "sum");
-  sample = (prom_metric_sample_t *)prom_map_get(h_sample->samples, l_value);
-  TEST_ASSERT_EQUAL_STRING("test_histogram_sum", sample->l_value);
-  TEST_ASSERT_EQUAL_DOUBLE(41.0, sample->r_value);
+  TEST_ASSERT_EQUAL_STRING("test_histogram_sum", h_sample->l_values[3 + PROM_METRIC_SAMPLE_HISTOGRAM_SUM]);
+  TEST_ASSERT_EQUAL_DOUBLE(41.0, prom_metric_sample_histogram_sum(h_sample));
+
+  prom_histogram_destroy(h);
+  h = NULL;
+}
+
+void test_prom_histogram_observe_bucket_boundaries(void) {
+  prom_histogram_t *h = prom_histogram_new("test_histogram_boundaries", "histogram under test",
+                                           prom_histogram_buckets_linear(1.0, 1.0, 4), 0, NULL);
+
+  // An observation equal to an upper bound belongs to that bucket
+  prom_histogram_observe(h, 1.0, NULL);
+  prom_histogram_observe(h, 2.5, NULL);
+  prom_histogram_observe(h, 4.0, NULL);
+  prom_histogram_observe(h, -3.0, NULL);
+  prom_histogram_observe(h, 100.0, NULL);
+
+  prom_metric_sample_histogram_t *h_sample = prom_metric_sample_histogram_from_labels(h, NULL);
+  TEST_ASSERT_EQUAL_DOUBLE(2.0, prom_metric_sample_histogram_cumulative_count(h_sample, 0));
+  TEST_ASSERT_EQUAL_DOUBLE(2.0, prom_metric_sample_histogram_cumulative_count(h_sample, 1));
+  TEST_ASSERT_EQUAL_DOUBLE(3.0, prom_metric_sample_histogram_cumulative_count(h_sample, 2));
+  TEST_ASSERT_EQUAL_DOUBLE(4.0, prom_metric_sample_histogram_cumulative_count(h_sample, 3));
+  TEST_ASSERT_EQUAL_DOUBLE(5.0, prom_metric_sample_histogram_cumulative_count(h_sample, 4));
+  TEST_ASSERT_EQUAL_DOUBLE(5.0, prom_metric_sample_histogram_count(h_sample));
+  TEST_ASSERT_EQUAL_DOUBLE(104.5, prom_metric_sample_histogram_sum(h_sample));
 
   prom_histogram_destroy(h);
   h = NULL;
@@ -76,5 +79,6 @@ void test_prom_histogram(void) {
 int main(int argc, const char **argv) {
   UNITY_BEGIN();
   RUN_TEST(test_prom_histogram);
+  RUN_TEST(test_prom_histogram_observe_bucket_boundaries);
   return UNITY_END();
 }
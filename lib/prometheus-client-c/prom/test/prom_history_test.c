@@ -0,0 +1,253 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <math.h>
+
+#include "prom_test_helpers.h"
+
+static prom_collector_registry_t *registry;
+static prom_gauge_t *test_gauge;
+
+static void test_registry_init(void) {
+  registry = prom_collector_registry_new("history_test");
+  test_gauge = prom_gauge_new("test_gauge", "gauge under test", 1, (const char *[]){"host"});
+  prom_collector_t *collector = prom_collector_new("history");
+  prom_collector_add_metric(collector, test_gauge);
+  prom_collector_registry_register_collector(registry, collector);
+}
+
+static void test_registry_destroy(void) {
+  prom_collector_registry_destroy(registry);
+  registry = NULL;
+  test_gauge = NULL;
+}
+
+void test_prom_history_chunk(void) {
+  prom_history_chunk_t *chunk = (prom_history_chunk_t *)calloc(1, sizeof(prom_history_chunk_t));
+  prom_history_chunk_reset(chunk);
+
+  // Irregular intervals that exercise every delta-of-delta width, and values that exercise every XOR case
+  int64_t t[] = {1700000000000, 1700000000100, 1700000000200, 1700000000301, 1700000010000, 1700000070000,
+                 1700000600000, 1800000000000, 1800000000001, 1800000000002};
+  double v[] = {0.0, 0.0, 1.5, 1.75, -1.75, NAN, INFINITY, 1e300, 4.9e-324, -0.0};
+  size_t n = sizeof(t) / sizeof(t[0]);
+  for (size_t i = 0; i < n; i++) TEST_ASSERT_EQUAL_INT(0, prom_history_chunk_append(chunk, t[i], v[i]));
+  TEST_ASSERT_EQUAL_INT(n, chunk->count);
+
+  prom_history_iter_t iter;
+  prom_history_iter_init(&iter, chunk);
+  int64_t rt;
+  double rv;
+  for (size_t i = 0; i < n; i++) {
+    TEST_ASSERT_TRUE(prom_history_iter_next(&iter, &rt, &rv));
+    TEST_ASSERT_EQUAL_INT(0, memcmp(&t[i], &rt, sizeof(rt)));
+    TEST_ASSERT_EQUAL_INT(0, memcmp(&v[i], &rv, sizeof(rv)));
+  }
+  TEST_ASSERT_FALSE(prom_history_iter_next(&iter, &rt, &rv));
+
+  // A steady series takes two bits per sample, and a full chunk refuses samples without changing
+  prom_history_chunk_reset(chunk);
+  size_t appended = 0;
+  while (prom_history_chunk_append(chunk, 1700000000000 + 100 * (int64_t)appended, 42.0) == 0) appended++;
+  TEST_ASSERT_TRUE(appended > (PROM_HISTORY_CHUNK_BYTES * 8 - 2 * PROM_HISTORY_SAMPLE_MAX_BITS - 128) / 2);
+  TEST_ASSERT_EQUAL_INT(appended, chunk->count);
+  prom_history_iter_init(&iter, chunk);
+  size_t read = 0;
+  while (prom_history_iter_next(&iter, &rt, &rv)) {
+    TEST_ASSERT_EQUAL_INT(0, rt - 1700000000000 - 100 * (int64_t)read);
+    TEST_ASSERT_EQUAL_DOUBLE(42.0, rv);
+    read++;
+  }
+  TEST_ASSERT_EQUAL_INT(appended, read);
+  free(chunk);
+}
+
+void test_prom_history_query_range(void) {
+  test_registry_init();
+  prom_history_t *h = prom_history_new(NULL);
+  TEST_ASSERT_NOT_NULL(h);
+
+  prom_gauge_set(test_gauge, 1.0, (const char *[]){"a"});
+  prom_gauge_set(test_gauge, -3.0, (const char *[]){"x\"y"});
+  TEST_ASSERT_EQUAL_INT(0, prom_history_record(h, registry, 1000));
+  prom_gauge_set(test_gauge, 2.5, (const char *[]){"a"});
+  TEST_ASSERT_EQUAL_INT(0, prom_history_record(h, registry, 1100));
+  // Samples that are not later than the last one are skipped
+  prom_gauge_set(test_gauge, 7.0, (const char *[]){"a"});
+  TEST_ASSERT_EQUAL_INT(0, prom_history_record(h, registry, 1100));
+
+  char *buf = NULL;
+  size_t cap = 0;
+  size_t len = 0;
+  TEST_ASSERT_EQUAL_INT(0, prom_history_query_range(h, "test_gauge", 0, 2000, 0, &buf, &cap, &len));
+  const char *raw =
+      "{\"status\":\"success\",\"data\":{\"resultType\":\"matrix\",\"result\":["
+      "{\"metric\":{\"__name__\":\"test_gauge\",\"host\":\"a\"},\"values\":[[1,\"1\"],[1.1,\"2.5\"]]},"
+      "{\"metric\":{\"__name__\":\"test_gauge\",\"host\":\"x\\\"y\"},\"values\":[[1,\"-3\"],[1.1,\"-3\"]]}]}}";
+  TEST_ASSERT_EQUAL_STRING(raw, buf);
+  TEST_ASSERT_EQUAL_INT(strlen(raw), len);
+
+  // Each step takes the latest sample at or before it; series with nothing in range are left out
+  TEST_ASSERT_EQUAL_INT(0, prom_history_query_range(h, "test_gauge", 1050, 1250, 100, &buf, &cap, &len));
+  const char *stepped =
+      "{\"status\":\"success\",\"data\":{\"resultType\":\"matrix\",\"result\":["
+      "{\"metric\":{\"__name__\":\"test_gauge\",\"host\":\"a\"},"
+      "\"values\":[[1.05,\"1\"],[1.15,\"2.5\"],[1.25,\"2.5\"]]},"
+      "{\"metric\":{\"__name__\":\"test_gauge\",\"host\":\"x\\\"y\"},\"values\":[[1.05,\"-3\"],[1.15,\"-3\"],"
+      "[1.25,\"-3\"]]}]}}";
+  TEST_ASSERT_EQUAL_STRING(stepped, buf);
+  TEST_ASSERT_EQUAL_INT(0, prom_history_query_range(h, "test_gauge", 5000, 6000, 0, &buf, &cap, &len));
+  TEST_ASSERT_EQUAL_STRING("{\"status\":\"success\",\"data\":{\"resultType\":\"matrix\",\"result\":[]}}", buf);
+  TEST_ASSERT_EQUAL_INT(0, prom_history_query_range(h, "other_gauge", 0, 2000, 0, &buf, &cap, &len));
+  TEST_ASSERT_EQUAL_STRING("{\"status\":\"success\",\"data\":{\"resultType\":\"matrix\",\"result\":[]}}", buf);
+
+  prom_free(buf);
+  prom_history_destroy(h);
+  test_registry_destroy();
+}
+
+void test_prom_history_errors(void) {
+  prom_history_t *h = prom_history_new(NULL);
+  char *buf = NULL;
+  size_t cap = 0;
+  size_t len = 0;
+
+  TEST_ASSERT_NOT_EQUAL(0, prom_history_query_range(h, "", 0, 1000, 0, &buf, &cap, &len));
+  TEST_ASSERT_EQUAL_STRING("{\"status\":\"error\",\"errorType\":\"bad_data\",\"error\":\"missing metric name\"}", buf);
+  TEST_ASSERT_NOT_EQUAL(0, prom_history_query_range(h, "test_gauge", 1000, 0, 0, &buf, &cap, &len));
+  TEST_ASSERT_NOT_EQUAL(0, prom_history_query_range(h, "test_gauge", 0, 1000, -1, &buf, &cap, &len));
+  TEST_ASSERT_NOT_EQUAL(0, prom_history_query_range(h, "test_gauge", 0, 11001 * 10, 9, &buf, &cap, &len));
+  TEST_ASSERT_EQUAL_INT(0, prom_history_query_range(h, "test_gauge", 0, 11000 * 10, 10, &buf, &cap, &len));
+
+  prom_free(buf);
+  prom_history_destroy(h);
+}
+
+void test_prom_history_extreme_range(void) {
+  test_registry_init();
+  prom_history_t *h = prom_history_new(NULL);
+  prom_gauge_set(test_gauge, 1.0, (const char *[]){"a"});
+  TEST_ASSERT_EQUAL_INT(0, prom_history_record(h, registry, 1000));
+  char *buf = NULL;
+  size_t cap = 0;
+  size_t len = 0;
+
+  // Timestamps whose difference does not fit an int64_t are refused before any arithmetic on them
+  TEST_ASSERT_NOT_EQUAL(0, prom_history_query_range(h, "test_gauge", INT64_MIN, INT64_MAX, 0, &buf, &cap, &len));
+  TEST_ASSERT_EQUAL_STRING(
+      "{\"status\":\"error\",\"errorType\":\"bad_data\",\"error\":\"start or end timestamp out of range\"}", buf);
+  TEST_ASSERT_NOT_EQUAL(0, prom_history_query_range(h, "test_gauge", INT64_MIN, 0, 1000, &buf, &cap, &len));
+  TEST_ASSERT_NOT_EQUAL(0, prom_history_query_range(h, "test_gauge", 0, INT64_MAX, INT64_MAX, &buf, &cap, &len));
+  TEST_ASSERT_NOT_EQUAL(0, prom_history_query_range(h, "test_gauge", -PROM_HISTORY_MAX_TIMESTAMP_MS,
+                                                    PROM_HISTORY_MAX_TIMESTAMP_MS, 1, &buf, &cap, &len));
+
+  // The widest range still answers, and a step larger than it leaves the point at start
+  TEST_ASSERT_EQUAL_INT(0, prom_history_query_range(h, "test_gauge", -PROM_HISTORY_MAX_TIMESTAMP_MS,
+                                                    PROM_HISTORY_MAX_TIMESTAMP_MS, 0, &buf, &cap, &len));
+  TEST_ASSERT_NOT_NULL(strstr(buf, "\"values\":[[1,\"1\"]]"));
+  TEST_ASSERT_EQUAL_INT(0, prom_history_query_range(h, "test_gauge", 1000, PROM_HISTORY_MAX_TIMESTAMP_MS, INT64_MAX,
+                                                    &buf, &cap, &len));
+  TEST_ASSERT_NOT_NULL(strstr(buf, "\"values\":[[1,\"1\"]]"));
+
+  prom_free(buf);
+  prom_history_destroy(h);
+  test_registry_destroy();
+}
+
+void test_prom_history_series_bytes(void) {
+  test_registry_init();
+  prom_history_config_t config = {.retention = 3600, .series_bytes = 4 * sizeof(prom_history_chunk_t)};
+  prom_history_t *h = prom_history_new(&config);
+
+  // Values that change in every bit fill chunks quickly, so the ring wraps several times
+  int64_t t = 1700000000000;
+  for (size_t i = 0; i < 5000; i++, t += 100) {
+    prom_gauge_set(test_gauge, (double)i * 1.000001, (const char *[]){"a"});
+    TEST_ASSERT_EQUAL_INT(0, prom_history_record(h, registry, t));
+  }
+
+  prom_history_stats_t stats;
+  TEST_ASSERT_EQUAL_INT(0, prom_history_stats(h, &stats));
+  TEST_ASSERT_EQUAL_INT(1, stats.series);
+  TEST_ASSERT_EQUAL_INT(config.series_bytes, stats.series_bytes_limit);
+  TEST_ASSERT_TRUE(stats.samples > 0 && stats.samples < 5000);
+  TEST_ASSERT_EQUAL_INT(stats.bytes, stats.largest_series_bytes);
+  // The chunks and their slots stay within the limit, the rest is the name and labels
+  TEST_ASSERT_TRUE(stats.bytes <= config.series_bytes + sizeof(prom_history_series_t) + 128);
+
+  // The oldest samples were dropped, the newest are all there
+  char *buf = NULL;
+  size_t cap = 0;
+  size_t len = 0;
+  TEST_ASSERT_EQUAL_INT(0, prom_history_query_range(h, "test_gauge", 0, t, 0, &buf, &cap, &len));
+  TEST_ASSERT_NULL(strstr(buf, "[1700000000,"));
+  TEST_ASSERT_NOT_NULL(strstr(buf, "[1700000499.9,\"4999.00499"));
+
+  prom_free(buf);
+  prom_history_destroy(h);
+  test_registry_destroy();
+}
+
+void test_prom_history_retention(void) {
+  test_registry_init();
+  prom_history_config_t config = {.retention = 10, .series_bytes = 0};
+  prom_history_t *h = prom_history_new(&config);
+
+  prom_gauge_set(test_gauge, 1.0, (const char *[]){"a"});
+  prom_gauge_set(test_gauge, 2.0, (const char *[]){"b"});
+  TEST_ASSERT_EQUAL_INT(0, prom_history_record(h, registry, 1700000000000));
+  prom_history_stats_t stats;
+  prom_history_stats(h, &stats);
+  TEST_ASSERT_EQUAL_INT(2, stats.series);
+
+  // A registry holding only the "a" series, so that "b" is no longer recorded
+  prom_collector_registry_t *other = prom_collector_registry_new("history_test_other");
+  prom_gauge_t *gauge = prom_gauge_new("test_gauge", "gauge under test", 1, (const char *[]){"host"});
+  prom_collector_t *collector = prom_collector_new("history");
+  prom_collector_add_metric(collector, gauge);
+  prom_collector_registry_register_collector(other, collector);
+  prom_gauge_set(gauge, 1.0, (const char *[]){"a"});
+
+  // Once a series is not recorded for the whole retention it is dropped
+  TEST_ASSERT_EQUAL_INT(0, prom_history_record(h, other, 1700000005000));
+  prom_history_stats(h, &stats);
+  TEST_ASSERT_EQUAL_INT(2, stats.series);
+  TEST_ASSERT_EQUAL_INT(0, prom_history_record(h, other, 1700000011000));
+  prom_history_stats(h, &stats);
+  TEST_ASSERT_EQUAL_INT(1, stats.series);
+  TEST_ASSERT_EQUAL_INT(3, stats.samples);
+
+  // Chunks whose samples all aged out are freed, so the remaining series starts over
+  TEST_ASSERT_EQUAL_INT(0, prom_history_record(h, other, 1700000030000));
+  prom_history_stats(h, &stats);
+  TEST_ASSERT_EQUAL_INT(1, stats.samples);
+
+  prom_collector_registry_destroy(other);
+  prom_history_destroy(h);
+  test_registry_destroy();
+}
+
+int main(int argc, const char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_prom_history_chunk);
+  RUN_TEST(test_prom_history_query_range);
+  RUN_TEST(test_prom_history_errors);
+  RUN_TEST(test_prom_history_extreme_range);
+  RUN_TEST(test_prom_history_series_bytes);
+  RUN_TEST(test_prom_history_retention);
+  return UNITY_END();
+}
@@ -14,6 +14,10 @@
  * limitations under the License.
  */
 
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
 #include "prom_test_helpers.h"
 
 void test_prom_map(void) {
@@ -25,21 +29,14 @@ void test_prom_map(void) {
   TEST_ASSERT_NULL(prom_map_get(map, "nope"));
   TEST_ASSERT_EQUAL_INT(2, prom_map_size(map));
 
-  for (prom_linked_list_node_t *current_node = map->keys->head; current_node != NULL;
-       current_node = current_node->next) {
-    const char *key = (const char *)current_node->item;
-
-    const char *expected;
-    if (strcmp(key, "foo") == 0) {
-      expected = "bar";
-    } else if (strcmp(key, "bing") == 0) {
-      expected = "bang";
-    }
-
-    const char *result = prom_map_get(map, key);
-
-    TEST_ASSERT_EQUAL_STRING(expected, result);
-  }
+  // Entries are in insertion order and carry their values
+  size_t size = 0;
+  prom_map_entry_t *entries = prom_map_entries(map, &size);
+  TEST_ASSERT_EQUAL_INT(2, size);
+  TEST_ASSERT_EQUAL_STRING("foo", entries[0].key);
+  TEST_ASSERT_EQUAL_STRING("bar", (const char *)entries[0].value);
+  TEST_ASSERT_EQUAL_STRING("bing", entries[1].key);
+  TEST_ASSERT_EQUAL_STRING("bang", (const char *)entries[1].value);
 
   prom_map_destroy(map);
   map = NULL;
@@ -51,7 +48,7 @@ void test_prom_map_when_large(void) {
 
   // Ensure each inserted key and value are present
   for (int i = 1; i <= 10000; i++) {
-    char buf[4];
+    char buf[6];
     sprintf(buf, "%d", i);
     const char *k = (const char *)buf;
     int *set = malloc(sizeof(int));
@@ -68,7 +65,7 @@ void test_prom_map_when_large(void) {
 
   // Ensure each key and value is correct
   for (int i = 1; i <= 10000; i++) {
-    char buf[5];
+    char buf[6];
     sprintf(buf, "%d", i);
     const char *k = (const char *)buf;
     int actual = *((int *)prom_map_get(map, k));
@@ -87,9 +84,246 @@ void test_prom_map_when_large(void) {
   map = NULL;
 }
 
+void test_prom_map_delete(void) {
+  prom_map_t *map = prom_map_new();
+  prom_map_set_free_value_fn(map, free);
+  for (int i = 0; i < 100; i++) {
+    char buf[16];
+    sprintf(buf, "k%d", i);
+    int *set = malloc(sizeof(int));
+    *set = i;
+    prom_map_set(map, buf, (void *)set);
+  }
+
+  // Overwriting a key keeps its place in the entries and updates the entry's value
+  int *replacement = malloc(sizeof(int));
+  *replacement = -1;
+  prom_map_set(map, "k0", (void *)replacement);
+  size_t size = 0;
+  prom_map_entry_t *entries = prom_map_entries(map, &size);
+  TEST_ASSERT_EQUAL_STRING("k0", entries[0].key);
+  TEST_ASSERT_EQUAL_INT(-1, *((int *)entries[0].value));
+  TEST_ASSERT_EQUAL_INT(-1, *((int *)prom_map_get(map, "k0")));
+
+  // Keys keep their insertion order across resizes
+  TEST_ASSERT_EQUAL_INT(100, size);
+  for (int i = 0; i < 100; i++) {
+    char buf[16];
+    sprintf(buf, "k%d", i);
+    TEST_ASSERT_EQUAL_STRING(buf, entries[i].key);
+  }
+
+  TEST_ASSERT_EQUAL_INT(0, prom_map_delete(map, "k50"));
+  TEST_ASSERT_EQUAL_INT(0, prom_map_delete(map, "missing"));
+  TEST_ASSERT_NULL(prom_map_get(map, "k50"));
+  TEST_ASSERT_EQUAL_INT(99, prom_map_size(map));
+  TEST_ASSERT_EQUAL_INT(51, *((int *)prom_map_get(map, "k51")));
+
+  // The entries close the gap and stay in order, and later overwrites still find their entry
+  entries = prom_map_entries(map, &size);
+  TEST_ASSERT_EQUAL_INT(99, size);
+  TEST_ASSERT_EQUAL_STRING("k49", entries[49].key);
+  TEST_ASSERT_EQUAL_STRING("k51", entries[50].key);
+  TEST_ASSERT_EQUAL_INT(51, *((int *)entries[50].value));
+  int *at_99 = malloc(sizeof(int));
+  *at_99 = 990;
+  prom_map_set(map, "k99", (void *)at_99);
+  entries = prom_map_entries(map, &size);
+  TEST_ASSERT_EQUAL_STRING("k99", entries[98].key);
+  TEST_ASSERT_EQUAL_INT(990, *((int *)entries[98].value));
+
+  prom_map_destroy(map);
+  map = NULL;
+}
+
+void test_prom_map_delete_many(void) {
+  prom_map_t *map = prom_map_new();
+  TEST_ASSERT_NULL(prom_map_get(map, "empty"));
+  TEST_ASSERT_EQUAL_INT(0, prom_map_delete(map, "empty"));
+
+  // Deleting every third key shifts entries back along their probe sequences; the rest must stay reachable
+  static int values[3000];
+  char buf[16];
+  for (int i = 0; i < 3000; i++) {
+    values[i] = i;
+    sprintf(buf, "series_%d", i);
+    prom_map_set(map, buf, &values[i]);
+  }
+  for (int i = 0; i < 3000; i += 3) {
+    sprintf(buf, "series_%d", i);
+    TEST_ASSERT_EQUAL_INT(0, prom_map_delete(map, buf));
+  }
+  TEST_ASSERT_EQUAL_INT(2000, prom_map_size(map));
+  for (int i = 0; i < 3000; i++) {
+    sprintf(buf, "series_%d", i);
+    int *actual = (int *)prom_map_get(map, buf);
+    if (i % 3 == 0) {
+      TEST_ASSERT_NULL(actual);
+    } else {
+      TEST_ASSERT_NOT_NULL(actual);
+      TEST_ASSERT_EQUAL_INT(i, *actual);
+    }
+  }
+
+  prom_map_destroy(map);
+  map = NULL;
+}
+
+void test_prom_map_sweep(void) {
+  prom_map_t *map = prom_map_new();
+  TEST_ASSERT_EQUAL_INT(0, prom_map_sweep(map, 1));
+
+  static int values[100];
+  char buf[16];
+  for (int i = 0; i < 100; i++) {
+    values[i] = i;
+    sprintf(buf, "k%d", i);
+    prom_map_set(map, buf, &values[i]);
+  }
+
+  // Stamps only grow, and pinned entries survive any cutoff
+  for (int i = 0; i < 100; i += 2) {
+    sprintf(buf, "k%d", i);
+    TEST_ASSERT_EQUAL_PTR(&values[i], prom_map_touch(map, buf, 5));
+  }
+  prom_map_touch(map, "k0", 1);
+  prom_map_touch(map, "k1", PROM_MAP_STAMP_PINNED);
+  TEST_ASSERT_NULL(prom_map_touch(map, "missing", 5));
+
+  TEST_ASSERT_EQUAL_INT(0, prom_map_sweep(map, 0));
+  TEST_ASSERT_EQUAL_INT(49, prom_map_sweep(map, 5));
+  TEST_ASSERT_EQUAL_INT(51, prom_map_size(map));
+
+  // The survivors keep their insertion order, and the entries stay usable for overwrites
+  size_t size = 0;
+  prom_map_entry_t *entries = prom_map_entries(map, &size);
+  TEST_ASSERT_EQUAL_INT(51, size);
+  TEST_ASSERT_EQUAL_STRING("k0", entries[0].key);
+  TEST_ASSERT_EQUAL_STRING("k1", entries[1].key);
+  TEST_ASSERT_EQUAL_STRING("k2", entries[2].key);
+  TEST_ASSERT_EQUAL_STRING("k98", entries[50].key);
+  for (int i = 0; i < 100; i++) {
+    sprintf(buf, "k%d", i);
+    int *actual = (int *)prom_map_get(map, buf);
+    if (i % 2 == 0 || i == 1) {
+      TEST_ASSERT_EQUAL_PTR(&values[i], actual);
+    } else {
+      TEST_ASSERT_NULL(actual);
+    }
+  }
+  prom_map_set(map, "k98", &values[0]);
+  entries = prom_map_entries(map, &size);
+  TEST_ASSERT_EQUAL_PTR(&values[0], entries[50].value);
+
+  prom_map_destroy(map);
+  map = NULL;
+}
+
+static int test_stable_values[256];
+static atomic_bool test_writer_done;
+
+static void *test_prom_map_writer(void *arg) {
+  prom_map_t *map = (prom_map_t *)arg;
+  char buf[32];
+  for (int round = 0; round < 20; round++) {
+    for (int i = 0; i < 1000; i++) {
+      sprintf(buf, "churn_%d", i);
+      prom_map_set(map, buf, &test_stable_values[0]);
+    }
+    for (int i = 0; i < 1000; i++) {
+      sprintf(buf, "churn_%d", i);
+      prom_map_delete(map, buf);
+    }
+  }
+  atomic_store(&test_writer_done, true);
+  return NULL;
+}
+
+void test_prom_map_get_while_writing(void) {
+  prom_map_t *map = prom_map_new();
+  char buf[32];
+  for (int i = 0; i < 256; i++) {
+    test_stable_values[i] = i;
+    sprintf(buf, "stable_%d", i);
+    prom_map_set(map, buf, &test_stable_values[i]);
+  }
+
+  // Inserts, resizes and deletes of other keys move the stable keys around, and lookups must never miss them
+  atomic_store(&test_writer_done, false);
+  pthread_t writer;
+  pthread_create(&writer, NULL, &test_prom_map_writer, map);
+  int misses = 0;
+  while (!atomic_load(&test_writer_done)) {
+    for (int i = 0; i < 256; i++) {
+      sprintf(buf, "stable_%d", i);
+      int *actual = (int *)prom_map_get(map, buf);
+      if (actual == NULL || *actual != i) misses++;
+    }
+  }
+  pthread_join(writer, NULL);
+  TEST_ASSERT_EQUAL_INT(0, misses);
+  TEST_ASSERT_EQUAL_INT(256, prom_map_size(map));
+
+  prom_map_destroy(map);
+  map = NULL;
+}
+
+#define TEST_OVERWRITE_MAGIC 0x5a5a5a5a
+
+// Poisons a value before freeing it so that a reader still holding it notices
+static void test_prom_map_free_poisoned(void *gen) {
+  int *value = (int *)gen;
+  *value = 0;
+  prom_free(value);
+}
+
+static void *test_prom_map_overwriter(void *arg) {
+  prom_map_t *map = (prom_map_t *)arg;
+  for (int i = 0; i < 20000; i++) {
+    int *value = (int *)prom_malloc(sizeof(int));
+    *value = TEST_OVERWRITE_MAGIC;
+    prom_map_set(map, "overwritten", value);
+  }
+  atomic_store(&test_writer_done, true);
+  return NULL;
+}
+
+void test_prom_map_get_while_overwriting(void) {
+  prom_map_t *map = prom_map_new();
+  prom_map_set_free_value_fn(map, &test_prom_map_free_poisoned);
+  int *first = (int *)prom_malloc(sizeof(int));
+  *first = TEST_OVERWRITE_MAGIC;
+  prom_map_set(map, "overwritten", first);
+
+  // A replaced value must stay readable until every lookup that could have seen it leaves its critical section
+  atomic_store(&test_writer_done, false);
+  pthread_t writer;
+  pthread_create(&writer, NULL, &test_prom_map_overwriter, map);
+  int misses = 0;
+  while (!atomic_load(&test_writer_done)) {
+    prom_epoch_enter();
+    int *actual = (int *)prom_map_get(map, "overwritten");
+    for (int i = 0; i < 100; i++) {
+      if (actual == NULL || *(volatile int *)actual != TEST_OVERWRITE_MAGIC) misses++;
+    }
+    prom_epoch_exit();
+  }
+  pthread_join(writer, NULL);
+  TEST_ASSERT_EQUAL_INT(0, misses);
+
+  prom_map_destroy(map);
+  map = NULL;
+  prom_epoch_reclaim();
+}
+
 int main(int argc, const char **argv) {
   UNITY_BEGIN();
   RUN_TEST(test_prom_map);
   RUN_TEST(test_prom_map_when_large);
+  RUN_TEST(test_prom_map_delete);
+  RUN_TEST(test_prom_map_delete_many);
+  RUN_TEST(test_prom_map_sweep);
+  RUN_TEST(test_prom_map_get_while_writing);
+  RUN_TEST(test_prom_map_get_while_overwriting);
   return UNITY_END();
 }
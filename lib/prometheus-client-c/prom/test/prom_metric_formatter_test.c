@@ -25,12 +25,30 @@ void test_prom_metric_formatter_load_l_value(void) {
   char *expected = "test{foo=\"one\",bar=\"two\",bing=\"three\"}";
   TEST_ASSERT_NOT_NULL(strstr(actual, expected));
 
-  free(actual);
+  prom_free(actual);
   actual = NULL;
   prom_metric_formatter_destroy(mf);
   mf = NULL;
 }
 
+void test_prom_metric_formatter_write_l_value(void) {
+  const char *keys[] = {"foo", "bar", "bing"};
+  const char *values[] = {"one", "two", "three"};
+  const char *expected = "test{foo=\"one\",bar=\"two\",bing=\"three\"}";
+  char buf[64];
+  TEST_ASSERT_EQUAL_INT(strlen(expected), prom_metric_formatter_write_l_value(buf, sizeof(buf), "test", 3, keys, values));
+  TEST_ASSERT_EQUAL_STRING(expected, buf);
+
+  // Nothing is written when the L-value does not fit
+  buf[0] = '\0';
+  TEST_ASSERT_EQUAL_INT(strlen(expected), prom_metric_formatter_write_l_value(buf, strlen(expected), "test", 3, keys,
+                                                                              values));
+  TEST_ASSERT_EQUAL_STRING("", buf);
+
+  TEST_ASSERT_EQUAL_INT(4, prom_metric_formatter_write_l_value(buf, sizeof(buf), "test", 0, NULL, NULL));
+  TEST_ASSERT_EQUAL_STRING("test", buf);
+}
+
 void test_prom_metric_formatter_load_sample(void) {
   prom_metric_formatter_t *mf = prom_metric_formatter_new();
   const char *l_value = "test{foo=\"one\",bar=\"two\",bing=\"three\"}";
@@ -40,7 +58,7 @@ void test_prom_metric_formatter_load_sample(void) {
   char *expected = "test{foo=\"one\",bar=\"two\",bing=\"three\"}";
   TEST_ASSERT_NOT_NULL(strstr(actual, expected));
 
-  free(actual);
+  prom_free(actual);
   actual = NULL;
   prom_metric_sample_destroy(sample);
   prom_metric_formatter_destroy(mf);
@@ -68,7 +86,7 @@ void test_prom_metric_formatter_load_metric(void) {
   substr = "\ntest_counter{foo=\"o\",bar=\"r\"}";
   TEST_ASSERT_NOT_NULL(strstr(result, substr));
 
-  free((char *)result);
+  prom_free((char *)result);
   result = NULL;
   prom_metric_destroy(m);
   m = NULL;
@@ -112,7 +130,7 @@ void test_prom_metric_formatter_load_metrics(void) {
     TEST_ASSERT_NOT_NULL(strstr(result, expected[i]));
   }
 
-  free((char *)result);
+  prom_free((char *)result);
   result = NULL;
 
   r = prom_metric_formatter_destroy(mf);
@@ -127,11 +145,85 @@ void test_prom_metric_formatter_load_metrics(void) {
   PROM_COLLECTOR_REGISTRY_DEFAULT = NULL;
 }
 
+void test_prom_metric_formatter_load_metric_openmetrics(void) {
+  prom_metric_formatter_t *mf = prom_metric_formatter_new();
+  const char *keys[] = {"foo"};
+  const char *values[] = {"a\"b"};
+  const char *exemplar_keys[] = {"trace_id"};
+  const char *exemplar_values[] = {"abc"};
+  prom_metric_t *m = prom_metric_new(PROM_COUNTER, "test_requests_total", "counter under test", 1, keys);
+  prom_metric_sample_t *s = prom_metric_sample_from_labels(m, values);
+  TEST_ASSERT_EQUAL_INT(0, prom_metric_sample_add_with_exemplar(s, 2.0, 1, exemplar_keys, exemplar_values));
+  prom_metric_formatter_load_metric_openmetrics(mf, m);
+
+  char *result = prom_metric_formatter_dump(mf);
+  const char *expected[] = {"# TYPE test_requests counter\n", "# HELP test_requests counter under test\n",
+                            "test_requests_total{foo=\"a\\\"b\"} 2 # {trace_id=\"abc\"} 2 ",
+                            "test_requests_created{foo=\"a\\\"b\"} "};
+  for (int i = 0; i < 4; i++) {
+    TEST_ASSERT_NOT_NULL(strstr(result, expected[i]));
+  }
+
+  prom_free(result);
+  result = NULL;
+  prom_metric_destroy(m);
+  prom_metric_formatter_destroy(mf);
+  mf = NULL;
+}
+
+void test_prom_metric_formatter_load_histogram_openmetrics(void) {
+  prom_metric_formatter_t *mf = prom_metric_formatter_new();
+  prom_histogram_t *h = prom_histogram_new("test_histogram", "histogram under test",
+                                           prom_histogram_buckets_linear(5.0, 5.0, 2), 0, NULL);
+  prom_histogram_observe(h, 3.0, NULL);
+  prom_histogram_observe(h, 7.0, NULL);
+  prom_metric_formatter_load_metric_openmetrics(mf, h);
+
+  char *result = prom_metric_formatter_dump(mf);
+  const char *expected[] = {"test_histogram_bucket{le=\"5.0\"} 1\n", "test_histogram_bucket{le=\"10.0\"} 2\n",
+                            "test_histogram_bucket{le=\"+Inf\"} 2\n", "test_histogram_count 2\n",
+                            "test_histogram_sum 10\n", "test_histogram_created "};
+  for (int i = 0; i < 6; i++) {
+    TEST_ASSERT_NOT_NULL(strstr(result, expected[i]));
+  }
+
+  prom_free(result);
+  result = NULL;
+  prom_histogram_destroy(h);
+  prom_metric_formatter_destroy(mf);
+  mf = NULL;
+}
+
+void test_prom_metric_formatter_load_metric_protobuf(void) {
+  prom_metric_formatter_t *mf = prom_metric_formatter_new();
+  prom_metric_t *m = prom_metric_new(PROM_GAUGE, "g", "h", 0, NULL);
+  prom_metric_sample_t *s = prom_metric_sample_from_labels(m, NULL);
+  prom_metric_sample_set(s, 1.0);
+  prom_metric_formatter_load_metric_protobuf(mf, m);
+
+  // MetricFamily{name: "g", help: "h", type: GAUGE, metric: [Metric{gauge: Gauge{value: 1.0}}]}
+  const unsigned char expected[] = {0x15, 0x0a, 0x01, 'g',  0x12, 0x01, 'h',  0x18, 0x01, 0x22, 0x0b, 0x12,
+                                    0x09, 0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xf0, 0x3f};
+  TEST_ASSERT_EQUAL_INT(sizeof(expected), prom_metric_formatter_len(mf));
+  char *result = prom_metric_formatter_dump(mf);
+  TEST_ASSERT_EQUAL_MEMORY(expected, result, sizeof(expected));
+
+  prom_free(result);
+  result = NULL;
+  prom_metric_destroy(m);
+  prom_metric_formatter_destroy(mf);
+  mf = NULL;
+}
+
 int main(int argc, const char **argv) {
   UNITY_BEGIN();
   RUN_TEST(test_prom_metric_formatter_load_l_value);
+  RUN_TEST(test_prom_metric_formatter_write_l_value);
   RUN_TEST(test_prom_metric_formatter_load_sample);
   RUN_TEST(test_prom_metric_formatter_load_metric);
   RUN_TEST(test_prom_metric_formatter_load_metrics);
+  RUN_TEST(test_prom_metric_formatter_load_metric_openmetrics);
+  RUN_TEST(test_prom_metric_formatter_load_histogram_openmetrics);
+  RUN_TEST(test_prom_metric_formatter_load_metric_protobuf);
   return UNITY_END();
 }
@@ -63,10 +63,38 @@ void test_prom_metric_set(void) {
   s = NULL;
 }
 
+void test_prom_metric_sample_exemplar_bound(void) {
+  prom_metric_sample_t *s = prom_metric_sample_new(PROM_COUNTER, l_value, 0.0);
+  const char *empty[129];
+  for (size_t i = 0; i < 129; i++) empty[i] = "";
+
+  // 128 pairs of empty strings fill the buffer with their terminators alone
+  TEST_ASSERT_EQUAL_INT(0, prom_metric_sample_add_with_exemplar(s, 1.0, 128, empty, empty));
+  prom_metric_exemplar_t exemplar;
+  TEST_ASSERT_EQUAL_INT(0, prom_metric_sample_exemplar_load(s, &exemplar));
+  TEST_ASSERT_EQUAL_INT(128, exemplar.label_count);
+  TEST_ASSERT_EQUAL_INT(sizeof(exemplar.labels), exemplar.labels_len);
+
+  // One more pair does not fit, and the rejected exemplar leaves the counter unchanged
+  TEST_ASSERT_NOT_EQUAL(0, prom_metric_sample_add_with_exemplar(s, 1.0, 129, empty, empty));
+  TEST_ASSERT_EQUAL_DOUBLE(1.0, s->r_value);
+
+  // 64 pairs of one character each reach both the character limit and the end of the buffer
+  const char *one[65];
+  for (size_t i = 0; i < 65; i++) one[i] = "a";
+  TEST_ASSERT_EQUAL_INT(0, prom_metric_sample_add_with_exemplar(s, 1.0, 64, one, one));
+  TEST_ASSERT_NOT_EQUAL(0, prom_metric_sample_add_with_exemplar(s, 1.0, 65, one, one));
+  TEST_ASSERT_EQUAL_DOUBLE(2.0, s->r_value);
+
+  prom_metric_sample_destroy(s);
+  s = NULL;
+}
+
 int main(int argc, const char **argv) {
   UNITY_BEGIN();
   RUN_TEST(test_prom_metric_sample_add);
   RUN_TEST(test_prom_metric_sample_sub);
   RUN_TEST(test_prom_metric_set);
+  RUN_TEST(test_prom_metric_sample_exemplar_bound);
   return UNITY_END();
 }
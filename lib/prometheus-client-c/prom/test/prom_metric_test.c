@@ -37,9 +37,71 @@ void test_metric_sample_from_labels(void) {
   metric = NULL;
 }
 
+void test_metric_invalid_names(void) {
+  TEST_ASSERT_NULL(prom_metric_new(PROM_GAUGE, "0_metric", "test gauge", 0, NULL));
+  TEST_ASSERT_NULL(prom_metric_new(PROM_GAUGE, "test-metric", "test gauge", 0, NULL));
+  TEST_ASSERT_NULL(prom_counter_new("", "test counter", 0, NULL));
+  TEST_ASSERT_NULL(prom_metric_new(PROM_GAUGE, "test_metric", "test gauge", 1, (const char *[]){"bad-key"}));
+  TEST_ASSERT_NULL(prom_metric_new(PROM_GAUGE, "test_metric", "test gauge", 1, (const char *[]){"__reserved"}));
+  TEST_ASSERT_NULL(prom_metric_new(PROM_GAUGE, "test_metric", "test gauge", 2, (const char *[]){"foo", "le"}));
+  TEST_ASSERT_NULL(prom_histogram_new("test_metric", "test histogram", NULL, 1, (const char *[]){"quantile"}));
+}
+
+void test_metric_max_series(void) {
+  prom_gauge_t *g = prom_gauge_new("test_gauge", "gauge under test", 1, (const char *[]){"iface"});
+  TEST_ASSERT_EQUAL_INT(0, prom_metric_set_max_series(g, 2));
+
+  TEST_ASSERT_EQUAL_INT(0, prom_gauge_set(g, 1.0, (const char *[]){"eth0"}));
+  TEST_ASSERT_EQUAL_INT(0, prom_gauge_set(g, 2.0, (const char *[]){"eth1"}));
+  TEST_ASSERT_TRUE(prom_gauge_set(g, 3.0, (const char *[]){"veth0"}));
+  TEST_ASSERT_NULL(prom_gauge_child(g, (const char *[]){"veth1"}));
+  TEST_ASSERT_EQUAL_UINT64(2, prom_metric_dropped_series(g));
+  TEST_ASSERT_EQUAL_INT(2, prom_map_size(g->samples));
+
+  // Existing series keep working at the limit
+  TEST_ASSERT_EQUAL_INT(0, prom_gauge_set(g, 4.0, (const char *[]){"eth0"}));
+  TEST_ASSERT_EQUAL_DOUBLE(4.0, prom_gauge_child(g, (const char *[]){"eth0"})->r_value);
+
+  prom_gauge_destroy(g);
+}
+
+void test_metric_series_ttl(void) {
+  prom_counter_t *c = prom_counter_new("test_counter", "counter under test", 1, (const char *[]){"pid"});
+  TEST_ASSERT_EQUAL_INT(0, prom_metric_set_series_ttl(c, 2));
+  prom_counter_inc(c, (const char *[]){"1"});
+  prom_counter_inc(c, (const char *[]){"2"});
+  prom_metric_sample_t *child = prom_counter_child(c, (const char *[]){"3"});
+
+  // Series live through ttl sweeps without updates and are evicted on the next one
+  TEST_ASSERT_EQUAL_INT(0, prom_metric_sweep(c));
+  prom_counter_inc(c, (const char *[]){"1"});
+  TEST_ASSERT_EQUAL_INT(0, prom_metric_sweep(c));
+  TEST_ASSERT_EQUAL_INT(1, prom_metric_sweep(c));
+  TEST_ASSERT_EQUAL_UINT64(1, prom_metric_evicted_series(c));
+  TEST_ASSERT_EQUAL_INT(2, prom_map_size(c->samples));
+  TEST_ASSERT_EQUAL_INT(1, prom_metric_sweep(c));
+  TEST_ASSERT_EQUAL_UINT64(2, prom_metric_evicted_series(c));
+
+  // Children are pinned, so they stay valid
+  for (int i = 0; i < 5; i++) prom_metric_sweep(c);
+  TEST_ASSERT_EQUAL_INT(1, prom_map_size(c->samples));
+  TEST_ASSERT_EQUAL_INT(0, prom_metric_sample_add(child, 1.0));
+  TEST_ASSERT_EQUAL_PTR(child, prom_counter_child(c, (const char *[]){"3"}));
+
+  // An evicted series starts over when it is updated again
+  prom_counter_inc(c, (const char *[]){"2"});
+  TEST_ASSERT_EQUAL_DOUBLE(1.0, prom_counter_child(c, (const char *[]){"2"})->r_value);
+
+  prom_counter_destroy(c);
+  for (int i = 0; i < 3; i++) prom_epoch_reclaim();
+}
+
 int main(int argc, const char **argv) {
   UNITY_BEGIN();
   RUN_TEST(test_metric_with_no_labels);
   RUN_TEST(test_metric_sample_from_labels);
+  RUN_TEST(test_metric_invalid_names);
+  RUN_TEST(test_metric_max_series);
+  RUN_TEST(test_metric_series_ttl);
   return UNITY_END();
 }
@@ -0,0 +1,197 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <math.h>
+
+#include "prom_test_helpers.h"
+
+void test_prom_native_histogram_index(void) {
+  // Schema 0 buckets are octaves: (0.5, 1] is 0, (1, 2] is 1 and (2, 4] is 2
+  TEST_ASSERT_EQUAL_INT(0, prom_metric_sample_native_histogram_index(1.0, 0));
+  TEST_ASSERT_EQUAL_INT(1, prom_metric_sample_native_histogram_index(2.0, 0));
+  TEST_ASSERT_EQUAL_INT(2, prom_metric_sample_native_histogram_index(3.0, 0));
+  TEST_ASSERT_EQUAL_INT(-1, prom_metric_sample_native_histogram_index(0.5, 0));
+  TEST_ASSERT_EQUAL_INT(2, prom_metric_sample_native_histogram_index(-3.0, 0));
+
+  // Schema 1 splits each octave at sqrt(2)
+  TEST_ASSERT_EQUAL_INT(1, prom_metric_sample_native_histogram_index(1.2, 1));
+  TEST_ASSERT_EQUAL_INT(2, prom_metric_sample_native_histogram_index(1.5, 1));
+  TEST_ASSERT_EQUAL_INT(2, prom_metric_sample_native_histogram_index(2.0, 1));
+  TEST_ASSERT_EQUAL_INT(3, prom_metric_sample_native_histogram_index(2.1, 1));
+
+  // Schema -1 buckets span two octaves: (1, 4] is 1 and (4, 16] is 2
+  TEST_ASSERT_EQUAL_INT(1, prom_metric_sample_native_histogram_index(3.0, -1));
+  TEST_ASSERT_EQUAL_INT(1, prom_metric_sample_native_histogram_index(4.0, -1));
+  TEST_ASSERT_EQUAL_INT(2, prom_metric_sample_native_histogram_index(5.0, -1));
+
+  // Every schema agrees with the bucket bounds for values near a power of the base
+  for (int32_t schema = PROM_NATIVE_HISTOGRAM_MIN_SCHEMA; schema <= PROM_NATIVE_HISTOGRAM_MAX_SCHEMA; schema++) {
+    for (int32_t i = -20; i <= 20; i++) {
+      double bound = exp2((double)i / exp2(schema));
+      TEST_ASSERT_EQUAL_INT(i, prom_metric_sample_native_histogram_index(bound * (1 - 1e-12), schema));
+      TEST_ASSERT_EQUAL_INT(i + 1, prom_metric_sample_native_histogram_index(bound * (1 + 1e-12), schema));
+    }
+  }
+}
+
+void test_prom_native_histogram_observe(void) {
+  prom_native_histogram_t *h = prom_native_histogram_new("test_native", "native histogram under test", 0, 0, 0, NULL);
+  TEST_ASSERT(h);
+  TEST_ASSERT_EQUAL_INT(PROM_NATIVE_HISTOGRAM_DEFAULT_MAX_BUCKETS, h->max_buckets);
+
+  TEST_ASSERT_EQUAL_INT(0, prom_native_histogram_observe(h, 1.0, NULL));
+  TEST_ASSERT_EQUAL_INT(0, prom_native_histogram_observe(h, 3.0, NULL));
+  TEST_ASSERT_EQUAL_INT(0, prom_native_histogram_observe(h, 4.0, NULL));
+  TEST_ASSERT_EQUAL_INT(0, prom_native_histogram_observe(h, -0.75, NULL));
+  TEST_ASSERT_EQUAL_INT(0, prom_native_histogram_observe(h, 0.0, NULL));
+  TEST_ASSERT_EQUAL_INT(0, prom_native_histogram_observe(h, NAN, NULL));
+
+  prom_metric_sample_native_histogram_t *sample = prom_native_histogram_child(h, NULL);
+  TEST_ASSERT_EQUAL_UINT64(6, sample->count);
+  TEST_ASSERT_TRUE(isnan(sample->sum));
+  TEST_ASSERT_EQUAL_UINT64(1, sample->zero_count);
+
+  TEST_ASSERT_EQUAL_INT(2, sample->positive.count);
+  TEST_ASSERT_EQUAL_INT(0, sample->positive.indices[0]);
+  TEST_ASSERT_EQUAL_UINT64(1, sample->positive.counts[0]);
+  TEST_ASSERT_EQUAL_INT(2, sample->positive.indices[1]);
+  TEST_ASSERT_EQUAL_UINT64(2, sample->positive.counts[1]);
+
+  TEST_ASSERT_EQUAL_INT(1, sample->negative.count);
+  TEST_ASSERT_EQUAL_INT(0, sample->negative.indices[0]);
+
+  TEST_ASSERT_EQUAL_STRING("test_native_bucket{le=\"+Inf\"}",
+                           sample->l_values[PROM_METRIC_SAMPLE_NATIVE_HISTOGRAM_INF]);
+  TEST_ASSERT_EQUAL_STRING("test_native_count", sample->l_values[PROM_METRIC_SAMPLE_NATIVE_HISTOGRAM_COUNT]);
+  TEST_ASSERT_EQUAL_STRING("test_native_sum", sample->l_values[PROM_METRIC_SAMPLE_NATIVE_HISTOGRAM_SUM]);
+
+  prom_native_histogram_destroy(h);
+  h = NULL;
+}
+
+void test_prom_native_histogram_downscale(void) {
+  prom_native_histogram_t *h = prom_native_histogram_new("test_native", "native histogram under test", 2, 2, 0, NULL);
+  prom_metric_sample_native_histogram_t *sample = prom_native_histogram_child(h, NULL);
+
+  // 1, 2 and 4 are three buckets apart at schema 2, so fitting them in two buckets takes three halvings
+  prom_metric_sample_native_histogram_observe(sample, 1.0);
+  prom_metric_sample_native_histogram_observe(sample, 2.0);
+  prom_metric_sample_native_histogram_observe(sample, 4.0);
+  TEST_ASSERT_EQUAL_INT(-1, sample->schema);
+  TEST_ASSERT_EQUAL_INT(2, sample->positive.count);
+  TEST_ASSERT_EQUAL_INT(0, sample->positive.indices[0]);
+  TEST_ASSERT_EQUAL_UINT64(1, sample->positive.counts[0]);
+  TEST_ASSERT_EQUAL_INT(1, sample->positive.indices[1]);
+  TEST_ASSERT_EQUAL_UINT64(2, sample->positive.counts[1]);
+  TEST_ASSERT_EQUAL_UINT64(3, sample->count);
+
+  prom_native_histogram_destroy(h);
+  h = NULL;
+}
+
+void test_prom_native_histogram_widen_zero_bucket(void) {
+  prom_native_histogram_t *h = prom_native_histogram_new("test_native", "native histogram under test",
+                                                         PROM_NATIVE_HISTOGRAM_MIN_SCHEMA, 1, 0, NULL);
+  prom_metric_sample_native_histogram_t *sample = prom_native_histogram_child(h, NULL);
+
+  // With no resolution left to give up, the bucket nearest to zero is folded into the zero bucket
+  prom_metric_sample_native_histogram_observe(sample, 1.0);
+  prom_metric_sample_native_histogram_observe(sample, 1048576.0);
+  TEST_ASSERT_EQUAL_INT(PROM_NATIVE_HISTOGRAM_MIN_SCHEMA, sample->schema);
+  TEST_ASSERT_EQUAL_DOUBLE(1.0, sample->zero_threshold);
+  TEST_ASSERT_EQUAL_UINT64(1, sample->zero_count);
+  TEST_ASSERT_EQUAL_INT(1, sample->positive.count);
+  TEST_ASSERT_EQUAL_INT(2, sample->positive.indices[0]);
+
+  prom_metric_sample_native_histogram_observe(sample, 0.5);
+  TEST_ASSERT_EQUAL_UINT64(2, sample->zero_count);
+
+  prom_native_histogram_destroy(h);
+  h = NULL;
+}
+
+void test_prom_native_histogram_protobuf(void) {
+  prom_native_histogram_t *h = prom_native_histogram_new("n", "h", 0, 0, 0, NULL);
+  prom_native_histogram_observe(h, 1.0, NULL);
+  prom_native_histogram_observe(h, 2.0, NULL);
+  prom_native_histogram_observe(h, 2.0, NULL);
+
+  prom_metric_formatter_t *mf = prom_metric_formatter_new();
+  prom_epoch_enter();
+  TEST_ASSERT_EQUAL_INT(0, prom_metric_formatter_load_metric_protobuf(mf, h));
+  prom_epoch_exit();
+  unsigned char *result = (unsigned char *)prom_metric_formatter_dump(mf);
+
+  // MetricFamily{name: "n", help: "h", type: HISTOGRAM, metric: [Metric{histogram: Histogram{...}}]}
+  const unsigned char family[] = {0x0a, 0x01, 'n', 0x12, 0x01, 'h', 0x18, 0x04, 0x22};
+  TEST_ASSERT_EQUAL_MEMORY(family, result + 1, sizeof(family));
+  TEST_ASSERT_EQUAL_INT(0x3a, result[11]);
+
+  // Histogram{sample_count: 3, sample_sum: 5, schema: 0, zero_threshold: 2^-128, zero_count: 0,
+  //           positive_span: [{offset: 0, length: 2}], positive_delta: [1, 1], created_timestamp}
+  const unsigned char histogram[] = {0x08, 0x03, 0x11, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x14, 0x40, 0x28, 0x00,
+                                     0x31, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xf0, 0x37, 0x38, 0x00, 0x62, 0x04,
+                                     0x08, 0x00, 0x10, 0x02, 0x6a, 0x02, 0x02, 0x02, 0x7a};
+  TEST_ASSERT_EQUAL_MEMORY(histogram, result + 13, sizeof(histogram));
+
+  prom_free(result);
+  prom_metric_formatter_destroy(mf);
+  prom_native_histogram_destroy(h);
+  h = NULL;
+}
+
+void test_prom_native_histogram_text(void) {
+  prom_native_histogram_t *h = prom_native_histogram_new("test_native", "native histogram under test", 3, 0, 1,
+                                                         (const char *[]){"path"});
+  prom_native_histogram_observe(h, 0.25, (const char *[]){"/a"});
+  prom_native_histogram_observe(h, 0.5, (const char *[]){"/a"});
+
+  prom_metric_formatter_t *mf = prom_metric_formatter_new();
+  prom_epoch_enter();
+  TEST_ASSERT_EQUAL_INT(0, prom_metric_formatter_load_metric(mf, h));
+  prom_epoch_exit();
+  char *result = prom_metric_formatter_dump(mf);
+  TEST_ASSERT_EQUAL_STRING(
+      "# HELP test_native native histogram under test\n"
+      "# TYPE test_native histogram\n"
+      "test_native_bucket{path=\"/a\",le=\"+Inf\"} 2\n"
+      "test_native_count{path=\"/a\"} 2\n"
+      "test_native_sum{path=\"/a\"} 0.75\n\n",
+      result);
+
+  prom_free(result);
+  prom_metric_formatter_destroy(mf);
+  prom_native_histogram_destroy(h);
+  h = NULL;
+}
+
+void test_prom_native_histogram_invalid_schema(void) {
+  TEST_ASSERT_NULL(prom_native_histogram_new("test_native", "native histogram under test", 9, 0, 0, NULL));
+  TEST_ASSERT_NULL(prom_native_histogram_new("test_native", "native histogram under test", -5, 0, 0, NULL));
+}
+
+int main(int argc, const char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_prom_native_histogram_index);
+  RUN_TEST(test_prom_native_histogram_observe);
+  RUN_TEST(test_prom_native_histogram_downscale);
+  RUN_TEST(test_prom_native_histogram_widen_zero_bucket);
+  RUN_TEST(test_prom_native_histogram_protobuf);
+  RUN_TEST(test_prom_native_histogram_text);
+  RUN_TEST(test_prom_native_histogram_invalid_schema);
+  return UNITY_END();
+}
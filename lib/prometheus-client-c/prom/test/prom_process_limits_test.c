@@ -78,6 +78,25 @@ void test_prom_process_limits_file_parsing(void) {
   f = NULL;
 }
 
+void test_prom_process_limits_soft(void) {
+  prom_process_limits_file_t *f = prom_process_limits_file_new(path);
+  double soft = 0.0;
+
+  TEST_ASSERT_EQUAL_INT(0, prom_process_limits_soft(f, "Max open files", &soft));
+  TEST_ASSERT_EQUAL_DOUBLE(1048576.0, soft);
+  TEST_ASSERT_EQUAL_INT(0, prom_process_limits_soft(f, "Max address space", &soft));
+  TEST_ASSERT_EQUAL_DOUBLE(-1.0, soft);
+  TEST_ASSERT_EQUAL_INT(0, prom_process_limits_soft(f, "Max realtime timeout", &soft));
+  TEST_ASSERT_EQUAL_DOUBLE(-1.0, soft);
+
+  // A prefix of a limit is not that limit
+  TEST_ASSERT_NOT_EQUAL(0, prom_process_limits_soft(f, "Max realtime", &soft));
+  TEST_ASSERT_NOT_EQUAL(0, prom_process_limits_soft(f, "Max missing", &soft));
+
+  prom_process_limits_file_destroy(f);
+  f = NULL;
+}
+
 void test_prom_process_limits_rdp_next_token(void) {
   prom_process_limits_file_t f = {.size = 4, .index = 0, .buf = " \t!"};
   prom_process_limits_file_t *fp = &f;
@@ -202,6 +221,7 @@ void test_prom_process_limits_rdp_letter(void) {
 
 int main(int argc, const char **argv) {
   UNITY_BEGIN();
+  RUN_TEST(test_prom_process_limits_soft);
   RUN_TEST(test_prom_process_limits_rdp_next_token);
   RUN_TEST(test_prom_process_limits_rdp_match);
   RUN_TEST(test_prom_process_limits_rdp_hard_limit);
@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include <unistd.h>
+
 #include "prom_test_helpers.h"
 
 void test_prom_procfs_buf(void) {
@@ -24,8 +26,46 @@ void test_prom_procfs_buf(void) {
   buf = NULL;
 }
 
+void test_prom_procfs_buf_read(void) {
+  char path[] = "/tmp/prom_procfs_test_XXXXXX";
+  int fd = mkstemp(path);
+  TEST_ASSERT_TRUE(fd >= 0);
+  TEST_ASSERT_EQUAL_INT(5, write(fd, "first", 5));
+
+  prom_procfs_buf_t *buf = prom_procfs_buf_new(path);
+  TEST_ASSERT_NOT_NULL(buf);
+  TEST_ASSERT_EQUAL_STRING("first", buf->buf);
+  TEST_ASSERT_EQUAL_INT(6, buf->size);
+
+  // Reading again sees the new contents through the same descriptor, growing the buffer to fit them
+  char contents[3 * PROM_PROCFS_BUF_INITIAL_SIZE];
+  memset(contents, 'x', sizeof(contents) - 1);
+  contents[sizeof(contents) - 1] = '\0';
+  TEST_ASSERT_EQUAL_INT(0, ftruncate(fd, 0));
+  TEST_ASSERT_EQUAL_INT(sizeof(contents) - 1, pwrite(fd, contents, sizeof(contents) - 1, 0));
+  int buf_fd = buf->fd;
+  buf->index = 3;
+  TEST_ASSERT_EQUAL_INT(0, prom_procfs_buf_read(buf));
+  TEST_ASSERT_EQUAL_INT(buf_fd, buf->fd);
+  TEST_ASSERT_EQUAL_INT(0, buf->index);
+  TEST_ASSERT_EQUAL_INT(sizeof(contents), buf->size);
+  TEST_ASSERT_EQUAL_STRING(contents, buf->buf);
+
+  // Shorter contents reuse the buffer
+  size_t allocated = buf->allocated;
+  TEST_ASSERT_EQUAL_INT(0, ftruncate(fd, 2));
+  TEST_ASSERT_EQUAL_INT(0, prom_procfs_buf_read(buf));
+  TEST_ASSERT_EQUAL_STRING("xx", buf->buf);
+  TEST_ASSERT_EQUAL_INT(allocated, buf->allocated);
+
+  prom_procfs_buf_destroy(buf);
+  close(fd);
+  unlink(path);
+}
+
 int main(int argc, const char **argv) {
   UNITY_BEGIN();
   RUN_TEST(test_prom_procfs_buf);
+  RUN_TEST(test_prom_procfs_buf_read);
   return UNITY_END();
 }
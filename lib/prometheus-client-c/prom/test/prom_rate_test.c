@@ -0,0 +1,127 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "prom_test_helpers.h"
+
+void test_prom_rate_update(void) {
+  prom_counter_t *c = prom_counter_u64_new("test_bytes_total", "counter under test", 0, NULL);
+  prom_gauge_t *g = prom_gauge_new("test_bytes_per_second", "rate under test", 0, NULL);
+  prom_metric_sample_t *counter = prom_counter_child(c, NULL);
+  prom_metric_sample_t *rate = prom_gauge_child(g, NULL);
+  prom_rate_t *r = prom_rate_new();
+  size_t i = 0;
+  TEST_ASSERT_EQUAL_INT(0, prom_rate_add(r, counter, rate, 64, &i));
+  TEST_ASSERT_EQUAL_INT(0, i);
+
+  // The first observation starts the counter at the raw value and has no rate yet
+  TEST_ASSERT_EQUAL_INT(0, prom_rate_observe(r, i, 1000));
+  TEST_ASSERT_EQUAL_INT(0, prom_rate_update(r, 10.0));
+  TEST_ASSERT_EQUAL_UINT64(1000, counter->i_value);
+  TEST_ASSERT_EQUAL_DOUBLE(0.0, rate->r_value);
+
+  TEST_ASSERT_EQUAL_INT(0, prom_rate_observe(r, i, 1500));
+  TEST_ASSERT_EQUAL_INT(0, prom_rate_update(r, 12.0));
+  TEST_ASSERT_EQUAL_UINT64(1500, counter->i_value);
+  TEST_ASSERT_EQUAL_DOUBLE(250.0, rate->r_value);
+
+  // Series that are not observed keep their values, and the next rate spans the whole gap
+  TEST_ASSERT_EQUAL_INT(0, prom_rate_update(r, 13.0));
+  TEST_ASSERT_EQUAL_UINT64(1500, counter->i_value);
+  TEST_ASSERT_EQUAL_DOUBLE(250.0, rate->r_value);
+  TEST_ASSERT_EQUAL_INT(0, prom_rate_observe(r, i, 1800));
+  TEST_ASSERT_EQUAL_INT(0, prom_rate_update(r, 14.0));
+  TEST_ASSERT_EQUAL_UINT64(1800, counter->i_value);
+  TEST_ASSERT_EQUAL_DOUBLE(150.0, rate->r_value);
+
+  // A 64-bit counter that goes down was reset
+  TEST_ASSERT_EQUAL_INT(0, prom_rate_observe(r, i, 40));
+  TEST_ASSERT_EQUAL_INT(0, prom_rate_update(r, 16.0));
+  TEST_ASSERT_EQUAL_UINT64(1840, counter->i_value);
+  TEST_ASSERT_EQUAL_DOUBLE(20.0, rate->r_value);
+
+  TEST_ASSERT_NOT_EQUAL(0, prom_rate_observe(r, 1, 0));
+  prom_rate_destroy(r);
+  prom_gauge_destroy(g);
+  prom_counter_destroy(c);
+}
+
+void test_prom_rate_wrap(void) {
+  prom_counter_t *c = prom_counter_u64_new("test_packets_total", "counter under test", 1, (const char *[]){"dev"});
+  prom_metric_sample_t *wraps = prom_counter_child(c, (const char *[]){"wraps"});
+  prom_metric_sample_t *resets = prom_counter_child(c, (const char *[]){"resets"});
+  prom_rate_t *r = prom_rate_new();
+  size_t w = 0;
+  size_t s = 0;
+  TEST_ASSERT_EQUAL_INT(0, prom_rate_add(r, wraps, NULL, 32, &w));
+  TEST_ASSERT_EQUAL_INT(0, prom_rate_add(r, resets, NULL, 32, &s));
+  TEST_ASSERT_EQUAL_INT(1, s);
+
+  prom_rate_observe(r, w, UINT32_MAX - 9);
+  prom_rate_observe(r, s, 1000);
+  TEST_ASSERT_EQUAL_INT(0, prom_rate_update(r, 1.0));
+
+  // A decrease from the top of the range wrapped, anywhere else it was a reset
+  prom_rate_observe(r, w, 5);
+  prom_rate_observe(r, s, 10);
+  TEST_ASSERT_EQUAL_INT(0, prom_rate_update(r, 2.0));
+  TEST_ASSERT_EQUAL_UINT64((uint64_t)UINT32_MAX - 9 + 15, wraps->i_value);
+  TEST_ASSERT_EQUAL_UINT64(1010, resets->i_value);
+
+  // Raw values are truncated to the width of the counter
+  prom_rate_observe(r, s, (UINT64_C(1) << 32) + 20);
+  TEST_ASSERT_EQUAL_INT(0, prom_rate_update(r, 3.0));
+  TEST_ASSERT_EQUAL_UINT64(1020, resets->i_value);
+
+  prom_rate_destroy(r);
+  prom_counter_destroy(c);
+}
+
+void test_prom_rate_add(void) {
+  prom_counter_t *c = prom_counter_new("test_counter", "counter under test", 1, (const char *[]){"n"});
+  prom_gauge_t *g = prom_gauge_new("test_gauge", "gauge under test", 0, NULL);
+  prom_metric_sample_t *gauge = prom_gauge_child(g, NULL);
+  prom_rate_t *r = prom_rate_new();
+  size_t i = 0;
+
+  TEST_ASSERT_NOT_EQUAL(0, prom_rate_add(r, gauge, NULL, 64, &i));
+  TEST_ASSERT_NOT_EQUAL(0, prom_rate_add(r, prom_counter_child(c, (const char *[]){"0"}), gauge, 0, &i));
+  TEST_ASSERT_NOT_EQUAL(0, prom_rate_add(r, prom_counter_child(c, (const char *[]){"0"}), gauge, 65, &i));
+
+  // Enough series to grow the arrays a few times
+  char label[16];
+  for (size_t n = 0; n < 100; n++) {
+    snprintf(label, sizeof(label), "%zu", n);
+    prom_metric_sample_t *counter = prom_counter_child(c, (const char *[]){label});
+    TEST_ASSERT_EQUAL_INT(0, prom_rate_add(r, counter, NULL, 64, &i));
+    TEST_ASSERT_EQUAL_INT(n, i);
+    prom_rate_observe(r, i, n);
+  }
+  TEST_ASSERT_EQUAL_INT(0, prom_rate_update(r, 1.0));
+  TEST_ASSERT_EQUAL_DOUBLE(99.0, prom_counter_child(c, (const char *[]){"99"})->r_value);
+
+  prom_rate_destroy(r);
+  prom_gauge_destroy(g);
+  prom_counter_destroy(c);
+}
+
+int main(int argc, const char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_prom_rate_update);
+  RUN_TEST(test_prom_rate_wrap);
+  RUN_TEST(test_prom_rate_add);
+  return UNITY_END();
+}
@@ -0,0 +1,467 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "prom_test_helpers.h"
+
+#define TEST_RECEIVER_MAX_BODIES 64
+
+// A stand-in remote write receiver. It answers the first fail_remaining requests with 503 and every other request
+// with status, and keeps the bodies it accepted in order.
+typedef struct test_receiver {
+  int fd;
+  unsigned short port;
+  pthread_t thread;
+  _Atomic int status;
+  _Atomic int fail_remaining;
+  _Atomic int accepted;
+  _Atomic int snappy_headers;
+  pthread_mutex_t lock;
+  char *bodies[TEST_RECEIVER_MAX_BODIES];
+  size_t body_lens[TEST_RECEIVER_MAX_BODIES];
+  size_t body_count;
+} test_receiver_t;
+
+static test_receiver_t receiver;
+static prom_collector_registry_t *registry;
+static prom_counter_t *test_counter;
+
+static void *test_receiver_run(void *arg) {
+  (void)arg;
+  char buf[4096];
+  for (;;) {
+    int conn = accept(receiver.fd, NULL, NULL);
+    if (conn < 0) return NULL;
+
+    // Read the headers, then Content-Length bytes of body
+    size_t len = 0;
+    char *headers_end = NULL;
+    while (headers_end == NULL && len < sizeof(buf) - 1) {
+      ssize_t n = recv(conn, buf + len, sizeof(buf) - 1 - len, 0);
+      if (n <= 0) break;
+      len += n;
+      buf[len] = '\0';
+      headers_end = strstr(buf, "\r\n\r\n");
+    }
+    if (headers_end == NULL) {
+      close(conn);
+      continue;
+    }
+    size_t content_length = 0;
+    char *cl = strcasestr(buf, "Content-Length:");
+    if (cl != NULL) content_length = strtoul(cl + strlen("Content-Length:"), NULL, 10);
+    if (strcasestr(buf, "Content-Encoding: snappy") != NULL) receiver.snappy_headers++;
+
+    size_t header_len = headers_end + 4 - buf;
+    char *body = malloc(content_length + 1);
+    size_t have = len - header_len;
+    memcpy(body, headers_end + 4, have);
+    while (have < content_length) {
+      ssize_t n = recv(conn, body + have, content_length - have, 0);
+      if (n <= 0) break;
+      have += n;
+    }
+
+    int status = receiver.status;
+    if (atomic_fetch_sub(&receiver.fail_remaining, 1) > 0) {
+      status = 503;
+    } else {
+      receiver.fail_remaining = 0;
+    }
+    if (status >= 200 && status < 300 && have == content_length && receiver.body_count < TEST_RECEIVER_MAX_BODIES) {
+      pthread_mutex_lock(&receiver.lock);
+      receiver.bodies[receiver.body_count] = body;
+      receiver.body_lens[receiver.body_count] = content_length;
+      receiver.body_count++;
+      pthread_mutex_unlock(&receiver.lock);
+      receiver.accepted++;
+    } else {
+      free(body);
+    }
+
+    char response[128];
+    int n = snprintf(response, sizeof(response), "HTTP/1.1 %d Test\r\nContent-Length: 0\r\nConnection: close\r\n\r\n",
+                     status);
+    send(conn, response, n, MSG_NOSIGNAL);
+    close(conn);
+  }
+}
+
+static void test_receiver_start(int status) {
+  memset(&receiver, 0, sizeof(receiver));
+  receiver.status = status;
+  pthread_mutex_init(&receiver.lock, NULL);
+
+  receiver.fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  if (bind(receiver.fd, (struct sockaddr *)&addr, sizeof(addr))) TEST_FAIL_MESSAGE("bind failed");
+  if (listen(receiver.fd, 16)) TEST_FAIL_MESSAGE("listen failed");
+  socklen_t addr_len = sizeof(addr);
+  getsockname(receiver.fd, (struct sockaddr *)&addr, &addr_len);
+  receiver.port = ntohs(addr.sin_port);
+  pthread_create(&receiver.thread, NULL, &test_receiver_run, NULL);
+}
+
+static void test_receiver_stop(void) {
+  shutdown(receiver.fd, SHUT_RDWR);
+  close(receiver.fd);
+  pthread_join(receiver.thread, NULL);
+  for (size_t i = 0; i < receiver.body_count; i++) free(receiver.bodies[i]);
+  pthread_mutex_destroy(&receiver.lock);
+}
+
+static void test_registry_init(void) {
+  registry = prom_collector_registry_new("remote_write_test");
+  const char *keys[] = {"zone", "app"};
+  test_counter = prom_counter_new("test_counter", "counter under test", 2, keys);
+  prom_collector_t *collector = prom_collector_new("remote_write");
+  prom_collector_add_metric(collector, test_counter);
+  prom_collector_registry_register_collector(registry, collector);
+  const char *values[] = {"b", "a"};
+  prom_counter_add(test_counter, 3.0, values);
+}
+
+static void test_registry_destroy(void) {
+  prom_collector_registry_destroy(registry);
+  registry = NULL;
+}
+
+static prom_remote_write_t *test_remote_write_new(const char *wal_path) {
+  char url[64];
+  sprintf(url, "http://127.0.0.1:%d/api/v1/write", receiver.port);
+  prom_remote_write_config_t config;
+  memset(&config, 0, sizeof(config));
+  config.url = url;
+  config.wal_path = wal_path;
+  config.concurrency = 2;
+  config.max_retries = 1;
+  config.retry_backoff_ms = 10;
+  config.timeout_ms = 1000;
+  return prom_remote_write_new(&config);
+}
+
+void test_prom_snappy_round_trip(void) {
+  size_t len = 200000;
+  char *input = malloc(len);
+  for (size_t i = 0; i < len; i++) {
+    // Mostly repetitive with some noise so that both literals and copies are produced
+    input[i] = (i % 1000 < 900) ? "prometheus"[i % 10] : (char)(i * 2654435761u >> 24);
+  }
+
+  prom_string_builder_t *sb = prom_string_builder_new();
+  TEST_ASSERT_EQUAL_INT(0, prom_snappy_compress(sb, input, len));
+  TEST_ASSERT_TRUE(prom_string_builder_len(sb) < len / 4);
+
+  size_t out_len = 0;
+  char *output = prom_snappy_uncompress(prom_string_builder_str(sb), prom_string_builder_len(sb), &out_len);
+  TEST_ASSERT_NOT_NULL(output);
+  TEST_ASSERT_EQUAL_INT(len, out_len);
+  TEST_ASSERT_EQUAL_MEMORY(input, output, len);
+  prom_free(output);
+
+  // Input too short to contain a match is a single literal
+  prom_string_builder_truncate(sb, 0);
+  TEST_ASSERT_EQUAL_INT(0, prom_snappy_compress(sb, "abc", 3));
+  TEST_ASSERT_EQUAL_MEMORY("\x03\x08"
+                           "abc",
+                           prom_string_builder_str(sb), 5);
+
+  // Truncated input is rejected
+  TEST_ASSERT_NULL(prom_snappy_uncompress("\x03\x08"
+                                          "ab",
+                                          4, &out_len));
+
+  prom_string_builder_destroy(sb);
+  free(input);
+}
+
+void test_prom_remote_write_encode(void) {
+  test_registry_init();
+  prom_string_builder_t *sb = prom_string_builder_new();
+  TEST_ASSERT_EQUAL_INT(0, prom_remote_write_encode(&sb, 1, registry, 1000));
+
+  // Labels are sorted by name: __name__ < app < zone
+  const char *data = prom_string_builder_str(sb);
+  size_t len = prom_string_builder_len(sb);
+  const char *name = memmem(data, len, "__name__", 8);
+  const char *app = memmem(data, len, "app", 3);
+  const char *zone = memmem(data, len, "zone", 4);
+  TEST_ASSERT_NOT_NULL(name);
+  TEST_ASSERT_NOT_NULL(app);
+  TEST_ASSERT_NOT_NULL(zone);
+  TEST_ASSERT_TRUE(name < app);
+  TEST_ASSERT_TRUE(app < zone);
+  TEST_ASSERT_NOT_NULL(memmem(data, len, "test_counter", 12));
+
+  // Sample { value: 3.0, timestamp: 1000 }
+  const char sample[] = {0x12, 0x0c, 0x09, 0, 0, 0, 0, 0, 0, 0x08, 0x40, 0x10, (char)0xe8, 0x07};
+  TEST_ASSERT_NOT_NULL(memmem(data, len, sample, sizeof(sample)));
+
+  prom_string_builder_destroy(sb);
+  test_registry_destroy();
+}
+
+void test_prom_remote_write_push(void) {
+  test_receiver_start(204);
+  test_registry_init();
+
+  prom_remote_write_t *rw = test_remote_write_new(NULL);
+  TEST_ASSERT_NOT_NULL(rw);
+  for (int i = 0; i < 3; i++) {
+    TEST_ASSERT_EQUAL_INT(0, prom_remote_write_push(rw, registry));
+  }
+  TEST_ASSERT_EQUAL_INT(0, prom_remote_write_flush(rw, 5000));
+
+  prom_remote_write_stats_t stats;
+  prom_remote_write_stats(rw, &stats);
+  TEST_ASSERT_EQUAL_INT(3, stats.requests_sent);
+  TEST_ASSERT_EQUAL_INT(3, receiver.accepted);
+  TEST_ASSERT_EQUAL_INT(3, receiver.snappy_headers);
+
+  size_t len = 0;
+  char *request = prom_snappy_uncompress(receiver.bodies[2], receiver.body_lens[2], &len);
+  TEST_ASSERT_NOT_NULL(request);
+  TEST_ASSERT_NOT_NULL(memmem(request, len, "test_counter", 12));
+  prom_free(request);
+
+  prom_remote_write_destroy(rw);
+  test_registry_destroy();
+  test_receiver_stop();
+}
+
+void test_prom_remote_write_wal_replay(void) {
+  char wal_path[64];
+  char shard_wal_path[72];
+  sprintf(wal_path, "/tmp/prom_remote_write_test_%d.wal", (int)getpid());
+  sprintf(shard_wal_path, "%s.1", wal_path);
+  unlink(wal_path);
+  unlink(shard_wal_path);
+
+  test_receiver_start(503);
+  test_registry_init();
+
+  prom_remote_write_t *rw = test_remote_write_new(wal_path);
+  TEST_ASSERT_NOT_NULL(rw);
+  TEST_ASSERT_EQUAL_INT(0, prom_remote_write_push(rw, registry));
+  TEST_ASSERT_EQUAL_INT(0, prom_remote_write_push(rw, registry));
+
+  // The receiver is down, so both requests end up in the WAL
+  prom_remote_write_stats_t stats;
+  for (int i = 0; i < 200; i++) {
+    prom_remote_write_stats(rw, &stats);
+    if (stats.wal_pending_bytes > 0 && stats.requests_failed >= 4) break;
+    usleep(10000);
+  }
+  TEST_ASSERT_TRUE(stats.wal_pending_bytes > 0);
+  TEST_ASSERT_EQUAL_INT(0, stats.requests_sent);
+
+  // Once it recovers the WAL is replayed and truncated
+  receiver.status = 200;
+  TEST_ASSERT_EQUAL_INT(0, prom_remote_write_flush(rw, 10000));
+  prom_remote_write_stats(rw, &stats);
+  TEST_ASSERT_EQUAL_INT(2, stats.requests_sent);
+  TEST_ASSERT_EQUAL_INT(0, stats.wal_pending_bytes);
+  TEST_ASSERT_EQUAL_INT(2, receiver.accepted);
+
+  // Both requests hold the same series, so they went through one shard's WAL
+  struct stat st;
+  TEST_ASSERT_EQUAL_INT(0, stat(wal_path, &st));
+  TEST_ASSERT_EQUAL_INT(0, st.st_size);
+  TEST_ASSERT_EQUAL_INT(0, stat(shard_wal_path, &st));
+  TEST_ASSERT_EQUAL_INT(0, st.st_size);
+
+  prom_remote_write_destroy(rw);
+  test_registry_destroy();
+  test_receiver_stop();
+  unlink(wal_path);
+  unlink(shard_wal_path);
+}
+
+static uint64_t test_read_varint(const unsigned char **p) {
+  uint64_t value = 0;
+  for (int shift = 0;; shift += 7) {
+    unsigned char byte = *(*p)++;
+    value |= (uint64_t)(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) return value;
+  }
+}
+
+// Walks a WriteRequest and checks that every series' timestamp is newer than the one it had in the previous request
+static void test_check_order(const char *request, size_t len, char keys[][64], int64_t *last_ts, int *samples,
+                             size_t *key_count) {
+  const unsigned char *p = (const unsigned char *)request;
+  const unsigned char *end = p + len;
+  while (p < end) {
+    TEST_ASSERT_EQUAL_INT(0x0a, test_read_varint(&p));
+    size_t series_len = test_read_varint(&p);
+    const unsigned char *series_end = p + series_len;
+    char key[64] = "";
+    int64_t ts = 0;
+    while (p < series_end) {
+      uint64_t tag = test_read_varint(&p);
+      size_t field_len = test_read_varint(&p);
+      const unsigned char *field_end = p + field_len;
+      if (tag == 0x0a) {
+        // Label { string name = 1; string value = 2; }: the values name the series
+        while (p < field_end) {
+          uint64_t label_tag = test_read_varint(&p);
+          size_t str_len = test_read_varint(&p);
+          if (label_tag == 0x12) strncat(key, (const char *)p, str_len < 16 ? str_len : 16);
+          p += str_len;
+        }
+      } else {
+        // Sample { double value = 1; int64 timestamp = 2; }
+        TEST_ASSERT_EQUAL_INT(0x12, tag);
+        TEST_ASSERT_EQUAL_INT(0x09, *p);
+        p += 9;
+        TEST_ASSERT_EQUAL_INT(0x10, *p);
+        p++;
+        ts = (int64_t)test_read_varint(&p);
+      }
+      p = field_end;
+    }
+    size_t i = 0;
+    while (i < *key_count && strcmp(keys[i], key) != 0) i++;
+    if (i == *key_count) {
+      TEST_ASSERT_TRUE(*key_count < 16);
+      strcpy(keys[i], key);
+      last_ts[i] = 0;
+      samples[i] = 0;
+      (*key_count)++;
+    }
+    TEST_ASSERT_TRUE(ts > last_ts[i]);
+    last_ts[i] = ts;
+    samples[i]++;
+  }
+}
+
+void test_prom_remote_write_order(void) {
+  char wal_path[64];
+  char shard_wal_path[72];
+  sprintf(wal_path, "/tmp/prom_remote_write_order_%d.wal", (int)getpid());
+  sprintf(shard_wal_path, "%s.1", wal_path);
+  unlink(wal_path);
+  unlink(shard_wal_path);
+
+  // Four failures exhaust both attempts of at least one shard's first batch, which goes to the WAL while newer
+  // batches are pushed behind it
+  test_receiver_start(200);
+  receiver.fail_remaining = 4;
+  test_registry_init();
+  const char *zones[] = {"c", "d", "e", "f", "g", "h", "i"};
+  for (size_t i = 0; i < sizeof(zones) / sizeof(zones[0]); i++) {
+    const char *values[] = {zones[i], "a"};
+    prom_counter_inc(test_counter, values);
+  }
+
+  prom_remote_write_t *rw = test_remote_write_new(wal_path);
+  TEST_ASSERT_NOT_NULL(rw);
+  const int pushes = 10;
+  for (int i = 0; i < pushes; i++) {
+    TEST_ASSERT_EQUAL_INT(0, prom_remote_write_push(rw, registry));
+    usleep(5000);
+  }
+  TEST_ASSERT_EQUAL_INT(0, prom_remote_write_flush(rw, 10000));
+
+  prom_remote_write_stats_t stats;
+  prom_remote_write_stats(rw, &stats);
+  TEST_ASSERT_EQUAL_INT(4, stats.requests_failed);
+  TEST_ASSERT_EQUAL_INT(0, stats.requests_dropped);
+  TEST_ASSERT_EQUAL_INT(stats.requests_sent, receiver.accepted);
+
+  // Every series arrives once per push, oldest first
+  char keys[16][64];
+  int64_t last_ts[16];
+  int samples[16];
+  size_t key_count = 0;
+  for (size_t i = 0; i < receiver.body_count; i++) {
+    size_t len = 0;
+    char *request = prom_snappy_uncompress(receiver.bodies[i], receiver.body_lens[i], &len);
+    TEST_ASSERT_NOT_NULL(request);
+    test_check_order(request, len, keys, last_ts, samples, &key_count);
+    prom_free(request);
+  }
+  TEST_ASSERT_EQUAL_INT(8, key_count);
+  for (size_t i = 0; i < key_count; i++) TEST_ASSERT_EQUAL_INT(pushes, samples[i]);
+
+  prom_remote_write_destroy(rw);
+  test_registry_destroy();
+  test_receiver_stop();
+  unlink(wal_path);
+  unlink(shard_wal_path);
+}
+
+void test_prom_remote_write_wal_recovery(void) {
+  char wal_path[64];
+  sprintf(wal_path, "/tmp/prom_remote_write_test_%d.wal", (int)getpid());
+  unlink(wal_path);
+
+  prom_remote_write_wal_t *wal = prom_remote_write_wal_new(wal_path, 1024);
+  TEST_ASSERT_EQUAL_INT(0, prom_remote_write_wal_append(wal, "first", 5));
+  TEST_ASSERT_EQUAL_INT(0, prom_remote_write_wal_append(wal, "second", 6));
+  // Records that would exceed the size limit are rejected
+  char big[1024] = {0};
+  TEST_ASSERT_NOT_EQUAL(0, prom_remote_write_wal_append(wal, big, sizeof(big)));
+  prom_remote_write_wal_destroy(wal);
+
+  // Simulate a crash in the middle of an append
+  FILE *f = fopen(wal_path, "a");
+  fwrite("\x40\x00\x00\x00garbage", 1, 11, f);
+  fclose(f);
+
+  wal = prom_remote_write_wal_new(wal_path, 1024);
+  TEST_ASSERT_EQUAL_INT(8 + 5 + 8 + 6, prom_remote_write_wal_pending(wal));
+
+  char *data = NULL;
+  size_t len = 0;
+  TEST_ASSERT_EQUAL_INT(0, prom_remote_write_wal_peek(wal, &data, &len));
+  TEST_ASSERT_EQUAL_MEMORY("first", data, len);
+  prom_free(data);
+  TEST_ASSERT_EQUAL_INT(0, prom_remote_write_wal_advance(wal));
+  TEST_ASSERT_EQUAL_INT(0, prom_remote_write_wal_peek(wal, &data, &len));
+  TEST_ASSERT_EQUAL_MEMORY("second", data, len);
+  prom_free(data);
+  TEST_ASSERT_EQUAL_INT(0, prom_remote_write_wal_advance(wal));
+  TEST_ASSERT_EQUAL_INT(0, prom_remote_write_wal_pending(wal));
+  TEST_ASSERT_NOT_EQUAL(0, prom_remote_write_wal_peek(wal, &data, &len));
+
+  prom_remote_write_wal_destroy(wal);
+  unlink(wal_path);
+}
+
+int main(int argc, const char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_prom_snappy_round_trip);
+  RUN_TEST(test_prom_remote_write_encode);
+  RUN_TEST(test_prom_remote_write_push);
+  RUN_TEST(test_prom_remote_write_wal_replay);
+  RUN_TEST(test_prom_remote_write_order);
+  RUN_TEST(test_prom_remote_write_wal_recovery);
+  return UNITY_END();
+}
@@ -0,0 +1,177 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include "prom_test_helpers.h"
+
+static prom_collector_registry_t *registry;
+static prom_gauge_t *test_gauge;
+static prom_counter_t *test_counter;
+static char segment_name[64];
+
+static void test_registry_init(void) {
+  sprintf(segment_name, "/prom_shm_test_%d", (int)getpid());
+  registry = prom_collector_registry_new("shm_test");
+  const char *keys[] = {"core"};
+  test_gauge = prom_gauge_new("test_gauge", "gauge under test", 1, keys);
+  test_counter = prom_counter_new("test_counter", "counter under test", 0, NULL);
+  prom_collector_t *collector = prom_collector_new("shm");
+  prom_collector_add_metric(collector, test_gauge);
+  prom_collector_add_metric(collector, test_counter);
+  prom_collector_registry_register_collector(registry, collector);
+}
+
+static void test_registry_destroy(void) {
+  prom_collector_registry_destroy(registry);
+  registry = NULL;
+}
+
+// Finds the slot of a series by name in the descriptor table
+static const prom_shm_descriptor_t *test_find(prom_shm_reader_t *reader, size_t count, const char *name,
+                                              size_t *slot) {
+  for (size_t i = 0; i < count; i++) {
+    const prom_shm_descriptor_t *descriptor = prom_shm_reader_descriptor(reader, i);
+    if (strcmp(descriptor->name, name) == 0) {
+      *slot = i;
+      return descriptor;
+    }
+  }
+  return NULL;
+}
+
+void test_prom_shm_publish(void) {
+  test_registry_init();
+  const char *core0[] = {"0"};
+  const char *core1[] = {"1"};
+  prom_gauge_set(test_gauge, 12.5, core0);
+  prom_gauge_set(test_gauge, 40.0, core1);
+  prom_counter_add(test_counter, 7, NULL);
+
+  // Readers cannot attach before the segment exists
+  TEST_ASSERT_NULL(prom_shm_reader_open(segment_name));
+
+  prom_shm_publisher_t *publisher = prom_shm_publisher_new(segment_name, 2);
+  TEST_ASSERT_NOT_NULL(publisher);
+  TEST_ASSERT_EQUAL_INT(0, prom_shm_publisher_publish(publisher, registry));
+  TEST_ASSERT_EQUAL_INT(1, publisher->header->dropped);
+
+  prom_shm_reader_t *reader = prom_shm_reader_open(segment_name);
+  TEST_ASSERT_NOT_NULL(reader);
+  TEST_ASSERT_EQUAL_INT(2, prom_shm_reader_capacity(reader));
+  TEST_ASSERT_NULL(prom_shm_reader_descriptor(reader, 2));
+
+  double values[2];
+  size_t count = 0;
+  uint64_t timestamp_ms = 0;
+  TEST_ASSERT_EQUAL_INT(0, prom_shm_reader_snapshot(reader, values, &count, &timestamp_ms));
+  TEST_ASSERT_EQUAL_INT(2, count);
+  TEST_ASSERT_TRUE(timestamp_ms > 0);
+
+  // Only two of the three series fit
+  size_t slot = 0;
+  const prom_shm_descriptor_t *descriptor = test_find(reader, count, "test_gauge{core=\"0\"}", &slot);
+  TEST_ASSERT_NOT_NULL(descriptor);
+  TEST_ASSERT_EQUAL_INT(PROM_SHM_GAUGE, descriptor->type);
+  TEST_ASSERT_EQUAL_INT(strlen("test_gauge{core=\"0\"}"), descriptor->name_len);
+  TEST_ASSERT_EQUAL_DOUBLE(12.5, values[slot]);
+  TEST_ASSERT_NOT_NULL(test_find(reader, count, "test_gauge{core=\"1\"}", &slot));
+  TEST_ASSERT_EQUAL_DOUBLE(40.0, values[slot]);
+
+  // Values follow the registry and slots are stable
+  prom_gauge_set(test_gauge, 13.5, core0);
+  TEST_ASSERT_EQUAL_INT(0, prom_shm_publisher_publish(publisher, registry));
+  TEST_ASSERT_EQUAL_INT(0, prom_shm_reader_snapshot(reader, values, &count, NULL));
+  test_find(reader, count, "test_gauge{core=\"0\"}", &slot);
+  TEST_ASSERT_EQUAL_DOUBLE(13.5, values[slot]);
+
+  // A series that left the registry reads as NaN
+  test_registry_destroy();
+  test_registry_init();
+  prom_gauge_set(test_gauge, 1.0, core0);
+  TEST_ASSERT_EQUAL_INT(0, prom_shm_publisher_publish(publisher, registry));
+  TEST_ASSERT_EQUAL_INT(0, prom_shm_reader_snapshot(reader, values, &count, NULL));
+  test_find(reader, count, "test_gauge{core=\"1\"}", &slot);
+  TEST_ASSERT_TRUE(isnan(values[slot]));
+
+  prom_shm_reader_close(reader);
+  prom_shm_publisher_destroy(publisher);
+  TEST_ASSERT_NULL(prom_shm_reader_open(segment_name));
+  test_registry_destroy();
+}
+
+#define TEST_SERIES 64
+
+static _Atomic bool publishing;
+
+static void *test_publisher_run(void *arg) {
+  prom_shm_publisher_t *publisher = (prom_shm_publisher_t *)arg;
+  char cores[TEST_SERIES][8];
+  for (int i = 0; i < TEST_SERIES; i++) sprintf(cores[i], "%d", i);
+  for (int round = 1; round <= 2000; round++) {
+    for (int i = 0; i < TEST_SERIES; i++) {
+      const char *values[] = {cores[i]};
+      prom_gauge_set(test_gauge, round, values);
+    }
+    prom_shm_publisher_publish(publisher, registry);
+  }
+  publishing = false;
+  return NULL;
+}
+
+void test_prom_shm_snapshot_consistency(void) {
+  test_registry_init();
+  prom_shm_publisher_t *publisher = prom_shm_publisher_new(segment_name, TEST_SERIES + 1);
+  TEST_ASSERT_NOT_NULL(publisher);
+  prom_shm_reader_t *reader = prom_shm_reader_open(segment_name);
+  TEST_ASSERT_NOT_NULL(reader);
+
+  // Every publication writes one round number to all gauges, so a torn snapshot would mix rounds
+  publishing = true;
+  pthread_t thread;
+  pthread_create(&thread, NULL, &test_publisher_run, publisher);
+  double values[TEST_SERIES + 1];
+  size_t snapshots = 0;
+  while (publishing) {
+    size_t count = 0;
+    TEST_ASSERT_EQUAL_INT(0, prom_shm_reader_snapshot(reader, values, &count, NULL));
+    double round = NAN;
+    for (size_t i = 0; i < count; i++) {
+      if (prom_shm_reader_descriptor(reader, i)->type != PROM_SHM_GAUGE) continue;
+      if (isnan(round)) round = values[i];
+      TEST_ASSERT_EQUAL_DOUBLE(round, values[i]);
+    }
+    snapshots++;
+  }
+  pthread_join(thread, NULL);
+  TEST_ASSERT_TRUE(snapshots > 0);
+
+  prom_shm_reader_close(reader);
+  prom_shm_publisher_destroy(publisher);
+  test_registry_destroy();
+}
+
+int main(int argc, const char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_prom_shm_publish);
+  RUN_TEST(test_prom_shm_snapshot_consistency);
+  return UNITY_END();
+}
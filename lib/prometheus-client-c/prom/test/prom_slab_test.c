@@ -0,0 +1,167 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdint.h>
+
+#include "prom_test_helpers.h"
+
+void test_prom_slab_malloc_free(void) {
+  prom_slab_stats_t before, after;
+  prom_slab_stats(&before);
+
+  char *a = (char *)prom_slab_malloc(40);
+  TEST_ASSERT_NOT_NULL(a);
+  TEST_ASSERT_EQUAL_INT(0, (uintptr_t)a % 16);
+  memset(a, 'a', 40);
+  prom_slab_stats(&after);
+  TEST_ASSERT_EQUAL_UINT64(before.allocs + 1, after.allocs);
+  TEST_ASSERT_EQUAL_INT(before.used_bytes + 48, after.used_bytes);
+
+  // A freed block is the first to be handed out again
+  prom_slab_free(a);
+  char *b = (char *)prom_slab_malloc(33);
+  TEST_ASSERT_EQUAL_PTR(a, b);
+  prom_slab_free(b);
+
+  prom_slab_stats(&after);
+  TEST_ASSERT_EQUAL_UINT64(before.frees + 2, after.frees);
+  TEST_ASSERT_EQUAL_INT(before.used_bytes, after.used_bytes);
+  TEST_ASSERT_EQUAL_UINT64(before.libc_allocs, after.libc_allocs);
+  prom_slab_free(NULL);
+}
+
+void test_prom_slab_realloc(void) {
+  char *a = (char *)prom_slab_malloc(20);
+  strcpy(a, "label_value");
+
+  // Growing within the size class keeps the block
+  TEST_ASSERT_EQUAL_PTR(a, prom_slab_realloc(a, 32));
+
+  char *b = (char *)prom_slab_realloc(a, 100);
+  TEST_ASSERT_TRUE(a != b);
+  TEST_ASSERT_EQUAL_STRING("label_value", b);
+
+  // Past the largest size class the block moves to libc, and prom_slab_free still takes it back
+  prom_slab_stats_t before, after;
+  prom_slab_stats(&before);
+  char *c = (char *)prom_slab_realloc(b, 4 * PROM_SLAB_MAX_SIZE);
+  TEST_ASSERT_EQUAL_STRING("label_value", c);
+  prom_slab_stats(&after);
+  TEST_ASSERT_EQUAL_UINT64(before.libc_allocs + 1, after.libc_allocs);
+  TEST_ASSERT_EQUAL_UINT64(before.frees + 1, after.frees);
+  prom_slab_free(c);
+
+  char *d = (char *)prom_slab_realloc(NULL, 8);
+  TEST_ASSERT_NOT_NULL(d);
+  prom_slab_free(d);
+}
+
+void test_prom_slab_strdup(void) {
+  char *a = prom_slab_strdup("node_cpu_seconds_total");
+  TEST_ASSERT_EQUAL_STRING("node_cpu_seconds_total", a);
+  char *b = prom_slab_strndup("node_cpu_seconds_total", 8);
+  TEST_ASSERT_EQUAL_STRING("node_cpu", b);
+  prom_slab_free(a);
+  prom_slab_free(b);
+}
+
+void test_prom_slab_page_release(void) {
+  prom_slab_stats_t before, during, after;
+  prom_slab_stats(&before);
+
+  // Fill several pages of the largest size class, then free every block
+  size_t count = 4 * (PROM_SLAB_PAGE_SIZE / PROM_SLAB_MAX_SIZE);
+  void **blocks = (void **)malloc(sizeof(void *) * count);
+  for (size_t i = 0; i < count; i++) {
+    blocks[i] = prom_slab_malloc(PROM_SLAB_MAX_SIZE);
+    memset(blocks[i], 0xff, PROM_SLAB_MAX_SIZE);
+  }
+  prom_slab_stats(&during);
+  TEST_ASSERT_TRUE(during.page_bytes >= before.page_bytes + 4 * PROM_SLAB_PAGE_SIZE);
+  for (size_t i = 0; i < count; i++) prom_slab_free(blocks[i]);
+  free(blocks);
+
+  // Empty pages go back to the arena except for one that the size class keeps
+  prom_slab_stats(&after);
+  TEST_ASSERT_TRUE(after.page_bytes <= before.page_bytes + PROM_SLAB_PAGE_SIZE);
+  TEST_ASSERT_EQUAL_INT(before.used_bytes, after.used_bytes);
+}
+
+void test_prom_slab_intern(void) {
+  prom_slab_stats_t before, after;
+  prom_slab_stats(&before);
+
+  const char *a = prom_slab_intern("eth0");
+  char copy[] = "eth0";
+  const char *b = prom_slab_intern(copy);
+  const char *c = prom_slab_intern("eth1");
+  TEST_ASSERT_EQUAL_PTR(a, b);
+  TEST_ASSERT_TRUE(a != c);
+  TEST_ASSERT_EQUAL_STRING("eth0", a);
+  TEST_ASSERT_EQUAL_STRING("eth1", c);
+
+  prom_slab_stats(&after);
+  TEST_ASSERT_EQUAL_INT(before.interned_strings + 2, after.interned_strings);
+  TEST_ASSERT_EQUAL_UINT64(before.intern_hits + 1, after.intern_hits);
+
+  // The copy outlives every release but the last
+  prom_slab_intern_release(a);
+  TEST_ASSERT_EQUAL_STRING("eth0", b);
+  prom_slab_intern_release(b);
+  prom_slab_intern_release(c);
+  prom_slab_intern_release(NULL);
+  prom_slab_stats(&after);
+  TEST_ASSERT_EQUAL_INT(before.interned_strings, after.interned_strings);
+
+  // Strings too long for a size class are interned all the same
+  char *long_value = (char *)malloc(2 * PROM_SLAB_MAX_SIZE + 1);
+  memset(long_value, 'x', 2 * PROM_SLAB_MAX_SIZE);
+  long_value[2 * PROM_SLAB_MAX_SIZE] = '\0';
+  const char *d = prom_slab_intern(long_value);
+  TEST_ASSERT_EQUAL_PTR(d, prom_slab_intern(long_value));
+  TEST_ASSERT_EQUAL_STRING(long_value, d);
+  prom_slab_intern_release(d);
+  prom_slab_intern_release(d);
+  free(long_value);
+}
+
+void test_prom_slab_intern_many(void) {
+  // Enough distinct strings to grow the intern table several times
+  const char *interned[1000];
+  char buf[32];
+  for (int i = 0; i < 1000; i++) {
+    snprintf(buf, sizeof(buf), "veth%d", i);
+    interned[i] = prom_slab_intern(buf);
+  }
+  for (int i = 0; i < 1000; i++) {
+    snprintf(buf, sizeof(buf), "veth%d", i);
+    TEST_ASSERT_EQUAL_PTR(interned[i], prom_slab_intern(buf));
+    prom_slab_intern_release(interned[i]);
+    prom_slab_intern_release(interned[i]);
+  }
+}
+
+int main(int argc, const char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_prom_slab_malloc_free);
+  RUN_TEST(test_prom_slab_realloc);
+  RUN_TEST(test_prom_slab_strdup);
+  RUN_TEST(test_prom_slab_page_release);
+  RUN_TEST(test_prom_slab_intern);
+  RUN_TEST(test_prom_slab_intern_many);
+  return UNITY_END();
+}
@@ -0,0 +1,154 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdatomic.h>
+
+#include "prom_test_helpers.h"
+
+// Count the calls into libc's allocator by interposing it. free is left alone since it does not allocate.
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static _Atomic size_t prom_steady_state_allocations;
+
+void *malloc(size_t size) {
+  atomic_fetch_add_explicit(&prom_steady_state_allocations, 1, memory_order_relaxed);
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+  atomic_fetch_add_explicit(&prom_steady_state_allocations, 1, memory_order_relaxed);
+  return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+  atomic_fetch_add_explicit(&prom_steady_state_allocations, 1, memory_order_relaxed);
+  return __libc_realloc(ptr, size);
+}
+
+#define PROM_STEADY_STATE_WARMUP_CYCLES 3
+#define PROM_STEADY_STATE_CYCLES 100
+
+static prom_collector_registry_t *registry;
+static prom_counter_t *counter;
+static prom_counter_t *counter_u64;
+static prom_gauge_t *gauge;
+static prom_gauge_t *gauge_i64;
+static prom_histogram_t *histogram;
+static prom_summary_t *summary;
+static prom_native_histogram_t *native_histogram;
+
+static char *buffers[PROM_EXPOSITION_FORMAT_COUNT];
+static size_t caps[PROM_EXPOSITION_FORMAT_COUNT];
+
+static void prom_steady_state_test_init(void) {
+  const char *keys[] = {"device"};
+  const double quantiles[] = {0.5, 0.9, 0.99};
+
+  registry = prom_collector_registry_new("steady_state");
+  prom_collector_t *collector = prom_collector_new("steady_state");
+  counter = prom_counter_new("steady_requests_total", "requests served", 1, keys);
+  counter_u64 = prom_counter_u64_new("steady_bytes_total", "bytes served", 1, keys);
+  gauge = prom_gauge_new("steady_usage", "usage ratio", 1, keys);
+  gauge_i64 = prom_gauge_i64_new("steady_running", "running tasks", 0, NULL);
+  histogram = prom_histogram_new("steady_latency_seconds", "request latency",
+                                 prom_histogram_buckets_exponential(0.001, 2.0, 12), 1, keys);
+  summary = prom_summary_new("steady_size_bytes", "request size", 3, quantiles, 600.0, 0, NULL);
+  native_histogram = prom_native_histogram_new("steady_native_seconds", "request latency", 3, 0, 0, NULL);
+  prom_collector_add_metric(collector, counter);
+  prom_collector_add_metric(collector, counter_u64);
+  prom_collector_add_metric(collector, gauge);
+  prom_collector_add_metric(collector, gauge_i64);
+  prom_collector_add_metric(collector, histogram);
+  prom_collector_add_metric(collector, summary);
+  prom_collector_add_metric(collector, native_histogram);
+  prom_collector_registry_register_collector(registry, collector);
+
+  // The process collector reads this process's own /proc files
+  prom_collector_registry_register_collector(registry, prom_collector_process_new(NULL, NULL));
+
+  for (int i = 0; i < PROM_EXPOSITION_FORMAT_COUNT; i++) {
+    buffers[i] = NULL;
+    caps[i] = 0;
+  }
+}
+
+static void prom_steady_state_test_destroy(void) {
+  for (int i = 0; i < PROM_EXPOSITION_FORMAT_COUNT; i++) prom_free(buffers[i]);
+  prom_collector_registry_destroy(registry);
+  registry = NULL;
+}
+
+// One collection cycle followed by a scrape in every exposition format
+static void prom_steady_state_cycle(int cycle, bool advance_generation) {
+  const char *devices[][1] = {{"sda"}, {"sdb"}, {"nvme0n1"}};
+  for (int d = 0; d < 3; d++) {
+    TEST_ASSERT_EQUAL_INT(0, prom_counter_inc(counter, devices[d]));
+    TEST_ASSERT_EQUAL_INT(0, prom_counter_add_u64(counter_u64, 4096, devices[d]));
+    TEST_ASSERT_EQUAL_INT(0, prom_gauge_set(gauge, cycle * 0.01 + d, devices[d]));
+    TEST_ASSERT_EQUAL_INT(0, prom_histogram_observe(histogram, 0.001 * (cycle % 50 + d), devices[d]));
+  }
+  TEST_ASSERT_EQUAL_INT(0, prom_gauge_set_i64(gauge_i64, cycle % 7, NULL));
+  TEST_ASSERT_EQUAL_INT(0, prom_summary_observe(summary, 100.0 + cycle, NULL));
+  TEST_ASSERT_EQUAL_INT(0, prom_native_histogram_observe(native_histogram, 0.001 * (cycle % 50 + 1), NULL));
+  if (advance_generation) TEST_ASSERT_EQUAL_INT(0, prom_collector_registry_advance_generation(registry));
+  // Read the limits on every scrape rather than once per interval
+  prom_collector_process_refresh_limits();
+
+  for (int f = 0; f < PROM_EXPOSITION_FORMAT_COUNT; f++) {
+    size_t len = 0;
+    TEST_ASSERT_EQUAL_INT(0, prom_collector_registry_render(registry, f, &buffers[f], &caps[f], &len));
+    TEST_ASSERT_TRUE(len > 0);
+    TEST_ASSERT_TRUE(len < caps[f]);
+  }
+}
+
+static void prom_steady_state_run(bool advance_generation) {
+  prom_steady_state_test_init();
+  for (int i = 0; i < PROM_STEADY_STATE_WARMUP_CYCLES; i++) prom_steady_state_cycle(i, advance_generation);
+
+#ifdef PROM_SLAB
+  prom_slab_stats_t before;
+  prom_slab_stats(&before);
+#endif
+  atomic_store(&prom_steady_state_allocations, 0);
+  for (int i = PROM_STEADY_STATE_WARMUP_CYCLES; i < PROM_STEADY_STATE_CYCLES; i++) {
+    prom_steady_state_cycle(i, advance_generation);
+  }
+  TEST_ASSERT_EQUAL_UINT64(0, atomic_load(&prom_steady_state_allocations));
+#ifdef PROM_SLAB
+  prom_slab_stats_t after;
+  prom_slab_stats(&after);
+  TEST_ASSERT_EQUAL_UINT64(before.allocs, after.allocs);
+#endif
+
+  TEST_ASSERT_NOT_NULL(strstr(buffers[PROM_EXPOSITION_TEXT], "steady_requests_total{device=\"nvme0n1\"} 100"));
+  TEST_ASSERT_NOT_NULL(strstr(buffers[PROM_EXPOSITION_OPENMETRICS], "# TYPE steady_requests counter"));
+  TEST_ASSERT_NOT_NULL(strstr(buffers[PROM_EXPOSITION_TEXT], "process_open_fds "));
+  prom_steady_state_test_destroy();
+}
+
+void test_prom_steady_state_render(void) { prom_steady_state_run(false); }
+
+void test_prom_steady_state_render_generations(void) { prom_steady_state_run(true); }
+
+int main(int argc, const char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_prom_steady_state_render);
+  RUN_TEST(test_prom_steady_state_render_generations);
+  return UNITY_END();
+}
@@ -49,15 +49,92 @@ void test_prom_string_builder_dump(void) {
   TEST_ASSERT_EQUAL_STRING(original, result);
 
   prom_string_builder_destroy(sb);
-  free((char *)result);
+  prom_free((char *)result);
   result = NULL;
   sb = NULL;
 }
 
+void test_prom_string_builder_add_numbers(void) {
+  prom_string_builder_t *sb = prom_string_builder_new();
+  prom_string_builder_add_u64(sb, 0);
+  prom_string_builder_add_char(sb, ' ');
+  prom_string_builder_add_u64(sb, UINT64_MAX);
+  prom_string_builder_add_char(sb, ' ');
+  prom_string_builder_add_double(sb, 0.1);
+  prom_string_builder_add_char(sb, ' ');
+  prom_string_builder_add_double(sb, -1.7976931348623157e308);
+  TEST_ASSERT_EQUAL_STRING("0 18446744073709551615 0.10000000000000001 -1.7976931348623157e+308",
+                           prom_string_builder_str(sb));
+  TEST_ASSERT_EQUAL_INT(strlen(prom_string_builder_str(sb)), prom_string_builder_len(sb));
+
+  prom_string_builder_destroy(sb);
+  sb = NULL;
+}
+
+void test_prom_string_builder_format_double(void) {
+  // The integer fast path must print exactly what "%.17g" prints
+  const double values[] = {0.0,   -0.0,   1.0,     -1.0,    42.0,   1e15,    9007199254740992.0, -9007199254740992.0,
+                           1e17,  1e300,  0.5,     -2.25,   1e-300, 123.456, 18446744073709551616.0};
+  for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+    char expected[PROM_STRING_BUILDER_DOUBLE_SIZE];
+    char actual[PROM_STRING_BUILDER_DOUBLE_SIZE];
+    int len = snprintf(expected, sizeof(expected), "%.17g", values[i]);
+    TEST_ASSERT_EQUAL_INT(len, prom_string_builder_format_double(actual, values[i]));
+    TEST_ASSERT_EQUAL_STRING(expected, actual);
+  }
+}
+
+void test_prom_string_builder_view(void) {
+  prom_string_builder_t *sb = prom_string_builder_new();
+  prom_string_builder_add_str(sb, "foo bar");
+  size_t len = 0;
+  const char *view = prom_string_builder_view(sb, &len);
+  TEST_ASSERT_EQUAL_PTR(prom_string_builder_str(sb), view);
+  TEST_ASSERT_EQUAL_INT(7, len);
+  TEST_ASSERT_EQUAL_STRING("foo bar", view);
+
+  prom_string_builder_destroy(sb);
+  sb = NULL;
+}
+
+void test_prom_string_builder_clear(void) {
+  prom_string_builder_t *sb = prom_string_builder_new();
+  char line[1024];
+  memset(line, 'x', sizeof(line) - 1);
+  line[sizeof(line) - 1] = '\0';
+
+  // Clearing keeps the allocation, so refilling to the same length does not move the string
+  prom_string_builder_add_str(sb, line);
+  const char *str = prom_string_builder_str(sb);
+  for (int i = 0; i < 8; i++) {
+    prom_string_builder_clear(sb);
+    TEST_ASSERT_EQUAL_INT(0, prom_string_builder_len(sb));
+    TEST_ASSERT_EQUAL_STRING("", prom_string_builder_str(sb));
+    prom_string_builder_add_str(sb, line);
+    TEST_ASSERT_EQUAL_PTR(str, prom_string_builder_str(sb));
+  }
+
+  // Once the strings stay short, the allocation is trimmed and the builder keeps working
+  for (int i = 0; i < 64; i++) {
+    prom_string_builder_clear(sb);
+    prom_string_builder_add_str(sb, "foo");
+    TEST_ASSERT_EQUAL_STRING("foo", prom_string_builder_str(sb));
+  }
+  prom_string_builder_add_str(sb, line);
+  TEST_ASSERT_EQUAL_INT(3 + strlen(line), prom_string_builder_len(sb));
+
+  prom_string_builder_destroy(sb);
+  sb = NULL;
+}
+
 int main(int argc, const char **argv) {
   UNITY_BEGIN();
   RUN_TEST(test_prom_string_builder_add_str);
   RUN_TEST(test_prom_string_builder_add_char);
+  RUN_TEST(test_prom_string_builder_add_numbers);
+  RUN_TEST(test_prom_string_builder_format_double);
+  RUN_TEST(test_prom_string_builder_view);
+  RUN_TEST(test_prom_string_builder_clear);
   RUN_TEST(test_prom_string_builder_dump);
   return UNITY_END();
 }
@@ -0,0 +1,175 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <math.h>
+#include <time.h>
+
+#include "prom_test_helpers.h"
+
+static char *render_metric(prom_metric_t *metric, prom_exposition_format_t format) {
+  prom_metric_formatter_t *mf = prom_metric_formatter_new();
+  prom_epoch_enter();
+  int r = format == PROM_EXPOSITION_OPENMETRICS ? prom_metric_formatter_load_metric_openmetrics(mf, metric)
+                                                : prom_metric_formatter_load_metric(mf, metric);
+  prom_epoch_exit();
+  TEST_ASSERT_EQUAL_INT(0, r);
+  char *result = prom_metric_formatter_dump(mf);
+  prom_metric_formatter_destroy(mf);
+  return result;
+}
+
+void test_prom_summary(void) {
+  prom_summary_t *s = prom_summary_new("test_summary", "summary under test", 0, NULL, 0, 0, NULL);
+  TEST_ASSERT(s);
+  TEST_ASSERT_EQUAL_INT(3, s->quantile_count);
+  TEST_ASSERT_EQUAL_DOUBLE(600.0, s->max_age);
+
+  for (int i = 1; i <= 100; i++) TEST_ASSERT_EQUAL_INT(0, prom_summary_observe(s, (double)i, NULL));
+  TEST_ASSERT_EQUAL_INT(1, prom_summary_observe(s, NAN, NULL));
+
+  prom_metric_sample_summary_t *sample = prom_summary_child(s, NULL);
+  TEST_ASSERT(sample);
+  double values[PROM_SUMMARY_MAX_QUANTILES];
+  uint64_t count = 0;
+  double sum = 0.0;
+  TEST_ASSERT_EQUAL_INT(0, prom_metric_sample_summary_snapshot(sample, values, &count, &sum));
+  TEST_ASSERT_EQUAL_UINT64(100, count);
+  TEST_ASSERT_EQUAL_DOUBLE(5050.0, sum);
+  TEST_ASSERT_DOUBLE_WITHIN(1.0, 50.0, values[0]);
+  TEST_ASSERT_DOUBLE_WITHIN(1.0, 90.0, values[1]);
+  TEST_ASSERT_DOUBLE_WITHIN(1.0, 99.0, values[2]);
+
+  TEST_ASSERT_EQUAL_STRING("test_summary{quantile=\"0.5\"}", sample->l_values[0]);
+  TEST_ASSERT_EQUAL_STRING("test_summary{quantile=\"0.99\"}", sample->l_values[2]);
+  TEST_ASSERT_EQUAL_STRING("test_summary_sum", sample->l_values[3 + PROM_METRIC_SAMPLE_SUMMARY_SUM]);
+  TEST_ASSERT_EQUAL_STRING("test_summary_count", sample->l_values[3 + PROM_METRIC_SAMPLE_SUMMARY_COUNT]);
+
+  char *text = render_metric(s, PROM_EXPOSITION_TEXT);
+  TEST_ASSERT_NOT_NULL(strstr(text, "# TYPE test_summary summary\n"));
+  TEST_ASSERT_NOT_NULL(strstr(text, "test_summary{quantile=\"0.9\"} "));
+  TEST_ASSERT_NOT_NULL(strstr(text, "test_summary_sum 5050\n"));
+  TEST_ASSERT_NOT_NULL(strstr(text, "test_summary_count 100\n"));
+  prom_free(text);
+
+  char *openmetrics = render_metric(s, PROM_EXPOSITION_OPENMETRICS);
+  TEST_ASSERT_NOT_NULL(strstr(openmetrics, "# TYPE test_summary summary\n"));
+  TEST_ASSERT_NOT_NULL(strstr(openmetrics, "test_summary{quantile=\"0.5\"} "));
+  TEST_ASSERT_NOT_NULL(strstr(openmetrics, "test_summary_count 100\n"));
+  TEST_ASSERT_NOT_NULL(strstr(openmetrics, "test_summary_created "));
+  prom_free(openmetrics);
+
+  prom_summary_destroy(s);
+  s = NULL;
+}
+
+void test_prom_summary_labels(void) {
+  prom_summary_t *s = prom_summary_new("test_summary", "summary under test", 2, (const double[]){0.25, 0.75}, 60, 1,
+                                       (const char *[]){"path"});
+  TEST_ASSERT(s);
+
+  prom_metric_sample_summary_t *a = prom_summary_child(s, (const char *[]){"/a"});
+  prom_metric_sample_summary_t *b = prom_summary_child(s, (const char *[]){"/b"});
+  TEST_ASSERT(a && b && a != b);
+  TEST_ASSERT_EQUAL_PTR(a, prom_summary_child(s, (const char *[]){"/a"}));
+  TEST_ASSERT_EQUAL_STRING("test_summary{path=\"/a\",quantile=\"0.25\"}", a->l_values[0]);
+
+  for (int i = 1; i <= 4; i++) prom_metric_sample_summary_observe(a, (double)i);
+  TEST_ASSERT_EQUAL_INT(0, prom_summary_observe(s, 7.0, (const char *[]){"/b"}));
+
+  double values[PROM_SUMMARY_MAX_QUANTILES];
+  uint64_t count = 0;
+  double sum = 0.0;
+  prom_metric_sample_summary_snapshot(b, values, &count, &sum);
+  TEST_ASSERT_EQUAL_UINT64(1, count);
+  TEST_ASSERT_EQUAL_DOUBLE(7.0, values[0]);
+  TEST_ASSERT_EQUAL_DOUBLE(7.0, values[1]);
+
+  prom_summary_destroy(s);
+  s = NULL;
+}
+
+void test_prom_summary_window(void) {
+  prom_summary_t *s = prom_summary_new("test_summary", "summary under test", 1, (const double[]){0.5}, 0.25, 0, NULL);
+  TEST_ASSERT(s);
+  prom_metric_sample_summary_t *sample = prom_summary_child(s, NULL);
+  prom_metric_sample_summary_observe(sample, 1.0);
+
+  double values[PROM_SUMMARY_MAX_QUANTILES];
+  uint64_t count = 0;
+  double sum = 0.0;
+  prom_metric_sample_summary_snapshot(sample, values, &count, &sum);
+  TEST_ASSERT_EQUAL_DOUBLE(1.0, values[0]);
+
+  // Once the window has slid past the observation the quantile is unknown, while count and sum keep it
+  nanosleep(&(struct timespec){.tv_sec = 0, .tv_nsec = 350 * 1000 * 1000}, NULL);
+  prom_metric_sample_summary_snapshot(sample, values, &count, &sum);
+  TEST_ASSERT_TRUE(isnan(values[0]));
+  TEST_ASSERT_EQUAL_UINT64(1, count);
+  TEST_ASSERT_EQUAL_DOUBLE(1.0, sum);
+
+  prom_metric_sample_summary_observe(sample, 5.0);
+  prom_metric_sample_summary_snapshot(sample, values, &count, &sum);
+  TEST_ASSERT_EQUAL_DOUBLE(5.0, values[0]);
+
+  prom_summary_destroy(s);
+  s = NULL;
+}
+
+void test_prom_summary_protobuf(void) {
+  prom_summary_t *s = prom_summary_new("s", "h", 1, (const double[]){0.5}, 0, 0, NULL);
+  prom_summary_observe(s, 2.0, NULL);
+
+  prom_metric_formatter_t *mf = prom_metric_formatter_new();
+  prom_epoch_enter();
+  TEST_ASSERT_EQUAL_INT(0, prom_metric_formatter_load_metric_protobuf(mf, s));
+  prom_epoch_exit();
+  unsigned char *result = (unsigned char *)prom_metric_formatter_dump(mf);
+
+  // MetricFamily{name: "s", help: "h", type: SUMMARY, metric: [Metric{summary: Summary{...}}]}
+  const unsigned char family[] = {0x0a, 0x01, 's', 0x12, 0x01, 'h', 0x18, 0x02, 0x22};
+  TEST_ASSERT_EQUAL_MEMORY(family, result + 1, sizeof(family));
+  TEST_ASSERT_EQUAL_INT(0x22, result[11]);
+
+  // Summary{sample_count: 1, sample_sum: 2.0, quantile: [Quantile{quantile: 0.5, value: 2.0}], created_timestamp}
+  const unsigned char summary[] = {0x08, 0x01, 0x11, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x1a, 0x12,
+                                   0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xe0, 0x3f, 0x11, 0x00, 0x00, 0x00,
+                                   0x00, 0x00, 0x00, 0x00, 0x40, 0x22};
+  TEST_ASSERT_EQUAL_MEMORY(summary, result + 13, sizeof(summary));
+
+  prom_free(result);
+  prom_metric_formatter_destroy(mf);
+  prom_summary_destroy(s);
+  s = NULL;
+}
+
+void test_prom_summary_invalid_quantiles(void) {
+  TEST_ASSERT_NULL(prom_summary_new("test_summary", "summary under test", 2, (const double[]){0.9, 0.5}, 0, 0, NULL));
+  TEST_ASSERT_NULL(prom_summary_new("test_summary", "summary under test", 1, (const double[]){1.5}, 0, 0, NULL));
+  TEST_ASSERT_NULL(prom_summary_new("test_summary", "summary under test", 1, (const double[]){NAN}, 0, 0, NULL));
+  TEST_ASSERT_NULL(prom_summary_new("test_summary", "summary under test", PROM_SUMMARY_MAX_QUANTILES + 1,
+                                    (const double[PROM_SUMMARY_MAX_QUANTILES + 1]){0}, 0, 0, NULL));
+}
+
+int main(int argc, const char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_prom_summary);
+  RUN_TEST(test_prom_summary_labels);
+  RUN_TEST(test_prom_summary_window);
+  RUN_TEST(test_prom_summary_protobuf);
+  RUN_TEST(test_prom_summary_invalid_quantiles);
+  return UNITY_END();
+}
@@ -0,0 +1,106 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <math.h>
+
+#include "prom_test_helpers.h"
+
+// Returns the values 1..count in a fixed pseudo-random order
+static double *shuffled_values(size_t count) {
+  double *values = (double *)prom_malloc(sizeof(double) * count);
+  for (size_t i = 0; i < count; i++) values[i] = (double)(i + 1);
+  uint64_t state = 42;
+  for (size_t i = count - 1; i > 0; i--) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    size_t j = (size_t)((state >> 33) % (i + 1));
+    double tmp = values[i];
+    values[i] = values[j];
+    values[j] = tmp;
+  }
+  return values;
+}
+
+void test_prom_tdigest_empty(void) {
+  prom_tdigest_t td;
+  prom_tdigest_reset(&td);
+  TEST_ASSERT_EQUAL_DOUBLE(0.0, prom_tdigest_weight(&td));
+  TEST_ASSERT_TRUE(isnan(prom_tdigest_quantile(&td, 0.5)));
+
+  // NaN is rejected and leaves the digest empty
+  TEST_ASSERT_EQUAL_INT(1, prom_tdigest_add(&td, NAN, 1.0));
+  TEST_ASSERT_TRUE(isnan(prom_tdigest_quantile(&td, 0.5)));
+
+  TEST_ASSERT_EQUAL_INT(0, prom_tdigest_add(&td, 3.0, 1.0));
+  TEST_ASSERT_EQUAL_DOUBLE(3.0, prom_tdigest_quantile(&td, 0.0));
+  TEST_ASSERT_EQUAL_DOUBLE(3.0, prom_tdigest_quantile(&td, 0.5));
+  TEST_ASSERT_EQUAL_DOUBLE(3.0, prom_tdigest_quantile(&td, 1.0));
+}
+
+void test_prom_tdigest_quantiles(void) {
+  size_t count = 100000;
+  double *values = shuffled_values(count);
+  prom_tdigest_t td;
+  prom_tdigest_reset(&td);
+  for (size_t i = 0; i < count; i++) TEST_ASSERT_EQUAL_INT(0, prom_tdigest_add(&td, values[i], 1.0));
+  prom_free(values);
+
+  TEST_ASSERT_EQUAL_DOUBLE((double)count, prom_tdigest_weight(&td));
+  TEST_ASSERT_EQUAL_DOUBLE(1.0, prom_tdigest_quantile(&td, 0.0));
+  TEST_ASSERT_EQUAL_DOUBLE((double)count, prom_tdigest_quantile(&td, 1.0));
+
+  // The values are uniform, so a quantile q should land within a small rank error of q * count
+  const double quantiles[] = {0.01, 0.1, 0.5, 0.9, 0.99, 0.999};
+  for (size_t i = 0; i < sizeof(quantiles) / sizeof(quantiles[0]); i++) {
+    double expected = quantiles[i] * (double)count;
+    TEST_ASSERT_DOUBLE_WITHIN(0.005 * (double)count, expected, prom_tdigest_quantile(&td, quantiles[i]));
+  }
+
+  // Compression keeps the storage bounded
+  prom_tdigest_compress(&td);
+  TEST_ASSERT_TRUE(td.count <= PROM_TDIGEST_CAPACITY);
+}
+
+void test_prom_tdigest_merge(void) {
+  size_t count = 20000;
+  double *values = shuffled_values(count);
+  prom_tdigest_t a;
+  prom_tdigest_t b;
+  prom_tdigest_t merged;
+  prom_tdigest_reset(&a);
+  prom_tdigest_reset(&b);
+  prom_tdigest_reset(&merged);
+  for (size_t i = 0; i < count; i++) prom_tdigest_add(i % 2 ? &a : &b, values[i], 1.0);
+  prom_free(values);
+
+  prom_tdigest_merge(&merged, &a);
+  prom_tdigest_merge(&merged, &b);
+  TEST_ASSERT_EQUAL_DOUBLE((double)count, prom_tdigest_weight(&merged));
+  TEST_ASSERT_DOUBLE_WITHIN(0.005 * (double)count, 0.5 * (double)count, prom_tdigest_quantile(&merged, 0.5));
+  TEST_ASSERT_DOUBLE_WITHIN(0.005 * (double)count, 0.9 * (double)count, prom_tdigest_quantile(&merged, 0.9));
+
+  // The sources are left untouched
+  TEST_ASSERT_EQUAL_DOUBLE((double)count / 2, prom_tdigest_weight(&a));
+  TEST_ASSERT_EQUAL_DOUBLE((double)count / 2, prom_tdigest_weight(&b));
+}
+
+int main(int argc, const char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_prom_tdigest_empty);
+  RUN_TEST(test_prom_tdigest_quantiles);
+  RUN_TEST(test_prom_tdigest_merge);
+  return UNITY_END();
+}
@@ -4,8 +4,15 @@
 #include <string.h>
 
 #include "prom.h"
+#include "prom_collector_registry_i.h"
 #include "prom_collector_registry_t.h"
 #include "prom_collector_t.h"
+#include "prom_epoch_i.h"
+#include "prom_epoch_t.h"
+#include "prom_group_i.h"
+#include "prom_group_t.h"
+#include "prom_history_i.h"
+#include "prom_history_t.h"
 #include "prom_linked_list_i.h"
 #include "prom_linked_list_t.h"
 #include "prom_map_i.h"
@@ -16,6 +23,10 @@
 #include "prom_metric_sample_histogram_i.h"
 #include "prom_metric_sample_histogram_t.h"
 #include "prom_metric_sample_i.h"
+#include "prom_metric_sample_native_histogram_i.h"
+#include "prom_metric_sample_native_histogram_t.h"
+#include "prom_metric_sample_summary_i.h"
+#include "prom_metric_sample_summary_t.h"
 #include "prom_metric_sample_t.h"
 #include "prom_metric_t.h"
 #include "prom_process_fds_i.h"
@@ -26,6 +37,21 @@
 #include "prom_process_stat_t.h"
 #include "prom_procfs_i.h"
 #include "prom_procfs_t.h"
+#include "prom_protobuf_i.h"
+#include "prom_rate_i.h"
+#include "prom_rate_t.h"
+#include "prom_remote_write_i.h"
+#include "prom_remote_write_t.h"
+#include "prom_remote_write_wal_i.h"
+#include "prom_remote_write_wal_t.h"
+#include "prom_shm_i.h"
+#include "prom_shm_t.h"
+#include "prom_slab_t.h"
+#include "prom_snappy_i.h"
 #include "prom_string_builder_i.h"
 #include "prom_string_builder_t.h"
+#include "prom_tdigest_i.h"
+#include "prom_tdigest_t.h"
+#include "prom_udp_exporter_i.h"
+#include "prom_udp_exporter_t.h"
 #include "unity.h"
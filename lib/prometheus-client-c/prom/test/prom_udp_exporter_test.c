@@ -0,0 +1,200 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <arpa/inet.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "prom_test_helpers.h"
+
+static int listener = -1;
+static unsigned short listener_port;
+static prom_collector_registry_t *registry;
+static prom_gauge_t *test_gauge;
+
+static void test_listener_start(void) {
+  listener = socket(AF_INET, SOCK_DGRAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  if (bind(listener, (struct sockaddr *)&addr, sizeof(addr))) TEST_FAIL_MESSAGE("bind failed");
+  socklen_t addr_len = sizeof(addr);
+  getsockname(listener, (struct sockaddr *)&addr, &addr_len);
+  listener_port = ntohs(addr.sin_port);
+
+  struct timeval timeout = {.tv_sec = 0, .tv_usec = 200000};
+  setsockopt(listener, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+}
+
+static void test_listener_stop(void) {
+  close(listener);
+  listener = -1;
+}
+
+// Receives one datagram into buf as a C string. Returns its length or -1 when nothing arrived.
+static ssize_t test_listener_recv(char *buf, size_t size) {
+  ssize_t n = recv(listener, buf, size - 1, 0);
+  if (n >= 0) buf[n] = '\0';
+  return n;
+}
+
+static void test_registry_init(void) {
+  registry = prom_collector_registry_new("udp_exporter_test");
+  const char *keys[] = {"host", "cpu"};
+  test_gauge = prom_gauge_new("test_gauge", "gauge under test", 2, keys);
+  prom_collector_t *collector = prom_collector_new("udp_exporter");
+  prom_collector_add_metric(collector, test_gauge);
+  prom_collector_registry_register_collector(registry, collector);
+}
+
+static void test_registry_destroy(void) {
+  prom_collector_registry_destroy(registry);
+  registry = NULL;
+}
+
+static prom_udp_exporter_t *test_udp_exporter_new(prom_udp_exporter_format_t format, size_t mtu) {
+  prom_udp_exporter_config_t config;
+  memset(&config, 0, sizeof(config));
+  config.host = "127.0.0.1";
+  config.port = listener_port;
+  config.format = format;
+  config.mtu = mtu;
+  return prom_udp_exporter_new(&config);
+}
+
+void test_prom_udp_exporter_influx(void) {
+  test_listener_start();
+  test_registry_init();
+  const char *values[] = {"a b,c", "0"};
+  prom_gauge_set(test_gauge, 1.5, values);
+
+  prom_udp_exporter_t *exporter = test_udp_exporter_new(PROM_UDP_EXPORTER_INFLUX, 0);
+  TEST_ASSERT_NOT_NULL(exporter);
+
+  // Serialization alone, with a fixed timestamp
+  TEST_ASSERT_EQUAL_INT(0, prom_udp_exporter_serialize(exporter, registry, 1000));
+  TEST_ASSERT_EQUAL_INT(1, exporter->datagram_count);
+  const char *expected = "test_gauge,host=a\\ b\\,c,cpu=0 value=1.5 1000\n";
+  TEST_ASSERT_EQUAL_INT(strlen(expected), exporter->buf_len);
+  TEST_ASSERT_EQUAL_MEMORY(expected, exporter->buf, exporter->buf_len);
+
+  // Over the wire the line is stamped with the current time
+  TEST_ASSERT_EQUAL_INT(0, prom_udp_exporter_send(exporter, registry));
+  char buf[2048];
+  TEST_ASSERT_TRUE(test_listener_recv(buf, sizeof(buf)) > 0);
+  TEST_ASSERT_EQUAL_STRING_LEN("test_gauge,host=a\\ b\\,c,cpu=0 value=1.5 ", buf, strlen(expected) - 5);
+  TEST_ASSERT_EQUAL_INT('\n', buf[strlen(buf) - 1]);
+
+  prom_udp_exporter_stats_t stats;
+  TEST_ASSERT_EQUAL_INT(0, prom_udp_exporter_stats(exporter, &stats));
+  TEST_ASSERT_EQUAL_INT(1, stats.datagrams_sent);
+  TEST_ASSERT_EQUAL_INT(0, stats.datagrams_dropped);
+  TEST_ASSERT_EQUAL_INT(strlen(buf), stats.bytes_sent);
+
+  prom_udp_exporter_destroy(exporter);
+  test_registry_destroy();
+  test_listener_stop();
+}
+
+void test_prom_udp_exporter_statsd(void) {
+  test_listener_start();
+  test_registry_init();
+  const char *values[] = {"a|b", "0"};
+  prom_gauge_set(test_gauge, -2.0, values);
+  const char *nan_values[] = {"nan", "1"};
+  prom_gauge_set(test_gauge, NAN, nan_values);
+
+  prom_udp_exporter_t *exporter = test_udp_exporter_new(PROM_UDP_EXPORTER_STATSD, 0);
+  TEST_ASSERT_NOT_NULL(exporter);
+  TEST_ASSERT_EQUAL_INT(0, prom_udp_exporter_send(exporter, registry));
+
+  // The negative gauge is reset to zero first and the NaN sample is skipped
+  char buf[2048];
+  TEST_ASSERT_TRUE(test_listener_recv(buf, sizeof(buf)) > 0);
+  TEST_ASSERT_EQUAL_STRING(
+      "test_gauge:0|g|#host:a_b,cpu:0\n"
+      "test_gauge:-2|g|#host:a_b,cpu:0\n",
+      buf);
+  TEST_ASSERT_EQUAL_INT(-1, test_listener_recv(buf, sizeof(buf)));
+
+  prom_udp_exporter_destroy(exporter);
+  test_registry_destroy();
+  test_listener_stop();
+}
+
+void test_prom_udp_exporter_mtu(void) {
+  test_listener_start();
+  test_registry_init();
+  size_t sample_count = 50;
+  for (size_t i = 0; i < sample_count; i++) {
+    char cpu[16];
+    sprintf(cpu, "%zu", i);
+    const char *values[] = {"host", cpu};
+    prom_gauge_set(test_gauge, (double)i, values);
+  }
+
+  size_t mtu = 128;
+  prom_udp_exporter_t *exporter = test_udp_exporter_new(PROM_UDP_EXPORTER_INFLUX, mtu);
+  TEST_ASSERT_NOT_NULL(exporter);
+  TEST_ASSERT_EQUAL_INT(0, prom_udp_exporter_send(exporter, registry));
+  size_t datagram_count = exporter->datagram_count;
+  TEST_ASSERT_TRUE(datagram_count > 1);
+
+  // Every datagram fits the MTU, holds whole lines and together they carry every sample
+  size_t lines = 0;
+  size_t received = 0;
+  char buf[2048];
+  ssize_t n;
+  while ((n = test_listener_recv(buf, sizeof(buf))) > 0) {
+    received++;
+    TEST_ASSERT_TRUE((size_t)n <= mtu);
+    TEST_ASSERT_EQUAL_INT('\n', buf[n - 1]);
+    for (ssize_t i = 0; i < n; i++) lines += buf[i] == '\n';
+  }
+  TEST_ASSERT_EQUAL_INT(datagram_count, received);
+  TEST_ASSERT_EQUAL_INT(sample_count, lines);
+
+  // The next cycle reuses the buffers
+  char *buf_before = exporter->buf;
+  size_t buf_cap = exporter->buf_cap;
+  size_t datagram_cap = exporter->datagram_cap;
+  TEST_ASSERT_EQUAL_INT(0, prom_udp_exporter_send(exporter, registry));
+  TEST_ASSERT_EQUAL_PTR(buf_before, exporter->buf);
+  TEST_ASSERT_EQUAL_INT(buf_cap, exporter->buf_cap);
+  TEST_ASSERT_EQUAL_INT(datagram_cap, exporter->datagram_cap);
+
+  prom_udp_exporter_stats_t stats;
+  prom_udp_exporter_stats(exporter, &stats);
+  TEST_ASSERT_EQUAL_INT(2 * datagram_count, stats.datagrams_sent);
+
+  prom_udp_exporter_destroy(exporter);
+  test_registry_destroy();
+  test_listener_stop();
+}
+
+int main(int argc, const char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_prom_udp_exporter_influx);
+  RUN_TEST(test_prom_udp_exporter_statsd);
+  RUN_TEST(test_prom_udp_exporter_mtu);
+  return UNITY_END();
+}
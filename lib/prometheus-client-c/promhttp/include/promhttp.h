@@ -27,6 +27,8 @@
 
 #include "microhttpd.h"
 #include "prom_collector_registry.h"
+#include "prom_history.h"
+#include "prom_summary.h"
 
 /**
  * @brief Sets the active registry for metric scraping.
@@ -36,6 +38,26 @@
  */
 void promhttp_set_active_collector_registry(prom_collector_registry_t *active_registry);
 
+/**
+ * @brief Sets a summary that observes the seconds each /metrics request spends rendering the registry.
+ *
+ * @param scrape_summary An unlabeled prom_summary_t*, or NULL to stop observing. The summary is not owned and MUST
+ *                       outlive the daemon.
+ */
+void promhttp_set_scrape_summary(prom_summary_t *scrape_summary);
+
+/**
+ * @brief Sets the history served at /api/v1/query_range.
+ *
+ * The endpoint takes the GET arguments of the Prometheus range query API: start and end as unix times in seconds, and
+ * step in seconds or as a duration such as 100ms, 15s, 5m or 1h. A missing step returns the recorded samples rather
+ * than points at each step. query is the name of a metric; PromQL expressions are not evaluated.
+ *
+ * @param history The prom_history_t* to query, or NULL to disable the endpoint. The history is not owned and MUST
+ *                outlive the daemon.
+ */
+void promhttp_set_history(prom_history_t *history);
+
 /**
  *  @brief Starts a daemon in the background and returns a pointer to an HMD_Daemon.
  *
@@ -46,3 +68,24 @@ void promhttp_set_active_collector_registry(prom_collector_registry_t *active_re
  */
 struct MHD_Daemon *promhttp_start_daemon(unsigned int flags, unsigned short port, MHD_AcceptPolicyCallback apc,
                                          void *apc_cls);
+
+/**
+ *  @brief Starts a daemon in the background that listens on a single local address instead of every interface.
+ *
+ * @param address An IPv4 or IPv6 literal such as "127.0.0.1" or "::1". MHD_USE_IPv6 is added to flags as required.
+ * @param port The TCP port
+ * @return struct MHD_Daemon* or NULL if the address cannot be parsed or bound
+ */
+struct MHD_Daemon *promhttp_start_daemon_on_address(unsigned int flags, const char *address, unsigned short port,
+                                                    MHD_AcceptPolicyCallback apc, void *apc_cls);
+
+/**
+ *  @brief Starts a daemon in the background that listens on a Unix domain socket. A stale socket file left at path by
+ *  a previous process, one that refuses connections, is replaced. The socket is created with the permissions allowed
+ *  by the process umask.
+ *
+ * @param path The file system path of the socket
+ * @return struct MHD_Daemon* or NULL upon failure. errno is EADDRINUSE if path exists and is not a stale socket.
+ */
+struct MHD_Daemon *promhttp_start_daemon_on_unix_socket(unsigned int flags, const char *path,
+                                                        MHD_AcceptPolicyCallback apc, void *apc_cls);
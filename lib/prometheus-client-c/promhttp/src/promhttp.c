@@ -14,13 +14,84 @@
  * limitations under the License.
  */
 
+#include <arpa/inet.h>
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "microhttpd.h"
 #include "prom.h"
 
 prom_collector_registry_t *PROM_ACTIVE_REGISTRY;
 
+static prom_metric_sample_summary_t *promhttp_scrape_sample;
+
+static prom_history_t *promhttp_history;
+
+// The number of response buffers kept between scrapes. Scrapes beyond this many in flight at once render into a buffer
+// of their own that MHD frees.
+#define PROMHTTP_BUFFER_COUNT 4
+
+// A response buffer that MHD holds while the response is sent. It is kept once released, so scrapes stop allocating
+// after the buffer has grown to fit the output.
+typedef struct promhttp_buffer {
+  char *data;
+  size_t cap;
+  bool busy;
+} promhttp_buffer_t;
+
+static promhttp_buffer_t promhttp_buffers[PROMHTTP_BUFFER_COUNT];
+
+// Guards the fields of every buffer. A scrape renders into a copy of data and cap taken while the lock is held, so a
+// release looking for its buffer never reads a pointer that another scrape is reallocating.
+static pthread_mutex_t promhttp_buffers_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Marks a free buffer busy and hands its memory to the caller, or returns NULL if every buffer is busy
+static promhttp_buffer_t *promhttp_buffer_acquire(char **data, size_t *cap) {
+  promhttp_buffer_t *self = NULL;
+  pthread_mutex_lock(&promhttp_buffers_lock);
+  for (int i = 0; i < PROMHTTP_BUFFER_COUNT; i++) {
+    if (!promhttp_buffers[i].busy) {
+      self = &promhttp_buffers[i];
+      self->busy = true;
+      *data = self->data;
+      *cap = self->cap;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&promhttp_buffers_lock);
+  return self;
+}
+
+// Stores the memory the caller rendered into back in the buffer. The buffer stays busy while MHD holds the response.
+static void promhttp_buffer_put(promhttp_buffer_t *self, char *data, size_t cap, bool busy) {
+  pthread_mutex_lock(&promhttp_buffers_lock);
+  self->data = data;
+  self->cap = cap;
+  self->busy = busy;
+  pthread_mutex_unlock(&promhttp_buffers_lock);
+}
+
+// Called by MHD with the response data once the response is destroyed
+static void promhttp_buffer_release(void *data) {
+  pthread_mutex_lock(&promhttp_buffers_lock);
+  for (int i = 0; i < PROMHTTP_BUFFER_COUNT; i++) {
+    if (promhttp_buffers[i].busy && promhttp_buffers[i].data == data) {
+      promhttp_buffers[i].busy = false;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&promhttp_buffers_lock);
+}
+
 void promhttp_set_active_collector_registry(prom_collector_registry_t *active_registry) {
   if (!active_registry) {
     PROM_ACTIVE_REGISTRY = PROM_COLLECTOR_REGISTRY_DEFAULT;
@@ -29,6 +100,43 @@ void promhttp_set_active_collector_registry(prom_collector_registry_t *active_re
   }
 }
 
+void promhttp_set_scrape_summary(prom_summary_t *scrape_summary) {
+  promhttp_scrape_sample = scrape_summary == NULL ? NULL : prom_summary_child(scrape_summary, NULL);
+}
+
+void promhttp_set_history(prom_history_t *history) { promhttp_history = history; }
+
+// prom_free may be a macro, so MHD is handed this instead
+static void promhttp_free(void *data) { prom_free(data); }
+
+// Parses a time in seconds into milliseconds. A duration may instead end in one of the units ms, s, m or h.
+static bool promhttp_parse_ms(const char *value, bool duration, int64_t *ms) {
+  if (value == NULL || value[0] == '\0') return false;
+  char *end = NULL;
+  double number = strtod(value, &end);
+  if (end == value || !isfinite(number)) return false;
+  double scale = 1000.0;
+  if (duration && strcmp(end, "ms") == 0) {
+    scale = 1.0;
+  } else if (duration && strcmp(end, "m") == 0) {
+    scale = 60000.0;
+  } else if (duration && strcmp(end, "h") == 0) {
+    scale = 3600000.0;
+  } else if (!(duration && strcmp(end, "s") == 0) && *end != '\0') {
+    return false;
+  }
+  // Beyond this the milliseconds do not fit an int64_t
+  if (fabs(number * scale) > 9.2e18) return false;
+  *ms = llround(number * scale);
+  return true;
+}
+
+static double promhttp_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
 enum MHD_Result promhttp_handler(void *cls, struct MHD_Connection *connection, const char *url,
                                   const char *method, const char *version, const char *upload_data,
                                   long unsigned int *upload_data_size, void **con_cls) {
@@ -47,12 +155,79 @@ enum MHD_Result promhttp_handler(void *cls, struct MHD_Connection *connection, c
         return ret;
     }
     if (strcmp(url, "/metrics") == 0) {
-        const char *buf = prom_collector_registry_bridge(PROM_ACTIVE_REGISTRY);
-        struct MHD_Response *response = MHD_create_response_from_buffer(strlen(buf), (void *)buf, MHD_RESPMEM_MUST_FREE);
+        const char *accept = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_ACCEPT);
+        prom_exposition_format_t format = prom_collector_registry_negotiate_format(accept);
+        size_t len = 0;
+        struct MHD_Response *response = NULL;
+        prom_metric_sample_summary_t *scrape_sample = promhttp_scrape_sample;
+        double start = scrape_sample != NULL ? promhttp_now() : 0.0;
+        char *data = NULL;
+        size_t cap = 0;
+        promhttp_buffer_t *pooled = promhttp_buffer_acquire(&data, &cap);
+        if (pooled != NULL) {
+            int r = prom_collector_registry_render(PROM_ACTIVE_REGISTRY, format, &data, &cap, &len);
+            if (scrape_sample != NULL) prom_metric_sample_summary_observe(scrape_sample, promhttp_now() - start);
+            promhttp_buffer_put(pooled, data, cap, r == 0);
+            if (r == 0) {
+                response = MHD_create_response_from_buffer_with_free_callback(len, data, &promhttp_buffer_release);
+            }
+            if (response == NULL) promhttp_buffer_put(pooled, data, cap, false);
+        } else {
+            const char *buf = prom_collector_registry_bridge_format(PROM_ACTIVE_REGISTRY, format, &len);
+            if (scrape_sample != NULL) prom_metric_sample_summary_observe(scrape_sample, promhttp_now() - start);
+            if (buf != NULL) response = MHD_create_response_from_buffer(len, (void *)buf, MHD_RESPMEM_MUST_FREE);
+        }
+        if (response == NULL) {
+            char *err = "Internal Server Error\n";
+            response = MHD_create_response_from_buffer(strlen(err), (void *)err, MHD_RESPMEM_PERSISTENT);
+            int ret = MHD_queue_response(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
+            MHD_destroy_response(response);
+            return ret;
+        }
+        MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_TYPE, prom_collector_registry_content_type(format));
         int ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
         MHD_destroy_response(response);
         return ret;
     }
+    if (strcmp(url, "/api/v1/query_range") == 0 && promhttp_history != NULL) {
+        const char *query = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "query");
+        const char *start = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "start");
+        const char *end = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "end");
+        const char *step = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "step");
+        int64_t start_ms = 0;
+        int64_t end_ms = 0;
+        int64_t step_ms = 0;
+        struct MHD_Response *response = NULL;
+        int status = MHD_HTTP_BAD_REQUEST;
+        if (!promhttp_parse_ms(start, false, &start_ms) || !promhttp_parse_ms(end, false, &end_ms) ||
+            (step != NULL && !promhttp_parse_ms(step, true, &step_ms))) {
+            char *err = "{\"status\":\"error\",\"errorType\":\"bad_data\","
+                        "\"error\":\"invalid start, end or step parameter\"}";
+            response = MHD_create_response_from_buffer(strlen(err), (void *)err, MHD_RESPMEM_PERSISTENT);
+        } else {
+            char *buf = NULL;
+            size_t cap = 0;
+            size_t len = 0;
+            int r = prom_history_query_range(promhttp_history, query != NULL ? query : "", start_ms, end_ms, step_ms,
+                                             &buf, &cap, &len);
+            if (buf != NULL) {
+                response = MHD_create_response_from_buffer_with_free_callback(len, buf, &promhttp_free);
+                if (response == NULL) prom_free(buf);
+            }
+            if (r == 0) status = MHD_HTTP_OK;
+        }
+        if (response == NULL) {
+            char *err = "Internal Server Error\n";
+            response = MHD_create_response_from_buffer(strlen(err), (void *)err, MHD_RESPMEM_PERSISTENT);
+            int ret = MHD_queue_response(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
+            MHD_destroy_response(response);
+            return ret;
+        }
+        MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_TYPE, "application/json");
+        int ret = MHD_queue_response(connection, status, response);
+        MHD_destroy_response(response);
+        return ret;
+    }
     char *buf = "Bad Request\n";
     struct MHD_Response *response = MHD_create_response_from_buffer(strlen(buf), (void *)buf, MHD_RESPMEM_PERSISTENT);
     int ret = MHD_queue_response(connection, MHD_HTTP_BAD_REQUEST, response);
@@ -64,3 +239,72 @@ struct MHD_Daemon *promhttp_start_daemon(unsigned int flags, unsigned short port
                                          void *apc_cls) {
   return MHD_start_daemon(flags, port, apc, apc_cls, &promhttp_handler, NULL, MHD_OPTION_END);
 }
+
+struct MHD_Daemon *promhttp_start_daemon_on_address(unsigned int flags, const char *address, unsigned short port,
+                                                    MHD_AcceptPolicyCallback apc, void *apc_cls) {
+  // MHD binds while starting, so the address only has to outlive MHD_start_daemon
+  struct sockaddr_storage addr;
+  memset(&addr, 0, sizeof(addr));
+  struct sockaddr_in *addr4 = (struct sockaddr_in *)&addr;
+  struct sockaddr_in6 *addr6 = (struct sockaddr_in6 *)&addr;
+  if (inet_pton(AF_INET, address, &addr4->sin_addr) == 1) {
+    addr4->sin_family = AF_INET;
+    addr4->sin_port = htons(port);
+  } else if (inet_pton(AF_INET6, address, &addr6->sin6_addr) == 1) {
+    addr6->sin6_family = AF_INET6;
+    addr6->sin6_port = htons(port);
+    flags |= MHD_USE_IPv6;
+  } else {
+    return NULL;
+  }
+  return MHD_start_daemon(flags, port, apc, apc_cls, &promhttp_handler, NULL, MHD_OPTION_SOCK_ADDR,
+                          (struct sockaddr *)&addr, MHD_OPTION_END);
+}
+
+// Removes a socket file left at the address by a process that is gone. Anything else there, including a socket that
+// still accepts connections, is left alone and reported with EADDRINUSE.
+static int promhttp_remove_stale_socket(const struct sockaddr_un *addr) {
+  struct stat st;
+  if (lstat(addr->sun_path, &st)) return errno == ENOENT ? 0 : 1;
+  if (!S_ISSOCK(st.st_mode)) {
+    errno = EADDRINUSE;
+    return 1;
+  }
+
+  int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (probe < 0) return 1;
+  int r = connect(probe, (const struct sockaddr *)addr, sizeof(*addr));
+  int connect_errno = errno;
+  close(probe);
+  if (r == 0 || connect_errno != ECONNREFUSED) {
+    errno = EADDRINUSE;
+    return 1;
+  }
+  return unlink(addr->sun_path);
+}
+
+struct MHD_Daemon *promhttp_start_daemon_on_unix_socket(unsigned int flags, const char *path,
+                                                        MHD_AcceptPolicyCallback apc, void *apc_cls) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) return NULL;
+  strcpy(addr.sun_path, path);
+  if (promhttp_remove_stale_socket(&addr)) return NULL;
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) return NULL;
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(fd, SOMAXCONN)) {
+    close(fd);
+    return NULL;
+  }
+
+  // MHD takes ownership of the listening socket and closes it when the daemon stops
+  struct MHD_Daemon *daemon =
+      MHD_start_daemon(flags, 0, apc, apc_cls, &promhttp_handler, NULL, MHD_OPTION_LISTEN_SOCKET, fd, MHD_OPTION_END);
+  if (daemon == NULL) {
+    close(fd);
+    unlink(path);
+  }
+  return daemon;
+}
@@ -5,8 +5,36 @@
 
 #include "expose_metrics.h"
 
-/** Mutex para sincronización de hilos */
-pthread_mutex_t lock;
+/** Grupo que publica juntas las métricas de memoria */
+static prom_group_t* memory_group;
+/** Grupo que publica juntas las métricas de disco */
+static prom_group_t* disk_group;
+/** Grupo que publica juntas las métricas de red */
+static prom_group_t* network_group;
+
+/**
+ * @brief Contador acumulado del kernel que se publica a través del motor de tasas.
+ *
+ * El kernel sólo expone el total desde el arranque; el motor calcula en cada ciclo cuánto aumentó y a qué ritmo, y
+ * resuelve los reinicios y desbordes del contador.
+ */
+typedef struct
+{
+    const char* rate_name; /**< Nombre del gauge con la tasa por segundo */
+    const char* rate_help; /**< Descripción del gauge con la tasa por segundo */
+    unsigned int bits;     /**< Ancho del contador en el kernel, para detectar desbordes */
+    size_t index;          /**< Índice de la serie en el motor de tasas, asignado al registrarla */
+} CounterSeries;
+
+/** Motor que publica los contadores acumulados y sus tasas, creado con el primero de ellos */
+static prom_rate_t* rates;
+/** Distinto de cero si cada contador acumulado se publica junto con un gauge de su tasa por segundo */
+static int rate_gauges;
+/** Grupos que contienen contadores acumulados; se confirman juntos al publicar las tasas */
+static prom_group_t** const counter_groups[] = {&disk_group, &network_group};
+
+/** Ancho en bits de los contadores que el agente lee como unsigned long */
+#define ULONG_BITS ((unsigned int)(sizeof(unsigned long) * CHAR_BIT))
 
 /** Métrica de Prometheus para el uso de CPU */
 static prom_gauge_t* cpu_usage_metric;
@@ -23,28 +51,48 @@ static prom_gauge_t* used_memory_metric;
 static prom_gauge_t* memory_fragmentation_metric;
 
 /** Métrica de Prometheus para el tiempo de lectura del disco */
-static prom_gauge_t* disk_read_time_metric;
+static prom_counter_t* disk_read_time_metric;
 /** Métrica de Prometheus para el tiempo de escritura del disco */
-static prom_gauge_t* disk_write_time_metric;
+static prom_counter_t* disk_write_time_metric;
 /** Métrica de Prometheus para el número de operaciones de E/S en progreso */
 static prom_gauge_t* disk_io_in_progress_metric;
 /** Métrica de Prometheus para el tiempo de E/S del disco */
-static prom_gauge_t* disk_io_time_metric;
+static prom_counter_t* disk_io_time_metric;
+/** Series de los contadores de disco */
+static CounterSeries disk_read_time_series = {"disk_read_time_ms_per_second",
+                                              "Milisegundos de lectura del disco por segundo", ULONG_BITS, 0};
+static CounterSeries disk_write_time_series = {"disk_write_time_ms_per_second",
+                                               "Milisegundos de escritura del disco por segundo", ULONG_BITS, 0};
+static CounterSeries disk_io_time_series = {"disk_io_time_ms_per_second", "Milisegundos de E/S del disco por segundo",
+                                            ULONG_BITS, 0};
 /** Estructura para almacenar las métricas de disco */
 DiskMetrics metrics_disk;
 
 /** Métrica de Prometheus para los bytes recibidos por la red */
-static prom_gauge_t* network_received_bytes_metric;
+static prom_counter_t* network_received_bytes_metric;
 /** Métrica de Prometheus para los bytes transmitidos por la red */
-static prom_gauge_t* network_transmitted_bytes_metric;
+static prom_counter_t* network_transmitted_bytes_metric;
 /**Metrica de Prometheus para errores recibidos*/
-static prom_gauge_t* network_received_errors_metric;
+static prom_counter_t* network_received_errors_metric;
 /**Metrica de Prometheus para errores transmitidos*/
-static prom_gauge_t* network_transmitted_errors_metric;
+static prom_counter_t* network_transmitted_errors_metric;
 /**Metrica de Prometheus para paquetes recibidos*/
-static prom_gauge_t* network_received_dropped_metric;
+static prom_counter_t* network_received_dropped_metric;
 /**Metrica de Prometheus para paquetes transmitidos*/
-static prom_gauge_t* network_transmitted_dropped_metric;
+static prom_counter_t* network_transmitted_dropped_metric;
+/** Series de los contadores de red */
+static CounterSeries network_received_bytes_series = {"network_received_bytes_per_second",
+                                                      "Bytes recibidos por la red por segundo", ULONG_BITS, 0};
+static CounterSeries network_transmitted_bytes_series = {"network_transmitted_bytes_per_second",
+                                                         "Bytes transmitidos por la red por segundo", ULONG_BITS, 0};
+static CounterSeries network_received_errors_series = {"network_received_errors_per_second",
+                                                       "Errores recibidos por la red por segundo", ULONG_BITS, 0};
+static CounterSeries network_transmitted_errors_series = {"network_transmitted_errors_per_second",
+                                                          "Errores transmitidos por la red por segundo", ULONG_BITS, 0};
+static CounterSeries network_received_dropped_series = {"network_received_dropped_per_second",
+                                                        "Paquetes recibidos descartados por segundo", ULONG_BITS, 0};
+static CounterSeries network_transmitted_dropped_series = {
+    "network_transmitted_dropped_per_second", "Paquetes transmitidos descartados por segundo", ULONG_BITS, 0};
 /** Estructura para almacenar las métricas de red */
 NetworkMetrics metrics_network;
 
@@ -52,7 +100,28 @@ NetworkMetrics metrics_network;
 static prom_gauge_t* running_processes_metric;
 
 /** Métrica de Prometheus para la cantidad de cambios de contexto */
-static prom_gauge_t* context_switches_metric;
+static prom_counter_t* context_switches_metric;
+/** Serie del contador de cambios de contexto, que el kernel lleva en 64 bits */
+static CounterSeries context_switches_series = {"context_switches_per_second", "Cambios de contexto por segundo", 64,
+                                                0};
+
+/** Resumen de Prometheus con los cuantiles de la duración de cada ciclo de recolección */
+static prom_summary_t* collection_duration_metric;
+/** Resumen de Prometheus con los cuantiles de la duración del renderizado de cada scrape */
+static prom_summary_t* scrape_duration_metric;
+
+/** Historial reciente de las series, o NULL si no está habilitado */
+static prom_history_t* history;
+/** Métrica de Prometheus para la memoria que ocupa el historial */
+static prom_gauge_t* history_memory_metric;
+/** Métrica de Prometheus para la memoria de la serie más grande del historial */
+static prom_gauge_t* history_largest_series_metric;
+/** Métrica de Prometheus para el límite de memoria de cada serie del historial */
+static prom_gauge_t* history_series_limit_metric;
+/** Métrica de Prometheus para la cantidad de series del historial */
+static prom_gauge_t* history_series_metric;
+/** Métrica de Prometheus para la cantidad de muestras del historial */
+static prom_gauge_t* history_samples_metric;
 
 // Actualiza la métrica de uso de CPU
 int update_cpu_gauge()
@@ -60,10 +129,7 @@ int update_cpu_gauge()
     double usage = get_cpu_usage();
     if (usage >= 0)
     {
-        pthread_mutex_lock(&lock);
         prom_gauge_set(cpu_usage_metric, usage, NULL);
-        pthread_mutex_unlock(&lock);
-
         return EXIT_SUCCESS;
     }
     else
@@ -83,13 +149,14 @@ int update_memory_gauge()
     double fragmentation = get_memory_fragmentation();
     if (usage >= 0 && total >= 0 && used >= 0 && available >= 0 && fragmentation >= 0)
     {
-        pthread_mutex_lock(&lock);
+        // Los scrapes ven los cinco valores del mismo ciclo
+        prom_group_begin(memory_group);
         prom_gauge_set(memory_usage_metric, usage, NULL);
         prom_gauge_set(total_memory_metric, total, NULL);
         prom_gauge_set(used_memory_metric, used, NULL);
         prom_gauge_set(available_memory_metric, available, NULL);
         prom_gauge_set(memory_fragmentation_metric, fragmentation, NULL);
-        pthread_mutex_unlock(&lock);
+        prom_group_commit(memory_group);
         return EXIT_SUCCESS;
     }
     else
@@ -99,6 +166,19 @@ int update_memory_gauge()
     }
 }
 
+/**
+ * @brief Anota el valor crudo de un contador acumulado; se publica en publish_counter_rates.
+ * @param series Serie del contador.
+ * @param value Valor leído del kernel.
+ */
+static void observe_counter(const CounterSeries* series, uint64_t value)
+{
+    if (rates != NULL)
+    {
+        prom_rate_observe(rates, series->index, value);
+    }
+}
+
 // Actualiza las métricas de disco
 void update_disk_gauge()
 {
@@ -106,12 +186,10 @@ void update_disk_gauge()
     int disk_metrics = get_disk_metrics(&metrics_disk);
     if (disk_metrics >= 0)
     {
-        pthread_mutex_lock(&lock);
-        prom_gauge_set(disk_read_time_metric, (double)metrics_disk.read_time_ms, NULL);
-        prom_gauge_set(disk_write_time_metric, (double)metrics_disk.write_time_ms, NULL);
-        prom_gauge_set(disk_io_in_progress_metric, (double)metrics_disk.io_in_progress, NULL);
-        prom_gauge_set(disk_io_time_metric, (double)metrics_disk.io_time_ms, NULL);
-        pthread_mutex_unlock(&lock);
+        prom_gauge_set_i64(disk_io_in_progress_metric, (int64_t)metrics_disk.io_in_progress, NULL);
+        observe_counter(&disk_read_time_series, metrics_disk.read_time_ms);
+        observe_counter(&disk_write_time_series, metrics_disk.write_time_ms);
+        observe_counter(&disk_io_time_series, metrics_disk.io_time_ms);
     }
     else
     {
@@ -125,14 +203,12 @@ void update_network_gauge()
     int network_metrics = get_network_metrics(&metrics_network);
     if (network_metrics >= 0)
     {
-        pthread_mutex_lock(&lock);
-        prom_gauge_set(network_received_bytes_metric, (double)metrics_network.receive_bytes, NULL);
-        prom_gauge_set(network_transmitted_bytes_metric, (double)metrics_network.transmit_bytes, NULL);
-        prom_gauge_set(network_received_errors_metric, (double)metrics_network.receive_errors, NULL);
-        prom_gauge_set(network_transmitted_errors_metric, (double)metrics_network.transmit_errors, NULL);
-        prom_gauge_set(network_received_dropped_metric, (double)metrics_network.receive_dropped, NULL);
-        prom_gauge_set(network_transmitted_dropped_metric, (double)metrics_network.transmit_dropped, NULL);
-        pthread_mutex_unlock(&lock);
+        observe_counter(&network_received_bytes_series, metrics_network.receive_bytes);
+        observe_counter(&network_transmitted_bytes_series, metrics_network.transmit_bytes);
+        observe_counter(&network_received_errors_series, metrics_network.receive_errors);
+        observe_counter(&network_transmitted_errors_series, metrics_network.transmit_errors);
+        observe_counter(&network_received_dropped_series, metrics_network.receive_dropped);
+        observe_counter(&network_transmitted_dropped_series, metrics_network.transmit_dropped);
     }
     else
     {
@@ -146,9 +222,7 @@ void update_proccess_gauge()
     int running_processes = get_running_processes();
     if (running_processes >= 0)
     {
-        pthread_mutex_lock(&lock);
-        prom_gauge_set(running_processes_metric, running_processes, NULL);
-        pthread_mutex_unlock(&lock);
+        prom_gauge_set_i64(running_processes_metric, running_processes, NULL);
     }
     else
     {
@@ -159,12 +233,10 @@ void update_proccess_gauge()
 // Actualiza la métrica de cambios de contexto
 void update_context_switches_gauge()
 {
-    double context_switches = (double)get_context_switches();
+    long long context_switches = get_context_switches();
     if (context_switches >= 0)
     {
-        pthread_mutex_lock(&lock);
-        prom_gauge_set(context_switches_metric, context_switches, NULL);
-        pthread_mutex_unlock(&lock);
+        observe_counter(&context_switches_series, (uint64_t)context_switches);
     }
     else
     {
@@ -172,195 +244,411 @@ void update_context_switches_gauge()
     }
 }
 
-// Función del hilo para exponer las métricas vía HTTP en el puerto 8000
-void* expose_metrics(void* arg)
+// Publica los contadores acumulados anotados en el ciclo y sus tasas
+void publish_counter_rates()
 {
-    (void)arg; // Argumento no utilizado
-
-    // Aseguramos que el manejador HTTP esté adjunto al registro por defecto
-    promhttp_set_active_collector_registry(NULL);
-
-    // Iniciamos el servidor HTTP en el puerto 8000
-    struct MHD_Daemon* daemon = promhttp_start_daemon(MHD_USE_SELECT_INTERNALLY, 8000, NULL, NULL);
-    if (daemon == NULL)
+    if (rates == NULL)
     {
-        fprintf(stderr, "Error al iniciar el servidor HTTP\n");
-        return NULL;
+        return;
     }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
 
-    // Mantenemos el servidor en ejecución
-    while (1)
+    // Los scrapes ven cada contador junto con su tasa y con los demás contadores de su grupo
+    for (size_t i = 0; i < sizeof(counter_groups) / sizeof(counter_groups[0]); i++)
     {
-        sleep(1);
+        if (*counter_groups[i] != NULL)
+        {
+            prom_group_begin(*counter_groups[i]);
+        }
+    }
+    if (prom_rate_update(rates, (double)now.tv_sec + (double)now.tv_nsec / 1e9) != 0)
+    {
+        fprintf(stderr, "Error al publicar los contadores acumulados\n");
     }
+    for (size_t i = 0; i < sizeof(counter_groups) / sizeof(counter_groups[0]); i++)
+    {
+        if (*counter_groups[i] != NULL)
+        {
+            prom_group_commit(*counter_groups[i]);
+        }
+    }
+}
 
-    // Nunca debería llegar aquí
-    MHD_stop_daemon(daemon);
-    return NULL;
+// Guarda los valores del ciclo en el historial y publica cuánta memoria ocupa
+void record_history()
+{
+    if (history == NULL)
+    {
+        return;
+    }
+    if (prom_history_record(history, PROM_COLLECTOR_REGISTRY_DEFAULT, 0) != 0)
+    {
+        fprintf(stderr, "Error al guardar las métricas en el historial\n");
+    }
+    prom_history_stats_t stats;
+    if (prom_history_stats(history, &stats) == 0)
+    {
+        prom_gauge_set(history_memory_metric, (double)stats.bytes, NULL);
+        prom_gauge_set(history_largest_series_metric, (double)stats.largest_series_bytes, NULL);
+        prom_gauge_set(history_series_limit_metric, (double)stats.series_bytes_limit, NULL);
+        prom_gauge_set(history_series_metric, (double)stats.series, NULL);
+        prom_gauge_set(history_samples_metric, (double)stats.samples, NULL);
+    }
 }
 
-// Inicializar mutex y métricas
-int init_metrics(Config config)
+// Crea el historial reciente y las métricas con su uso de memoria
+static int init_history(Config config)
 {
-    // Inicializamos el mutex
-    if (pthread_mutex_init(&lock, NULL) != 0)
+    prom_history_config_t history_config = {0};
+    history_config.retention = config.history_retention;
+    history_config.series_bytes = (size_t)config.history_series_bytes;
+    history = prom_history_new(&history_config);
+    if (history == NULL)
     {
-        fprintf(stderr, "Error al inicializar el mutex\n");
+        fprintf(stderr, "Error al crear el historial de métricas\n");
         return EXIT_FAILURE;
     }
 
-    // Inicializamos el registro de coleccionistas de Prometheus
-    if (prom_collector_registry_default_init() != 0)
+    history_memory_metric = prom_gauge_new("history_memory_bytes", "Memoria que ocupa el historial reciente", 0, NULL);
+    history_largest_series_metric = prom_gauge_new("history_largest_series_bytes",
+                                                   "Memoria de la serie más grande del historial", 0, NULL);
+    history_series_limit_metric = prom_gauge_new("history_series_limit_bytes",
+                                                 "Memoria máxima de las muestras de cada serie del historial", 0, NULL);
+    history_series_metric = prom_gauge_new("history_series", "Cantidad de series del historial", 0, NULL);
+    history_samples_metric = prom_gauge_new("history_samples", "Cantidad de muestras del historial", 0, NULL);
+    if (prom_collector_registry_must_register_metric(history_memory_metric) == NULL ||
+        prom_collector_registry_must_register_metric(history_largest_series_metric) == NULL ||
+        prom_collector_registry_must_register_metric(history_series_limit_metric) == NULL ||
+        prom_collector_registry_must_register_metric(history_series_metric) == NULL ||
+        prom_collector_registry_must_register_metric(history_samples_metric) == NULL)
     {
-        fprintf(stderr, "Error al inicializar el registro de Prometheus\n");
+        fprintf(stderr, "Error al registrar las métricas del historial\n");
         return EXIT_FAILURE;
     }
+    promhttp_set_history(history);
+    return EXIT_SUCCESS;
+}
 
-    // Creamos la métrica para el uso de CPU
-    cpu_usage_metric = prom_gauge_new("cpu_usage_percentage", "Porcentaje de uso de CPU", 0, NULL);
-    if (cpu_usage_metric == NULL)
+// Registra la duración de un ciclo de recolección
+void observe_collection_duration(double seconds)
+{
+    prom_summary_observe(collection_duration_metric, seconds, NULL);
+}
+
+// Función del hilo para exponer las métricas vía HTTP
+void* expose_metrics(void* arg)
+{
+    Config* config = (Config*)arg;
+
+    // Aseguramos que el manejador HTTP esté adjunto al registro por defecto
+    promhttp_set_active_collector_registry(NULL);
+
+    // Iniciamos el servidor HTTP en TCP, en todas las interfaces o sólo en la dirección configurada
+    struct MHD_Daemon* daemon = NULL;
+    if (config->http_port != 0)
     {
-        fprintf(stderr, "Error al crear la métrica de uso de CPU\n");
-        return EXIT_FAILURE;
+        if (config->http_bind_address != NULL)
+        {
+            daemon = promhttp_start_daemon_on_address(MHD_USE_SELECT_INTERNALLY, config->http_bind_address,
+                                                      (unsigned short)config->http_port, NULL, NULL);
+        }
+        else
+        {
+            daemon = promhttp_start_daemon(MHD_USE_SELECT_INTERNALLY, (unsigned short)config->http_port, NULL, NULL);
+        }
+        if (daemon == NULL)
+        {
+            fprintf(stderr, "Error al iniciar el servidor HTTP en el puerto %d\n", config->http_port);
+        }
     }
 
-    // Creamos la métrica para el uso de memoria
-    memory_usage_metric = prom_gauge_new("memory_usage_percentage", "Porcentaje de uso de memoria", 0, NULL);
-    if (memory_usage_metric == NULL)
+    // Iniciamos el servidor HTTP en el socket Unix para los scrapers locales
+    struct MHD_Daemon* unix_daemon = NULL;
+    if (config->http_unix_socket != NULL)
     {
-        fprintf(stderr, "Error al crear la métrica de uso de memoria\n");
-        return EXIT_FAILURE;
+        unix_daemon = promhttp_start_daemon_on_unix_socket(MHD_USE_SELECT_INTERNALLY, config->http_unix_socket, NULL,
+                                                           NULL);
+        if (unix_daemon == NULL)
+        {
+            // EADDRINUSE indica que la ruta existe y no es un socket abandonado, por lo que no se reemplaza
+            fprintf(stderr, "Error al iniciar el servidor HTTP en %s: %s\n", config->http_unix_socket,
+                    strerror(errno));
+        }
     }
 
-    // Creamos las métricas de memoria (total, usada, disponible, fragmentación)
-    total_memory_metric = prom_gauge_new("total_memory_mb", "Memoria total en MB", 0, NULL);
-    used_memory_metric = prom_gauge_new("used_memory_mb", "Memoria usada en MB", 0, NULL);
-    available_memory_metric = prom_gauge_new("available_memory_mb", "Memoria disponible en MB", 0, NULL);
-    memory_fragmentation_metric = prom_gauge_new("memory_fragmentation_percentage", "Porcentaje de fragmentación de memoria", 0, NULL);
-    if (total_memory_metric == NULL || used_memory_metric == NULL || available_memory_metric == NULL || memory_fragmentation_metric == NULL)
+    if (daemon == NULL && unix_daemon == NULL)
     {
-        fprintf(stderr, "Error al crear la métricas de memoria\n");
-        return EXIT_FAILURE;
+        return NULL;
     }
 
-    // Creamos las métricas de disco
-    disk_read_time_metric = prom_gauge_new("disk_read_time_ms", "Tiempo de lectura del disco en ms", 0, NULL);
-    disk_write_time_metric = prom_gauge_new("disk_write_time_ms", "Tiempo de escritura del disco en ms", 0, NULL);
-    disk_io_in_progress_metric = prom_gauge_new("disk_io_in_progress", "Operaciones de E/S en progreso", 0, NULL);
-    disk_io_time_metric = prom_gauge_new("disk_io_time_ms", "Tiempo de E/S del disco en ms", 0, NULL);
-    if (disk_read_time_metric == NULL || disk_write_time_metric == NULL || disk_io_in_progress_metric == NULL ||
-        disk_io_time_metric == NULL)
+    // Mantenemos el servidor en ejecución
+    while (1)
     {
-        fprintf(stderr, "Error al crear las métricas de disco\n");
-        return EXIT_FAILURE;
+        sleep(1);
     }
 
-    // Creamos las métricas de red
-    network_received_bytes_metric = prom_gauge_new("network_received_bytes", "Bytes recibidos por la red", 0, NULL);
-    network_transmitted_bytes_metric =
-        prom_gauge_new("network_transmitted_bytes", "Bytes transmitidos por la red", 0, NULL);
-    network_received_errors_metric = prom_gauge_new("network_received_errors", "Errores recibidos por la red", 0, NULL);
-    network_transmitted_errors_metric =
-        prom_gauge_new("network_transmitted_errors", "Errores transmitidos por la red", 0, NULL);
-    network_received_dropped_metric =
-        prom_gauge_new("network_received_dropped", "Paquetes recibidos por la red", 0, NULL);
-    network_transmitted_dropped_metric =
-        prom_gauge_new("network_transmitted_dropped", "Paquetes transmitidos por la red", 0, NULL);
-    if (network_received_bytes_metric == NULL || network_transmitted_bytes_metric == NULL ||
-        network_received_errors_metric == NULL || network_transmitted_errors_metric == NULL ||
-        network_received_dropped_metric == NULL || network_transmitted_dropped_metric == NULL)
-    {
-        fprintf(stderr, "Error al crear las métricas de red\n");
-        return EXIT_FAILURE;
+    // Nunca debería llegar aquí
+    if (daemon != NULL)
+    {
+        MHD_stop_daemon(daemon);
     }
+    if (unix_daemon != NULL)
+    {
+        MHD_stop_daemon(unix_daemon);
+    }
+    return NULL;
+}
 
-    // Creamos la métrica para el número de procesos en ejecución
-    running_processes_metric = prom_gauge_new("running_processes", "Número de procesos en ejecución", 0, NULL);
-    if (running_processes_metric == NULL)
+/**
+ * @brief Descriptor estático de una métrica integrada del agente.
+ *
+ * Las métricas se describen en tiempo de compilación y sólo se crean las del grupo habilitado en la configuración.
+ * Las métricas de un grupo con varios valores relacionados se publican juntas a través de un prom_group_t. Los
+ * contadores acumulados del kernel se publican como counters a través del motor de tasas.
+ */
+typedef struct
+{
+    const char* group;           /**< Nombre del grupo en la configuración (p. ej. "cpu_usage") */
+    const char* name;            /**< Nombre de la métrica en Prometheus */
+    const char* help;            /**< Descripción de la métrica */
+    int integer;                 /**< Distinto de cero si la métrica guarda enteros de 64 bits */
+    prom_metric_t** slot;        /**< Variable donde se guarda la métrica creada */
+    prom_group_t** commit_group; /**< Grupo con el que se publica la métrica, o NULL si se publica sola */
+    CounterSeries* counter;      /**< Serie del contador acumulado, o NULL si la métrica es un gauge */
+} MetricDescriptor;
+
+/** Tabla de las métricas integradas, agrupadas según los nombres aceptados en la configuración */
+static const MetricDescriptor metric_descriptors[] = {
+    {"cpu_usage", "cpu_usage_percentage", "Porcentaje de uso de CPU", 0, &cpu_usage_metric, NULL, NULL},
+    {"memory_usage", "memory_usage_percentage", "Porcentaje de uso de memoria", 0, &memory_usage_metric,
+     &memory_group, NULL},
+    {"memory_usage", "total_memory_mb", "Memoria total en MB", 0, &total_memory_metric, &memory_group, NULL},
+    {"memory_usage", "used_memory_mb", "Memoria usada en MB", 0, &used_memory_metric, &memory_group, NULL},
+    {"memory_usage", "available_memory_mb", "Memoria disponible en MB", 0, &available_memory_metric, &memory_group,
+     NULL},
+    {"memory_usage", "memory_fragmentation_percentage", "Porcentaje de fragmentación de memoria", 0,
+     &memory_fragmentation_metric, &memory_group, NULL},
+    {"disk_usage", "disk_read_time_ms_total", "Tiempo de lectura del disco en ms", 1, &disk_read_time_metric,
+     &disk_group, &disk_read_time_series},
+    {"disk_usage", "disk_write_time_ms_total", "Tiempo de escritura del disco en ms", 1, &disk_write_time_metric,
+     &disk_group, &disk_write_time_series},
+    {"disk_usage", "disk_io_in_progress", "Operaciones de E/S en progreso", 1, &disk_io_in_progress_metric, NULL,
+     NULL},
+    {"disk_usage", "disk_io_time_ms_total", "Tiempo de E/S del disco en ms", 1, &disk_io_time_metric, &disk_group,
+     &disk_io_time_series},
+    {"network_usage", "network_received_bytes_total", "Bytes recibidos por la red", 1,
+     &network_received_bytes_metric, &network_group, &network_received_bytes_series},
+    {"network_usage", "network_transmitted_bytes_total", "Bytes transmitidos por la red", 1,
+     &network_transmitted_bytes_metric, &network_group, &network_transmitted_bytes_series},
+    {"network_usage", "network_received_errors_total", "Errores recibidos por la red", 1,
+     &network_received_errors_metric, &network_group, &network_received_errors_series},
+    {"network_usage", "network_transmitted_errors_total", "Errores transmitidos por la red", 1,
+     &network_transmitted_errors_metric, &network_group, &network_transmitted_errors_series},
+    {"network_usage", "network_received_dropped_total", "Paquetes recibidos descartados por la red", 1,
+     &network_received_dropped_metric, &network_group, &network_received_dropped_series},
+    {"network_usage", "network_transmitted_dropped_total", "Paquetes transmitidos descartados por la red", 1,
+     &network_transmitted_dropped_metric, &network_group, &network_transmitted_dropped_series},
+    {"running_processes", "running_processes", "Número de procesos en ejecución", 1, &running_processes_metric, NULL,
+     NULL},
+    {"context_switches", "context_switches_total", "Cantidad de cambios de contexto", 1, &context_switches_metric,
+     NULL, &context_switches_series},
+};
+
+/** Cantidad de métricas integradas */
+#define METRIC_DESCRIPTOR_COUNT (sizeof(metric_descriptors) / sizeof(metric_descriptors[0]))
+
+/**
+ * @brief Agrega una métrica a su grupo de publicación, creándolo si hace falta.
+ *
+ * La métrica se une a su grupo antes de registrarse, cuando todavía ningún scrape puede leerla.
+ *
+ * @param commit_group Variable del grupo, o NULL si la métrica se publica sola.
+ * @param metric Métrica a agregar.
+ * @return 0 si se agregó, -1 en caso de error.
+ */
+static int join_commit_group(prom_group_t** commit_group, prom_metric_t* metric)
+{
+    if (commit_group == NULL)
     {
-        fprintf(stderr, "Error al crear la métrica de procesos en ejecución\n");
-        return EXIT_FAILURE;
+        return 0;
+    }
+    if (*commit_group == NULL)
+    {
+        *commit_group = prom_group_new();
     }
+    if (*commit_group == NULL || prom_group_add(*commit_group, metric) != 0)
+    {
+        return -1;
+    }
+    return 0;
+}
 
-    // Creamos la métrica para la cantidad de cambios de contexto
-    context_switches_metric = prom_gauge_new("context_switches", "Cantidad de cambios de contexto", 0, NULL);
-    if (context_switches_metric == NULL)
+/**
+ * @brief Agrega un contador acumulado al motor de tasas, con su gauge de tasa si está habilitado.
+ *
+ * @param descriptor Descriptor del contador, ya creado y registrado.
+ * @return 0 si se agregó, -1 en caso de error.
+ */
+static int register_counter_series(const MetricDescriptor* descriptor)
+{
+    if (rates == NULL)
     {
-        fprintf(stderr, "Error al crear la métrica de cambios de contexto\n");
-        return EXIT_FAILURE;
+        rates = prom_rate_new();
+        if (rates == NULL)
+        {
+            fprintf(stderr, "Error al crear el motor de tasas\n");
+            return -1;
+        }
     }
 
-    // Registramos las métricas en el registro por defecto
-    // Actualizar las métricas según la configuración
-    for (int i = 0; i < config.metrics_count; i++)
+    prom_metric_sample_t* rate = NULL;
+    if (rate_gauges)
     {
-        if (strcmp(config.metrics[i], "cpu_usage") == 0)
+        prom_gauge_t* gauge = prom_gauge_new(descriptor->counter->rate_name, descriptor->counter->rate_help, 0, NULL);
+        if (gauge == NULL || join_commit_group(descriptor->commit_group, gauge) != 0)
         {
-            if (prom_collector_registry_must_register_metric(cpu_usage_metric) == NULL)
+            fprintf(stderr, "Error al crear la métrica %s\n", descriptor->counter->rate_name);
+            if (gauge != NULL)
             {
-                fprintf(stderr, "Error al registrar la métrica de uso de CPU\n");
-                return EXIT_FAILURE;
+                prom_gauge_destroy(gauge);
             }
+            return -1;
         }
-        else if (strcmp(config.metrics[i], "memory_usage") == 0)
+        if (prom_collector_registry_must_register_metric(gauge) == NULL)
         {
-            if (prom_collector_registry_must_register_metric(memory_usage_metric) == NULL ||
-                prom_collector_registry_must_register_metric(total_memory_metric) == NULL ||
-                prom_collector_registry_must_register_metric(used_memory_metric) == NULL ||
-                prom_collector_registry_must_register_metric(available_memory_metric) == NULL ||
-                prom_collector_registry_must_register_metric(memory_fragmentation_metric) == NULL)
-            {
-                fprintf(stderr, "Error al registrar las métricas de memoria\n");
-                return EXIT_FAILURE;
-            }
+            fprintf(stderr, "Error al crear la métrica %s\n", descriptor->counter->rate_name);
+            return -1;
         }
-        else if (strcmp(config.metrics[i], "disk_usage") == 0)
+        rate = prom_gauge_child(gauge, NULL);
+    }
+
+    prom_metric_sample_t* counter = prom_counter_child(*descriptor->slot, NULL);
+    if (counter == NULL || (rate_gauges && rate == NULL) ||
+        prom_rate_add(rates, counter, rate, descriptor->counter->bits, &descriptor->counter->index) != 0)
+    {
+        fprintf(stderr, "Error al crear la serie de %s\n", descriptor->name);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Crea y registra las métricas de un grupo de la configuración.
+ *
+ * Las métricas que ya fueron creadas (grupo repetido en la configuración) se omiten.
+ *
+ * @param group Nombre del grupo.
+ * @return Cantidad de métricas del grupo, o -1 si alguna no pudo crearse o registrarse.
+ */
+static int register_metric_group(const char* group)
+{
+    int found = 0;
+    for (size_t i = 0; i < METRIC_DESCRIPTOR_COUNT; i++)
+    {
+        const MetricDescriptor* descriptor = &metric_descriptors[i];
+        if (strcmp(descriptor->group, group) != 0)
         {
-            if (prom_collector_registry_must_register_metric(disk_read_time_metric) == NULL ||
-                prom_collector_registry_must_register_metric(disk_write_time_metric) == NULL ||
-                prom_collector_registry_must_register_metric(disk_io_in_progress_metric) == NULL ||
-                prom_collector_registry_must_register_metric(disk_io_time_metric) == NULL)
-            {
-                fprintf(stderr, "Error al registrar las métricas de disco\n");
-                return EXIT_FAILURE;
-            }
+            continue;
         }
-        else if (strcmp(config.metrics[i], "network_usage") == 0)
+        found++;
+        if (*descriptor->slot != NULL)
         {
-            if (prom_collector_registry_must_register_metric(network_received_bytes_metric) == NULL ||
-                prom_collector_registry_must_register_metric(network_transmitted_bytes_metric) == NULL ||
-                prom_collector_registry_must_register_metric(network_received_errors_metric) == NULL ||
-                prom_collector_registry_must_register_metric(network_transmitted_errors_metric) == NULL ||
-                prom_collector_registry_must_register_metric(network_received_dropped_metric) == NULL ||
-                prom_collector_registry_must_register_metric(network_transmitted_dropped_metric) == NULL)
-            {
-                fprintf(stderr, "Error al registrar las métricas de red\n");
-                return EXIT_FAILURE;
-            }
+            continue;
+        }
+        prom_metric_t* metric = NULL;
+        if (descriptor->counter != NULL)
+        {
+            metric = prom_counter_u64_new(descriptor->name, descriptor->help, 0, NULL);
         }
-        else if (strcmp(config.metrics[i], "running_processes") == 0)
+        else
         {
-            if (prom_collector_registry_must_register_metric(running_processes_metric) == NULL)
+            metric = descriptor->integer ? prom_gauge_i64_new(descriptor->name, descriptor->help, 0, NULL)
+                                         : prom_gauge_new(descriptor->name, descriptor->help, 0, NULL);
+        }
+        if (metric == NULL)
+        {
+            fprintf(stderr, "Error al crear la métrica %s\n", descriptor->name);
+            return -1;
+        }
+        if (join_commit_group(descriptor->commit_group, metric) != 0)
+        {
+            fprintf(stderr, "Error al agrupar la métrica %s\n", descriptor->name);
+            if (descriptor->counter != NULL)
+            {
+                prom_counter_destroy(metric);
+            }
+            else
             {
-                fprintf(stderr, "Error al registrar la métrica de procesos en ejecución\n");
-                return EXIT_FAILURE;
+                prom_gauge_destroy(metric);
             }
+            return -1;
+        }
+        if (prom_collector_registry_must_register_metric(metric) == NULL)
+        {
+            fprintf(stderr, "Error al crear la métrica %s\n", descriptor->name);
+            return -1;
         }
-        else if (strcmp(config.metrics[i], "context_switches") == 0)
+        *descriptor->slot = metric;
+        if (descriptor->counter != NULL && register_counter_series(descriptor) != 0)
         {
-            if (prom_collector_registry_must_register_metric(context_switches_metric) == NULL)
+            return -1;
+        }
+    }
+    return found;
+}
+
+// Inicializar métricas
+int init_metrics(Config config)
+{
+    // Inicializamos el registro de coleccionistas de Prometheus
+    if (prom_collector_registry_default_init() != 0)
+    {
+        fprintf(stderr, "Error al inicializar el registro de Prometheus\n");
+        return EXIT_FAILURE;
+    }
+
+    // Creamos los resúmenes de latencia del propio agente. Cubren los últimos 10 minutos con memoria fija por serie.
+    collection_duration_metric = prom_summary_new("metrics_collection_duration_seconds",
+                                                  "Duración de cada ciclo de recolección de métricas", 0, NULL, 0, 0,
+                                                  NULL);
+    scrape_duration_metric = prom_summary_new("metrics_scrape_duration_seconds",
+                                              "Duración del renderizado de cada scrape de /metrics", 0, NULL, 0, 0,
+                                              NULL);
+    if (collection_duration_metric == NULL || scrape_duration_metric == NULL)
+    {
+        fprintf(stderr, "Error al crear los resúmenes de latencia\n");
+        return EXIT_FAILURE;
+    }
+    if (prom_collector_registry_must_register_metric(collection_duration_metric) == NULL ||
+        prom_collector_registry_must_register_metric(scrape_duration_metric) == NULL)
+    {
+        fprintf(stderr, "Error al registrar los resúmenes de latencia\n");
+        return EXIT_FAILURE;
+    }
+    promhttp_set_scrape_summary(scrape_duration_metric);
+
+    // Los contadores acumulados se publican junto con su tasa por segundo si así se configuró
+    rate_gauges = config.rate_gauges;
+
+    // El historial reciente se sirve en /api/v1/query_range si así se configuró
+    if (config.history_retention > 0 && init_history(config) != EXIT_SUCCESS)
     {
-                fprintf(stderr, "Error al registrar la métrica de cambios de contexto\n");
         return EXIT_FAILURE;
     }
+
+    // Creamos y registramos sólo las métricas de los grupos habilitados en la configuración
+    for (int i = 0; i < config.metrics_count; i++)
+    {
+        int found = register_metric_group(config.metrics[i]);
+        if (found < 0)
+        {
+            return EXIT_FAILURE;
+        }
+        if (found == 0)
+        {
+            fprintf(stderr, "Métrica desconocida en la configuración: %s\n", config.metrics[i]);
         }
-        // Agregar más métricas según sea necesario
     }
     return EXIT_SUCCESS;
 }
-
-// Destructor de mutex
-void destroy_mutex()
-{
-    pthread_mutex_destroy(&lock);
-}
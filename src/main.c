@@ -24,6 +24,7 @@
 #include "globant.h"
 #include <cjson/cJSON.h> // Para manejar JSON
 #include <stdbool.h>
+#include <time.h>
 
 /**
  * @brief Actualiza las métricas del sistema según la configuración proporcionada.
@@ -55,10 +56,51 @@ int main(int argc, char* argv[])
 
     // Inicializamos Metricas
     init_metrics(config);
+
+    // Modo push: enviamos las métricas a un receptor remote_write si está configurado
+    prom_remote_write_t* remote_write = NULL;
+    if (config.remote_write_url != NULL)
+    {
+        prom_remote_write_config_t rw_config = {0};
+        rw_config.url = config.remote_write_url;
+        rw_config.wal_path = config.remote_write_wal;
+        rw_config.concurrency = config.remote_write_concurrency;
+        remote_write = prom_remote_write_new(&rw_config);
+        if (remote_write == NULL)
+        {
+            fprintf(stderr, "Error al inicializar remote_write hacia %s\n", config.remote_write_url);
+        }
+    }
+
+    // Publicación en memoria compartida para consumidores locales
+    prom_shm_publisher_t* shm_publisher = NULL;
+    if (config.shm_name != NULL)
+    {
+        shm_publisher = prom_shm_publisher_new(config.shm_name, (size_t)config.shm_capacity);
+        if (shm_publisher == NULL)
+        {
+            fprintf(stderr, "Error al crear el segmento de memoria compartida %s\n", config.shm_name);
+        }
+    }
+
+    // Exportador UDP hacia InfluxDB o StatsD si está configurado
+    prom_udp_exporter_t* udp_exporter = NULL;
+    if (config.udp_host != NULL)
+    {
+        prom_udp_exporter_config_t udp_config = {0};
+        udp_config.host = config.udp_host;
+        udp_config.port = (unsigned short)config.udp_port;
+        udp_config.format = config.udp_statsd ? PROM_UDP_EXPORTER_STATSD : PROM_UDP_EXPORTER_INFLUX;
+        udp_exporter = prom_udp_exporter_new(&udp_config);
+        if (udp_exporter == NULL)
+        {
+            fprintf(stderr, "Error al inicializar el exportador UDP hacia %s\n", config.udp_host);
+        }
+    }
     // Creamos un hilo para exponer las métricas vía HTTP
     pthread_t tid;
 
-    if (pthread_create(&tid, NULL, expose_metrics, NULL) != 0)
+    if (pthread_create(&tid, NULL, expose_metrics, &config) != 0)
     {
         fprintf(stderr, "Error al crear el hilo del servidor HTTP\n");
         return EXIT_FAILURE;
@@ -70,6 +112,18 @@ int main(int argc, char* argv[])
     while (true)
     {
         update_metrics(config);
+        if (remote_write != NULL && prom_remote_write_push(remote_write, PROM_COLLECTOR_REGISTRY_DEFAULT) != 0)
+        {
+            fprintf(stderr, "Error al encolar las métricas para remote_write\n");
+        }
+        if (shm_publisher != NULL && prom_shm_publisher_publish(shm_publisher, PROM_COLLECTOR_REGISTRY_DEFAULT) != 0)
+        {
+            fprintf(stderr, "Error al publicar las métricas en memoria compartida\n");
+        }
+        if (udp_exporter != NULL && prom_udp_exporter_send(udp_exporter, PROM_COLLECTOR_REGISTRY_DEFAULT) != 0)
+        {
+            fprintf(stderr, "Error al enviar las métricas por UDP\n");
+        }
         sleep((unsigned int)config.sampling_interval);
     }
 
@@ -79,6 +133,24 @@ int main(int argc, char* argv[])
         free(config.metrics[i]);
     }
     free(config.metrics);
+    if (remote_write != NULL)
+    {
+        prom_remote_write_destroy(remote_write);
+    }
+    free(config.remote_write_url);
+    free(config.remote_write_wal);
+    if (udp_exporter != NULL)
+    {
+        prom_udp_exporter_destroy(udp_exporter);
+    }
+    free(config.udp_host);
+    if (shm_publisher != NULL)
+    {
+        prom_shm_publisher_destroy(shm_publisher);
+    }
+    free(config.shm_name);
+    free(config.http_bind_address);
+    free(config.http_unix_socket);
 
     // Esperamos a que los hilos terminen (aunque en este caso, no lo harán)
     pthread_join(tid, NULL);
@@ -94,6 +166,9 @@ int main(int argc, char* argv[])
  */
 void update_metrics(Config config)
 {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
     // Actualizar las métricas según la configuración
     for (int i = 0; i < config.metrics_count; i++)
     {
@@ -123,6 +198,22 @@ void update_metrics(Config config)
         }
         // Agregar más métricas según sea necesario
     }
+
+    // Los contadores acumulados anotados en el ciclo se publican juntos, con una sola pasada del motor de tasas
+    publish_counter_rates();
+
+    // El historial guarda los valores del ciclo y se consulta en /api/v1/query_range
+    record_history();
+
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    observe_collection_duration((double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9);
+
+    // Cerramos el ciclo: los scrapes hasta la próxima actualización reutilizan la misma salida renderizada
+    prom_collector_registry_advance_generation(PROM_COLLECTOR_REGISTRY_DEFAULT);
+
+    // Cada ciclo cuenta para el TTL de las series; se descartan las que llevan demasiado sin actualizarse
+    prom_collector_registry_sweep(PROM_COLLECTOR_REGISTRY_DEFAULT);
 }
 
 /**
@@ -133,7 +224,7 @@ void update_metrics(Config config)
  */
 Config load_config(const char* filename)
 {
-    Config config = {intervalo, NULL, 0}; // Configuración por defecto
+    Config config = {intervalo, NULL, 0, NULL, NULL, 0, NULL, 0, 0, NULL, HTTP_PORT, NULL, NULL, SHM_CAPACITY, 0, 0, 0}; // Configuración por defecto
 
     FILE* file = fopen(filename, "r"); // Abrir el archivo en modo lectura
     if (file == NULL)
@@ -186,6 +277,103 @@ Config load_config(const char* filename)
         }
     }
 
+    // Publicar también la tasa por segundo de los contadores acumulados (opcional)
+    cJSON* rate_gauges = cJSON_GetObjectItem(json, "rate_gauges");
+    if (cJSON_IsBool(rate_gauges))
+    {
+        config.rate_gauges = cJSON_IsTrue(rate_gauges);
+    }
+
+    // Obtener la configuración del historial reciente en memoria (opcional)
+    cJSON* history = cJSON_GetObjectItem(json, "history");
+    if (cJSON_IsObject(history))
+    {
+        config.history_retention = PROM_HISTORY_DEFAULT_RETENTION;
+        cJSON* retention_hours = cJSON_GetObjectItem(history, "retention_hours");
+        if (cJSON_IsNumber(retention_hours) && retention_hours->valuedouble > 0)
+        {
+            config.history_retention = (int)(retention_hours->valuedouble * 3600);
+        }
+        cJSON* series_bytes = cJSON_GetObjectItem(history, "series_bytes");
+        if (cJSON_IsNumber(series_bytes) && series_bytes->valueint > 0)
+        {
+            config.history_series_bytes = series_bytes->valueint;
+        }
+    }
+
+    // Obtener la configuración de remote_write (opcional)
+    cJSON* remote_write = cJSON_GetObjectItem(json, "remote_write");
+    if (cJSON_IsObject(remote_write))
+    {
+        cJSON* url = cJSON_GetObjectItem(remote_write, "url");
+        if (cJSON_IsString(url))
+        {
+            config.remote_write_url = strdup(url->valuestring);
+        }
+        cJSON* wal_path = cJSON_GetObjectItem(remote_write, "wal_path");
+        if (cJSON_IsString(wal_path))
+        {
+            config.remote_write_wal = strdup(wal_path->valuestring);
+        }
+        cJSON* concurrency = cJSON_GetObjectItem(remote_write, "concurrency");
+        if (cJSON_IsNumber(concurrency))
+        {
+            config.remote_write_concurrency = concurrency->valueint;
+        }
+    }
+
+    // Obtener la configuración del exportador UDP (opcional)
+    cJSON* udp_exporter = cJSON_GetObjectItem(json, "udp_exporter");
+    if (cJSON_IsObject(udp_exporter))
+    {
+        cJSON* host = cJSON_GetObjectItem(udp_exporter, "host");
+        config.udp_host = strdup(cJSON_IsString(host) ? host->valuestring : "127.0.0.1");
+        cJSON* port = cJSON_GetObjectItem(udp_exporter, "port");
+        if (cJSON_IsNumber(port))
+        {
+            config.udp_port = port->valueint;
+        }
+        cJSON* format = cJSON_GetObjectItem(udp_exporter, "format");
+        if (cJSON_IsString(format))
+        {
+            config.udp_statsd = strcmp(format->valuestring, "statsd") == 0;
+        }
+    }
+
+    // Obtener la configuración del servidor HTTP (opcional)
+    cJSON* http = cJSON_GetObjectItem(json, "http");
+    if (cJSON_IsObject(http))
+    {
+        cJSON* bind_address = cJSON_GetObjectItem(http, "bind_address");
+        if (cJSON_IsString(bind_address))
+        {
+            config.http_bind_address = strdup(bind_address->valuestring);
+        }
+        cJSON* port = cJSON_GetObjectItem(http, "port");
+        if (cJSON_IsNumber(port))
+        {
+            config.http_port = port->valueint;
+        }
+        cJSON* unix_socket = cJSON_GetObjectItem(http, "unix_socket");
+        if (cJSON_IsString(unix_socket))
+        {
+            config.http_unix_socket = strdup(unix_socket->valuestring);
+        }
+    }
+
+    // Obtener la configuración de memoria compartida (opcional)
+    cJSON* shm = cJSON_GetObjectItem(json, "shm");
+    if (cJSON_IsObject(shm))
+    {
+        cJSON* name = cJSON_GetObjectItem(shm, "name");
+        config.shm_name = strdup(cJSON_IsString(name) ? name->valuestring : SHM_NAME);
+        cJSON* capacity = cJSON_GetObjectItem(shm, "capacity");
+        if (cJSON_IsNumber(capacity) && capacity->valueint > 0)
+        {
+            config.shm_capacity = capacity->valueint;
+        }
+    }
+
     // Limpiar
     cJSON_Delete(json);
     free(json_data);
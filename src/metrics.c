@@ -8,32 +8,103 @@
 
 #include "metrics.h"
 
+/**
+ * @brief Tamaño inicial del buffer de lectura de /proc.
+ */
+#define PROC_BUFFER_INIT_SIZE 4096
+
+/**
+ * @brief Buffer compartido en el que se leen los archivos de /proc.
+ *
+ * Las funciones de este archivo se llaman desde el hilo de recolección, así que comparten un único buffer. Crece al
+ * doble hasta que entra el archivo más grande y a partir de ahí las lecturas no reservan memoria.
+ */
+static char* proc_buffer = NULL;
+
+/**
+ * @brief Capacidad en bytes de proc_buffer.
+ */
+static size_t proc_buffer_capacity = 0;
+
+/**
+ * @brief Lee un archivo de /proc completo en el buffer compartido.
+ *
+ * A diferencia de fopen, no reserva un FILE ni su buffer de E/S en cada llamada. El contenido es válido hasta la
+ * siguiente lectura.
+ *
+ * @param path Ruta del archivo.
+ * @return Contenido del archivo terminado en NUL, o NULL en caso de error (errno indica la causa).
+ */
+static char* read_proc_file(const char* path)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    size_t len = 0;
+    for (;;)
+    {
+        // Reservar un byte para el NUL final
+        if (proc_buffer_capacity - len < 2)
+        {
+            size_t capacity = proc_buffer_capacity == 0 ? PROC_BUFFER_INIT_SIZE : proc_buffer_capacity * 2;
+            char* buffer = realloc(proc_buffer, capacity);
+            if (buffer == NULL)
+            {
+                close(fd);
+                errno = ENOMEM;
+                return NULL;
+            }
+            proc_buffer = buffer;
+            proc_buffer_capacity = capacity;
+        }
+
+        ssize_t n = read(fd, proc_buffer + len, proc_buffer_capacity - len - 1);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            int saved_errno = errno;
+            close(fd);
+            errno = saved_errno;
+            return NULL;
+        }
+        if (n == 0)
+        {
+            break;
+        }
+        len += (size_t)n;
+    }
+
+    close(fd);
+    proc_buffer[len] = '\0';
+    return proc_buffer;
+}
+
 // Función para obtener la memoria total en MB
 double get_memory_total(void)
 {
-    FILE* fp;
-    char buffer[BUFFER_SIZE];
     unsigned long long total_mem_aux = 0;
 
-    // Abrir el archivo /proc/meminfo
-    fp = fopen("/proc/meminfo", "r");
-    if (fp == NULL)
+    // Leer el archivo /proc/meminfo
+    char* data = read_proc_file("/proc/meminfo");
+    if (data == NULL)
     {
         perror("Error al abrir /proc/meminfo");
         return -1.0; // Retornar -1 en caso de error
     }
 
-    // Leer los valores de memoria total
-    while (fgets(buffer, sizeof(buffer), fp) != NULL)
+    // Buscar el valor de memoria total
+    char* line = strstr(data, "MemTotal:");
+    if (line != NULL)
     {
-        if (sscanf(buffer, "MemTotal: %llu kB", &total_mem_aux) == 1)
-        {
-            break; // MemTotal encontrado, salir del bucle
-        }
+        sscanf(line, "MemTotal: %llu kB", &total_mem_aux);
     }
 
-    fclose(fp);
-
     // Verificar si se encontró el valor
     if (total_mem_aux == 0)
     {
@@ -48,29 +119,23 @@ double get_memory_total(void)
 // Función para obtener la memoria libre en MB
 double get_memory_free(void)
 {
-    FILE* fp;
-    char buffer[BUFFER_SIZE];
     unsigned long long free_mem_aux = 0;
 
-    // Abrir el archivo /proc/meminfo
-    fp = fopen("/proc/meminfo", "r");
-    if (fp == NULL)
+    // Leer el archivo /proc/meminfo
+    char* data = read_proc_file("/proc/meminfo");
+    if (data == NULL)
     {
         perror("Error al abrir /proc/meminfo");
         return -1.0; // Retornar -1 en caso de error
     }
 
-    // Leer los valores de memoria libre
-    while (fgets(buffer, sizeof(buffer), fp) != NULL)
+    // Buscar el valor de memoria libre
+    char* line = strstr(data, "MemAvailable:");
+    if (line != NULL)
     {
-        if (sscanf(buffer, "MemAvailable: %llu kB", &free_mem_aux) == 1)
-        {
-            break; // MemAvailable encontrado, salir del bucle
-        }
+        sscanf(line, "MemAvailable: %llu kB", &free_mem_aux);
     }
 
-    fclose(fp);
-
     // Verificar si se encontró el valor
     if (free_mem_aux == 0)
     {
@@ -135,23 +200,14 @@ double get_cpu_usage(void)
     unsigned long long totald, idled;
     double cpu_usage_percent;
 
-    // Abrir el archivo /proc/stat
-    FILE* fp = fopen("/proc/stat", "r");
-    if (fp == NULL)
+    // Leer el archivo /proc/stat
+    char* buffer = read_proc_file("/proc/stat");
+    if (buffer == NULL)
     {
         perror("Error al abrir /proc/stat");
         return -1.0;
     }
 
-    char buffer[BUFFER_SIZE * 4];
-    if (fgets(buffer, sizeof(buffer), fp) == NULL)
-    {
-        perror("Error al leer /proc/stat");
-        fclose(fp);
-        return -1.0;
-    }
-    fclose(fp);
-
     // Analizar los valores de tiempo de CPU
     int ret = sscanf(buffer, "cpu  %llu %llu %llu %llu %llu %llu %llu %llu", &user, &nice, &system, &idle, &iowait,
                      &irq, &softirq, &steal);
@@ -199,21 +255,22 @@ double get_cpu_usage(void)
 // Función para leer las métricas de disco desde /proc/diskstats
 int get_disk_metrics(DiskMetrics* metrics)
 {
-    FILE* file = fopen("/proc/diskstats", "r");
-    if (file == NULL)
+    char* data = read_proc_file("/proc/diskstats");
+    if (data == NULL)
     {
         perror("Error al abrir /proc/diskstats");
         return -1;
     }
 
-    char buffer[BUFFER_SIZE];
     const char* device_name = "sda";
-    while (fgets(buffer, BUFFER_SIZE, file))
+    char* line_save = NULL;
+    for (char* buffer = strtok_r(data, "\n", &line_save); buffer != NULL; buffer = strtok_r(NULL, "\n", &line_save))
     {
         if (strstr(buffer, device_name) != NULL)
         {
-            // Utilizamos strtok para dividir la línea en campos
-            char* token = strtok(buffer, " ");
+            // Utilizamos strtok_r para dividir la línea en campos
+            char* field_save = NULL;
+            char* token = strtok_r(buffer, " ", &field_save);
             int field = 0;
             while (token != NULL)
             {
@@ -234,36 +291,33 @@ int get_disk_metrics(DiskMetrics* metrics)
                 { // Campo 11: io_time_ms
                     metrics->io_time_ms = strtoul(token, NULL, 10);
                 }
-                token = strtok(NULL, " ");
+                token = strtok_r(NULL, " ", &field_save);
                 field++;
             }
 
-            fclose(file);
             return 0; // Éxito
         }
     }
 
-    fclose(file);
     return -1; // Dispositivo no encontrado
 }
 
 // Función para extraer las métricas desde /proc/net/dev
 int get_network_metrics(NetworkMetrics* metrics)
 {
-    FILE* fp;
-    char buffer[BUFFER_SIZE];
     char* token;
     int buffer_num = 0;
 
-    fp = fopen("/proc/net/dev", "r");
-    if (fp == NULL)
+    char* data = read_proc_file("/proc/net/dev");
+    if (data == NULL)
     {
         perror("Error al abrir /proc/net/dev");
         return -1;
     }
 
     // Salta las dos primeras bufferas de encabezado
-    while (fgets(buffer, BUFFER_SIZE, fp) != NULL)
+    char* line_save = NULL;
+    for (char* buffer = strtok_r(data, "\n", &line_save); buffer != NULL; buffer = strtok_r(NULL, "\n", &line_save))
     {
         if (buffer_num < 2)
         {
@@ -272,109 +326,92 @@ int get_network_metrics(NetworkMetrics* metrics)
         }
 
         // Tokenizar la línea por espacios
-        token = strtok(buffer, ":");
+        char* field_save = NULL;
+        token = strtok_r(buffer, ":", &field_save);
         if (token)
         {
             // Obtener nombre de la interfaz
             strcpy(metrics->interface, token);
 
             // Continuar con los valores de la interfaz (primero es el de Receive)
-            token = strtok(NULL, " ");
+            token = strtok_r(NULL, " ", &field_save);
             if (token)
             {
                 // Leer los datos de Receive (primero están los bytes, luego errs y drop)
                 metrics->receive_bytes = strtoul(token, NULL, 10);
                 for (int i = 0; i < 2; i++)
-                    token = strtok(NULL, " ");                                   // Saltar packets
-                metrics->receive_errors = strtoul(token, NULL, 10);              // Tercer valor (errs)
-                metrics->receive_dropped = strtoul(strtok(NULL, " "), NULL, 10); // Cuarto valor (drop)
+                    token = strtok_r(NULL, " ", &field_save);                                   // Saltar packets
+                metrics->receive_errors = strtoul(token, NULL, 10);                             // Tercer valor (errs)
+                metrics->receive_dropped = strtoul(strtok_r(NULL, " ", &field_save), NULL, 10); // Cuarto valor (drop)
 
                 // Saltar los campos restantes de Receive
                 for (int i = 0; i < 5; i++)
-                    token = strtok(NULL, " ");
+                    token = strtok_r(NULL, " ", &field_save);
 
                 // Leer los datos de Transmit (nuevamente bytes, errs y drop)
                 metrics->transmit_bytes = strtoul(token, NULL, 10); // Bytes de Transmit
                 for (int i = 0; i < 2; i++)
-                    token = strtok(NULL, " ");                                    // Saltar packets
-                metrics->transmit_errors = strtoul(token, NULL, 10);              // Errores de Transmit
-                metrics->transmit_dropped = strtoul(strtok(NULL, " "), NULL, 10); // Paquetes descartados de Transmit
+                    token = strtok_r(NULL, " ", &field_save);          // Saltar packets
+                metrics->transmit_errors = strtoul(token, NULL, 10); // Errores de Transmit
+                metrics->transmit_dropped =
+                    strtoul(strtok_r(NULL, " ", &field_save), NULL, 10); // Paquetes descartados de Transmit
             }
         }
 
         buffer_num++;
     }
 
-    fclose(fp);
     return 0;
 }
 
 // Función para obtener el número de procesos en ejecución
 int get_running_processes(void)
 {
-    FILE* fp;
-    char buffer[BUFFER_SIZE];
     int running_processes = 0;
 
-    // Abrir el archivo /proc/loadavg
-    fp = fopen("/proc/stat", "r");
-    if (fp == NULL)
+    // Leer el archivo /proc/stat
+    char* data = read_proc_file("/proc/stat");
+    if (data == NULL)
     {
         perror("Error al abrir /proc/stat");
         return -1; // Retornar -1 en caso de error
     }
 
-    // Leer los valores de /proc/stat
-    while (fgets(buffer, sizeof(buffer), fp) != NULL)
+    // Buscar la línea que comienza con "procs_running" y extraer el número de procesos en ejecución
+    char* line = strstr(data, "\nprocs_running ");
+    if (line != NULL)
     {
-        // Buscar la línea que comienza con "procs_running"
-        if (strncmp(buffer, "procs_running", 13) == 0)
-        {
-            // Extraer el número de procesos en ejecución
-            sscanf(buffer, "procs_running %d", &running_processes);
-            break;
-        }
+        sscanf(line + 1, "procs_running %d", &running_processes);
     }
 
     // Verificar si se encontró el valor
     if (running_processes == 0)
     {
         fprintf(stderr, "Error al leer el número de procesos en ejecución desde /proc/stat\n");
-        fclose(fp);
         return -1; // Retornar -1 en caso de error
     }
 
-    fclose(fp);
-
     return running_processes;
 }
 
 // Función para obtener la cantidad de cambios de contexto
 long long get_context_switches(void)
 {
-    FILE* fp;
-    char buffer[BUFFER_SIZE];
     unsigned long long context_switches = 0;
 
-    fp = fopen("/proc/stat", "r");
-    if (fp == NULL)
+    char* data = read_proc_file("/proc/stat");
+    if (data == NULL)
     {
         perror("Error al abrir /proc/stat");
         return -1;
     }
 
-    // Leer las líneas de /proc/stat
-    while (fgets(buffer, sizeof(buffer), fp) != NULL)
+    // Buscar la línea que comienza con "ctxt" y obtener el número de cambios de contexto
+    char* line = strstr(data, "\nctxt ");
+    if (line != NULL)
     {
-        // Buscar la línea que comienza con "ctxt"
-        if (strncmp(buffer, "ctxt", 4) == 0)
-        {
-            // Parsear la línea y obtener el número de cambios de contexto
-            sscanf(buffer, "ctxt %llu", &context_switches);
-            break;
-        }
+        sscanf(line + 1, "ctxt %llu", &context_switches);
     }
 
-    fclose(fp);
     return (long long)context_switches;
 }
@@ -0,0 +1,85 @@
+/**
+ * @file shm_dump.c
+ * @brief Herramienta que imprime las métricas publicadas en memoria compartida
+ *
+ * Abre en sólo lectura el segmento que publica el agente y muestra una línea por serie con su valor, en el mismo
+ * formato que la exposición de texto de Prometheus. La lectura no realiza llamadas al sistema: toma una instantánea
+ * consistente protegida por el seqlock del segmento.
+ *
+ * Uso: shm_dump [segmento] [intervalo_ms]
+ *
+ * Si se indica un intervalo, la instantánea se repite hasta que el proceso sea interrumpido.
+ */
+
+#include "globant.h"
+#include <inttypes.h>
+#include <prom.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * @brief Imprime una instantánea del segmento.
+ *
+ * @param reader Lector del segmento.
+ * @param values Arreglo con espacio para la capacidad del segmento.
+ * @return 0 si la instantánea fue consistente, 1 en caso contrario
+ */
+static int dump_snapshot(prom_shm_reader_t* reader, double* values)
+{
+    size_t count = 0;
+    uint64_t timestamp_ms = 0;
+    if (prom_shm_reader_snapshot(reader, values, &count, &timestamp_ms) != 0)
+    {
+        fprintf(stderr, "Error al leer una instantánea consistente del segmento\n");
+        return 1;
+    }
+
+    printf("# timestamp_ms %" PRIu64 "\n", timestamp_ms);
+    for (size_t i = 0; i < count; i++)
+    {
+        const prom_shm_descriptor_t* descriptor = prom_shm_reader_descriptor(reader, i);
+        printf("%s %.17g\n", descriptor->name, values[i]);
+    }
+    fflush(stdout);
+    return 0;
+}
+
+/**
+ * @brief Función principal
+ * @param argc Cantidad de argumentos
+ * @param argv Argumentos de la línea de comandos
+ * @return 0 si la ejecución fue exitosa, 1 en caso contrario
+ */
+int main(int argc, char* argv[])
+{
+    const char* name = argc > 1 ? argv[1] : SHM_NAME;
+    long interval_ms = argc > 2 ? strtol(argv[2], NULL, 10) : 0;
+
+    prom_shm_reader_t* reader = prom_shm_reader_open(name);
+    if (reader == NULL)
+    {
+        fprintf(stderr, "Error al abrir el segmento de memoria compartida %s\n", name);
+        return EXIT_FAILURE;
+    }
+
+    double* values = malloc(prom_shm_reader_capacity(reader) * sizeof(double));
+    if (values == NULL)
+    {
+        fprintf(stderr, "Error al reservar memoria\n");
+        prom_shm_reader_close(reader);
+        return EXIT_FAILURE;
+    }
+
+    int result = dump_snapshot(reader, values);
+    while (interval_ms > 0 && result == 0)
+    {
+        struct timespec delay = {interval_ms / 1000, (interval_ms % 1000) * 1000000};
+        nanosleep(&delay, NULL);
+        result = dump_snapshot(reader, values);
+    }
+
+    free(values);
+    prom_shm_reader_close(reader);
+    return result == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}